@@ -6,12 +6,13 @@
 #include "debug.h"
 
 #include "framework/app_framework.h"
+#include "framework/irq_dispatch.h"
 
 #define ADC_BUFFER_SIZE 10
 volatile uint16_t adc_buffer[ADC_BUFFER_SIZE];
 volatile uint8_t dma_complete = 0;
 
-void DMA1_Channel1_IRQHandler(void){
+static void adc_dma_irq_handler(void){
     if(DMA_GetITStatus(DMA1_IT_TC1) != RESET) {
         dma_complete = 1;
         DMA_ClearITPendingBit(DMA1_IT_TC1);
@@ -53,6 +54,7 @@ void adc_dma_setup(void){
     DMA_ITConfig(DMA1_Channel1, DMA_IT_TC, ENABLE);
 
     // Configure NVIC for DMA
+    irq_attach(DMA1_Channel1_IRQn, adc_dma_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel1_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
@@ -0,0 +1,70 @@
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "adc_oversample.h"
+#include "timebase.h"
+
+// PA0 at 16 bits: 256 samples per result at the maximum rate the 7.5-cycle
+// sample time allows (600 kHz, ~2340 results/s). The loop measures how
+// much of the CPU the accumulation takes by counting idle spins against a
+// run with the ADC stopped.
+#define ADC_HIGHRES_EXTRA_BITS 4
+#define ADC_HIGHRES_FRAMES     512
+#define ADC_HIGHRES_WINDOW_MS  100
+
+static const adc_scan_channel_t adc_highres_channel = {ADC_Channel_0, ADC_SampleTime_7Cycles5};
+
+static uint16_t adc_highres_buffer[2 * ADC_HIGHRES_FRAMES] __attribute__((aligned(4)));
+static uint32_t adc_highres_idle_spins = 1;
+
+static uint32_t adc_highres_spin(void){
+    uint32_t start = timebase_ticks();
+    uint32_t window = timebase_tick_hz() / 1000 * ADC_HIGHRES_WINDOW_MS;
+    uint32_t spins = 0;
+
+    while(timebase_ticks() - start < window) {
+        spins++;
+    }
+
+    return spins;
+}
+
+void adc_highres_setup(void){
+    adc_oversample_config_t config;
+
+    printf("ADC High Resolution Setup\n");
+
+    // Spins in the window with nothing else running
+    adc_highres_idle_spins = adc_highres_spin();
+
+    config.channels = &adc_highres_channel;
+    config.channel_count = 1;
+    config.extra_bits = ADC_HIGHRES_EXTRA_BITS;
+    config.buffer = adc_highres_buffer;
+    config.frames = ADC_HIGHRES_FRAMES;
+    config.timer = NULL;
+    config.rate_hz = 0;
+    config.dither = 0;
+    config.callback = NULL;
+
+    if(adc_oversample_init(&config) != 0 || adc_oversample_start() != 0) {
+        printf("ADC High Resolution: Init failed\n");
+    }
+}
+
+void adc_highres_loop(void){
+    const adc_oversample_stats_t *stats = adc_oversample_get_stats();
+    uint32_t results = stats->results;
+    uint32_t spins = adc_highres_spin();
+    uint32_t busy = spins < adc_highres_idle_spins ? adc_highres_idle_spins - spins : 0;
+    uint16_t value = adc_oversample_read(0);
+
+    // 16-bit result against a 3.3 V reference, in microvolts
+    printf("ADC High Resolution: %u (%d uV), %d results/s, CPU %d.%d%%, %d overruns\n",
+           value, (int)((uint32_t)value * 3300000ULL / 65536),
+           (int)((stats->results - results) * 1000 / ADC_HIGHRES_WINDOW_MS),
+           (int)(busy * 100ULL / adc_highres_idle_spins), (int)(busy * 1000ULL / adc_highres_idle_spins % 10),
+           (int)adc_scan_get_stats()->overruns);
+
+    Delay_Ms(900);
+}
@@ -5,11 +5,12 @@
 #include "debug.h"
 
 #include "framework/app_framework.h"
+#include "framework/irq_dispatch.h"
 
 volatile uint16_t adc_value = 0;
 volatile uint8_t conversion_complete = 0;
 
-void ADC1_2_IRQHandler(void){
+static void adc_interrupt_irq_handler(void){
     if(ADC_GetITStatus(ADC1, ADC_IT_EOC) != RESET) {
         adc_value = ADC_GetConversionValue(ADC1);
         conversion_complete = 1;
@@ -48,6 +49,7 @@ void adc_interrupt_setup(void){
     ADC_ITConfig(ADC1, ADC_IT_EOC, ENABLE);
 
     // Configure NVIC
+    irq_attach(ADC1_2_IRQn, adc_interrupt_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = ADC1_2_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
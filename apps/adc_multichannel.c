@@ -0,0 +1,126 @@
+#include <string.h>
+
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "adc_scan.h"
+#include "timebase.h"
+
+// PA0-PA2 plus Vrefint, scanned back to back. Vrefint needs a long sample
+// time; the pins use a short one, giving a 312 ADC-clock frame (26 us).
+#define ADC_MULTICHANNEL_CHANNELS 4
+#define ADC_MULTICHANNEL_FRAMES   64
+
+static const adc_scan_channel_t adc_multichannel_channels[ADC_MULTICHANNEL_CHANNELS] = {
+    {ADC_Channel_0, ADC_SampleTime_7Cycles5},
+    {ADC_Channel_1, ADC_SampleTime_7Cycles5},
+    {ADC_Channel_2, ADC_SampleTime_7Cycles5},
+    {ADC_Channel_Vrefint, ADC_SampleTime_239Cycles5},
+};
+
+static uint16_t adc_multichannel_buffer[2 * ADC_MULTICHANNEL_FRAMES * ADC_MULTICHANNEL_CHANNELS];
+static uint16_t adc_multichannel_samples[ADC_MULTICHANNEL_FRAMES];
+
+typedef struct {
+    uint32_t sum;
+    uint16_t min;
+    uint16_t max;
+} adc_multichannel_summary_t;
+
+static volatile adc_multichannel_summary_t adc_multichannel_summary[ADC_MULTICHANNEL_CHANNELS];
+static volatile uint32_t adc_multichannel_frames = 0;
+static volatile uint32_t adc_multichannel_ticks = 0;
+
+static void adc_multichannel_on_half(const uint16_t *samples, uint16_t frames){
+    uint32_t start = timebase_ticks();
+
+    for(uint8_t channel = 0; channel < ADC_MULTICHANNEL_CHANNELS; channel++) {
+        volatile adc_multichannel_summary_t *summary = &adc_multichannel_summary[channel];
+        uint32_t sum = 0;
+        uint16_t min = summary->min;
+        uint16_t max = summary->max;
+
+        adc_scan_deinterleave(samples, frames, channel, adc_multichannel_samples);
+
+        for(uint16_t i = 0; i < frames; i++) {
+            uint16_t sample = adc_multichannel_samples[i];
+
+            sum += sample;
+            if(sample < min) {
+                min = sample;
+            }
+            if(sample > max) {
+                max = sample;
+            }
+        }
+
+        summary->sum += sum;
+        summary->min = min;
+        summary->max = max;
+    }
+
+    adc_multichannel_frames += frames;
+    adc_multichannel_ticks += timebase_ticks() - start;
+}
+
+static void adc_multichannel_reset(void){
+    for(uint8_t channel = 0; channel < ADC_MULTICHANNEL_CHANNELS; channel++) {
+        adc_multichannel_summary[channel].sum = 0;
+        adc_multichannel_summary[channel].min = 0xFFFF;
+        adc_multichannel_summary[channel].max = 0;
+    }
+
+    adc_multichannel_frames = 0;
+    adc_multichannel_ticks = 0;
+}
+
+void adc_multichannel_setup(void){
+    adc_scan_config_t config;
+
+    printf("ADC Multichannel Setup\n");
+
+    config.channels = adc_multichannel_channels;
+    config.channel_count = ADC_MULTICHANNEL_CHANNELS;
+    config.buffer = adc_multichannel_buffer;
+    config.frames = ADC_MULTICHANNEL_FRAMES;
+    config.callback = adc_multichannel_on_half;
+
+    if(adc_scan_init(&config) != 0) {
+        printf("ADC Multichannel: Init failed\n");
+        return;
+    }
+
+    adc_multichannel_reset();
+    adc_scan_start();
+}
+
+void adc_multichannel_loop(void){
+    adc_multichannel_summary_t summary[ADC_MULTICHANNEL_CHANNELS];
+    const adc_scan_stats_t *stats = adc_scan_get_stats();
+    uint32_t frames, ticks;
+
+    Delay_Ms(1000);
+
+    // Snapshot and restart the window with the DMA interrupt held off
+    NVIC_DisableIRQ(DMA1_Channel1_IRQn);
+    memcpy(summary, (const void *)adc_multichannel_summary, sizeof(summary));
+    frames = adc_multichannel_frames;
+    ticks = adc_multichannel_ticks;
+    adc_multichannel_reset();
+    NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+
+    if(frames == 0) {
+        printf("ADC Multichannel: No data\n");
+        return;
+    }
+
+    for(uint8_t channel = 0; channel < ADC_MULTICHANNEL_CHANNELS; channel++) {
+        printf("ADC Multichannel: ch%d avg %d min %d max %d\n", channel,
+               (int)(summary[channel].sum / frames), summary[channel].min, summary[channel].max);
+    }
+
+    // The callback cost is what each half leaves for the rest of the system
+    ticks = (uint64_t)ticks * 10 / frames;
+    printf("ADC Multichannel: %d frames/s, %d.%d SysTick ticks per frame in callback, %d overruns\n",
+           (int)frames, (int)(ticks / 10), (int)(ticks % 10), (int)stats->overruns);
+}
@@ -0,0 +1,121 @@
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_tim.h"
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "adc_injected.h"
+#include "adc_scan.h"
+
+// Current sense synchronised to a 20 kHz PWM: TIM1 CH1 drives the load on
+// PA8 with a 25 % pulse, and CH4 fires in the middle of that pulse to
+// start an injected conversion of PA1. Meanwhile PA0 and PA2 stream at
+// 10 kHz through the regular group and DMA. The timer counter read in the
+// callback shows how long after the edge the result was in hand.
+#define ADC_PRIORITY_PWM_HZ  20000
+#define ADC_PRIORITY_SCAN_HZ 10000
+#define ADC_PRIORITY_FRAMES  64
+
+static const adc_scan_channel_t adc_priority_scan_channels[2] = {
+    {ADC_Channel_0, ADC_SampleTime_28Cycles5},
+    {ADC_Channel_2, ADC_SampleTime_28Cycles5},
+};
+
+static const adc_scan_channel_t adc_priority_sense_channel = {ADC_Channel_1, ADC_SampleTime_7Cycles5};
+
+static uint16_t adc_priority_buffer[2 * ADC_PRIORITY_FRAMES * 2];
+static volatile uint16_t adc_priority_current = 0;
+static volatile uint16_t adc_priority_latency = 0;
+static volatile uint16_t adc_priority_latency_max = 0;
+
+static void adc_priority_on_sense(const uint16_t *results, uint8_t count){
+    // Ticks since the CC4 edge, at the 72 MHz timer clock
+    uint16_t latency = TIM1->CNT - TIM1->CH4CVR;
+
+    (void)count;
+    adc_priority_current = results[0];
+    adc_priority_latency = latency;
+    if(latency > adc_priority_latency_max) {
+        adc_priority_latency_max = latency;
+    }
+}
+
+static void adc_priority_pwm_init(void){
+    GPIO_InitTypeDef GPIO_InitStructure;
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+    TIM_OCInitTypeDef TIM_OCInitStructure;
+    uint16_t period = SystemCoreClock / ADC_PRIORITY_PWM_HZ;
+
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA | RCC_APB2Periph_TIM1, ENABLE);
+
+    GPIO_InitStructure.GPIO_Pin = GPIO_Pin_8;
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF_PP;
+    GPIO_Init(GPIOA, &GPIO_InitStructure);
+
+    TIM_TimeBaseStructure.TIM_Period = period - 1;
+    TIM_TimeBaseStructure.TIM_Prescaler = 0;
+    TIM_TimeBaseStructure.TIM_ClockDivision = TIM_CKD_DIV1;
+    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
+    TIM_TimeBaseInit(TIM1, &TIM_TimeBaseStructure);
+
+    TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_PWM1;
+    TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Enable;
+    TIM_OCInitStructure.TIM_OutputNState = TIM_OutputNState_Disable;
+    TIM_OCInitStructure.TIM_Pulse = period / 4;
+    TIM_OCInitStructure.TIM_OCPolarity = TIM_OCPolarity_High;
+    TIM_OCInitStructure.TIM_OCNPolarity = TIM_OCNPolarity_High;
+    TIM_OCInitStructure.TIM_OCIdleState = TIM_OCIdleState_Reset;
+    TIM_OCInitStructure.TIM_OCNIdleState = TIM_OCNIdleState_Reset;
+    TIM_OC1Init(TIM1, &TIM_OCInitStructure);
+
+    // Mid-pulse sampling point; PA11 stays a plain GPIO
+    TIM_OCInitStructure.TIM_Pulse = period / 8;
+    TIM_OC4Init(TIM1, &TIM_OCInitStructure);
+
+    TIM_CtrlPWMOutputs(TIM1, ENABLE);
+    TIM_Cmd(TIM1, ENABLE);
+}
+
+void adc_priority_setup(void){
+    adc_scan_config_t scan;
+    adc_injected_config_t sense;
+
+    printf("ADC Priority Setup\n");
+
+    scan.channels = adc_priority_scan_channels;
+    scan.channel_count = 2;
+    scan.buffer = adc_priority_buffer;
+    scan.frames = ADC_PRIORITY_FRAMES;
+    scan.callback = NULL;
+
+    sense.channels = &adc_priority_sense_channel;
+    sense.channel_count = 1;
+    sense.trigger = ADC_ExternalTrigInjecConv_T1_CC4;
+    sense.callback = adc_priority_on_sense;
+
+    if(adc_scan_init(&scan) != 0 || adc_injected_init(&sense) != 0 ||
+       adc_scan_start_timed(TIM3, ADC_PRIORITY_SCAN_HZ) != 0) {
+        printf("ADC Priority: Init failed\n");
+        return;
+    }
+
+    adc_priority_pwm_init();
+}
+
+void adc_priority_loop(void){
+    const adc_scan_stats_t *scan = adc_scan_get_stats();
+    const adc_injected_stats_t *sense = adc_injected_get_stats();
+    uint32_t conversions = sense->conversions;
+    uint32_t halves = scan->half_buffers;
+
+    Delay_Ms(1000);
+
+    printf("ADC Priority: %d sense/s, current %d, latency %d ns (max %d ns)\n",
+           (int)(sense->conversions - conversions), adc_priority_current,
+           (int)(adc_priority_latency * 1000 / (SystemCoreClock / 1000000)),
+           (int)(adc_priority_latency_max * 1000 / (SystemCoreClock / 1000000)));
+    printf("ADC Priority: Scan %d frames/s, %d overruns\n",
+           (int)((scan->half_buffers - halves) * ADC_PRIORITY_FRAMES), (int)scan->overruns);
+}
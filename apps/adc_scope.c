@@ -0,0 +1,49 @@
+#include "ch32v10x_usart.h"
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "adc_stream.h"
+
+// PA0 and PA1 at 40 kHz each, streamed raw on the debug USART at 2 Mbaud:
+// 160 kB/s of samples out of the link's 200 kB/s. The console goes quiet
+// once the stream starts; run tools/scope_receiver.py on the host side.
+#define ADC_SCOPE_RATE_HZ 40000
+#define ADC_SCOPE_BAUD    2000000
+#define ADC_SCOPE_FRAMES  256
+
+static const adc_scan_channel_t adc_scope_channels[2] = {
+    {ADC_Channel_0, ADC_SampleTime_28Cycles5},
+    {ADC_Channel_1, ADC_SampleTime_28Cycles5},
+};
+
+static uint16_t adc_scope_buffer[2 * ADC_SCOPE_FRAMES * 2];
+
+void adc_scope_setup(void){
+    adc_stream_config_t config;
+
+    printf("ADC Scope Setup\n");
+
+    config.channels = adc_scope_channels;
+    config.channel_count = 2;
+    config.buffer = adc_scope_buffer;
+    config.frames = ADC_SCOPE_FRAMES;
+    config.timer = TIM3;
+    config.rate_hz = ADC_SCOPE_RATE_HZ;
+    config.usart = USART1;
+    config.baudrate = ADC_SCOPE_BAUD;
+
+    printf("ADC Scope: Streaming at %d baud\n", ADC_SCOPE_BAUD);
+
+    // Let the text drain before the baud rate changes under it
+    while(USART_GetFlagStatus(USART1, USART_FLAG_TC) == RESET);
+
+    if(adc_stream_init(&config) != 0 || adc_stream_start() != 0) {
+        USART_Printf_Init(115200);
+        printf("ADC Scope: Init failed\n");
+    }
+}
+
+void adc_scope_loop(void){
+    // Everything happens in the DMA interrupts; the USART belongs to the
+    // stream, so there is nothing to print
+}
@@ -0,0 +1,102 @@
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "adc_scan.h"
+#include "dsp_fft.h"
+#include "timebase.h"
+
+// Spectrum of PA0 sampled at 8192 Hz by TIM3. Each 1024-sample DMA half
+// buffer is converted and transformed where it lies, so the only RAM is
+// the 4 KB acquisition buffer. Bins are 8 Hz wide. Setup first prints the
+// FFT cycle counts per size, using the same buffer as scratch. Cycles are
+// SysTick ticks times eight, as SysTick counts HCLK/8.
+#define ADC_SPECTRUM_RATE_HZ 8192
+#define ADC_SPECTRUM_POINTS  1024
+
+static const adc_scan_channel_t adc_spectrum_channel = {ADC_Channel_0, ADC_SampleTime_28Cycles5};
+
+static uint16_t adc_spectrum_buffer[2 * ADC_SPECTRUM_POINTS];
+static const uint16_t *volatile adc_spectrum_ready = NULL;
+static uint32_t adc_spectrum_last_ms = 0;
+
+static void adc_spectrum_on_half(const uint16_t *samples, uint16_t frames){
+    (void)frames;
+    adc_spectrum_ready = samples;
+}
+
+static void adc_spectrum_bench(void){
+    q15_t *data = (q15_t *)adc_spectrum_buffer;
+    uint32_t start, complex_cycles, real_cycles;
+
+    for(uint16_t n = 64; n <= DSP_FFT_MAX_POINTS; n *= 2) {
+        // Low-level noise-like input; the cost does not depend on the data
+        for(uint16_t i = 0; i < 2 * n; i++) {
+            data[i] = (q15_t)((i * 7919) & 0x0FFF) - 0x0800;
+        }
+
+        start = timebase_ticks();
+        dsp_cfft_q15(data, n);
+        complex_cycles = (timebase_ticks() - start) * 8;
+
+        start = timebase_ticks();
+        dsp_rfft_q15(data, n);
+        real_cycles = (timebase_ticks() - start) * 8;
+
+        printf("ADC Spectrum: %4d points: complex %6d cycles, real %6d cycles\n",
+               n, (int)complex_cycles, (int)real_cycles);
+    }
+}
+
+void adc_spectrum_setup(void){
+    adc_scan_config_t config;
+
+    printf("ADC Spectrum Setup\n");
+
+    adc_spectrum_bench();
+
+    config.channels = &adc_spectrum_channel;
+    config.channel_count = 1;
+    config.buffer = adc_spectrum_buffer;
+    config.frames = ADC_SPECTRUM_POINTS;
+    config.callback = adc_spectrum_on_half;
+
+    if(adc_scan_init(&config) != 0 || adc_scan_start_timed(TIM3, ADC_SPECTRUM_RATE_HZ) != 0) {
+        printf("ADC Spectrum: Init failed\n");
+    }
+}
+
+void adc_spectrum_loop(void){
+    q15_t *data;
+    uint16_t peak = 1;
+    uint32_t start, cycles;
+
+    if(adc_spectrum_ready == NULL) {
+        return;
+    }
+
+    // The DMA is filling the other half for the next 125 ms
+    data = (q15_t *)adc_spectrum_ready;
+    adc_spectrum_ready = NULL;
+
+    start = timebase_ticks();
+    dsp_q15_from_adc((const uint16_t *)data, data, ADC_SPECTRUM_POINTS);
+    dsp_rfft_q15(data, ADC_SPECTRUM_POINTS);
+    dsp_fft_magnitude_q15(data, data, ADC_SPECTRUM_POINTS / 2);
+    cycles = (timebase_ticks() - start) * 8;
+
+    // Bin 0 holds DC (and Nyquist in its imaginary part), so skip it
+    for(uint16_t i = 2; i < ADC_SPECTRUM_POINTS / 2; i++) {
+        if(data[i] > data[peak]) {
+            peak = i;
+        }
+    }
+
+    if(timebase_ms() - adc_spectrum_last_ms < 1000) {
+        return;
+    }
+    adc_spectrum_last_ms = timebase_ms();
+
+    printf("ADC Spectrum: Peak %d Hz, magnitude %d, %d cycles, %d overruns\n",
+           (int)((uint32_t)peak * ADC_SPECTRUM_RATE_HZ / ADC_SPECTRUM_POINTS), data[peak],
+           (int)cycles, (int)adc_scan_get_stats()->overruns);
+}
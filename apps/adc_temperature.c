@@ -0,0 +1,91 @@
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "adc_calibration.h"
+#include "adc_scan.h"
+#include "timebase.h"
+
+// Die temperature and supply voltage from the internal channels, with the
+// ADC offset cached in backup registers. Press reset to see the warm start
+// skip the calibration. The loop compares the precomputed conversion with
+// the driver's TempSensor_Volt_To_Temper() path.
+#define ADC_TEMPERATURE_FRAMES 16
+
+static const adc_scan_channel_t adc_temperature_channels[2] = {
+    {ADC_Channel_TempSensor, ADC_SampleTime_239Cycles5},
+    {ADC_Channel_Vrefint, ADC_SampleTime_239Cycles5},
+};
+
+static uint16_t adc_temperature_buffer[2 * ADC_TEMPERATURE_FRAMES * 2];
+static volatile uint16_t adc_temperature_raw = 0;
+static volatile uint32_t adc_temperature_first_us = 0;
+
+static void adc_temperature_on_half(const uint16_t *samples, uint16_t frames){
+    uint32_t sum = 0;
+
+    for(uint16_t i = 0; i < frames; i++) {
+        sum += samples[2 * i];
+    }
+
+    adc_temperature_raw = sum / frames;
+
+    if(adc_temperature_first_us == 0) {
+        adc_temperature_first_us = timebase_us();
+    }
+}
+
+void adc_temperature_setup(void){
+    adc_scan_config_t config;
+    uint32_t start = timebase_us();
+    uint8_t measured;
+
+    printf("ADC Temperature Setup\n");
+
+    config.channels = adc_temperature_channels;
+    config.channel_count = 2;
+    config.buffer = adc_temperature_buffer;
+    config.frames = ADC_TEMPERATURE_FRAMES;
+    config.callback = adc_temperature_on_half;
+
+    if(adc_scan_init(&config) != 0) {
+        printf("ADC Temperature: Init failed\n");
+        return;
+    }
+
+    measured = adc_calibration_init();
+    adc_scan_start();
+
+    while(adc_temperature_first_us == 0);
+
+    printf("ADC Temperature: Offset %d (%s), first samples after %d us\n",
+           adc_calibration_offset(), measured ? "measured" : "cached", (int)(adc_temperature_first_us - start));
+}
+
+void adc_temperature_loop(void){
+    uint16_t raw = adc_temperature_raw;
+    uint32_t start, fast_cycles, driver_cycles;
+    int16_t tenths;
+    s32 degrees;
+
+    if(adc_calibration_refresh()) {
+        printf("ADC Temperature: Drift, recalibrating\n");
+        adc_scan_stop();
+        adc_scan_wait_idle();
+        adc_calibration_run();
+        adc_scan_start();
+    }
+
+    start = timebase_ticks();
+    tenths = adc_calibration_to_temperature(raw);
+    fast_cycles = (timebase_ticks() - start) * 8;
+
+    start = timebase_ticks();
+    degrees = TempSensor_Volt_To_Temper(adc_calibration_apply(raw) * adc_calibration_supply_mv() / 4096);
+    driver_cycles = (timebase_ticks() - start) * 8;
+
+    printf("ADC Temperature: %d.%d C (driver %d C), supply %d mV, %d vs %d cycles\n",
+           tenths / 10, (tenths < 0 ? -tenths : tenths) % 10, (int)degrees,
+           adc_calibration_supply_mv(), (int)fast_cycles, (int)driver_cycles);
+
+    Delay_Ms(1000);
+}
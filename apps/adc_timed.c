@@ -0,0 +1,71 @@
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "adc_scan.h"
+#include "timebase.h"
+
+// PA0 and PA1 sampled together at 10 kHz, paced by TIM3 TRGO. The frame
+// count against the SysTick time shows the rate is the timer's, not the
+// ADC's.
+#define ADC_TIMED_RATE_HZ 10000
+#define ADC_TIMED_CHANNELS 2
+#define ADC_TIMED_FRAMES   100
+
+static const adc_scan_channel_t adc_timed_channels[ADC_TIMED_CHANNELS] = {
+    {ADC_Channel_0, ADC_SampleTime_28Cycles5},
+    {ADC_Channel_1, ADC_SampleTime_28Cycles5},
+};
+
+static uint16_t adc_timed_buffer[2 * ADC_TIMED_FRAMES * ADC_TIMED_CHANNELS];
+static volatile uint32_t adc_timed_frames = 0;
+static volatile uint16_t adc_timed_last[ADC_TIMED_CHANNELS];
+
+static uint32_t adc_timed_start_us;
+
+static void adc_timed_on_half(const uint16_t *samples, uint16_t frames){
+    const uint16_t *last = samples + (frames - 1) * ADC_TIMED_CHANNELS;
+
+    adc_timed_last[0] = last[0];
+    adc_timed_last[1] = last[1];
+    adc_timed_frames += frames;
+}
+
+void adc_timed_setup(void){
+    adc_scan_config_t config;
+
+    printf("ADC Timed Setup\n");
+
+    config.channels = adc_timed_channels;
+    config.channel_count = ADC_TIMED_CHANNELS;
+    config.buffer = adc_timed_buffer;
+    config.frames = ADC_TIMED_FRAMES;
+    config.callback = adc_timed_on_half;
+
+    if(adc_scan_init(&config) != 0 || adc_scan_start_timed(TIM3, ADC_TIMED_RATE_HZ) != 0) {
+        printf("ADC Timed: Init failed\n");
+        return;
+    }
+
+    adc_timed_start_us = timebase_us();
+
+    printf("ADC Timed: %d Hz requested, %d Hz from the timer, %d Hz max\n",
+           ADC_TIMED_RATE_HZ, (int)adc_scan_get_rate(), (int)adc_scan_max_rate());
+}
+
+void adc_timed_loop(void){
+    const adc_scan_stats_t *stats = adc_scan_get_stats();
+    uint32_t elapsed_us;
+
+    Delay_Ms(1000);
+
+    elapsed_us = timebase_us() - adc_timed_start_us;
+    if(elapsed_us == 0) {
+        return;
+    }
+
+    // Counts whole halves only, so the figure lags by up to one half
+    printf("ADC Timed: %d frames in %d ms (%d Hz), PA0 %d, PA1 %d, %d overruns\n",
+           (int)adc_timed_frames, (int)(elapsed_us / 1000),
+           (int)((uint64_t)adc_timed_frames * 1000000 / elapsed_us),
+           adc_timed_last[0], adc_timed_last[1], (int)stats->overruns);
+}
@@ -0,0 +1,87 @@
+#include "ch32v10x_tim.h"
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "adc_capture.h"
+
+// Transient catcher on PA0: sampled at 200 kHz, with the analog watchdog
+// tripping on anything outside 1000-3000 (about 0.8-2.4 V). Each capture
+// keeps 0.5 ms before the trip and 1.5 ms after it; the loop prints a
+// summary and the samples right around the trip, then re-arms.
+#define ADC_TRIGGER_RATE_HZ 200000
+#define ADC_TRIGGER_FRAMES  512
+#define ADC_TRIGGER_PRE     100
+#define ADC_TRIGGER_POST    300
+#define ADC_TRIGGER_SHOWN   8
+
+static const adc_scan_channel_t adc_trigger_channel = {ADC_Channel_0, ADC_SampleTime_7Cycles5};
+
+static uint16_t adc_trigger_buffer[2 * ADC_TRIGGER_FRAMES];
+static adc_capture_event_t adc_trigger_event;
+static volatile uint8_t adc_trigger_ready = 0;
+
+static void adc_trigger_on_capture(const adc_capture_event_t *event){
+    adc_trigger_event = *event;
+    adc_trigger_ready = 1;
+}
+
+static void adc_trigger_report(void){
+    const adc_capture_event_t *event = &adc_trigger_event;
+    uint16_t min = 0xFFFF, max = 0;
+
+    for(uint16_t i = 0; i < event->count; i++) {
+        uint16_t value = *adc_capture_frame(event, i);
+
+        if(value < min) {
+            min = value;
+        }
+        if(value > max) {
+            max = value;
+        }
+    }
+
+    printf("ADC Trigger: Tripped at %d, window min %d max %d\n",
+           *adc_capture_frame(event, event->pre), min, max);
+
+    printf("ADC Trigger:");
+    for(uint16_t i = event->pre - ADC_TRIGGER_SHOWN / 2; i < event->pre + ADC_TRIGGER_SHOWN; i++) {
+        printf(i == event->pre ? " [%d]" : " %d", *adc_capture_frame(event, i));
+    }
+    printf("\n");
+}
+
+void adc_trigger_setup(void){
+    adc_capture_config_t config;
+
+    printf("ADC Trigger Setup\n");
+
+    config.channels = &adc_trigger_channel;
+    config.channel_count = 1;
+    config.buffer = adc_trigger_buffer;
+    config.frames = ADC_TRIGGER_FRAMES;
+    config.timer = TIM3;
+    config.rate_hz = ADC_TRIGGER_RATE_HZ;
+    config.watch_channel = ADC_Channel_0;
+    config.low = 1000;
+    config.high = 3000;
+    config.pre = ADC_TRIGGER_PRE;
+    config.post = ADC_TRIGGER_POST;
+    config.callback = adc_trigger_on_capture;
+
+    if(adc_capture_init(&config) != 0 || adc_capture_arm() != 0) {
+        printf("ADC Trigger: Init failed\n");
+    }
+}
+
+void adc_trigger_loop(void){
+    if(!adc_trigger_ready) {
+        return;
+    }
+
+    adc_trigger_ready = 0;
+    adc_trigger_report();
+    printf("ADC Trigger: %d captures, %d trips\n",
+           (int)adc_capture_get_stats()->captures, (int)adc_capture_get_stats()->trips);
+
+    adc_capture_arm();
+}
@@ -0,0 +1,122 @@
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "dsp_biquad.h"
+#include "dsp_cic.h"
+#include "dsp_fir.h"
+#include "dsp_smooth.h"
+#include "timebase.h"
+
+// Cycles per sample of each lib/dsp kernel on a 256-sample block, the size
+// of an ADC DMA half buffer. Each kernel runs twice and the second run is
+// timed, so flash wait states are measured warm. SysTick counts HCLK/8,
+// so a block is timed to within eight cycles.
+#define DSP_BENCH_BLOCK 256
+#define DSP_BENCH_TAPS  31
+
+// 31-tap Hamming-windowed low-pass, cut-off 0.1 fs, unity DC gain
+static const q15_t dsp_bench_fir_q15[DSP_BENCH_TAPS] = {
+    0, 39, 91, 139, 129, 0, -271, -609, -832, -696, 0, 1297, 3011, 4755, 6059, 6542,
+    6059, 4755, 3011, 1297, 0, -696, -832, -609, -271, 0, 129, 139, 91, 39, 0,
+};
+
+static q31_t dsp_bench_fir_q31[DSP_BENCH_TAPS];
+
+// 4th-order Butterworth low-pass at 0.05 fs as two sections
+static const dsp_biquad_q15_coeffs_t dsp_bench_biquad_q15[2] = {
+    {312, 624, 312, -24243, 9107},
+    {359, 717, 359, -27869, 12919},
+};
+
+static const dsp_biquad_q31_coeffs_t dsp_bench_biquad_q31[2] = {
+    {20440642, 40881285, 20440642, -1588788093, 596808838},
+    {23497607, 46995214, 23497607, -1826396550, 846645154},
+};
+
+static q15_t dsp_bench_input[DSP_BENCH_BLOCK];
+static q15_t dsp_bench_output[DSP_BENCH_BLOCK];
+static q31_t dsp_bench_input_q31[DSP_BENCH_BLOCK];
+static q31_t dsp_bench_output_q31[DSP_BENCH_BLOCK];
+
+static q15_t dsp_bench_fir_state[2 * DSP_BENCH_TAPS];
+static q31_t dsp_bench_fir_state_q31[2 * DSP_BENCH_TAPS];
+static q15_t dsp_bench_biquad_state[4 * 2];
+static q31_t dsp_bench_biquad_state_q31[4 * 2];
+static q15_t dsp_bench_average_history[16];
+
+static void dsp_bench_report(const char *name, uint32_t ticks){
+    uint32_t cycles = ticks * 8;
+
+    printf("DSP Bench: %-20s %4d.%02d cycles/sample\n", name,
+           (int)(cycles / DSP_BENCH_BLOCK), (int)(cycles % DSP_BENCH_BLOCK * 100 / DSP_BENCH_BLOCK));
+}
+
+// Slow ramp plus pseudo-random noise, roughly what a noisy sensor gives
+static void dsp_bench_fill(void){
+    uint32_t seed = 1;
+
+    for(int i = 0; i < DSP_BENCH_BLOCK; i++) {
+        seed = seed * 1664525 + 1013904223;
+        dsp_bench_input[i] = (q15_t)(i * 64 - 8192 + (int16_t)(seed >> 16) / 8);
+        dsp_bench_input_q31[i] = (q31_t)dsp_bench_input[i] * 65536;
+    }
+
+    for(int i = 0; i < DSP_BENCH_TAPS; i++) {
+        dsp_bench_fir_q31[i] = (q31_t)dsp_bench_fir_q15[i] * 65536;
+    }
+}
+
+#define DSP_BENCH_RUN(name, call)                           \
+    do {                                                    \
+        uint32_t start;                                     \
+        call;                                               \
+        start = timebase_ticks();                           \
+        call;                                               \
+        dsp_bench_report(name, timebase_ticks() - start);   \
+    } while(0)
+
+void dsp_bench_setup(void){
+    dsp_fir_q15_t fir;
+    dsp_fir_q31_t fir_q31;
+    dsp_fir_decimate_q15_t decimator;
+    dsp_biquad_q15_t biquad;
+    dsp_biquad_q31_t biquad_q31;
+    dsp_cic_t cic;
+    dsp_moving_average_t average;
+    dsp_median_t median;
+
+    printf("DSP Bench Setup\n");
+
+    dsp_bench_fill();
+
+    dsp_fir_q15_init(&fir, dsp_bench_fir_q15, dsp_bench_fir_state, DSP_BENCH_TAPS);
+    DSP_BENCH_RUN("FIR Q15 31 taps", dsp_fir_q15(&fir, dsp_bench_input, dsp_bench_output, DSP_BENCH_BLOCK));
+
+    dsp_fir_q15_init(&fir, dsp_bench_fir_q15, dsp_bench_fir_state, DSP_BENCH_TAPS);
+    DSP_BENCH_RUN("FIR Q15 symmetric", dsp_fir_sym_q15(&fir, dsp_bench_input, dsp_bench_output, DSP_BENCH_BLOCK));
+
+    dsp_fir_q31_init(&fir_q31, dsp_bench_fir_q31, dsp_bench_fir_state_q31, DSP_BENCH_TAPS);
+    DSP_BENCH_RUN("FIR Q31 31 taps", dsp_fir_q31(&fir_q31, dsp_bench_input_q31, dsp_bench_output_q31, DSP_BENCH_BLOCK));
+
+    dsp_fir_decimate_q15_init(&decimator, dsp_bench_fir_q15, dsp_bench_fir_state, DSP_BENCH_TAPS, 4);
+    DSP_BENCH_RUN("FIR decimate by 4", dsp_fir_decimate_q15(&decimator, dsp_bench_input, dsp_bench_output, DSP_BENCH_BLOCK));
+
+    dsp_biquad_q15_init(&biquad, dsp_bench_biquad_q15, dsp_bench_biquad_state, 2);
+    DSP_BENCH_RUN("Biquad Q15 x2", dsp_biquad_q15(&biquad, dsp_bench_input, dsp_bench_output, DSP_BENCH_BLOCK));
+
+    dsp_biquad_q31_init(&biquad_q31, dsp_bench_biquad_q31, dsp_bench_biquad_state_q31, 2);
+    DSP_BENCH_RUN("Biquad Q31 x2", dsp_biquad_q31(&biquad_q31, dsp_bench_input_q31, dsp_bench_output_q31, DSP_BENCH_BLOCK));
+
+    dsp_cic_init(&cic, 3, 8);
+    DSP_BENCH_RUN("CIC order 3 by 8", dsp_cic_decimate(&cic, dsp_bench_input, dsp_bench_output, DSP_BENCH_BLOCK));
+
+    dsp_moving_average_init(&average, dsp_bench_average_history, 16);
+    DSP_BENCH_RUN("Moving average 16", dsp_moving_average(&average, dsp_bench_input, dsp_bench_output, DSP_BENCH_BLOCK));
+
+    dsp_median_init(&median, 5);
+    DSP_BENCH_RUN("Median 5", dsp_median(&median, dsp_bench_input, dsp_bench_output, DSP_BENCH_BLOCK));
+}
+
+void dsp_bench_loop(void){
+    Delay_Ms(1000);
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_spi.h"
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "fat.h"
+#include "sd_card.h"
+#include "spi_queue.h"
+
+// Appends a CSV line per loop to LOG.CSV on a FAT-formatted SD card
+// (SPI1, CS on PA4). The file can be read on a PC at any time after a sync.
+#define FAT_LOGGER_SYNC_EVERY 10
+
+static fat_file_t fat_logger_file;
+static uint8_t fat_logger_ready = 0;
+static uint32_t fat_logger_lines = 0;
+
+void fat_logger_setup(void){
+    sd_card_config_t config;
+
+    printf("FAT Logger Setup\n");
+
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA, ENABLE);
+    spi_queue_init();
+
+    config.cs_port = GPIOA;
+    config.cs_pin = GPIO_Pin_4;
+    config.prescaler = SPI_BaudRatePrescaler_4;
+
+    if(sd_card_init(&config) != 0) {
+        printf("FAT Logger: No card found\n");
+        return;
+    }
+
+    if(fat_mount(sd_card_get_blockdev()) != 0) {
+        printf("FAT Logger: No FAT filesystem\n");
+        return;
+    }
+
+    if(fat_open(&fat_logger_file, "LOG.CSV", FAT_WRITE | FAT_CREATE | FAT_APPEND) != 0) {
+        printf("FAT Logger: Cannot open LOG.CSV\n");
+        return;
+    }
+
+    fat_logger_ready = 1;
+    printf("FAT Logger: FAT%d, %d byte clusters, LOG.CSV is %d bytes\n",
+           fat_get_type(), (int)fat_get_cluster_size(), (int)fat_logger_file.size);
+}
+
+void fat_logger_loop(void){
+    char line[48];
+    int length;
+
+    if(!fat_logger_ready) {
+        Delay_Ms(1000);
+        return;
+    }
+
+    length = snprintf(line, sizeof(line), "%d,%d\r\n", (int)fat_logger_lines, (int)(fat_logger_lines * 7 % 4096));
+    if(fat_write(&fat_logger_file, line, length) != 0) {
+        printf("FAT Logger: Write failed\n");
+    }
+
+    // Directory entry and FAT reach the card only on sync
+    if(++fat_logger_lines % FAT_LOGGER_SYNC_EVERY == 0) {
+        fat_sync(&fat_logger_file);
+        printf("FAT Logger: %d lines, %d bytes\n", (int)fat_logger_lines, (int)fat_logger_file.size);
+    }
+
+    Delay_Ms(100);
+}
@@ -0,0 +1,74 @@
+#include <stddef.h>
+
+#include "irq_dispatch.h"
+
+#define IRQ_FIRST WWDG_IRQn
+#define IRQ_LAST  USBHD_IRQn
+#define IRQ_COUNT (IRQ_LAST - IRQ_FIRST + 1)
+
+static irq_handler_t irq_handlers[IRQ_COUNT];
+
+void irq_attach(IRQn_Type irq, irq_handler_t handler){
+    if(irq >= IRQ_FIRST && irq <= IRQ_LAST) {
+        irq_handlers[irq - IRQ_FIRST] = handler;
+    }
+}
+
+void irq_detach(IRQn_Type irq){
+    irq_attach(irq, NULL);
+}
+
+static inline void irq_dispatch(IRQn_Type irq){
+    irq_handler_t handler = irq_handlers[irq - IRQ_FIRST];
+
+    if(handler) {
+        handler();
+    }
+}
+
+#define IRQ_DISPATCH_VECTOR(vector, irq) \
+        void vector(void) __attribute__((interrupt("WCH-Interrupt-fast"))); \
+        void vector(void){ \
+            irq_dispatch(irq); \
+        }
+
+IRQ_DISPATCH_VECTOR(WWDG_IRQHandler, WWDG_IRQn)
+IRQ_DISPATCH_VECTOR(PVD_IRQHandler, PVD_IRQn)
+IRQ_DISPATCH_VECTOR(TAMPER_IRQHandler, TAMPER_IRQn)
+IRQ_DISPATCH_VECTOR(RTC_IRQHandler, RTC_IRQn)
+IRQ_DISPATCH_VECTOR(FLASH_IRQHandler, FLASH_IRQn)
+IRQ_DISPATCH_VECTOR(RCC_IRQHandler, RCC_IRQn)
+IRQ_DISPATCH_VECTOR(EXTI0_IRQHandler, EXTI0_IRQn)
+IRQ_DISPATCH_VECTOR(EXTI1_IRQHandler, EXTI1_IRQn)
+IRQ_DISPATCH_VECTOR(EXTI2_IRQHandler, EXTI2_IRQn)
+IRQ_DISPATCH_VECTOR(EXTI3_IRQHandler, EXTI3_IRQn)
+IRQ_DISPATCH_VECTOR(EXTI4_IRQHandler, EXTI4_IRQn)
+IRQ_DISPATCH_VECTOR(DMA1_Channel1_IRQHandler, DMA1_Channel1_IRQn)
+IRQ_DISPATCH_VECTOR(DMA1_Channel2_IRQHandler, DMA1_Channel2_IRQn)
+IRQ_DISPATCH_VECTOR(DMA1_Channel3_IRQHandler, DMA1_Channel3_IRQn)
+IRQ_DISPATCH_VECTOR(DMA1_Channel4_IRQHandler, DMA1_Channel4_IRQn)
+IRQ_DISPATCH_VECTOR(DMA1_Channel5_IRQHandler, DMA1_Channel5_IRQn)
+IRQ_DISPATCH_VECTOR(DMA1_Channel6_IRQHandler, DMA1_Channel6_IRQn)
+IRQ_DISPATCH_VECTOR(DMA1_Channel7_IRQHandler, DMA1_Channel7_IRQn)
+IRQ_DISPATCH_VECTOR(ADC1_2_IRQHandler, ADC1_2_IRQn)
+IRQ_DISPATCH_VECTOR(EXTI9_5_IRQHandler, EXTI9_5_IRQn)
+IRQ_DISPATCH_VECTOR(TIM1_BRK_IRQHandler, TIM1_BRK_IRQn)
+IRQ_DISPATCH_VECTOR(TIM1_UP_IRQHandler, TIM1_UP_IRQn)
+IRQ_DISPATCH_VECTOR(TIM1_TRG_COM_IRQHandler, TIM1_TRG_COM_IRQn)
+IRQ_DISPATCH_VECTOR(TIM1_CC_IRQHandler, TIM1_CC_IRQn)
+IRQ_DISPATCH_VECTOR(TIM2_IRQHandler, TIM2_IRQn)
+IRQ_DISPATCH_VECTOR(TIM3_IRQHandler, TIM3_IRQn)
+IRQ_DISPATCH_VECTOR(TIM4_IRQHandler, TIM4_IRQn)
+IRQ_DISPATCH_VECTOR(I2C1_EV_IRQHandler, I2C1_EV_IRQn)
+IRQ_DISPATCH_VECTOR(I2C1_ER_IRQHandler, I2C1_ER_IRQn)
+IRQ_DISPATCH_VECTOR(I2C2_EV_IRQHandler, I2C2_EV_IRQn)
+IRQ_DISPATCH_VECTOR(I2C2_ER_IRQHandler, I2C2_ER_IRQn)
+IRQ_DISPATCH_VECTOR(SPI1_IRQHandler, SPI1_IRQn)
+IRQ_DISPATCH_VECTOR(SPI2_IRQHandler, SPI2_IRQn)
+IRQ_DISPATCH_VECTOR(USART1_IRQHandler, USART1_IRQn)
+IRQ_DISPATCH_VECTOR(USART2_IRQHandler, USART2_IRQn)
+IRQ_DISPATCH_VECTOR(USART3_IRQHandler, USART3_IRQn)
+IRQ_DISPATCH_VECTOR(EXTI15_10_IRQHandler, EXTI15_10_IRQn)
+IRQ_DISPATCH_VECTOR(RTCAlarm_IRQHandler, RTCAlarm_IRQn)
+IRQ_DISPATCH_VECTOR(USBWakeUp_IRQHandler, USBWakeUp_IRQn)
+IRQ_DISPATCH_VECTOR(USBHD_IRQHandler, USBHD_IRQn)
@@ -0,0 +1,35 @@
+#ifndef IRQ_DISPATCH_H
+#define IRQ_DISPATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+
+// Every app and driver is linked into the same image, so peripheral vectors
+// are defined once here and forwarded to whichever handler is attached at
+// runtime. Attach in setup() before enabling the interrupt in the NVIC.
+typedef void (*irq_handler_t)(void);
+
+void irq_attach(IRQn_Type irq, irq_handler_t handler);
+void irq_detach(IRQn_Type irq);
+
+// Short critical sections shared between thread and interrupt context.
+// irq_lock() clears mstatus.MIE and returns the previous value.
+static inline uint32_t irq_lock(void){
+    uint32_t mstatus;
+
+    __asm volatile ("csrrci %0, mstatus, 0x8" : "=r" (mstatus) :: "memory");
+    return mstatus;
+}
+
+static inline void irq_unlock(uint32_t mstatus){
+    __asm volatile ("csrs mstatus, %0" :: "r" (mstatus & 0x8) : "memory");
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,11 +5,12 @@
 #include "debug.h"
 
 #include "framework/app_framework.h"
+#include "framework/irq_dispatch.h"
 
 volatile uint8_t gpio_int_button_pressed = 0;
 volatile uint8_t gpio_int_led_state = 0;
 
-void EXTI4_IRQHandler(void){
+static void gpio_interrupt_irq_handler(void){
     if(EXTI_GetITStatus(EXTI_Line4) != RESET) {
         gpio_int_button_pressed = 1;
         EXTI_ClearITPendingBit(EXTI_Line4);
@@ -50,6 +51,7 @@ void gpio_interrupt_setup(void){
     EXTI_Init(&EXTI_InitStructure);
 
     // Configure NVIC
+    irq_attach(EXTI4_IRQn, gpio_interrupt_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = EXTI4_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 1;
@@ -0,0 +1,111 @@
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "i2c_master.h"
+#include "timebase.h"
+
+// Burst of 100 temperature register reads from an LM75-style sensor
+// (address 0x90) with the CPU free the whole time. Each read writes the
+// register pointer and reads back after a repeated START. Four
+// transactions are kept in flight and resubmitted from their callbacks;
+// the thread only counts how often it got to spin, which gives the CPU
+// share left over for other work.
+#define I2C_ASYNC_SENSOR_ADDR 0x90
+#define I2C_ASYNC_READS       100
+#define I2C_ASYNC_IN_FLIGHT   4
+#define I2C_ASYNC_CALIBRATE   10000
+#define I2C_ASYNC_REG_TEMP    0x00
+
+static const uint8_t i2c_async_register = I2C_ASYNC_REG_TEMP;
+static i2c_transaction_t i2c_async_transactions[I2C_ASYNC_IN_FLIGHT];
+static uint8_t i2c_async_data[I2C_ASYNC_IN_FLIGHT][2];
+static volatile uint32_t i2c_async_submitted = 0;
+static volatile uint32_t i2c_async_completed = 0;
+static volatile uint32_t i2c_async_failed = 0;
+static volatile int16_t i2c_async_raw = 0;
+static uint32_t i2c_async_calibrate_ticks = 1;   // For I2C_ASYNC_CALIBRATE spins
+
+static void i2c_async_complete(i2c_transaction_t *transaction){
+    uint8_t *data = transaction->rx_buffer;
+
+    if(transaction->status == I2C_TRANSACTION_DONE) {
+        i2c_async_raw = (int16_t)((data[0] << 8) | data[1]);
+    } else {
+        i2c_async_failed++;
+    }
+
+    i2c_async_completed++;
+
+    if(i2c_async_submitted < I2C_ASYNC_READS) {
+        i2c_async_submitted++;
+        i2c_master_submit(transaction);
+    }
+}
+
+static uint32_t i2c_async_spin(uint32_t target, uint32_t limit){
+    uint32_t spins = 0;
+
+    while(i2c_async_completed < target && spins < limit) {
+        i2c_master_poll();
+        spins++;
+    }
+
+    return spins;
+}
+
+void i2c_async_setup(void){
+    uint32_t start;
+
+    printf("I2C Async Setup\n");
+
+    i2c_master_init(400000);
+
+    for(uint8_t i = 0; i < I2C_ASYNC_IN_FLIGHT; i++) {
+        i2c_async_transactions[i].address = I2C_ASYNC_SENSOR_ADDR;
+        i2c_async_transactions[i].tx_buffer = &i2c_async_register;
+        i2c_async_transactions[i].tx_length = 1;
+        i2c_async_transactions[i].rx_buffer = i2c_async_data[i];
+        i2c_async_transactions[i].rx_length = 2;
+        i2c_async_transactions[i].callback = i2c_async_complete;
+    }
+
+    // Cost of the spins with nothing else running; a single spin is shorter
+    // than a SysTick tick
+    i2c_async_completed = 0;
+    start = timebase_ticks();
+    i2c_async_spin(1, I2C_ASYNC_CALIBRATE);
+    i2c_async_calibrate_ticks = timebase_ticks() - start;
+}
+
+void i2c_async_loop(void){
+    const i2c_master_stats_t *stats = i2c_master_get_stats();
+    uint32_t start, elapsed, idle;
+
+    i2c_async_completed = 0;
+    i2c_async_failed = 0;
+    i2c_async_submitted = I2C_ASYNC_IN_FLIGHT;
+
+    start = timebase_ticks();
+
+    for(uint8_t i = 0; i < I2C_ASYNC_IN_FLIGHT; i++) {
+        i2c_master_submit(&i2c_async_transactions[i]);
+    }
+
+    idle = (uint64_t)i2c_async_spin(I2C_ASYNC_READS, 0xFFFFFFFF) * i2c_async_calibrate_ticks / I2C_ASYNC_CALIBRATE;
+    elapsed = timebase_ticks() - start;
+
+    if(idle > elapsed) {
+        idle = elapsed;
+    }
+
+    // LM75: 9-bit two's complement in 0.5 degree steps, left aligned
+    printf("I2C Async: %d reads (%d failed) in %d us, CPU busy %d.%d%%, last %d.%d C\n",
+           (int)i2c_async_completed, (int)i2c_async_failed, (int)(elapsed / (timebase_tick_hz() / 1000000)),
+           (int)((elapsed - idle) * 100ULL / elapsed), (int)((elapsed - idle) * 1000ULL / elapsed % 10),
+           i2c_async_raw / 256, (i2c_async_raw & 0x80) ? 5 : 0);
+    printf("I2C Async: NACKs = %d, timeouts = %d, recoveries = %d (%d failed, last %d us)\n",
+           (int)stats->nacks, (int)stats->timeouts, (int)stats->recoveries,
+           (int)stats->recovery_failures, (int)stats->last_recovery_us);
+
+    Delay_Ms(1000);
+}
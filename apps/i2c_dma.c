@@ -6,23 +6,26 @@
 #include "debug.h"
 
 #include "framework/app_framework.h"
+#include "framework/irq_dispatch.h"
+#include "timebase.h"
 
 #define I2C_SLAVE_ADDR 0xA0
 #define BUFFER_SIZE 8
+#define I2C_TIMEOUT_US 10000 // Per bus phase, independent of clock and optimization
 
 volatile uint8_t i2c_tx_buffer[BUFFER_SIZE] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77};
 volatile uint8_t i2c_rx_buffer[BUFFER_SIZE];
 volatile uint8_t i2c_dma_tx_complete = 0;
 volatile uint8_t i2c_dma_rx_complete = 0;
 
-void DMA1_Channel6_IRQHandler(void){
+static void i2c_dma_tx_irq_handler(void){
     if(DMA_GetITStatus(DMA1_IT_TC6) != RESET) {
         i2c_dma_tx_complete = 1;
         DMA_ClearITPendingBit(DMA1_IT_TC6);
     }
 }
 
-void DMA1_Channel7_IRQHandler(void){
+static void i2c_dma_rx_irq_handler(void){
     if(DMA_GetITStatus(DMA1_IT_TC7) != RESET) {
         i2c_dma_rx_complete = 1;
         DMA_ClearITPendingBit(DMA1_IT_TC7);
@@ -74,12 +77,14 @@ void i2c_dma_setup(void){
     DMA_ITConfig(DMA1_Channel7, DMA_IT_TC, ENABLE);
 
     // Configure NVIC for DMA
+    irq_attach(DMA1_Channel6_IRQn, i2c_dma_tx_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel6_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&NVIC_InitStructure);
 
+    irq_attach(DMA1_Channel7_IRQn, i2c_dma_rx_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel7_IRQn;
     NVIC_Init(&NVIC_InitStructure);
 
@@ -97,13 +102,13 @@ void i2c_dma_setup(void){
 }
 
 uint8_t i2c_dma_write(uint8_t slave_addr, uint8_t *data, uint16_t size){
-    uint32_t timeout = 0x10000;
+    uint32_t deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
     // Wait until I2C is not busy
-    while(I2C_GetFlagStatus(I2C1, I2C_FLAG_BUSY) && timeout--);
-
-    if(timeout == 0){
-        return 1;
+    while(I2C_GetFlagStatus(I2C1, I2C_FLAG_BUSY)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Reset DMA channel
@@ -116,37 +121,43 @@ uint8_t i2c_dma_write(uint8_t slave_addr, uint8_t *data, uint16_t size){
 
     // Generate start condition
     I2C_GenerateSTART(I2C1, ENABLE);
-    timeout = 0x10000;
-
-    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT) && timeout--);
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    if(timeout == 0){
-        return 1;
+    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Send slave address
     I2C_Send7bitAddress(I2C1, slave_addr, I2C_Direction_Transmitter);
-    timeout = 0x10000;
-
-    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED) && timeout--);
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    if(timeout == 0){
-        return 1;
+    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Enable DMA
     DMA_Cmd(DMA1_Channel6, ENABLE);
 
     // Wait for DMA completion
-    while(!i2c_dma_tx_complete);
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    // Wait for I2C completion
-    timeout = 0x10000;
+    while(!i2c_dma_tx_complete) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
+    }
 
-    while(!I2C_GetFlagStatus(I2C1, I2C_FLAG_BTF) && timeout--);
+    // Wait for I2C completion
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    if(timeout == 0){
-        return 1;
+    while(!I2C_GetFlagStatus(I2C1, I2C_FLAG_BTF)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Generate stop condition
@@ -159,7 +170,7 @@ uint8_t i2c_dma_write(uint8_t slave_addr, uint8_t *data, uint16_t size){
 }
 
 uint8_t i2c_dma_read(uint8_t slave_addr, uint8_t reg_addr, uint8_t *data, uint16_t size){
-    uint32_t timeout = 0x10000;
+    uint32_t deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
     // First write register address
     if(i2c_dma_write(slave_addr, &reg_addr, 1) != 0) {
@@ -169,10 +180,10 @@ uint8_t i2c_dma_read(uint8_t slave_addr, uint8_t reg_addr, uint8_t *data, uint16
     Delay_Ms(1);
 
     // Wait until I2C is not busy
-    while(I2C_GetFlagStatus(I2C1, I2C_FLAG_BUSY) && timeout--);
-
-    if(timeout == 0){
-        return 1;
+    while(I2C_GetFlagStatus(I2C1, I2C_FLAG_BUSY)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Reset DMA channel
@@ -185,22 +196,22 @@ uint8_t i2c_dma_read(uint8_t slave_addr, uint8_t reg_addr, uint8_t *data, uint16
 
     // Generate start condition
     I2C_GenerateSTART(I2C1, ENABLE);
-    timeout = 0x10000;
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT) && timeout--);
-
-    if(timeout == 0){
-        return 1;
+    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Send slave address for read
     I2C_Send7bitAddress(I2C1, slave_addr, I2C_Direction_Receiver);
-    timeout = 0x10000;
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED) && timeout--);
-
-    if(timeout == 0){
-        return 1;
+    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Configure for last byte
@@ -210,7 +221,13 @@ uint8_t i2c_dma_read(uint8_t slave_addr, uint8_t reg_addr, uint8_t *data, uint16
     DMA_Cmd(DMA1_Channel7, ENABLE);
 
     // Wait for DMA completion
-    while(!i2c_dma_rx_complete);
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
+
+    while(!i2c_dma_rx_complete) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
+    }
 
     // Generate stop condition
     I2C_GenerateSTOP(I2C1, ENABLE);
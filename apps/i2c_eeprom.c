@@ -0,0 +1,78 @@
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "eeprom24.h"
+#include "i2c_master.h"
+#include "timebase.h"
+
+// Rewrites a 1 KB configuration block in a 24C32 (address 0xA0) and reads
+// it back. Page bursts and ACK polling keep the write near the part's own
+// write-cycle time: 32 pages of about 5 ms.
+#define I2C_EEPROM_BLOCK_ADDR 0x0100
+#define I2C_EEPROM_BLOCK_SIZE 1024
+
+static uint8_t i2c_eeprom_block[I2C_EEPROM_BLOCK_SIZE];
+static uint8_t i2c_eeprom_ready = 0;
+static uint8_t i2c_eeprom_pass = 0;
+
+void i2c_eeprom_setup(void){
+    eeprom24_config_t config;
+
+    printf("I2C EEPROM Setup\n");
+
+    i2c_master_init(400000);
+
+    config.address = 0xA0;
+    config.address_bytes = 2;
+    config.page_size = 32;
+    config.size = 4096;
+
+    if(eeprom24_init(&config) != 0) {
+        printf("I2C EEPROM: No EEPROM found\n");
+        return;
+    }
+
+    i2c_eeprom_ready = 1;
+}
+
+void i2c_eeprom_loop(void){
+    uint32_t start, write_us, read_us;
+    uint32_t errors = 0;
+
+    if(!i2c_eeprom_ready) {
+        Delay_Ms(1000);
+        return;
+    }
+
+    i2c_eeprom_pass++;
+    for(int i = 0; i < I2C_EEPROM_BLOCK_SIZE; i++) {
+        i2c_eeprom_block[i] = i + i2c_eeprom_pass;
+    }
+
+    start = timebase_us();
+    if(eeprom24_write(I2C_EEPROM_BLOCK_ADDR, i2c_eeprom_block, I2C_EEPROM_BLOCK_SIZE) != 0) {
+        printf("I2C EEPROM: Write failed\n");
+    }
+    write_us = timebase_us() - start;
+
+    for(int i = 0; i < I2C_EEPROM_BLOCK_SIZE; i++) {
+        i2c_eeprom_block[i] = 0;
+    }
+
+    start = timebase_us();
+    if(eeprom24_read(I2C_EEPROM_BLOCK_ADDR, i2c_eeprom_block, I2C_EEPROM_BLOCK_SIZE) != 0) {
+        printf("I2C EEPROM: Read failed\n");
+    }
+    read_us = timebase_us() - start;
+
+    for(int i = 0; i < I2C_EEPROM_BLOCK_SIZE; i++) {
+        if(i2c_eeprom_block[i] != (uint8_t)(i + i2c_eeprom_pass)) {
+            errors++;
+        }
+    }
+
+    printf("I2C EEPROM: %d bytes written in %d ms, read in %d ms, %d errors\n",
+           I2C_EEPROM_BLOCK_SIZE, (int)(write_us / 1000), (int)(read_us / 1000), (int)errors);
+
+    Delay_Ms(5000);
+}
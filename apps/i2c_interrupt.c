@@ -5,6 +5,7 @@
 #include "debug.h"
 
 #include "framework/app_framework.h"
+#include "framework/irq_dispatch.h"
 
 #define I2C_SLAVE_ADDR 0xA0
 
@@ -23,7 +24,7 @@ volatile uint8_t i2c_reg_addr = 0;
 #define I2C_STATE_READ_ADDR     5
 #define I2C_STATE_READ_DATA     6
 
-void I2C1_EV_IRQHandler(void){
+static void i2c_interrupt_ev_irq_handler(void){
     switch(i2c_state) {
     case I2C_STATE_WRITE_ADDR:
 
@@ -94,7 +95,7 @@ void I2C1_EV_IRQHandler(void){
     }
 }
 
-void I2C1_ER_IRQHandler(void){
+static void i2c_interrupt_er_irq_handler(void){
     if(I2C_GetITStatus(I2C1, I2C_IT_AF) != RESET) {
         I2C_ClearITPendingBit(I2C1, I2C_IT_AF);
         I2C_GenerateSTOP(I2C1, ENABLE);
@@ -134,12 +135,14 @@ void i2c_interrupt_setup(void){
     I2C_ITConfig(I2C1, I2C_IT_EVT | I2C_IT_ERR, ENABLE);
 
     // Configure NVIC
+    irq_attach(I2C1_EV_IRQn, i2c_interrupt_ev_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = I2C1_EV_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&NVIC_InitStructure);
 
+    irq_attach(I2C1_ER_IRQn, i2c_interrupt_er_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = I2C1_ER_IRQn;
     NVIC_Init(&NVIC_InitStructure);
 
@@ -4,8 +4,10 @@
 #include "debug.h"
 
 #include "framework/app_framework.h"
+#include "timebase.h"
 
 #define I2C_SLAVE_ADDR 0xA0  // Example EEPROM address
+#define I2C_TIMEOUT_US 10000 // Per bus phase, independent of clock and optimization
 
 void i2c_polling_setup(void){
     GPIO_InitTypeDef GPIO_InitStructure;
@@ -37,53 +39,53 @@ void i2c_polling_setup(void){
 }
 
 uint8_t i2c_write_byte(uint8_t slave_addr, uint8_t reg_addr, uint8_t data){
-    uint32_t timeout = 0x1000;
+    uint32_t deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
     // Wait until I2C is not busy
-    while(I2C_GetFlagStatus(I2C1, I2C_FLAG_BUSY) && timeout--);
-
-    if(timeout == 0){
-        return 1;
+    while(I2C_GetFlagStatus(I2C1, I2C_FLAG_BUSY)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Generate start condition
     I2C_GenerateSTART(I2C1, ENABLE);
-    timeout = 0x1000;
-
-    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT) && timeout--);
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    if(timeout == 0){
-        return 1;
+    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Send slave address for write
     I2C_Send7bitAddress(I2C1, slave_addr, I2C_Direction_Transmitter);
-    timeout = 0x1000;
-
-    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED) && timeout--);
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    if(timeout == 0){
-        return 1;
+    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Send register address
     I2C_SendData(I2C1, reg_addr);
-    timeout = 0x1000;
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_BYTE_TRANSMITTED) && timeout--);
-
-    if(timeout == 0){
-        return 1;
+    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_BYTE_TRANSMITTED)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Send data
     I2C_SendData(I2C1, data);
-    timeout = 0x1000;
-
-    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_BYTE_TRANSMITTED) && timeout--);
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    if(timeout == 0){
-        return 1;
+    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_BYTE_TRANSMITTED)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Generate stop condition
@@ -93,63 +95,63 @@ uint8_t i2c_write_byte(uint8_t slave_addr, uint8_t reg_addr, uint8_t data){
 }
 
 uint8_t i2c_read_byte(uint8_t slave_addr, uint8_t reg_addr, uint8_t *data){
-    uint32_t timeout = 0x1000;
+    uint32_t deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
     // Wait until I2C is not busy
-    while(I2C_GetFlagStatus(I2C1, I2C_FLAG_BUSY) && timeout--);
-
-    if(timeout == 0){
-        return 1;
+    while(I2C_GetFlagStatus(I2C1, I2C_FLAG_BUSY)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Generate start condition
     I2C_GenerateSTART(I2C1, ENABLE);
-    timeout = 0x1000;
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT) && timeout--);
-
-    if(timeout == 0){
-        return 1;
+    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Send slave address for write
     I2C_Send7bitAddress(I2C1, slave_addr, I2C_Direction_Transmitter);
-    timeout = 0x1000;
-
-    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED) && timeout--);
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    if(timeout == 0){
-        return 1;
+    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Send register address
     I2C_SendData(I2C1, reg_addr);
-    timeout = 0x1000;
-
-    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_BYTE_TRANSMITTED) && timeout--);
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    if(timeout == 0){
-        return 1;
+    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_BYTE_TRANSMITTED)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Generate restart condition
     I2C_GenerateSTART(I2C1, ENABLE);
-    timeout = 0x1000;
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT) && timeout--);
-
-    if(timeout == 0){
-        return 1;
+    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_MODE_SELECT)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Send slave address for read
     I2C_Send7bitAddress(I2C1, slave_addr, I2C_Direction_Receiver);
-    timeout = 0x1000;
-
-    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED) && timeout--);
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    if(timeout == 0){
-        return 1;
+    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Disable ACK and generate stop condition
@@ -157,12 +159,12 @@ uint8_t i2c_read_byte(uint8_t slave_addr, uint8_t reg_addr, uint8_t *data){
     I2C_GenerateSTOP(I2C1, ENABLE);
 
     // Wait for data
-    timeout = 0x1000;
-
-    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_BYTE_RECEIVED) && timeout--);
+    deadline = timebase_deadline_us(I2C_TIMEOUT_US);
 
-    if(timeout == 0){
-        return 1;
+    while(!I2C_CheckEvent(I2C1, I2C_EVENT_MASTER_BYTE_RECEIVED)) {
+        if(timebase_expired(deadline)) {
+            return 1;
+        }
     }
 
     // Read data
@@ -0,0 +1,108 @@
+#include <string.h>
+
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "i2c_master.h"
+#include "i2c_slave.h"
+
+// The board as an I2C peripheral at 0x42 on I2C2 (PB10/PB11) with a
+// 16-byte register map. With PB6-PB10 and PB7-PB11 jumpered, the I2C1
+// master checks the slave on the same board: a write to the scratch
+// registers followed by a repeated-START read of the whole map.
+#define I2C_REGISTER_MAP_ADDR    (0x42 << 1)
+#define I2C_REGISTER_MAP_SIZE    16
+
+#define I2C_REGISTER_MAP_WHO_AM_I 0x00
+#define I2C_REGISTER_MAP_COUNTER  0x01
+#define I2C_REGISTER_MAP_SCRATCH  0x08
+
+static uint8_t i2c_register_map_registers[I2C_REGISTER_MAP_SIZE];
+static volatile uint8_t i2c_register_map_written = 0;
+static volatile uint8_t i2c_register_map_offset;
+static volatile uint8_t i2c_register_map_length;
+
+static i2c_transaction_t i2c_register_map_transaction;
+static uint8_t i2c_register_map_tx[5];
+static uint8_t i2c_register_map_rx[I2C_REGISTER_MAP_SIZE];
+
+static void i2c_register_map_on_write(uint8_t offset, uint8_t length){
+    i2c_register_map_offset = offset;
+    i2c_register_map_length = length;
+    i2c_register_map_written = 1;
+}
+
+// Master side of the loopback test
+static void i2c_register_map_check(void){
+    i2c_transaction_t *transaction = &i2c_register_map_transaction;
+    static uint8_t pattern = 0;
+
+    i2c_register_map_tx[0] = I2C_REGISTER_MAP_SCRATCH;
+    for(uint8_t i = 1; i < sizeof(i2c_register_map_tx); i++) {
+        i2c_register_map_tx[i] = pattern + i;
+    }
+    pattern += 0x10;
+
+    transaction->address = I2C_REGISTER_MAP_ADDR;
+    transaction->tx_buffer = i2c_register_map_tx;
+    transaction->tx_length = sizeof(i2c_register_map_tx);
+    transaction->rx_length = 0;
+    i2c_master_submit(transaction);
+    if(i2c_master_wait(transaction) != 0) {
+        printf("I2C Register Map: Loopback write failed (jumpers fitted?)\n");
+        return;
+    }
+
+    i2c_register_map_tx[0] = I2C_REGISTER_MAP_WHO_AM_I;
+    transaction->tx_length = 1;
+    transaction->rx_buffer = i2c_register_map_rx;
+    transaction->rx_length = I2C_REGISTER_MAP_SIZE;
+    i2c_master_submit(transaction);
+    if(i2c_master_wait(transaction) != 0) {
+        printf("I2C Register Map: Loopback read failed\n");
+        return;
+    }
+
+    printf("I2C Register Map: Loopback read - ");
+    for(int i = 0; i < I2C_REGISTER_MAP_SIZE; i++) {
+        printf("%02X ", i2c_register_map_rx[i]);
+    }
+    printf("\n");
+}
+
+void i2c_register_map_setup(void){
+    i2c_slave_config_t config;
+
+    printf("I2C Register Map Setup\n");
+
+    memset(i2c_register_map_registers, 0, sizeof(i2c_register_map_registers));
+    i2c_register_map_registers[I2C_REGISTER_MAP_WHO_AM_I] = 0xC3;
+
+    config.address = I2C_REGISTER_MAP_ADDR;
+    config.registers = i2c_register_map_registers;
+    config.size = I2C_REGISTER_MAP_SIZE;
+    config.on_write = i2c_register_map_on_write;
+    i2c_slave_init(&config);
+
+    i2c_master_init(400000);
+}
+
+void i2c_register_map_loop(void){
+    const i2c_slave_stats_t *stats = i2c_slave_get_stats();
+
+    // Single byte, so the master never sees it half updated
+    i2c_register_map_registers[I2C_REGISTER_MAP_COUNTER]++;
+
+    i2c_register_map_check();
+
+    if(i2c_register_map_written) {
+        i2c_register_map_written = 0;
+        printf("I2C Register Map: Host wrote %d bytes at 0x%02X\n",
+               i2c_register_map_length, i2c_register_map_offset);
+    }
+
+    printf("I2C Register Map: %d reads, %d writes, %d overruns, %d bus errors\n",
+           (int)stats->reads, (int)stats->writes, (int)stats->overruns, (int)stats->bus_errors);
+
+    Delay_Ms(1000);
+}
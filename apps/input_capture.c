@@ -0,0 +1,87 @@
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_tim.h"
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "timer_capture.h"
+
+// Measures PA8 and PA11 (TIM1 CH1 and CH4, with CH2 and CH3 taking their
+// falling edges) at the full 72 MHz tick. For a self-test, TIM3 puts out
+// 10 kHz at 30 % on PA6 and 70 % on PA7: wire PA6 to PA8 and PA7 to PA11.
+// Edges go to RAM by DMA; the loop computes the figures once a second over
+// the newest 32 periods.
+#define INPUT_CAPTURE_TEST_HZ 10000
+#define INPUT_CAPTURE_PERIODS 32
+
+static void input_capture_test_signal(void){
+    GPIO_InitTypeDef GPIO_InitStructure;
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+    TIM_OCInitTypeDef TIM_OCInitStructure;
+    uint16_t period = SystemCoreClock / INPUT_CAPTURE_TEST_HZ;
+
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3, ENABLE);
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA, ENABLE);
+
+    GPIO_InitStructure.GPIO_Pin = GPIO_Pin_6 | GPIO_Pin_7;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF_PP;
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+    GPIO_Init(GPIOA, &GPIO_InitStructure);
+
+    TIM_TimeBaseStructure.TIM_Period = period - 1;
+    TIM_TimeBaseStructure.TIM_Prescaler = 0;
+    TIM_TimeBaseStructure.TIM_ClockDivision = TIM_CKD_DIV1;
+    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseInit(TIM3, &TIM_TimeBaseStructure);
+
+    TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_PWM1;
+    TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Enable;
+    TIM_OCInitStructure.TIM_Pulse = period * 3 / 10;
+    TIM_OCInitStructure.TIM_OCPolarity = TIM_OCPolarity_High;
+    TIM_OC1Init(TIM3, &TIM_OCInitStructure);
+
+    TIM_OCInitStructure.TIM_Pulse = period * 7 / 10;
+    TIM_OC2Init(TIM3, &TIM_OCInitStructure);
+
+    TIM_Cmd(TIM3, ENABLE);
+}
+
+static void input_capture_report(uint8_t index, const char *pin){
+    timer_capture_result_t result;
+
+    if(timer_capture_measure(index, INPUT_CAPTURE_PERIODS, &result) != 0) {
+        printf("Input Capture: %s no signal\n", pin);
+        return;
+    }
+
+    printf("Input Capture: %s %d.%03d Hz, duty %d.%02d %%, jitter %d ns, period %d-%d ticks\n", pin,
+           (int)(result.frequency / 1000), (int)(result.frequency % 1000),
+           result.duty / 100, result.duty % 100, (int)result.jitter,
+           (int)result.period_min, (int)result.period_max);
+}
+
+void input_capture_setup(void){
+    timer_capture_config_t config;
+
+    printf("Input Capture Setup\n");
+
+    config.timer = TIM1;
+    config.channel_mask = 0x09;
+    config.prescaler = 0;
+    config.filter = 2;
+
+    if(timer_capture_init(&config) != 0) {
+        printf("Input Capture: Init failed\n");
+        return;
+    }
+
+    timer_capture_start();
+    input_capture_test_signal();
+}
+
+void input_capture_loop(void){
+    Delay_Ms(1000);
+
+    input_capture_report(0, "PA8");
+    input_capture_report(3, "PA11");
+}
@@ -0,0 +1,93 @@
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_rcc.h"
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "modbus_rtu.h"
+
+#define MODBUS_SLAVE_ADDRESS 0x11
+
+// Register map served directly by the Modbus engine
+static uint16_t modbus_holding_registers[16];
+static uint16_t modbus_input_registers[4];
+static uint8_t modbus_coils[2];
+static uint8_t modbus_discrete_inputs[1];
+static volatile uint8_t modbus_write_seen = 0;
+
+static void modbus_slave_write_callback(uint8_t function, uint16_t address, uint16_t count){
+    modbus_write_seen = 1;
+}
+
+static const modbus_map_t modbus_slave_map = {
+    .slave_address = MODBUS_SLAVE_ADDRESS,
+    .holding_registers = modbus_holding_registers,
+    .holding_register_count = 16,
+    .input_registers = modbus_input_registers,
+    .input_register_count = 4,
+    .coils = modbus_coils,
+    .coil_count = 16,
+    .discrete_inputs = modbus_discrete_inputs,
+    .discrete_input_count = 8,
+    .write_callback = modbus_slave_write_callback,
+};
+
+void modbus_slave_setup(void){
+    GPIO_InitTypeDef GPIO_InitStructure;
+    rs485_config_t port;
+
+    printf("Modbus Slave Setup\n");
+
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA | RCC_APB2Periph_GPIOC, ENABLE);
+
+    // Coil 0 drives the LED on PC13
+    GPIO_InitStructure.GPIO_Pin = GPIO_Pin_13;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_Out_PP;
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+    GPIO_Init(GPIOC, &GPIO_InitStructure);
+    GPIO_SetBits(GPIOC, GPIO_Pin_13);
+
+    port.usart = USART2;
+    port.baudrate = 115200;
+    port.de_port = GPIOA;
+    port.de_pin = GPIO_Pin_1;
+
+    if(modbus_rtu_init(&port, TIM3, &modbus_slave_map) != 0) {
+        printf("Modbus Slave: Init failed\n");
+        return;
+    }
+
+    printf("Modbus Slave: Address 0x%02X on USART2 at 115200 baud, DE on PA1\n", MODBUS_SLAVE_ADDRESS);
+}
+
+void modbus_slave_loop(void){
+    static uint32_t uptime = 0;
+    const modbus_stats_t *stats = modbus_rtu_get_stats();
+
+    uptime++;
+    modbus_input_registers[0] = uptime & 0xFFFF;
+    modbus_input_registers[1] = uptime >> 16;
+    modbus_input_registers[2] = stats->frames_received & 0xFFFF;
+    modbus_input_registers[3] = stats->crc_errors & 0xFFFF;
+    modbus_discrete_inputs[0] = GPIO_ReadInputData(GPIOA) & 0xFF;
+
+    if(modbus_coils[0] & 0x01) {
+        GPIO_ResetBits(GPIOC, GPIO_Pin_13); // LED ON
+    } else {
+        GPIO_SetBits(GPIOC, GPIO_Pin_13);   // LED OFF
+    }
+
+    if(modbus_write_seen) {
+        modbus_write_seen = 0;
+        printf("Modbus Slave: HR0 = %d, HR1 = %d\n", modbus_holding_registers[0], modbus_holding_registers[1]);
+    }
+
+    printf(
+        "Modbus Slave: RX = %d, TX = %d, CRC errors = %d, exceptions = %d\n",
+        (int)stats->frames_received,
+        (int)stats->frames_answered,
+        (int)stats->crc_errors,
+        (int)stats->exceptions
+    );
+
+    Delay_Ms(1000);
+}
@@ -6,11 +6,12 @@
 #include "debug.h"
 
 #include "framework/app_framework.h"
+#include "framework/irq_dispatch.h"
 
 volatile uint8_t rtc_second_flag = 0;
 volatile uint8_t rtc_alarm_flag = 0;
 
-void RTC_IRQHandler(void){
+static void rtc_irq_handler(void){
     if(RTC_GetITStatus(RTC_IT_SEC) != RESET) {
         rtc_second_flag = 1;
         RTC_ClearITPendingBit(RTC_IT_SEC);
@@ -107,6 +108,7 @@ void rtc_setup(void){
     }
 
     // Configure NVIC
+    irq_attach(RTC_IRQn, rtc_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = RTC_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
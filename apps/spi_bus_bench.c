@@ -0,0 +1,121 @@
+#include <string.h>
+
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_spi.h"
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "spi_queue.h"
+#include "timebase.h"
+
+// Device-switch latency on the SPI1 bus manager. Two devices with different
+// mode and clock (CS on PA4 and PB0); no slaves need to be attached.
+#define SPI_BUS_BENCH_BATCH  8
+#define SPI_BUS_BENCH_ROUNDS 32
+
+static spi_device_t spi_bus_bench_devices[2];
+static spi_transaction_t spi_bus_bench_transactions[SPI_BUS_BENCH_BATCH];
+static uint8_t spi_bus_bench_data[SPI_BUS_BENCH_BATCH];
+
+// Average SysTick ticks (8 cycles each) per one-byte transaction for a
+// queued batch in tenths, with every transaction after the first started
+// from the DMA interrupt
+static uint32_t spi_bus_bench_batch(uint8_t alternate){
+    spi_transaction_t *chain[SPI_BUS_BENCH_BATCH];
+    uint32_t start, total = 0;
+
+    for(uint8_t i = 0; i < SPI_BUS_BENCH_BATCH; i++) {
+        spi_bus_bench_transactions[i].device = &spi_bus_bench_devices[alternate ? i & 1 : 0];
+        chain[i] = &spi_bus_bench_transactions[i];
+    }
+
+    for(uint8_t round = 0; round < SPI_BUS_BENCH_ROUNDS; round++) {
+        start = timebase_ticks();
+        spi_queue_submit_chain(chain, SPI_BUS_BENCH_BATCH);
+        while(spi_bus_bench_transactions[SPI_BUS_BENCH_BATCH - 1].status != SPI_TRANSACTION_DONE);
+        total += timebase_ticks() - start;
+    }
+
+    return total * 10 / (SPI_BUS_BENCH_ROUNDS * SPI_BUS_BENCH_BATCH);
+}
+
+// What a switch used to cost: a full SPI_Init() and SPI_Cmd(), against the
+// two CTLR1 writes the bus manager does now. Timed on the otherwise unused
+// SPI2 so the queue's view of SPI1 stays intact. Tenths of a tick, as above.
+static void spi_bus_bench_register_cost(uint32_t *init_ticks, uint32_t *image_ticks){
+    SPI_InitTypeDef SPI_InitStructure;
+    uint32_t start;
+    uint16_t images[2];
+
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_SPI2, ENABLE);
+
+    images[0] = spi_bus_bench_devices[0].ctlr1;
+    images[1] = spi_bus_bench_devices[1].ctlr1;
+
+    SPI_InitStructure.SPI_Direction = SPI_Direction_2Lines_FullDuplex;
+    SPI_InitStructure.SPI_Mode = SPI_Mode_Master;
+    SPI_InitStructure.SPI_DataSize = SPI_DataSize_8b;
+    SPI_InitStructure.SPI_NSS = SPI_NSS_Soft;
+    SPI_InitStructure.SPI_FirstBit = SPI_FirstBit_MSB;
+    SPI_InitStructure.SPI_CRCPolynomial = 7;
+
+    *init_ticks = 0;
+    *image_ticks = 0;
+
+    for(uint8_t round = 0; round < SPI_BUS_BENCH_ROUNDS; round++) {
+        SPI_InitStructure.SPI_CPOL = round & 1 ? SPI_CPOL_High : SPI_CPOL_Low;
+        SPI_InitStructure.SPI_CPHA = round & 1 ? SPI_CPHA_2Edge : SPI_CPHA_1Edge;
+        SPI_InitStructure.SPI_BaudRatePrescaler = round & 1 ? SPI_BaudRatePrescaler_8 : SPI_BaudRatePrescaler_2;
+
+        start = timebase_ticks();
+        SPI_Cmd(SPI2, DISABLE);
+        SPI_Init(SPI2, &SPI_InitStructure);
+        SPI_Cmd(SPI2, ENABLE);
+        *init_ticks += timebase_ticks() - start;
+
+        start = timebase_ticks();
+        SPI2->CTLR1 = images[round & 1] & ~SPI_CTLR1_SPE;
+        SPI2->CTLR1 = images[round & 1];
+        *image_ticks += timebase_ticks() - start;
+    }
+
+    *init_ticks = *init_ticks * 10 / SPI_BUS_BENCH_ROUNDS;
+    *image_ticks = *image_ticks * 10 / SPI_BUS_BENCH_ROUNDS;
+
+    SPI_I2S_DeInit(SPI2);
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_SPI2, DISABLE);
+}
+
+void spi_bus_bench_setup(void){
+    printf("SPI Bus Benchmark Setup\n");
+
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA | RCC_APB2Periph_GPIOB, ENABLE);
+    spi_queue_init();
+
+    spi_device_init(&spi_bus_bench_devices[0], GPIOA, GPIO_Pin_4, 0, SPI_BaudRatePrescaler_2);
+    spi_device_init(&spi_bus_bench_devices[1], GPIOB, GPIO_Pin_0, 3, SPI_BaudRatePrescaler_8);
+
+    memset(spi_bus_bench_transactions, 0, sizeof(spi_bus_bench_transactions));
+    for(uint8_t i = 0; i < SPI_BUS_BENCH_BATCH; i++) {
+        spi_bus_bench_transactions[i].tx_buffer = &spi_bus_bench_data[i];
+        spi_bus_bench_transactions[i].length = 1;
+    }
+}
+
+void spi_bus_bench_loop(void){
+    uint32_t same, alternate, init_ticks, image_ticks;
+
+    same = spi_bus_bench_batch(0);
+    alternate = spi_bus_bench_batch(1);
+    spi_bus_bench_register_cost(&init_ticks, &image_ticks);
+
+    // Device 1 clocks 4x slower, so half the alternating batch is longer on
+    // the wire; compare the register costs for the switch itself
+    printf("SPI Bus Benchmark: %d.%d ticks/transaction same device, %d.%d alternating\n",
+           (int)(same / 10), (int)(same % 10), (int)(alternate / 10), (int)(alternate % 10));
+    printf("SPI Bus Benchmark: Switch by SPI_Init() %d.%d ticks, by CTLR1 image %d.%d ticks\n",
+           (int)(init_ticks / 10), (int)(init_ticks % 10), (int)(image_ticks / 10), (int)(image_ticks % 10));
+
+    Delay_Ms(2000);
+}
@@ -0,0 +1,89 @@
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_spi.h"
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "spi_lcd.h"
+#include "spi_queue.h"
+
+// 128x160 ST7735 on SPI1: CS PA4, DC PA3, RST PA2
+#define SPI_DISPLAY_WIDTH  128
+#define SPI_DISPLAY_HEIGHT 160
+#define SPI_DISPLAY_BOX    20
+
+static int16_t spi_display_x = 0;
+static int16_t spi_display_y = 0;
+static int16_t spi_display_dx = 2;
+static int16_t spi_display_dy = 3;
+static uint32_t spi_display_frames = 0;
+
+// Gradient background with a bouncing box on top
+static void spi_display_render(uint16_t x, uint16_t y, uint16_t width, uint16_t lines, uint16_t *pixels){
+    for(uint16_t row = y; row < y + lines; row++) {
+        for(uint16_t column = x; column < x + width; column++) {
+            if(column >= spi_display_x && column < spi_display_x + SPI_DISPLAY_BOX &&
+               row >= spi_display_y && row < spi_display_y + SPI_DISPLAY_BOX) {
+                *pixels++ = SPI_LCD_RGB565(255, 255, 0);
+            } else {
+                *pixels++ = SPI_LCD_RGB565(0, column * 2, row);
+            }
+        }
+    }
+}
+
+void spi_display_setup(void){
+    spi_lcd_config_t config;
+
+    printf("SPI Display Setup\n");
+
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA, ENABLE);
+    spi_queue_init();
+
+    config.controller = SPI_LCD_ST7735;
+    config.width = SPI_DISPLAY_WIDTH;
+    config.height = SPI_DISPLAY_HEIGHT;
+    config.x_offset = 0;
+    config.y_offset = 0;
+    config.madctl = SPI_LCD_MADCTL_MX | SPI_LCD_MADCTL_MY;
+    config.cs_port = GPIOA;
+    config.cs_pin = GPIO_Pin_4;
+    config.dc_port = GPIOA;
+    config.dc_pin = GPIO_Pin_3;
+    config.reset_port = GPIOA;
+    config.reset_pin = GPIO_Pin_2;
+    config.prescaler = SPI_BaudRatePrescaler_4;
+
+    if(spi_lcd_init(&config) != 0) {
+        printf("SPI Display: Init failed\n");
+        return;
+    }
+
+    spi_lcd_invalidate_all();
+    spi_lcd_flush(spi_display_render);
+
+    printf("SPI Display: ST7735 %dx%d, CS PA4, DC PA3, RST PA2\n", SPI_DISPLAY_WIDTH, SPI_DISPLAY_HEIGHT);
+}
+
+void spi_display_loop(void){
+    // Only the box's old and new positions are redrawn
+    spi_lcd_invalidate(spi_display_x, spi_display_y, SPI_DISPLAY_BOX, SPI_DISPLAY_BOX);
+
+    spi_display_x += spi_display_dx;
+    spi_display_y += spi_display_dy;
+    if(spi_display_x <= 0 || spi_display_x >= SPI_DISPLAY_WIDTH - SPI_DISPLAY_BOX) {
+        spi_display_dx = -spi_display_dx;
+    }
+    if(spi_display_y <= 0 || spi_display_y >= SPI_DISPLAY_HEIGHT - SPI_DISPLAY_BOX) {
+        spi_display_dy = -spi_display_dy;
+    }
+
+    spi_lcd_invalidate(spi_display_x, spi_display_y, SPI_DISPLAY_BOX, SPI_DISPLAY_BOX);
+    spi_lcd_flush(spi_display_render);
+
+    if(++spi_display_frames % 100 == 0) {
+        printf("SPI Display: %d frames\n", (int)spi_display_frames);
+    }
+
+    Delay_Ms(10);
+}
@@ -6,6 +6,7 @@
 #include "debug.h"
 
 #include "framework/app_framework.h"
+#include "framework/irq_dispatch.h"
 
 #define SPI_DMA_BUFFER_SIZE 16
 
@@ -14,14 +15,14 @@ volatile uint8_t spi_dma_rx_buffer[SPI_DMA_BUFFER_SIZE];
 volatile uint8_t spi_dma_tx_complete = 1;
 volatile uint8_t spi_dma_rx_complete = 1;
 
-void DMA1_Channel2_IRQHandler(void){
+static void spi_dma_rx_irq_handler(void){
     if(DMA_GetITStatus(DMA1_IT_TC2) != RESET) {
         spi_dma_rx_complete = 1;
         DMA_ClearITPendingBit(DMA1_IT_TC2);
     }
 }
 
-void DMA1_Channel3_IRQHandler(void){
+static void spi_dma_tx_irq_handler(void){
     if(DMA_GetITStatus(DMA1_IT_TC3) != RESET) {
         spi_dma_tx_complete = 1;
         DMA_ClearITPendingBit(DMA1_IT_TC3);
@@ -89,12 +90,14 @@ void spi_dma_setup(void){
     DMA_ITConfig(DMA1_Channel3, DMA_IT_TC, ENABLE);
 
     // Configure NVIC for DMA
+    irq_attach(DMA1_Channel2_IRQn, spi_dma_rx_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel2_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&NVIC_InitStructure);
 
+    irq_attach(DMA1_Channel3_IRQn, spi_dma_tx_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel3_IRQn;
     NVIC_Init(&NVIC_InitStructure);
 
@@ -5,6 +5,7 @@
 #include "debug.h"
 
 #include "framework/app_framework.h"
+#include "framework/irq_dispatch.h"
 
 #define SPI_BUFFER_SIZE 16
 
@@ -15,7 +16,7 @@ volatile uint16_t spi_int_rx_index = 0;
 volatile uint16_t spi_int_transfer_length = 0;
 volatile uint8_t spi_int_transfer_complete = 1;
 
-void SPI1_IRQHandler(void){
+static void spi_interrupt_irq_handler(void){
     // Handle receive interrupt
     if(SPI_I2S_GetITStatus(SPI1, SPI_I2S_IT_RXNE) != RESET) {
         spi_int_rx_buffer[spi_int_rx_index++] = SPI_I2S_ReceiveData(SPI1);
@@ -86,6 +87,7 @@ void spi_interrupt_setup(void){
     SPI_Init(SPI1, &SPI_InitStructure);
 
     // Configure NVIC
+    irq_attach(SPI1_IRQn, spi_interrupt_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = SPI1_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
@@ -0,0 +1,65 @@
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_spi.h"
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "spi_queue.h"
+
+#define SPI_MULTI_LENGTH 16
+
+// Two devices sharing SPI1: one in mode 0 at 9 MHz (CS PA4), one in mode 3 at 1.1 MHz (CS PB0)
+static uint8_t spi_multi_tx[2][SPI_MULTI_LENGTH];
+static uint8_t spi_multi_rx[2][SPI_MULTI_LENGTH];
+static spi_device_t spi_multi_devices[2];
+static spi_transaction_t spi_multi_transactions[2];
+static volatile uint32_t spi_multi_completed = 0;
+
+static void spi_multi_complete(spi_transaction_t *transaction){
+    spi_multi_completed++;
+}
+
+void spi_multi_setup(void){
+    printf("SPI Multi-Device Setup\n");
+
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA | RCC_APB2Periph_GPIOB, ENABLE);
+
+    spi_queue_init();
+    spi_device_init(&spi_multi_devices[0], GPIOA, GPIO_Pin_4, 0, SPI_BaudRatePrescaler_8);
+    spi_device_init(&spi_multi_devices[1], GPIOB, GPIO_Pin_0, 3, SPI_BaudRatePrescaler_64);
+
+    for(int i = 0; i < SPI_MULTI_LENGTH; i++) {
+        spi_multi_tx[0][i] = i;
+        spi_multi_tx[1][i] = 0x80 | i;
+    }
+
+    spi_multi_transactions[0].device = &spi_multi_devices[0];
+    spi_multi_transactions[0].tx_buffer = spi_multi_tx[0];
+    spi_multi_transactions[0].rx_buffer = spi_multi_rx[0];
+    spi_multi_transactions[0].length = SPI_MULTI_LENGTH;
+    spi_multi_transactions[0].callback = spi_multi_complete;
+
+    spi_multi_transactions[1].device = &spi_multi_devices[1];
+    spi_multi_transactions[1].tx_buffer = spi_multi_tx[1];
+    spi_multi_transactions[1].rx_buffer = spi_multi_rx[1];
+    spi_multi_transactions[1].length = SPI_MULTI_LENGTH;
+    spi_multi_transactions[1].callback = spi_multi_complete;
+
+    printf("SPI Multi-Device: Device 0 on PA4 (mode 0), device 1 on PB0 (mode 3)\n");
+}
+
+void spi_multi_loop(void){
+    // Both transactions go back to back on the bus; the CPU is free meanwhile
+    spi_queue_submit(&spi_multi_transactions[0]);
+    spi_queue_submit(&spi_multi_transactions[1]);
+
+    Delay_Ms(500);
+
+    printf("SPI Multi-Device: %d transactions completed, RX0[0] = 0x%02X, RX1[0] = 0x%02X\n",
+           (int)spi_multi_completed, spi_multi_rx[0][0], spi_multi_rx[1][0]);
+
+    for(int i = 0; i < SPI_MULTI_LENGTH; i++) {
+        spi_multi_tx[0][i]++;
+        spi_multi_tx[1][i]--;
+    }
+}
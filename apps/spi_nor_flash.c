@@ -0,0 +1,89 @@
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_spi.h"
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "spi_nor.h"
+#include "spi_queue.h"
+
+// W25Qxx on SPI1 with CS on PA4; the first sector is used as test area
+static uint8_t spi_nor_flash_block[SPI_NOR_BLOCK_SIZE];
+static uint8_t spi_nor_flash_ready = 0;
+static uint8_t spi_nor_flash_pass = 0;
+
+static uint32_t spi_nor_flash_verify(const blockdev_t *dev, uint32_t block, uint8_t seed){
+    uint32_t errors = 0;
+
+    if(dev->read(dev, block, spi_nor_flash_block, 1) != 0) {
+        return SPI_NOR_BLOCK_SIZE;
+    }
+
+    for(int i = 0; i < SPI_NOR_BLOCK_SIZE; i++) {
+        if(spi_nor_flash_block[i] != (uint8_t)(i + seed)) {
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+void spi_nor_flash_setup(void){
+    spi_nor_config_t config;
+
+    printf("SPI NOR Flash Setup\n");
+
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA, ENABLE);
+    spi_queue_init();
+
+    config.cs_port = GPIOA;
+    config.cs_pin = GPIO_Pin_4;
+    config.prescaler = SPI_BaudRatePrescaler_2;
+
+    if(spi_nor_init(&config) != 0) {
+        printf("SPI NOR: No chip found (JEDEC ID 0x%06X)\n", (unsigned int)spi_nor_get_jedec_id());
+        return;
+    }
+
+    spi_nor_flash_ready = 1;
+    printf("SPI NOR: JEDEC ID 0x%06X, %d KB\n",
+           (unsigned int)spi_nor_get_jedec_id(), (int)(spi_nor_get_capacity() / 1024));
+}
+
+void spi_nor_flash_loop(void){
+    const blockdev_t *dev = spi_nor_get_blockdev();
+    uint32_t errors = 0;
+    uint8_t seed = spi_nor_flash_pass++;
+
+    if(!spi_nor_flash_ready) {
+        Delay_Ms(1000);
+        return;
+    }
+
+    // Fresh sector: blocks are programmed in place, pages pipelined
+    spi_nor_erase(0, SPI_NOR_SECTOR_SIZE);
+    for(int block = 0; block < SPI_NOR_SECTOR_SIZE / SPI_NOR_BLOCK_SIZE; block++) {
+        for(int i = 0; i < SPI_NOR_BLOCK_SIZE; i++) {
+            spi_nor_flash_block[i] = i + seed + block;
+        }
+        dev->write(dev, block, spi_nor_flash_block, 1);
+    }
+
+    for(int block = 0; block < SPI_NOR_SECTOR_SIZE / SPI_NOR_BLOCK_SIZE; block++) {
+        errors += spi_nor_flash_verify(dev, block, seed + block);
+    }
+
+    // Overwriting programmed data goes through the scratch sector
+    for(int i = 0; i < SPI_NOR_BLOCK_SIZE; i++) {
+        spi_nor_flash_block[i] = i + seed + 0x55;
+    }
+    dev->write(dev, 3, spi_nor_flash_block, 1);
+    dev->sync(dev);
+
+    errors += spi_nor_flash_verify(dev, 3, seed + 0x55);
+    errors += spi_nor_flash_verify(dev, 4, seed + 4);
+
+    printf("SPI NOR: Pass %d, %d byte errors\n", seed, (int)errors);
+
+    Delay_Ms(2000);
+}
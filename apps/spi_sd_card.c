@@ -0,0 +1,87 @@
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_spi.h"
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "sd_card.h"
+#include "spi_queue.h"
+
+// SD card on SPI1 with CS on PA4. Overwrites raw blocks from
+// SPI_SD_CARD_FIRST_BLOCK on, so use a scratch card.
+#define SPI_SD_CARD_FIRST_BLOCK 65536
+#define SPI_SD_CARD_RUN         4
+
+static uint8_t spi_sd_card_buffer[SPI_SD_CARD_RUN * SD_CARD_BLOCK_SIZE];
+static uint8_t spi_sd_card_ready = 0;
+static uint32_t spi_sd_card_block = SPI_SD_CARD_FIRST_BLOCK;
+
+void spi_sd_card_setup(void){
+    sd_card_config_t config;
+
+    printf("SPI SD Card Setup\n");
+
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA, ENABLE);
+    spi_queue_init();
+
+    config.cs_port = GPIOA;
+    config.cs_pin = GPIO_Pin_4;
+    config.prescaler = SPI_BaudRatePrescaler_4;
+
+    if(sd_card_init(&config) != 0) {
+        printf("SPI SD Card: No card found\n");
+        return;
+    }
+
+    spi_sd_card_ready = 1;
+    printf("SPI SD Card: %s, %d MB\n", sd_card_is_sdhc() ? "SDHC" : "SDSC",
+           (int)(sd_card_get_block_count() / 2048));
+}
+
+void spi_sd_card_loop(void){
+    const blockdev_t *dev = sd_card_get_blockdev();
+    const sd_card_stats_t *stats = sd_card_get_stats();
+    uint32_t errors = 0;
+
+    if(!spi_sd_card_ready) {
+        Delay_Ms(1000);
+        return;
+    }
+
+    // One multi-block run straight to the card, as a logger would write it
+    for(int i = 0; i < (int)sizeof(spi_sd_card_buffer); i++) {
+        spi_sd_card_buffer[i] = i + spi_sd_card_block;
+    }
+
+    if(dev->write(dev, spi_sd_card_block, spi_sd_card_buffer, SPI_SD_CARD_RUN) != 0) {
+        printf("SPI SD Card: Write failed at block %d\n", (int)spi_sd_card_block);
+    }
+
+    for(int i = 0; i < (int)sizeof(spi_sd_card_buffer); i++) {
+        spi_sd_card_buffer[i] = 0;
+    }
+
+    if(dev->read(dev, spi_sd_card_block, spi_sd_card_buffer, SPI_SD_CARD_RUN) != 0) {
+        printf("SPI SD Card: Read failed at block %d\n", (int)spi_sd_card_block);
+    }
+
+    for(int i = 0; i < (int)sizeof(spi_sd_card_buffer); i++) {
+        if(spi_sd_card_buffer[i] != (uint8_t)(i + spi_sd_card_block)) {
+            errors++;
+        }
+    }
+
+    // Single-block rewrites of the same block stay in the cache until sync
+    for(int i = 0; i < 8; i++) {
+        spi_sd_card_buffer[0] = i;
+        dev->write(dev, spi_sd_card_block, spi_sd_card_buffer, 1);
+    }
+    dev->sync(dev);
+
+    printf("SPI SD Card: Block %d, %d byte errors, CRC errors = %d, timeouts = %d, writebacks = %d\n",
+           (int)spi_sd_card_block, (int)errors, (int)stats->crc_errors, (int)stats->timeouts, (int)stats->writebacks);
+
+    spi_sd_card_block += SPI_SD_CARD_RUN;
+
+    Delay_Ms(1000);
+}
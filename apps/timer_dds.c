@@ -0,0 +1,57 @@
+#include "ch32v10x_tim.h"
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "dds.h"
+
+// Waveform generator on PA6 (TIM3 CH1): 10-bit PWM at 70.3 kHz, filtered by
+// an RC low-pass (e.g. 1 k and 22 nF, ~7 kHz) into an analog signal. Every
+// two seconds it moves to the next waveform and frequency; the odd
+// frequencies show off the millihertz resolution.
+typedef struct {
+    const char *name;
+    const q15_t *table;
+    uint32_t millihertz;
+} timer_dds_step_t;
+
+static const timer_dds_step_t timer_dds_steps[] = {
+    {"sine", dds_sine, 1000000},
+    {"sine", dds_sine, 1234567},
+    {"triangle", dds_triangle, 440000},
+    {"sine", dds_sine, 50},
+};
+
+static uint8_t timer_dds_index = 0;
+
+void timer_dds_setup(void){
+    dds_config_t config;
+
+    printf("Timer DDS Setup\n");
+
+    config.timer = TIM3;
+    config.channel = TIM_Channel_1;
+    config.period = 1024;
+
+    if(dds_init(&config) != 0 || dds_start() != 0) {
+        printf("Timer DDS: Init failed\n");
+        return;
+    }
+
+    printf("Timer DDS: %d Hz sample rate on PA6\n", (int)dds_sample_rate());
+}
+
+void timer_dds_loop(void){
+    const timer_dds_step_t *step = &timer_dds_steps[timer_dds_index];
+    const dds_stats_t *stats = dds_get_stats();
+
+    dds_set_waveform(step->table);
+    dds_set_frequency(step->millihertz);
+
+    printf("Timer DDS: %s at %d.%03d Hz, %d half buffers, %d overruns\n", step->name,
+           (int)(step->millihertz / 1000), (int)(step->millihertz % 1000),
+           (int)stats->half_buffers, (int)stats->overruns);
+
+    timer_dds_index = (timer_dds_index + 1) % (sizeof(timer_dds_steps) / sizeof(timer_dds_steps[0]));
+
+    Delay_Ms(2000);
+}
@@ -5,11 +5,12 @@
 #include "debug.h"
 
 #include "framework/app_framework.h"
+#include "framework/irq_dispatch.h"
 
 volatile uint32_t timer_int_counter = 0;
 volatile uint8_t timer_int_led_state = 0;
 
-void TIM2_IRQHandler(void){
+static void timer_interrupt_irq_handler(void){
     if(TIM_GetITStatus(TIM2, TIM_IT_Update) != RESET) {
         timer_int_counter++;
 
@@ -61,6 +62,7 @@ void timer_interrupt_setup(void){
     TIM_ITConfig(TIM2, TIM_IT_Update, ENABLE);
 
     // Configure NVIC
+    irq_attach(TIM2_IRQn, timer_interrupt_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = TIM2_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 1;
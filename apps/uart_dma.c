@@ -6,6 +6,7 @@
 #include "debug.h"
 
 #include "framework/app_framework.h"
+#include "framework/irq_dispatch.h"
 
 #define DMA_BUFFER_SIZE 64
 
@@ -14,14 +15,14 @@ volatile char uart_tx_dma_buffer[DMA_BUFFER_SIZE];
 volatile uint8_t uart_dma_rx_complete = 0;
 volatile uint8_t uart_dma_tx_complete = 1; // Initially ready to transmit
 
-void DMA1_Channel4_IRQHandler(void){
+static void uart_dma_tx_irq_handler(void){
     if(DMA_GetITStatus(DMA1_IT_TC4) != RESET) {
         uart_dma_tx_complete = 1;
         DMA_ClearITPendingBit(DMA1_IT_TC4);
     }
 }
 
-void DMA1_Channel5_IRQHandler(void){
+static void uart_dma_rx_irq_handler(void){
     if(DMA_GetITStatus(DMA1_IT_TC5) != RESET) {
         uart_dma_rx_complete = 1;
         DMA_ClearITPendingBit(DMA1_IT_TC5);
@@ -78,12 +79,14 @@ void uart_dma_setup(void){
     DMA_ITConfig(DMA1_Channel5, DMA_IT_TC, ENABLE);
 
     // Configure NVIC for DMA
+    irq_attach(DMA1_Channel4_IRQn, uart_dma_tx_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel4_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&NVIC_InitStructure);
 
+    irq_attach(DMA1_Channel5_IRQn, uart_dma_rx_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel5_IRQn;
     NVIC_Init(&NVIC_InitStructure);
 
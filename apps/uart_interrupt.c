@@ -5,6 +5,7 @@
 #include "debug.h"
 
 #include "framework/app_framework.h"
+#include "framework/irq_dispatch.h"
 
 #define RX_BUFFER_SIZE 128
 #define TX_BUFFER_SIZE 128
@@ -15,7 +16,7 @@ volatile uint16_t uart_int_rx_head = 0, uart_int_rx_tail = 0;
 volatile uint16_t uart_int_tx_head = 0, uart_int_tx_tail = 0;
 volatile uint8_t uart_int_tx_busy = 0;
 
-void USART1_IRQHandler(void){
+static void uart_interrupt_irq_handler(void){
     // Handle receive interrupt
     if(USART_GetITStatus(USART1, USART_IT_RXNE) != RESET) {
         uint8_t received_char = USART_ReceiveData(USART1);
@@ -77,6 +78,7 @@ void uart_interrupt_setup(void){
     USART_ITConfig(USART1, USART_IT_RXNE, ENABLE);
 
     // Configure NVIC
+    irq_attach(USART1_IRQn, uart_interrupt_irq_handler);
     NVIC_InitStructure.NVIC_IRQChannel = USART1_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
@@ -0,0 +1,71 @@
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_rcc.h"
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "rs485.h"
+
+// USART2 keeps USART1 free for printf; DE/RE of the transceiver on PA1
+#define RS485_DE_PORT GPIOA
+#define RS485_DE_PIN  GPIO_Pin_1
+
+static uint8_t uart_rs485_tx_frame[] = "RS485 frame #0000\r\n";
+static volatile uint32_t uart_rs485_frames_sent = 0;
+
+static void uart_rs485_tx_complete(void){
+    uart_rs485_frames_sent++;
+}
+
+void uart_rs485_setup(void){
+    rs485_config_t config;
+
+    printf("UART RS485 Setup\n");
+
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA, ENABLE);
+
+    config.usart = USART2;
+    config.baudrate = 115200;
+    config.de_port = RS485_DE_PORT;
+    config.de_pin = RS485_DE_PIN;
+
+    if(rs485_init(&config) != 0) {
+        printf("UART RS485: Init failed\n");
+        return;
+    }
+
+    rs485_set_tx_complete_callback(uart_rs485_tx_complete);
+
+    printf("UART RS485: USART2 at 115200 baud, DE on PA1, TX on PA2, RX on PA3\n");
+}
+
+void uart_rs485_loop(void){
+    static uint16_t sequence = 0;
+    uint8_t rx_data[32];
+    uint16_t count;
+
+    // Frame buffer is sent in place, so only touch it once the bus is released
+    if(!rs485_is_busy()) {
+        uart_rs485_tx_frame[13] = '0' + (sequence / 1000) % 10;
+        uart_rs485_tx_frame[14] = '0' + (sequence / 100) % 10;
+        uart_rs485_tx_frame[15] = '0' + (sequence / 10) % 10;
+        uart_rs485_tx_frame[16] = '0' + sequence % 10;
+        rs485_send(uart_rs485_tx_frame, sizeof(uart_rs485_tx_frame) - 1);
+        sequence++;
+    }
+
+    count = rs485_read(rx_data, sizeof(rx_data));
+
+    if(count > 0) {
+        printf("UART RS485: Received %d bytes: ", count);
+
+        for(uint16_t i = 0; i < count; i++) {
+            printf("0x%02X ", rx_data[i]);
+        }
+
+        printf("\n");
+    }
+
+    printf("UART RS485: Frames sent = %d\n", (int)uart_rs485_frames_sent);
+
+    Delay_Ms(500);
+}
@@ -0,0 +1,83 @@
+#include "ch32v10x_tim.h"
+#include "debug.h"
+
+#include "framework/app_framework.h"
+#include "timebase.h"
+#include "ws2812.h"
+
+// A moving rainbow on 300 LEDs at 60 fps, data on PA6 (TIM3 CH1). Each
+// frame is drawn into one pixel buffer while the driver sends the other.
+// Once a second it prints the frame rate and how much of the CPU the
+// drawing took; the driver's own share is its interrupts, ~1 %.
+#define WS2812_STRIP_LEDS     300
+#define WS2812_STRIP_FRAME_US 16667
+
+static uint8_t ws2812_strip_pixels[2][WS2812_STRIP_LEDS * 3];
+static uint8_t ws2812_strip_front = 0;
+static uint8_t ws2812_strip_hue = 0;
+static uint32_t ws2812_strip_deadline;
+static uint32_t ws2812_strip_report;
+static uint32_t ws2812_strip_draw_ticks = 0;
+
+// Hue 0-255 around red, green and blue at a quarter brightness
+static void ws2812_strip_wheel(uint8_t *pixels, uint16_t index, uint8_t hue){
+    uint8_t step = (hue % 85) * 3 / 4;
+
+    if(hue < 85) {
+        ws2812_set_pixel(pixels, index, 63 - step, step, 0);
+    } else if(hue < 170) {
+        ws2812_set_pixel(pixels, index, 0, 63 - step, step);
+    } else {
+        ws2812_set_pixel(pixels, index, step, 0, 63 - step);
+    }
+}
+
+static void ws2812_strip_draw(uint8_t *pixels){
+    uint32_t start = timebase_ticks();
+
+    for(uint16_t i = 0; i < WS2812_STRIP_LEDS; i++) {
+        ws2812_strip_wheel(pixels, i, ws2812_strip_hue + i * 256 / WS2812_STRIP_LEDS);
+    }
+    ws2812_strip_hue++;
+
+    ws2812_strip_draw_ticks += timebase_ticks() - start;
+}
+
+void ws2812_strip_setup(void){
+    printf("WS2812 Strip Setup\n");
+
+    if(ws2812_init(TIM_Channel_1) != 0) {
+        printf("WS2812 Strip: Init failed\n");
+        return;
+    }
+
+    ws2812_strip_draw(ws2812_strip_pixels[0]);
+    ws2812_strip_deadline = timebase_us();
+    ws2812_strip_report = timebase_deadline_us(1000000);
+}
+
+void ws2812_strip_loop(void){
+    const ws2812_stats_t *stats = ws2812_get_stats();
+    static uint32_t frames = 0;
+
+    if(timebase_expired(ws2812_strip_deadline) && !ws2812_is_busy()) {
+        ws2812_strip_deadline += WS2812_STRIP_FRAME_US;
+        ws2812_show(ws2812_strip_pixels[ws2812_strip_front], WS2812_STRIP_LEDS);
+
+        ws2812_strip_front ^= 1;
+        ws2812_strip_draw(ws2812_strip_pixels[ws2812_strip_front]);
+    }
+
+    if(timebase_expired(ws2812_strip_report)) {
+        ws2812_strip_report += 1000000;
+
+        printf("WS2812 Strip: %d fps, drawing %d.%d %% CPU, %d underruns\n",
+               (int)(stats->frames - frames),
+               (int)(ws2812_strip_draw_ticks / (timebase_tick_hz() / 100)),
+               (int)(ws2812_strip_draw_ticks / (timebase_tick_hz() / 1000) % 10),
+               (int)stats->underruns);
+
+        frames = stats->frames;
+        ws2812_strip_draw_ticks = 0;
+    }
+}
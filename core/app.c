@@ -16,6 +16,24 @@ void adc_interrupt_setup(void);
 void adc_interrupt_loop(void);
 void adc_dma_setup(void);
 void adc_dma_loop(void);
+void adc_multichannel_setup(void);
+void adc_multichannel_loop(void);
+void adc_timed_setup(void);
+void adc_timed_loop(void);
+void adc_spectrum_setup(void);
+void adc_spectrum_loop(void);
+void adc_highres_setup(void);
+void adc_highres_loop(void);
+void adc_temperature_setup(void);
+void adc_temperature_loop(void);
+void adc_priority_setup(void);
+void adc_priority_loop(void);
+void adc_trigger_setup(void);
+void adc_trigger_loop(void);
+void adc_scope_setup(void);
+void adc_scope_loop(void);
+void dsp_bench_setup(void);
+void dsp_bench_loop(void);
 
 // GPIO apps
 void gpio_polling_setup(void);
@@ -30,6 +48,12 @@ void i2c_interrupt_setup(void);
 void i2c_interrupt_loop(void);
 void i2c_dma_setup(void);
 void i2c_dma_loop(void);
+void i2c_async_setup(void);
+void i2c_async_loop(void);
+void i2c_eeprom_setup(void);
+void i2c_eeprom_loop(void);
+void i2c_register_map_setup(void);
+void i2c_register_map_loop(void);
 
 // SPI apps
 void spi_polling_setup(void);
@@ -38,12 +62,30 @@ void spi_interrupt_setup(void);
 void spi_interrupt_loop(void);
 void spi_dma_setup(void);
 void spi_dma_loop(void);
+void spi_multi_setup(void);
+void spi_multi_loop(void);
+void spi_nor_flash_setup(void);
+void spi_nor_flash_loop(void);
+void spi_display_setup(void);
+void spi_display_loop(void);
+void spi_sd_card_setup(void);
+void spi_sd_card_loop(void);
+void fat_logger_setup(void);
+void fat_logger_loop(void);
+void spi_bus_bench_setup(void);
+void spi_bus_bench_loop(void);
 
 // Timer apps
 void timer_interrupt_setup(void);
 void timer_interrupt_loop(void);
 void timer_pwm_setup(void);
 void timer_pwm_loop(void);
+void timer_dds_setup(void);
+void timer_dds_loop(void);
+void input_capture_setup(void);
+void input_capture_loop(void);
+void ws2812_strip_setup(void);
+void ws2812_strip_loop(void);
 
 // UART apps
 void uart_polling_setup(void);
@@ -52,6 +94,10 @@ void uart_interrupt_setup(void);
 void uart_interrupt_loop(void);
 void uart_dma_setup(void);
 void uart_dma_loop(void);
+void uart_rs485_setup(void);
+void uart_rs485_loop(void);
+void modbus_slave_setup(void);
+void modbus_slave_loop(void);
 
 // Other apps
 void rtc_setup(void);
@@ -76,6 +122,15 @@ void register_all_apps(void) {
     // register_app("ADC Polling", adc_polling_setup, adc_polling_loop);
     // register_app("ADC Interrupt", adc_interrupt_setup, adc_interrupt_loop);
     // register_app("ADC DMA", adc_dma_setup, adc_dma_loop);
+    // register_app("ADC Multichannel", adc_multichannel_setup, adc_multichannel_loop);
+    // register_app("ADC Timed", adc_timed_setup, adc_timed_loop);
+    // register_app("ADC Spectrum", adc_spectrum_setup, adc_spectrum_loop);
+    // register_app("ADC High Resolution", adc_highres_setup, adc_highres_loop);
+    // register_app("ADC Temperature", adc_temperature_setup, adc_temperature_loop);
+    // register_app("ADC Priority", adc_priority_setup, adc_priority_loop);
+    // register_app("ADC Trigger", adc_trigger_setup, adc_trigger_loop);
+    // register_app("ADC Scope", adc_scope_setup, adc_scope_loop);
+    // register_app("DSP Benchmark", dsp_bench_setup, dsp_bench_loop);
 
     // ===========================================
     // GPIO APPS
@@ -89,6 +144,9 @@ void register_all_apps(void) {
     // register_app("I2C Polling", i2c_polling_setup, i2c_polling_loop);
     // register_app("I2C Interrupt", i2c_interrupt_setup, i2c_interrupt_loop);
     // register_app("I2C DMA", i2c_dma_setup, i2c_dma_loop);
+    // register_app("I2C Async", i2c_async_setup, i2c_async_loop);
+    // register_app("I2C EEPROM", i2c_eeprom_setup, i2c_eeprom_loop);
+    // register_app("I2C Register Map", i2c_register_map_setup, i2c_register_map_loop);
 
     // ===========================================
     // SPI APPS
@@ -96,12 +154,21 @@ void register_all_apps(void) {
     // register_app("SPI Polling", spi_polling_setup, spi_polling_loop);
     // register_app("SPI Interrupt", spi_interrupt_setup, spi_interrupt_loop);
     // register_app("SPI DMA", spi_dma_setup, spi_dma_loop);
+    // register_app("SPI Multi-Device", spi_multi_setup, spi_multi_loop);
+    // register_app("SPI NOR Flash", spi_nor_flash_setup, spi_nor_flash_loop);
+    // register_app("SPI Display", spi_display_setup, spi_display_loop);
+    // register_app("SPI SD Card", spi_sd_card_setup, spi_sd_card_loop);
+    // register_app("FAT Logger", fat_logger_setup, fat_logger_loop);
+    // register_app("SPI Bus Benchmark", spi_bus_bench_setup, spi_bus_bench_loop);
 
     // ===========================================
     // TIMER APPS
     // ===========================================
     // register_app("Timer Interrupt", timer_interrupt_setup, timer_interrupt_loop);
     // register_app("Timer PWM", timer_pwm_setup, timer_pwm_loop);
+    // register_app("Timer DDS", timer_dds_setup, timer_dds_loop);
+    // register_app("Input Capture", input_capture_setup, input_capture_loop);
+    // register_app("WS2812 Strip", ws2812_strip_setup, ws2812_strip_loop);
 
     // ===========================================
     // UART APPS
@@ -109,6 +176,8 @@ void register_all_apps(void) {
     // register_app("UART Polling", uart_polling_setup, uart_polling_loop);
     // register_app("UART Interrupt", uart_interrupt_setup, uart_interrupt_loop);
     // register_app("UART DMA", uart_dma_setup, uart_dma_loop);
+    // register_app("UART RS485", uart_rs485_setup, uart_rs485_loop);
+    // register_app("Modbus Slave", modbus_slave_setup, modbus_slave_loop);
 
     // ===========================================
     // OTHER APPS
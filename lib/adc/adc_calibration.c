@@ -0,0 +1,171 @@
+#include "ch32v10x_adc.h"
+#include "ch32v10x_bkp.h"
+#include "ch32v10x_pwr.h"
+#include "ch32v10x_rcc.h"
+
+#include "adc_calibration.h"
+#include "timebase.h"
+
+#define ADC_CALIBRATION_MAGIC 0xCA1B
+
+// Factory sensor calibration: reference voltage in mV (low half) and the
+// temperature in degrees C it was taken at (high half)
+#define ADC_CALIBRATION_FACTORY (*(const uint32_t *)0x1FFFF898)
+
+// Sensor slope of 4.3 mV per degree, as TempSensor_Volt_To_Temper() uses
+#define ADC_CALIBRATION_SLOPE_UV 4300
+
+// Sensor and Vrefint startup after TSVREFE is set
+#define ADC_CALIBRATION_STARTUP_US 10
+
+static int16_t adc_calibration_offset_value = 0;
+static uint16_t adc_calibration_temp_raw = 0;
+static uint16_t adc_calibration_vref_raw = 0;
+static uint16_t adc_calibration_supply = 3300;
+
+static uint32_t adc_calibration_mv_factor;      // mV per code, Q16
+static int32_t adc_calibration_temp_factor;     // Tenths of a degree per code, Q16
+static int32_t adc_calibration_temp_base;       // Tenths of a degree at code 0, Q16
+
+// All the divides happen here, once per Vrefint reading
+static void adc_calibration_set_supply(uint16_t vref_raw){
+    uint32_t factory = ADC_CALIBRATION_FACTORY;
+    int64_t reference_mv = factory & 0xFFFF;
+    int64_t reference_tenths = (int64_t)((factory >> 16) & 0xFFFF) * 10;
+
+    if(vref_raw) {
+        adc_calibration_supply = (uint16_t)(ADC_CALIBRATION_VREFINT_MV * 4096u / vref_raw);
+        adc_calibration_mv_factor = ((uint32_t)ADC_CALIBRATION_VREFINT_MV << 16) / vref_raw;
+    } else {
+        adc_calibration_mv_factor = (uint32_t)adc_calibration_supply << 4;
+    }
+
+    // T = Tref + (mV - Vref) / slope, folded into raw * factor + base
+    adc_calibration_temp_factor = (int32_t)((int64_t)adc_calibration_mv_factor * 10000 / ADC_CALIBRATION_SLOPE_UV);
+    adc_calibration_temp_base = (int32_t)((reference_tenths << 16) - (reference_mv << 16) * 10000 / ADC_CALIBRATION_SLOPE_UV);
+}
+
+// One injected conversion. The regular group is untouched and the
+// injected setup of adc_injected, if any, is restored afterwards, as is
+// the sample time of a scanned sensor channel, which the scan timing
+// depends on.
+static uint16_t adc_calibration_sample(uint8_t channel){
+    uint32_t isqr = ADC1->ISQR;
+    uint32_t samptr = ADC1->SAMPTR1;
+    uint32_t trigger = ADC1->CTLR2 & (ADC_JEXTSEL | ADC_JEXTTRIG);
+    uint32_t interrupt = ADC1->CTLR1 & ADC_JEOCIE;
+    uint16_t value;
+
+    if((ADC1->CTLR2 & ADC_TSVREFE) == 0) {
+        uint32_t deadline = timebase_deadline_us(ADC_CALIBRATION_STARTUP_US);
+
+        ADC_TempSensorVrefintCmd(ENABLE);
+        while(!timebase_expired(deadline));
+    }
+
+    ADC1->CTLR1 &= ~ADC_JEOCIE;
+
+    ADC_InjectedSequencerLengthConfig(ADC1, 1);
+    ADC_InjectedChannelConfig(ADC1, channel, 1, ADC_SampleTime_239Cycles5);
+    ADC_ExternalTrigInjectedConvConfig(ADC1, ADC_ExternalTrigInjecConv_None);
+    ADC_ClearFlag(ADC1, ADC_FLAG_JEOC);
+    ADC_SoftwareStartInjectedConvCmd(ADC1, ENABLE);
+
+    while(ADC_GetFlagStatus(ADC1, ADC_FLAG_JEOC) == RESET);
+
+    value = ADC_GetInjectedConversionValue(ADC1, ADC_InjectedChannel_1);
+
+    ADC1->ISQR = isqr;
+    ADC1->SAMPTR1 = samptr;
+    ADC1->CTLR2 = (ADC1->CTLR2 & ~(ADC_JEXTSEL | ADC_JEXTTRIG)) | trigger;
+    ADC_ClearFlag(ADC1, ADC_FLAG_JEOC);
+    ADC1->CTLR1 |= interrupt;
+
+    return value;
+}
+
+static uint16_t adc_calibration_check_word(uint16_t offset, uint16_t temp, uint16_t vref){
+    return ADC_CALIBRATION_MAGIC ^ offset ^ temp ^ vref;
+}
+
+static uint8_t adc_calibration_restore(void){
+    uint16_t offset = BKP_ReadBackupRegister(BKP_DR2);
+    uint16_t temp = BKP_ReadBackupRegister(BKP_DR3);
+    uint16_t vref = BKP_ReadBackupRegister(BKP_DR4);
+
+    if(BKP_ReadBackupRegister(BKP_DR5) != adc_calibration_check_word(offset, temp, vref) || vref == 0) {
+        return 1;
+    }
+
+    adc_calibration_offset_value = (int16_t)offset;
+    adc_calibration_temp_raw = temp;
+    adc_calibration_vref_raw = vref;
+
+    return 0;
+}
+
+static void adc_calibration_store(void){
+    uint16_t offset = (uint16_t)adc_calibration_offset_value;
+
+    BKP_WriteBackupRegister(BKP_DR2, offset);
+    BKP_WriteBackupRegister(BKP_DR3, adc_calibration_temp_raw);
+    BKP_WriteBackupRegister(BKP_DR4, adc_calibration_vref_raw);
+    BKP_WriteBackupRegister(BKP_DR5, adc_calibration_check_word(offset, adc_calibration_temp_raw, adc_calibration_vref_raw));
+}
+
+uint8_t adc_calibration_init(void){
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_PWR | RCC_APB1Periph_BKP, ENABLE);
+    PWR_BackupAccessCmd(ENABLE);
+
+    if(adc_calibration_restore() == 0) {
+        adc_calibration_set_supply(adc_calibration_vref_raw);
+        return 0;
+    }
+
+    adc_calibration_run();
+
+    return 1;
+}
+
+void adc_calibration_run(void){
+    adc_calibration_offset_value = Get_CalibrationValue(ADC1);
+    adc_calibration_temp_raw = adc_calibration_sample(ADC_Channel_TempSensor);
+    adc_calibration_vref_raw = adc_calibration_sample(ADC_Channel_Vrefint);
+
+    adc_calibration_store();
+    adc_calibration_set_supply(adc_calibration_vref_raw);
+}
+
+uint8_t adc_calibration_refresh(void){
+    uint16_t temp = adc_calibration_sample(ADC_Channel_TempSensor);
+    uint16_t vref = adc_calibration_sample(ADC_Channel_Vrefint);
+    int16_t temp_drift = (int16_t)(temp - adc_calibration_temp_raw);
+    int16_t vref_drift = (int16_t)(vref - adc_calibration_vref_raw);
+
+    adc_calibration_set_supply(vref);
+
+    if(temp_drift < 0) {
+        temp_drift = -temp_drift;
+    }
+    if(vref_drift < 0) {
+        vref_drift = -vref_drift;
+    }
+
+    return temp_drift > ADC_CALIBRATION_TEMP_DRIFT || vref_drift > ADC_CALIBRATION_VREF_DRIFT;
+}
+
+int16_t adc_calibration_offset(void){
+    return adc_calibration_offset_value;
+}
+
+uint16_t adc_calibration_supply_mv(void){
+    return adc_calibration_supply;
+}
+
+uint16_t adc_calibration_to_mv(uint16_t raw){
+    return (uint16_t)((adc_calibration_apply(raw) * adc_calibration_mv_factor + 0x8000) >> 16);
+}
+
+int16_t adc_calibration_to_temperature(uint16_t raw){
+    return (int16_t)(((int32_t)adc_calibration_apply(raw) * adc_calibration_temp_factor + adc_calibration_temp_base + 0x8000) >> 16);
+}
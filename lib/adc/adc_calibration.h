@@ -0,0 +1,57 @@
+#ifndef ADC_CALIBRATION_H
+#define ADC_CALIBRATION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+
+// Internal reference voltage, used to measure the supply
+#define ADC_CALIBRATION_VREFINT_MV 1200
+
+// Drift, in raw codes, beyond which the cached offset is no longer trusted:
+// roughly 10 degrees C on the temperature sensor and 1 % on Vrefint
+#define ADC_CALIBRATION_TEMP_DRIFT 50
+#define ADC_CALIBRATION_VREF_DRIFT 15
+
+// ADC1 offset calibration kept in backup registers BKP_DR2-DR5, so a warm
+// reset (or any reset with VBAT present) reuses it instead of running
+// Get_CalibrationValue(): ten calibration cycles and a sort. The cache
+// records the temperature and Vrefint readings it was taken at.
+//
+// ADC1 must be enabled and idle (no scan running). Returns 0 when the
+// cached value was reused, 1 when it had to be measured.
+uint8_t adc_calibration_init(void);
+
+// Measures the offset now and stores it; ADC1 must be idle
+void adc_calibration_run(void);
+
+// Takes fresh temperature and Vrefint readings through the injected group
+// and updates the conversion factors. A running regular scan is only
+// paused; an adc_injected setup is put back afterwards, its triggers
+// ignored meanwhile. Channels 16 and 17 are left at the 239.5-cycle sample
+// time. Returns 1 if the readings drifted from those of the cached offset;
+// the caller should then stop acquisition and call adc_calibration_run().
+uint8_t adc_calibration_refresh(void);
+
+int16_t adc_calibration_offset(void);
+
+static inline uint16_t adc_calibration_apply(uint16_t raw){
+    int32_t value = (int32_t)raw + adc_calibration_offset();
+
+    return value < 0 ? 0 : value > 4095 ? 4095 : (uint16_t)value;
+}
+
+// Raw-code conversions with factors precomputed from the factory
+// constants and the last Vrefint reading: one multiply and a shift each.
+// The offset is applied inside.
+uint16_t adc_calibration_supply_mv(void);
+uint16_t adc_calibration_to_mv(uint16_t raw);
+int16_t adc_calibration_to_temperature(uint16_t raw);   // Tenths of a degree C
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,154 @@
+#include <string.h>
+
+#include "ch32v10x_adc.h"
+
+#include "adc_capture.h"
+
+enum {
+    ADC_CAPTURE_IDLE,
+    ADC_CAPTURE_FILLING,    // Collecting the pre-trigger history
+    ADC_CAPTURE_ARMED,      // Watchdog on, no CPU work
+    ADC_CAPTURE_TRIGGERED,  // Collecting the post-trigger frames
+};
+
+static adc_capture_config_t adc_capture_config;
+static adc_capture_stats_t adc_capture_stats;
+static adc_capture_event_t adc_capture_event;
+static volatile uint8_t adc_capture_state = ADC_CAPTURE_IDLE;
+static uint16_t adc_capture_trigger;
+
+static void adc_capture_on_awd(void){
+    uint16_t position;
+
+    // The watchdog flags every conversion outside the window, so it is
+    // masked until the next arm
+    ADC1->CTLR1 &= ~ADC_AWDIE;
+    ADC1->STATR = ~(uint32_t)ADC_AWD;
+    adc_capture_stats.trips++;
+
+    if(adc_capture_state != ADC_CAPTURE_ARMED) {
+        return;
+    }
+
+    position = adc_scan_position();
+    adc_capture_trigger = position ? position - 1 : adc_capture_event.length - 1;
+    adc_capture_state = ADC_CAPTURE_TRIGGERED;
+    adc_scan_enable_callback(1);
+}
+
+static void adc_capture_on_half(const uint16_t *samples, uint16_t frames){
+    uint16_t length = adc_capture_event.length;
+    uint16_t boundary, elapsed, first;
+
+    if(adc_capture_state == ADC_CAPTURE_FILLING) {
+        // History is complete: hand the stream to the watchdog
+        adc_capture_state = ADC_CAPTURE_ARMED;
+        adc_scan_enable_callback(0);
+        ADC1->STATR = ~(uint32_t)ADC_AWD;
+        ADC1->CTLR1 |= ADC_AWDIE;
+        return;
+    }
+
+    if(adc_capture_state != ADC_CAPTURE_TRIGGERED) {
+        return;
+    }
+
+    // Frame the DMA moved on to, and frames written after the trip one
+    boundary = samples == adc_capture_config.buffer ? frames : 0;
+    elapsed = boundary + length - adc_capture_trigger - 1;
+    if(elapsed >= length) {
+        elapsed -= length;
+    }
+
+    if(elapsed + 1 < adc_capture_config.post) {
+        return;
+    }
+
+    adc_scan_stop();
+    adc_capture_state = ADC_CAPTURE_IDLE;
+    adc_capture_stats.captures++;
+
+    first = adc_capture_trigger + length - adc_capture_config.pre;
+    if(first >= length) {
+        first -= length;
+    }
+    adc_capture_event.first = first;
+
+    if(adc_capture_config.callback) {
+        adc_capture_config.callback(&adc_capture_event);
+    }
+}
+
+uint8_t adc_capture_init(const adc_capture_config_t *config){
+    adc_scan_config_t scan;
+
+    if(config->post == 0 || config->pre + config->post >= config->frames || config->low > config->high) {
+        return 1;
+    }
+
+    adc_capture_config = *config;
+    adc_capture_state = ADC_CAPTURE_IDLE;
+    memset(&adc_capture_stats, 0, sizeof(adc_capture_stats));
+
+    adc_capture_event.buffer = config->buffer;
+    adc_capture_event.length = config->frames * 2;
+    adc_capture_event.pre = config->pre;
+    adc_capture_event.count = config->pre + config->post;
+    adc_capture_event.channel_count = config->channel_count;
+
+    scan.channels = config->channels;
+    scan.channel_count = config->channel_count;
+    scan.buffer = config->buffer;
+    scan.frames = config->frames;
+    scan.callback = adc_capture_on_half;
+
+    // adc_scan_init() resets the ADC, so the watchdog comes after it
+    if(adc_scan_init(&scan) != 0) {
+        return 1;
+    }
+
+    ADC_AnalogWatchdogThresholdsConfig(ADC1, config->high, config->low);
+    if(config->watch_channel == ADC_CAPTURE_ALL_CHANNELS) {
+        ADC_AnalogWatchdogCmd(ADC1, ADC_AnalogWatchdog_AllRegEnable);
+    } else {
+        ADC_AnalogWatchdogSingleChannelConfig(ADC1, config->watch_channel);
+        ADC_AnalogWatchdogCmd(ADC1, ADC_AnalogWatchdog_SingleRegEnable);
+    }
+
+    adc_scan_attach_event(ADC_AWD, adc_capture_on_awd);
+
+    return 0;
+}
+
+uint8_t adc_capture_arm(void){
+    adc_capture_stop();
+
+    adc_capture_state = ADC_CAPTURE_FILLING;
+    adc_scan_enable_callback(1);
+
+    if(adc_capture_config.timer) {
+        if(adc_scan_start_timed(adc_capture_config.timer, adc_capture_config.rate_hz) != 0) {
+            adc_capture_state = ADC_CAPTURE_IDLE;
+            return 1;
+        }
+        return 0;
+    }
+
+    adc_scan_start();
+
+    return 0;
+}
+
+void adc_capture_stop(void){
+    adc_scan_stop();
+    ADC1->CTLR1 &= ~ADC_AWDIE;
+    adc_capture_state = ADC_CAPTURE_IDLE;
+}
+
+void adc_capture_set_thresholds(uint16_t low, uint16_t high){
+    ADC_AnalogWatchdogThresholdsConfig(ADC1, high, low);
+}
+
+const adc_capture_stats_t *adc_capture_get_stats(void){
+    return &adc_capture_stats;
+}
@@ -0,0 +1,89 @@
+#ifndef ADC_CAPTURE_H
+#define ADC_CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+#include "adc_scan.h"
+
+// Watch every scanned channel rather than one
+#define ADC_CAPTURE_ALL_CHANNELS 0xFF
+
+// A frozen capture: `count` frames starting at frame `first` of the
+// circular buffer, wrapping at `length`. Frame `pre` of the capture is the
+// one the watchdog tripped on. Read it with adc_capture_frame().
+typedef struct {
+    const uint16_t *buffer;
+    uint16_t length;        // Frames in the whole buffer
+    uint16_t first;
+    uint16_t pre;
+    uint16_t count;         // pre + post
+    uint8_t channel_count;
+} adc_capture_event_t;
+
+// Runs in the DMA interrupt once the post-trigger frames are in. The
+// buffer stays frozen until adc_capture_arm() is called again.
+typedef void (*adc_capture_callback_t)(const adc_capture_event_t *event);
+
+typedef struct {
+    const adc_scan_channel_t *channels;
+    uint8_t channel_count;
+    uint16_t *buffer;           // 2 * frames * channel_count samples
+    uint16_t frames;            // Per half buffer, more than pre + post
+    TIM_TypeDef *timer;         // Trigger timer, or NULL to run at the maximum rate
+    uint32_t rate_hz;           // Frame rate when a timer is used
+    uint8_t watch_channel;      // ADC_Channel_x, or ADC_CAPTURE_ALL_CHANNELS
+    uint16_t low;               // Trips on a sample below low or above high
+    uint16_t high;
+    uint16_t pre;               // Frames kept before the trip
+    uint16_t post;              // Frames kept from the trip on
+    adc_capture_callback_t callback;
+} adc_capture_config_t;
+
+typedef struct {
+    uint32_t captures;
+    uint32_t trips;         // Watchdog interrupts, including any outside a capture
+} adc_capture_stats_t;
+
+// Oscilloscope-style capture on top of adc_scan. The scan streams into the
+// circular buffer with its half-buffer interrupts masked while the ADC's
+// analog watchdog compares every conversion against [low, high]. Nothing
+// runs on the CPU until a sample falls outside: the watchdog interrupt
+// notes the DMA position and unmasks the half-buffer interrupt, which
+// stops the scan once `post` frames have followed and hands over the
+// window. The trip frame is the last one the DMA had finished when the
+// watchdog interrupt ran, so it can be late by the interrupt latency,
+// under a microsecond, at the top sample rates.
+//
+// The scan keeps going up to the end of a half buffer before it stops,
+// which is why pre + post must stay below `frames`.
+uint8_t adc_capture_init(const adc_capture_config_t *config);
+
+// Starts the scan. The watchdog is enabled after the first half buffer
+// filled, so every capture has its full pre-trigger history.
+uint8_t adc_capture_arm(void);
+void adc_capture_stop(void);
+
+// Moves the thresholds; takes effect from the next conversion
+void adc_capture_set_thresholds(uint16_t low, uint16_t high);
+
+// Frame `index` (0 to count - 1) of a capture, one sample per channel
+static inline const uint16_t *adc_capture_frame(const adc_capture_event_t *event, uint16_t index){
+    uint16_t frame = event->first + index;
+
+    if(frame >= event->length) {
+        frame -= event->length;
+    }
+
+    return event->buffer + frame * event->channel_count;
+}
+
+const adc_capture_stats_t *adc_capture_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,109 @@
+#include <string.h>
+
+#include "ch32v10x_adc.h"
+
+#include "adc_injected.h"
+
+static adc_injected_config_t adc_injected_config;
+static adc_injected_stats_t adc_injected_stats;
+
+static void adc_injected_jeoc_handler(void){
+    uint16_t results[ADC_INJECTED_MAX_CHANNELS];
+    uint8_t count = adc_injected_config.channel_count;
+
+    // Flags clear by writing 0
+    ADC1->STATR = ~(uint32_t)(ADC_JEOC | ADC_JSTRT);
+
+    switch(count) {
+        case 4:
+            results[3] = ADC1->IDATAR4;
+            // fall through
+        case 3:
+            results[2] = ADC1->IDATAR3;
+            // fall through
+        case 2:
+            results[1] = ADC1->IDATAR2;
+            // fall through
+        default:
+            results[0] = ADC1->IDATAR1;
+            break;
+    }
+
+    adc_injected_stats.conversions++;
+
+    if(adc_injected_config.callback) {
+        adc_injected_config.callback(results, count);
+    }
+}
+
+// A channel converted twice has to use one sample time: the ADC keeps a
+// single one per channel, and the regular scan's timing depends on it
+static uint8_t adc_injected_check_sample_times(const adc_injected_config_t *config){
+    for(uint8_t i = 0; i < config->channel_count; i++) {
+        const adc_scan_channel_t *channel = &config->channels[i];
+        uint8_t scanned = adc_scan_sample_time(channel->channel);
+
+        if(scanned != ADC_SCAN_NOT_SCANNED && scanned != channel->sample_time) {
+            return 1;
+        }
+
+        for(uint8_t j = 0; j < i; j++) {
+            if(config->channels[j].channel == channel->channel && config->channels[j].sample_time != channel->sample_time) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+uint8_t adc_injected_init(const adc_injected_config_t *config){
+    if(config->channel_count == 0 || config->channel_count > ADC_INJECTED_MAX_CHANNELS) {
+        return 1;
+    }
+
+    if(adc_injected_check_sample_times(config) != 0) {
+        return 1;
+    }
+
+    adc_injected_config = *config;
+    memset(&adc_injected_stats, 0, sizeof(adc_injected_stats));
+
+    for(uint8_t i = 0; i < config->channel_count; i++) {
+        adc_scan_configure_pin(config->channels[i].channel);
+    }
+
+    // The length has to be set first: ranks are placed relative to it
+    ADC_InjectedSequencerLengthConfig(ADC1, config->channel_count);
+    for(uint8_t i = 0; i < config->channel_count; i++) {
+        ADC_InjectedChannelConfig(ADC1, config->channels[i].channel, i + 1, config->channels[i].sample_time);
+    }
+
+    // Without SCAN only the first rank of the group is converted
+    if(config->channel_count > 1) {
+        ADC1->CTLR1 |= ADC_SCAN;
+    }
+
+    ADC_ExternalTrigInjectedConvConfig(ADC1, config->trigger);
+    ADC_ExternalTrigInjectedConvCmd(ADC1, ENABLE);
+
+    adc_scan_attach_event(ADC_JEOC, adc_injected_jeoc_handler);
+    ADC_ClearFlag(ADC1, ADC_FLAG_JEOC);
+    ADC_ITConfig(ADC1, ADC_IT_JEOC, ENABLE);
+
+    return 0;
+}
+
+void adc_injected_trigger(void){
+    ADC_SoftwareStartInjectedConvCmd(ADC1, ENABLE);
+}
+
+void adc_injected_stop(void){
+    ADC_ExternalTrigInjectedConvCmd(ADC1, DISABLE);
+    ADC_ITConfig(ADC1, ADC_IT_JEOC, DISABLE);
+    adc_scan_attach_event(ADC_JEOC, NULL);
+}
+
+const adc_injected_stats_t *adc_injected_get_stats(void){
+    return &adc_injected_stats;
+}
@@ -0,0 +1,52 @@
+#ifndef ADC_INJECTED_H
+#define ADC_INJECTED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+#include "adc_scan.h"
+
+#define ADC_INJECTED_MAX_CHANNELS 4
+
+// Runs in the ADC interrupt right after the injected group converted,
+// one value per channel in rank order
+typedef void (*adc_injected_callback_t)(const uint16_t *results, uint8_t count);
+
+typedef struct {
+    const adc_scan_channel_t *channels; // Up to 4, rank 1 first
+    uint8_t channel_count;
+    uint32_t trigger;                   // ADC_ExternalTrigInjecConv_x; None for adc_injected_trigger()
+    adc_injected_callback_t callback;
+} adc_injected_config_t;
+
+typedef struct {
+    uint32_t conversions;
+} adc_injected_stats_t;
+
+// High-priority conversions on ADC1's injected group. A trigger (typically
+// a timer edge such as TIM1 CC4 placed in the middle of a PWM pulse)
+// converts the group at that instant, pausing the regular scan, which then
+// carries on with its DMA stream undisturbed. Results are read in the
+// highest-priority interrupt straight from the injected data registers.
+//
+// Call after adc_scan_init(), which resets the ADC. The trigger timer is
+// set up by the application. The ADC keeps one sample time per channel, so
+// a channel the regular scan also converts must use the scan's sample time;
+// init fails otherwise, or if the group lists a channel twice with
+// different sample times.
+uint8_t adc_injected_init(const adc_injected_config_t *config);
+
+// Software start, for trigger ADC_ExternalTrigInjecConv_None
+void adc_injected_trigger(void);
+
+void adc_injected_stop(void);
+
+const adc_injected_stats_t *adc_injected_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
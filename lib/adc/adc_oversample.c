@@ -0,0 +1,192 @@
+#include <string.h>
+
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_tim.h"
+
+#include "adc_oversample.h"
+#include "timebase.h"
+
+static adc_oversample_config_t adc_oversample_config;
+static adc_oversample_stats_t adc_oversample_stats;
+static volatile uint16_t adc_oversample_results[ADC_SCAN_MAX_CHANNELS];
+static uint16_t adc_oversample_window;
+
+// Single channel: samples are contiguous, so two are read and added per
+// 32-bit access. Each 16-bit lane takes up to 16 12-bit samples before
+// it could carry into the other.
+static uint32_t adc_oversample_sum_packed(const uint16_t *samples, uint16_t count){
+    const uint32_t *pairs = (const uint32_t *)samples;
+    uint32_t total = 0;
+
+    for(uint16_t left = count / 2; left; ) {
+        uint16_t chunk = left > 16 ? 16 : left;
+        uint32_t lanes = 0;
+
+        left -= chunk;
+        while(chunk >= 4) {
+            lanes += pairs[0] + pairs[1] + pairs[2] + pairs[3];
+            pairs += 4;
+            chunk -= 4;
+        }
+        while(chunk--) {
+            lanes += *pairs++;
+        }
+
+        total += (lanes & 0xFFFF) + (lanes >> 16);
+    }
+
+    return total;
+}
+
+static uint32_t adc_oversample_sum(const uint16_t *samples, uint16_t count, uint8_t stride){
+    uint32_t total0 = 0;
+    uint32_t total1 = 0;
+
+    // count is a power of four, so no remainder
+    while(count) {
+        total0 += samples[0];
+        total1 += samples[stride];
+        total0 += samples[2 * stride];
+        total1 += samples[3 * stride];
+        samples += 4 * stride;
+        count -= 4;
+    }
+
+    return total0 + total1;
+}
+
+static void adc_oversample_on_half(const uint16_t *samples, uint16_t frames){
+    uint8_t channels = adc_oversample_config.channel_count;
+    uint8_t shift = adc_oversample_config.extra_bits;
+    uint16_t window = adc_oversample_window;
+    uint16_t results[ADC_SCAN_MAX_CHANNELS];
+
+    for(; frames >= window; frames -= window) {
+        if(channels == 1 && ((uintptr_t)samples & 3) == 0) {
+            results[0] = adc_oversample_sum_packed(samples, window) >> shift;
+        } else {
+            for(uint8_t i = 0; i < channels; i++) {
+                results[i] = adc_oversample_sum(samples + i, window, channels) >> shift;
+            }
+        }
+
+        for(uint8_t i = 0; i < channels; i++) {
+            adc_oversample_results[i] = results[i];
+        }
+
+        samples += window * channels;
+        adc_oversample_stats.results++;
+
+        if(adc_oversample_config.callback) {
+            adc_oversample_config.callback(results, channels);
+        }
+    }
+}
+
+// 50 % PWM on TIM4 CH3 (PB8) with one period per result
+static uint8_t adc_oversample_start_dither(uint32_t rate_hz){
+    GPIO_InitTypeDef GPIO_InitStructure;
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+    TIM_OCInitTypeDef TIM_OCInitStructure;
+    uint64_t ticks;
+    uint32_t prescaler, period;
+
+    ticks = (uint64_t)timebase_timer_clock(TIM4) * adc_oversample_window / rate_hz;
+    prescaler = (uint32_t)((ticks - 1) / 65536);
+    if(ticks < 2 || prescaler > 0xFFFF) {
+        return 1;
+    }
+    period = (uint32_t)(ticks / (prescaler + 1));
+
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOB, ENABLE);
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM4, ENABLE);
+
+    GPIO_InitStructure.GPIO_Pin = GPIO_Pin_8;
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_2MHz;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF_PP;
+    GPIO_Init(GPIOB, &GPIO_InitStructure);
+
+    TIM_TimeBaseStructure.TIM_Period = period - 1;
+    TIM_TimeBaseStructure.TIM_Prescaler = prescaler;
+    TIM_TimeBaseStructure.TIM_ClockDivision = TIM_CKD_DIV1;
+    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
+    TIM_TimeBaseInit(TIM4, &TIM_TimeBaseStructure);
+
+    TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_PWM1;
+    TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Enable;
+    TIM_OCInitStructure.TIM_OutputNState = TIM_OutputNState_Disable;
+    TIM_OCInitStructure.TIM_Pulse = period / 2;
+    TIM_OCInitStructure.TIM_OCPolarity = TIM_OCPolarity_High;
+    TIM_OCInitStructure.TIM_OCNPolarity = TIM_OCNPolarity_High;
+    TIM_OCInitStructure.TIM_OCIdleState = TIM_OCIdleState_Reset;
+    TIM_OCInitStructure.TIM_OCNIdleState = TIM_OCNIdleState_Reset;
+    TIM_OC3Init(TIM4, &TIM_OCInitStructure);
+
+    TIM_Cmd(TIM4, ENABLE);
+
+    return 0;
+}
+
+uint8_t adc_oversample_init(const adc_oversample_config_t *config){
+    adc_scan_config_t scan;
+    uint16_t window;
+
+    if(config->extra_bits == 0 || config->extra_bits > ADC_OVERSAMPLE_MAX_EXTRA_BITS) {
+        return 1;
+    }
+
+    window = 1 << (2 * config->extra_bits);
+    if(config->frames < window || config->frames % window != 0) {
+        return 1;
+    }
+
+    if(config->dither && config->timer == TIM4) {
+        return 1;
+    }
+
+    adc_oversample_config = *config;
+    adc_oversample_window = window;
+    memset(&adc_oversample_stats, 0, sizeof(adc_oversample_stats));
+
+    scan.channels = config->channels;
+    scan.channel_count = config->channel_count;
+    scan.buffer = config->buffer;
+    scan.frames = config->frames;
+    scan.callback = adc_oversample_on_half;
+
+    return adc_scan_init(&scan);
+}
+
+uint8_t adc_oversample_start(void){
+    uint32_t rate = adc_oversample_config.timer ? adc_oversample_config.rate_hz : adc_scan_max_rate();
+
+    if(adc_oversample_config.dither && adc_oversample_start_dither(rate) != 0) {
+        return 1;
+    }
+
+    if(adc_oversample_config.timer) {
+        return adc_scan_start_timed(adc_oversample_config.timer, adc_oversample_config.rate_hz);
+    }
+
+    adc_scan_start();
+
+    return 0;
+}
+
+void adc_oversample_stop(void){
+    adc_scan_stop();
+
+    if(adc_oversample_config.dither) {
+        TIM_Cmd(TIM4, DISABLE);
+    }
+}
+
+uint16_t adc_oversample_read(uint8_t index){
+    return adc_oversample_results[index];
+}
+
+const adc_oversample_stats_t *adc_oversample_get_stats(void){
+    return &adc_oversample_stats;
+}
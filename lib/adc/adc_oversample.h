@@ -0,0 +1,58 @@
+#ifndef ADC_OVERSAMPLE_H
+#define ADC_OVERSAMPLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+#include "adc_scan.h"
+
+#define ADC_OVERSAMPLE_MAX_EXTRA_BITS 4
+
+// Runs in the DMA interrupt once per result frame, one value per channel in
+// scan order, each 12 + extra_bits wide
+typedef void (*adc_oversample_callback_t)(const uint16_t *results, uint8_t channel_count);
+
+typedef struct {
+    const adc_scan_channel_t *channels;
+    uint8_t channel_count;
+    uint8_t extra_bits;         // 1-4: 4^extra_bits samples per result
+    uint16_t *buffer;           // 2 * frames * channel_count samples
+    uint16_t frames;            // Per half buffer, a multiple of 4^extra_bits
+    TIM_TypeDef *timer;         // Trigger timer, or NULL to run at the maximum rate
+    uint32_t rate_hz;           // Frame rate when a timer is used
+    uint8_t dither;             // Triangle dither output on PB8, see below
+    adc_oversample_callback_t callback;
+} adc_oversample_config_t;
+
+typedef struct {
+    uint32_t results;
+} adc_oversample_stats_t;
+
+// Oversampling on top of adc_scan: the DMA collects 4^n frames, the half
+// buffer interrupt sums each channel and drops n bits, leaving n more bits
+// than the ADC has. The sum is the only CPU work, a couple of cycles per
+// sample, so the maximum sample rate costs only a few percent of the CPU.
+//
+// The gain only holds if the input moves across several codes within each
+// result. The ADC's own noise usually does that; for a very quiet input,
+// `dither` drives a 50 % PWM on PB8 (TIM4 CH3) with a period of exactly one
+// result. Fed to the input through a resistor and integrated by the input
+// capacitor, it adds a triangle of a few LSB that averages out to its mean
+// over each result. TIM4 cannot then be the trigger timer.
+uint8_t adc_oversample_init(const adc_oversample_config_t *config);
+
+uint8_t adc_oversample_start(void);
+void adc_oversample_stop(void);
+
+// Latest result of a channel (index in scan order)
+uint16_t adc_oversample_read(uint8_t index);
+
+const adc_oversample_stats_t *adc_oversample_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,420 @@
+#include <string.h>
+
+#include "ch32v10x_adc.h"
+#include "ch32v10x_dma.h"
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_misc.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_tim.h"
+
+#include "irq_dispatch.h"
+#include "adc_scan.h"
+#include "timebase.h"
+
+#define ADC_SCAN_DMA DMA1_Channel1
+
+static adc_scan_config_t adc_scan_config;
+static adc_scan_stats_t adc_scan_stats;
+static uint16_t adc_scan_half_length;
+static uint32_t adc_scan_frame_half_clocks;
+static uint32_t adc_scan_adc_clock;
+static uint32_t adc_scan_frame_ticks;
+static uint32_t adc_scan_stop_tick;
+static uint8_t adc_scan_draining = 0;
+static TIM_TypeDef *adc_scan_timer = NULL;
+
+// The ADC keeps one sample time per channel, whichever group converts it
+static uint8_t adc_scan_sample_times[ADC_Channel_17 + 1];
+static uint32_t adc_scan_rate = 0;
+
+// ADC1 raises one interrupt for EOC, JEOC and AWD; modules built on
+// adc_scan attach a handler per flag
+static adc_scan_event_handler_t adc_scan_jeoc_handler = NULL;
+static adc_scan_event_handler_t adc_scan_awd_handler = NULL;
+
+// Sample time in half ADC clocks, indexed by ADC_SampleTime_x
+static const uint16_t adc_scan_sample_half_clocks[8] = {3, 15, 27, 57, 83, 111, 143, 479};
+
+// Every conversion adds 12.5 ADC clocks to its sample time
+#define ADC_SCAN_CONVERSION_HALF_CLOCKS 25
+
+static void adc_scan_dma_irq_handler(void){
+    uint32_t flags = DMA1->INTFR & (DMA1_IT_HT1 | DMA1_IT_TC1);
+    const uint16_t *half;
+    uint32_t other;
+
+    if(flags == 0) {
+        return;
+    }
+
+    // Both halves pending means one was never seen
+    if(flags == (DMA1_IT_HT1 | DMA1_IT_TC1)) {
+        adc_scan_stats.overruns++;
+    }
+
+    if(flags & DMA1_IT_TC1) {
+        half = adc_scan_config.buffer + adc_scan_half_length;
+        other = DMA1_IT_HT1;
+    } else {
+        half = adc_scan_config.buffer;
+        other = DMA1_IT_TC1;
+    }
+
+    DMA1->INTFCR = flags;
+    adc_scan_stats.half_buffers++;
+
+    if(adc_scan_config.callback) {
+        adc_scan_config.callback(half, adc_scan_config.frames);
+    }
+
+    // The DMA reached the end of the other half while the callback ran,
+    // so it has started overwriting the half just handed out
+    if(DMA1->INTFR & other) {
+        adc_scan_stats.overruns++;
+    }
+}
+
+static void adc_scan_adc_irq_handler(void){
+    uint32_t flags = ADC1->STATR;
+
+    if((flags & ADC_JEOC) && adc_scan_jeoc_handler) {
+        adc_scan_jeoc_handler();
+    }
+
+    if((flags & ADC_AWD) && adc_scan_awd_handler) {
+        adc_scan_awd_handler();
+    }
+}
+
+void adc_scan_attach_event(uint8_t flag, adc_scan_event_handler_t handler){
+    NVIC_InitTypeDef NVIC_InitStructure;
+
+    if(flag == ADC_JEOC) {
+        adc_scan_jeoc_handler = handler;
+    } else if(flag == ADC_AWD) {
+        adc_scan_awd_handler = handler;
+    }
+
+    // Above the DMA so injected results and watchdog trips are seen first
+    irq_attach(ADC1_2_IRQn, adc_scan_adc_irq_handler);
+    NVIC_InitStructure.NVIC_IRQChannel = ADC1_2_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+}
+
+void adc_scan_configure_pin(uint8_t channel){
+    GPIO_InitTypeDef GPIO_InitStructure;
+
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AIN;
+
+    if(channel <= ADC_Channel_7) {
+        RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA, ENABLE);
+        GPIO_InitStructure.GPIO_Pin = GPIO_Pin_0 << channel;
+        GPIO_Init(GPIOA, &GPIO_InitStructure);
+    } else if(channel <= ADC_Channel_9) {
+        RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOB, ENABLE);
+        GPIO_InitStructure.GPIO_Pin = GPIO_Pin_0 << (channel - ADC_Channel_8);
+        GPIO_Init(GPIOB, &GPIO_InitStructure);
+    } else if(channel <= ADC_Channel_15) {
+        RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOC, ENABLE);
+        GPIO_InitStructure.GPIO_Pin = GPIO_Pin_0 << (channel - ADC_Channel_10);
+        GPIO_Init(GPIOC, &GPIO_InitStructure);
+    } else {
+        ADC_TempSensorVrefintCmd(ENABLE);
+    }
+}
+
+uint8_t adc_scan_init(const adc_scan_config_t *config){
+    ADC_InitTypeDef ADC_InitStructure;
+    DMA_InitTypeDef DMA_InitStructure;
+    NVIC_InitTypeDef NVIC_InitStructure;
+    RCC_ClocksTypeDef clocks;
+
+    if(config->channel_count == 0 || config->channel_count > ADC_SCAN_MAX_CHANNELS || config->frames == 0) {
+        return 1;
+    }
+
+    adc_scan_config = *config;
+    adc_scan_half_length = config->frames * config->channel_count;
+    adc_scan_frame_half_clocks = 0;
+    memset(&adc_scan_stats, 0, sizeof(adc_scan_stats));
+
+    memset(adc_scan_sample_times, ADC_SCAN_NOT_SCANNED, sizeof(adc_scan_sample_times));
+
+    for(uint8_t i = 0; i < config->channel_count; i++) {
+        const adc_scan_channel_t *channel = &config->channels[i];
+
+        if(channel->channel > ADC_Channel_17 || channel->sample_time > ADC_SampleTime_239Cycles5) {
+            return 1;
+        }
+
+        if(adc_scan_sample_times[channel->channel] != ADC_SCAN_NOT_SCANNED &&
+           adc_scan_sample_times[channel->channel] != channel->sample_time) {
+            return 1;
+        }
+
+        adc_scan_sample_times[channel->channel] = channel->sample_time;
+        adc_scan_frame_half_clocks += adc_scan_sample_half_clocks[channel->sample_time] + ADC_SCAN_CONVERSION_HALF_CLOCKS;
+    }
+
+    // Enable clocks; the ADC clock must stay at or below 14 MHz
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_ADC1, ENABLE);
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+    RCC_ADCCLKConfig(RCC_PCLK2_Div6);
+
+    RCC_GetClocksFreq(&clocks);
+    adc_scan_adc_clock = clocks.ADCCLK_Frequency;
+
+    // Longest a sequence can run on after a stop, rounded up a tick
+    adc_scan_frame_ticks = (uint64_t)adc_scan_frame_half_clocks * timebase_tick_hz() / (adc_scan_adc_clock * 2) + 2;
+    adc_scan_draining = 0;
+
+    ADC_DeInit(ADC1);
+
+    for(uint8_t i = 0; i < config->channel_count; i++) {
+        adc_scan_configure_pin(config->channels[i].channel);
+    }
+
+    // Configure DMA: circular over both halves, interrupt at each half
+    DMA_DeInit(ADC_SCAN_DMA);
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&ADC1->RDATAR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)config->buffer;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+    DMA_InitStructure.DMA_BufferSize = adc_scan_half_length * 2;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(ADC_SCAN_DMA, &DMA_InitStructure);
+
+    DMA_ITConfig(ADC_SCAN_DMA, DMA_IT_HT | DMA_IT_TC, ENABLE);
+
+    irq_attach(DMA1_Channel1_IRQn, adc_scan_dma_irq_handler);
+    NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel1_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+
+    // Configure ADC
+    ADC_InitStructure.ADC_Mode = ADC_Mode_Independent;
+    ADC_InitStructure.ADC_ScanConvMode = config->channel_count > 1 ? ENABLE : DISABLE;
+    ADC_InitStructure.ADC_ContinuousConvMode = ENABLE;
+    ADC_InitStructure.ADC_ExternalTrigConv = ADC_ExternalTrigConv_None;
+    ADC_InitStructure.ADC_DataAlign = ADC_DataAlign_Right;
+    ADC_InitStructure.ADC_NbrOfChannel = config->channel_count;
+    ADC_Init(ADC1, &ADC_InitStructure);
+
+    for(uint8_t i = 0; i < config->channel_count; i++) {
+        ADC_RegularChannelConfig(ADC1, config->channels[i].channel, i + 1, config->channels[i].sample_time);
+    }
+
+    ADC_DMACmd(ADC1, ENABLE);
+    ADC_Cmd(ADC1, ENABLE);
+
+    // Calibrate ADC
+    ADC_ResetCalibration(ADC1);
+
+    while(ADC_GetResetCalibrationStatus(ADC1));
+
+    ADC_StartCalibration(ADC1);
+
+    while(ADC_GetCalibrationStatus(ADC1));
+
+    return 0;
+}
+
+void adc_scan_wait_idle(void){
+    if(adc_scan_draining) {
+        while(timebase_ticks() - adc_scan_stop_tick < adc_scan_frame_ticks);
+        adc_scan_draining = 0;
+    }
+}
+
+// Restarts the DMA from the first half, in step with rank 1. A sequence
+// that was in flight at the last stop runs to its last rank regardless, so
+// wait it out; the ADC's DMA request is dropped and raised again so its
+// last, unmoved result is not taken as rank 1 of the next sequence.
+static void adc_scan_arm_dma(void){
+    adc_scan_wait_idle();
+
+    ADC1->CTLR2 &= ~ADC_DMA;
+    (void)ADC1->RDATAR;
+
+    ADC_SCAN_DMA->CFGR &= ~DMA_CFGR1_EN;
+    ADC_SCAN_DMA->CNTR = adc_scan_half_length * 2;
+    DMA1->INTFCR = DMA1_IT_GL1;
+    ADC_SCAN_DMA->CFGR |= DMA_CFGR1_EN;
+
+    ADC1->CTLR2 |= ADC_DMA;
+}
+
+void adc_scan_start(void){
+    adc_scan_stop();
+    adc_scan_arm_dma();
+
+    ADC1->CTLR2 = (ADC1->CTLR2 & ~ADC_EXTSEL) | ADC_ExternalTrigConv_None | ADC_CONT;
+    ADC_SoftwareStartConvCmd(ADC1, ENABLE);
+}
+
+uint8_t adc_scan_start_timed(TIM_TypeDef *timer, uint32_t rate_hz){
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+    TIM_OCInitTypeDef TIM_OCInitStructure;
+    uint32_t trigger, clock, ticks, prescaler, period;
+
+    if(timer == TIM1) {
+        RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM1, ENABLE);
+        trigger = ADC_ExternalTrigConv_T1_CC1;
+    } else if(timer == TIM2) {
+        RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, ENABLE);
+        trigger = ADC_ExternalTrigConv_T2_CC2;
+    } else if(timer == TIM3) {
+        RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3, ENABLE);
+        trigger = ADC_ExternalTrigConv_T3_TRGO;
+    } else if(timer == TIM4) {
+        RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM4, ENABLE);
+        trigger = ADC_ExternalTrigConv_T4_CC4;
+    } else {
+        return 1;
+    }
+
+    if(rate_hz == 0 || rate_hz > adc_scan_max_rate()) {
+        return 1;
+    }
+
+    adc_scan_stop();
+
+    // Smallest prescaler that fits the period in 16 bits keeps the rate
+    // error below one timer clock per frame
+    clock = timebase_timer_clock(timer);
+    ticks = clock / rate_hz;
+    prescaler = (ticks - 1) / 65536;
+    period = ticks / (prescaler + 1);
+    adc_scan_rate = clock / ((prescaler + 1) * period);
+
+    TIM_TimeBaseStructure.TIM_Period = period - 1;
+    TIM_TimeBaseStructure.TIM_Prescaler = prescaler;
+    TIM_TimeBaseStructure.TIM_ClockDivision = TIM_CKD_DIV1;
+    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
+    TIM_TimeBaseInit(timer, &TIM_TimeBaseStructure);
+
+    if(timer == TIM3) {
+        TIM_SelectOutputTrigger(TIM3, TIM_TRGOSource_Update);
+    } else {
+        TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_PWM1;
+        TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Enable;
+        TIM_OCInitStructure.TIM_OutputNState = TIM_OutputNState_Disable;
+        TIM_OCInitStructure.TIM_Pulse = period / 2;
+        TIM_OCInitStructure.TIM_OCPolarity = TIM_OCPolarity_High;
+        TIM_OCInitStructure.TIM_OCNPolarity = TIM_OCNPolarity_High;
+        TIM_OCInitStructure.TIM_OCIdleState = TIM_OCIdleState_Reset;
+        TIM_OCInitStructure.TIM_OCNIdleState = TIM_OCNIdleState_Reset;
+
+        if(timer == TIM1) {
+            TIM_OC1Init(TIM1, &TIM_OCInitStructure);
+            TIM_CtrlPWMOutputs(TIM1, ENABLE);
+        } else if(timer == TIM2) {
+            TIM_OC2Init(TIM2, &TIM_OCInitStructure);
+        } else {
+            TIM_OC4Init(TIM4, &TIM_OCInitStructure);
+        }
+    }
+
+    adc_scan_arm_dma();
+
+    // Each trigger converts the whole sequence once
+    ADC1->CTLR2 = (ADC1->CTLR2 & ~(ADC_EXTSEL | ADC_CONT)) | trigger | ADC_EXTTRIG;
+
+    adc_scan_timer = timer;
+    timer->CNT = 0;
+    TIM_Cmd(timer, ENABLE);
+
+    return 0;
+}
+
+void adc_scan_stop(void){
+    if(adc_scan_timer) {
+        TIM_Cmd(adc_scan_timer, DISABLE);
+        adc_scan_timer = NULL;
+        adc_scan_rate = 0;
+    }
+
+    // The sequence in progress still converts every rank before the ADC
+    // waits for a start. Stopping is cheap enough for the DMA interrupt;
+    // the next start waits for that sequence to finish.
+    if(ADC1->CTLR2 & (ADC_CONT | ADC_EXTTRIG)) {
+        adc_scan_stop_tick = timebase_ticks();
+        adc_scan_draining = 1;
+    }
+
+    ADC1->CTLR2 &= ~(ADC_CONT | ADC_EXTTRIG);
+    ADC_SCAN_DMA->CFGR &= ~DMA_CFGR1_EN;
+}
+
+uint32_t adc_scan_max_rate(void){
+    if(adc_scan_frame_half_clocks == 0) {
+        return 0;
+    }
+
+    return adc_scan_adc_clock * 2 / adc_scan_frame_half_clocks;
+}
+
+uint32_t adc_scan_get_rate(void){
+    return adc_scan_rate;
+}
+
+void adc_scan_deinterleave(const uint16_t *samples, uint16_t frames, uint8_t index, uint16_t *output){
+    uint8_t stride = adc_scan_config.channel_count;
+
+    samples += index;
+
+    // Four frames per pass to keep the loop overhead off the copy
+    while(frames >= 4) {
+        output[0] = samples[0];
+        output[1] = samples[stride];
+        output[2] = samples[2 * stride];
+        output[3] = samples[3 * stride];
+        samples += 4 * stride;
+        output += 4;
+        frames -= 4;
+    }
+
+    while(frames--) {
+        *output++ = *samples;
+        samples += stride;
+    }
+}
+
+void adc_scan_enable_callback(uint8_t enable){
+    if(enable) {
+        // Halves that completed while masked are not reported late
+        DMA1->INTFCR = DMA1_IT_HT1 | DMA1_IT_TC1;
+        ADC_SCAN_DMA->CFGR |= DMA_IT_HT | DMA_IT_TC;
+    } else {
+        ADC_SCAN_DMA->CFGR &= ~(DMA_IT_HT | DMA_IT_TC);
+    }
+}
+
+uint8_t adc_scan_sample_time(uint8_t channel){
+    if(channel > ADC_Channel_17) {
+        return ADC_SCAN_NOT_SCANNED;
+    }
+
+    return adc_scan_sample_times[channel];
+}
+
+uint16_t adc_scan_position(void){
+    uint16_t written = adc_scan_half_length * 2 - ADC_SCAN_DMA->CNTR;
+
+    return written / adc_scan_config.channel_count;
+}
+
+const adc_scan_stats_t *adc_scan_get_stats(void){
+    return &adc_scan_stats;
+}
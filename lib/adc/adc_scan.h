@@ -0,0 +1,98 @@
+#ifndef ADC_SCAN_H
+#define ADC_SCAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+
+#define ADC_SCAN_MAX_CHANNELS 16
+
+// adc_scan_sample_time() for a channel the regular scan does not convert
+#define ADC_SCAN_NOT_SCANNED 0xFF
+
+typedef struct {
+    uint8_t channel;        // ADC_Channel_x
+    uint8_t sample_time;    // ADC_SampleTime_x
+} adc_scan_channel_t;
+
+// Runs in the DMA interrupt with the half of the buffer that just filled:
+// `frames` frames of one sample per channel, in scan order. The DMA fills
+// the other half meanwhile, so the data stays valid for half a buffer time.
+typedef void (*adc_scan_callback_t)(const uint16_t *samples, uint16_t frames);
+
+typedef struct {
+    const adc_scan_channel_t *channels; // Scan order, rank 1 first
+    uint8_t channel_count;
+    uint16_t *buffer;                   // 2 * frames * channel_count samples
+    uint16_t frames;                    // Frames per half buffer
+    adc_scan_callback_t callback;
+} adc_scan_config_t;
+
+typedef struct {
+    uint32_t half_buffers;
+    uint32_t overruns;      // Callback still busy when the next half filled
+} adc_scan_stats_t;
+
+// ADC1 in scan mode with circular DMA on channel 1. Configures the analog
+// pins of the listed channels (PA0-PA7, PB0-PB1, PC0-PC5) and enables the
+// temperature sensor and Vrefint if they are scanned. The ADC clock is set
+// to PCLK2/6 (12 MHz), the fastest within spec at 72 MHz. Calibrates.
+// Fails if a channel is listed twice with different sample times.
+uint8_t adc_scan_init(const adc_scan_config_t *config);
+
+// Converts back to back as fast as the sample times allow
+void adc_scan_start(void);
+
+// One frame per timer period, so the sample instants come from the timer
+// clock and not from conversion time or interrupt latency. The trigger is
+// TIM3 TRGO (update) or the CC event of TIM1 CH1, TIM2 CH2 or TIM4 CH4;
+// those channels run in PWM mode but their pins stay untouched unless the
+// application switches them to alternate function. Fails for other timers
+// or a rate the frame conversion time cannot keep up with.
+uint8_t adc_scan_start_timed(TIM_TypeDef *timer, uint32_t rate_hz);
+
+// Safe from interrupts. The sequence in flight still converts its
+// remaining ranks; the next start waits for them so rank 1 stays first.
+void adc_scan_stop(void);
+
+// Returns once the sequence in flight at the last stop has converted its
+// last rank, so the ADC can be calibrated or reconfigured
+void adc_scan_wait_idle(void);
+
+// Highest frame rate the sample times allow
+uint32_t adc_scan_max_rate(void);
+
+// Frame rate the timer actually produces; 0 when free running
+uint32_t adc_scan_get_rate(void);
+
+// Copies one channel (index in scan order) out of interleaved frames
+void adc_scan_deinterleave(const uint16_t *samples, uint16_t frames, uint8_t index, uint16_t *output);
+
+const adc_scan_stats_t *adc_scan_get_stats(void);
+
+// For the modules layered on adc_scan: analog pin setup for a channel, and
+// a handler for the ADC1 interrupt per flag (ADC_JEOC or ADC_AWD). The
+// handler clears its flag. The interrupt runs at the highest priority.
+typedef void (*adc_scan_event_handler_t)(void);
+
+void adc_scan_configure_pin(uint8_t channel);
+void adc_scan_attach_event(uint8_t flag, adc_scan_event_handler_t handler);
+
+// Sample time the regular scan set for a channel, or ADC_SCAN_NOT_SCANNED.
+// The ADC has one per channel, so a module converting the same channel
+// must use it too: the scan timing is computed from it.
+uint8_t adc_scan_sample_time(uint8_t channel);
+
+// Masks the half-buffer interrupts, so a scan can stream with no CPU
+// involvement at all (on by default), and reports the frame the DMA is
+// writing, counted from the start of the buffer
+void adc_scan_enable_callback(uint8_t enable);
+uint16_t adc_scan_position(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,229 @@
+#include <string.h>
+
+#include "ch32v10x_dma.h"
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_misc.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_usart.h"
+
+#include "irq_dispatch.h"
+#include "adc_stream.h"
+#include "timebase.h"
+
+typedef struct {
+    USART_TypeDef *usart;
+    GPIO_TypeDef *gpio;
+    uint16_t tx_pin;
+    DMA_Channel_TypeDef *tx_dma;
+    uint32_t tx_complete;
+    IRQn_Type irq;
+} adc_stream_port_t;
+
+static const adc_stream_port_t adc_stream_ports[] = {
+    {USART1, GPIOA, GPIO_Pin_9, DMA1_Channel4, DMA1_IT_TC4, DMA1_Channel4_IRQn},
+    {USART2, GPIOA, GPIO_Pin_2, DMA1_Channel7, DMA1_IT_TC7, DMA1_Channel7_IRQn},
+    {USART3, GPIOB, GPIO_Pin_10, DMA1_Channel2, DMA1_IT_TC2, DMA1_Channel2_IRQn},
+};
+
+// Headroom for the DMA restarts and interrupt latency, as a fraction of
+// the half-buffer time
+#define ADC_STREAM_MARGIN_SHIFT 5
+
+static adc_stream_config_t adc_stream_config;
+static adc_stream_stats_t adc_stream_stats;
+static const adc_stream_port_t *adc_stream_port;
+static adc_stream_header_t adc_stream_header;
+static const uint16_t *adc_stream_payload;
+static uint16_t adc_stream_payload_bytes;
+static uint32_t adc_stream_channel_mask;
+static volatile uint8_t adc_stream_busy = 0;
+static uint8_t adc_stream_header_sent;
+
+static void adc_stream_send(const void *data, uint16_t length){
+    DMA_Channel_TypeDef *tx_dma = adc_stream_port->tx_dma;
+
+    tx_dma->CFGR &= ~DMA_CFGR1_EN;
+    tx_dma->MADDR = (uint32_t)data;
+    tx_dma->CNTR = length;
+    tx_dma->CFGR |= DMA_CFGR1_EN;
+}
+
+// The header goes out first; its completion chains the samples
+static void adc_stream_tx_irq_handler(void){
+    if((DMA1->INTFR & adc_stream_port->tx_complete) == 0) {
+        return;
+    }
+
+    DMA1->INTFCR = adc_stream_port->tx_complete;
+
+    if(!adc_stream_header_sent) {
+        adc_stream_header_sent = 1;
+        adc_stream_send(adc_stream_payload, adc_stream_payload_bytes);
+        return;
+    }
+
+    adc_stream_stats.sent++;
+    adc_stream_busy = 0;
+}
+
+static void adc_stream_on_half(const uint16_t *samples, uint16_t frames){
+    adc_stream_header_t *header = &adc_stream_header;
+    const uint8_t *bytes = (const uint8_t *)header;
+    uint8_t check = 0;
+
+    (void)frames;
+
+    // Cutting the late one short leaves a frame the receiver discards
+    if(adc_stream_busy) {
+        adc_stream_port->tx_dma->CFGR &= ~DMA_CFGR1_EN;
+        DMA1->INTFCR = adc_stream_port->tx_complete;
+        adc_stream_stats.dropped++;
+    }
+
+    header->sequence++;
+    header->timestamp = timebase_us();
+
+    for(uint8_t i = 0; i < sizeof(*header) - 1; i++) {
+        check ^= bytes[i];
+    }
+    header->check = check;
+
+    adc_stream_payload = samples;
+    adc_stream_header_sent = 0;
+    adc_stream_busy = 1;
+    adc_stream_send(header, sizeof(*header));
+}
+
+uint8_t adc_stream_init(const adc_stream_config_t *config){
+    const adc_stream_port_t *port = NULL;
+    adc_scan_config_t scan;
+    GPIO_InitTypeDef GPIO_InitStructure;
+    USART_InitTypeDef USART_InitStructure;
+    DMA_InitTypeDef DMA_InitStructure;
+    NVIC_InitTypeDef NVIC_InitStructure;
+
+    for(uint8_t i = 0; i < sizeof(adc_stream_ports) / sizeof(adc_stream_ports[0]); i++) {
+        if(adc_stream_ports[i].usart == config->usart) {
+            port = &adc_stream_ports[i];
+        }
+    }
+
+    if(port == NULL || config->baudrate == 0) {
+        return 1;
+    }
+
+    adc_stream_config = *config;
+    adc_stream_port = port;
+    adc_stream_payload_bytes = config->frames * config->channel_count * 2;
+    memset(&adc_stream_stats, 0, sizeof(adc_stream_stats));
+
+    adc_stream_channel_mask = 0;
+    for(uint8_t i = 0; i < config->channel_count; i++) {
+        adc_stream_channel_mask |= 1ul << config->channels[i].channel;
+    }
+
+    scan.channels = config->channels;
+    scan.channel_count = config->channel_count;
+    scan.buffer = config->buffer;
+    scan.frames = config->frames;
+    scan.callback = adc_stream_on_half;
+
+    if(adc_scan_init(&scan) != 0) {
+        return 1;
+    }
+
+    // Enable clocks
+    if(port->usart == USART1) {
+        RCC_APB2PeriphClockCmd(RCC_APB2Periph_USART1, ENABLE);
+    } else if(port->usart == USART2) {
+        RCC_APB1PeriphClockCmd(RCC_APB1Periph_USART2, ENABLE);
+    } else {
+        RCC_APB1PeriphClockCmd(RCC_APB1Periph_USART3, ENABLE);
+    }
+    RCC_APB2PeriphClockCmd(port->gpio == GPIOA ? RCC_APB2Periph_GPIOA : RCC_APB2Periph_GPIOB, ENABLE);
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+
+    GPIO_InitStructure.GPIO_Pin = port->tx_pin;
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF_PP;
+    GPIO_Init(port->gpio, &GPIO_InitStructure);
+
+    // TX DMA: memory address and length are set per transfer
+    DMA_DeInit(port->tx_dma);
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&port->usart->DATAR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = 0;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+    DMA_InitStructure.DMA_BufferSize = 0;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(port->tx_dma, &DMA_InitStructure);
+
+    DMA_ITConfig(port->tx_dma, DMA_IT_TC, ENABLE);
+
+    // Same priority as the ADC half-buffer interrupt, so neither cuts into
+    // the other halfway through a restart
+    irq_attach(port->irq, adc_stream_tx_irq_handler);
+    NVIC_InitStructure.NVIC_IRQChannel = port->irq;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+
+    USART_InitStructure.USART_BaudRate = config->baudrate;
+    USART_InitStructure.USART_WordLength = USART_WordLength_8b;
+    USART_InitStructure.USART_StopBits = USART_StopBits_1;
+    USART_InitStructure.USART_Parity = USART_Parity_No;
+    USART_InitStructure.USART_HardwareFlowControl = USART_HardwareFlowControl_None;
+    USART_InitStructure.USART_Mode = USART_Mode_Tx;
+    USART_Init(port->usart, &USART_InitStructure);
+
+    USART_DMACmd(port->usart, USART_DMAReq_Tx, ENABLE);
+    USART_Cmd(port->usart, ENABLE);
+
+    return 0;
+}
+
+uint8_t adc_stream_start(void){
+    const adc_stream_config_t *config = &adc_stream_config;
+    uint32_t rate = config->timer ? config->rate_hz : adc_scan_max_rate();
+    uint64_t bits = (uint64_t)(sizeof(adc_stream_header_t) + adc_stream_payload_bytes) * 10;
+    uint64_t capacity = (uint64_t)config->baudrate * config->frames;
+
+    // Ten bits a byte on the wire, within one half-buffer time
+    if(bits * rate > capacity - (capacity >> ADC_STREAM_MARGIN_SHIFT)) {
+        return 1;
+    }
+
+    adc_stream_stop();
+
+    adc_stream_header.sync = ADC_STREAM_SYNC;
+    adc_stream_header.sequence = 0xFFFF;
+    adc_stream_header.channel_mask = adc_stream_channel_mask;
+    adc_stream_header.frames = config->frames;
+    adc_stream_header.channel_count = config->channel_count;
+
+    if(config->timer) {
+        return adc_scan_start_timed(config->timer, config->rate_hz);
+    }
+
+    adc_scan_start();
+
+    return 0;
+}
+
+void adc_stream_stop(void){
+    adc_scan_stop();
+
+    adc_stream_port->tx_dma->CFGR &= ~DMA_CFGR1_EN;
+    DMA1->INTFCR = adc_stream_port->tx_complete;
+    adc_stream_busy = 0;
+}
+
+const adc_stream_stats_t *adc_stream_get_stats(void){
+    return &adc_stream_stats;
+}
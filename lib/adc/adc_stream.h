@@ -0,0 +1,65 @@
+#ifndef ADC_STREAM_H
+#define ADC_STREAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+#include "adc_scan.h"
+
+#define ADC_STREAM_SYNC 0x5AA5
+
+// Sent little-endian ahead of every half buffer; tools/scope_receiver.py
+// mirrors this layout. The samples follow as frames * channel_count
+// little-endian 16-bit words in scan order.
+typedef struct {
+    uint16_t sync;          // ADC_STREAM_SYNC
+    uint16_t sequence;      // Half buffers since start, dropped ones included
+    uint32_t timestamp;     // timebase_us() when the half completed
+    uint32_t channel_mask;  // Bit n for ADC_Channel_n
+    uint16_t frames;
+    uint8_t channel_count;
+    uint8_t check;          // XOR of the 15 bytes before it
+} adc_stream_header_t;
+
+typedef struct {
+    const adc_scan_channel_t *channels;
+    uint8_t channel_count;
+    uint16_t *buffer;           // 2 * frames * channel_count samples
+    uint16_t frames;            // Per half buffer
+    TIM_TypeDef *timer;         // Trigger timer, or NULL to run at the maximum rate
+    uint32_t rate_hz;           // Frame rate when a timer is used
+    USART_TypeDef *usart;       // USART1 (PA9), USART2 (PA2) or USART3 (PB10)
+    uint32_t baudrate;
+} adc_stream_config_t;
+
+typedef struct {
+    uint32_t sent;
+    uint32_t dropped;       // Still on the wire when the next half filled
+} adc_stream_stats_t;
+
+// Scope mode: every half buffer adc_scan fills goes out of the USART by
+// DMA straight from the ADC buffer, behind a 16-byte header, so the only
+// CPU work per half is building the header and two DMA restarts. A half
+// must be on the wire within one half-buffer time, before the ADC comes
+// back to it; if the previous one is still going out it is cut short and
+// counted as dropped, and the receiver skips it by its missing successor
+// and the sequence gap.
+//
+// The USART is reconfigured for transmit only at `baudrate`; nothing else
+// (printf included) may write to it while streaming.
+uint8_t adc_stream_init(const adc_stream_config_t *config);
+
+// Fails if the link cannot carry the frame rate, with a few percent spare
+// for interrupt latency: at 2 Mbaud, about 96 k samples/s.
+uint8_t adc_stream_start(void);
+void adc_stream_stop(void);
+
+const adc_stream_stats_t *adc_stream_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef BLOCKDEV_H
+#define BLOCKDEV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+
+typedef struct blockdev blockdev_t;
+
+// Fixed-size block storage (SPI NOR, SD card) as seen by filesystems.
+// Calls block until the data has been transferred and return 0 on success,
+// 1 on failure. A write may still be completing inside the device when it
+// returns; sync() waits for it and flushes any cached blocks.
+struct blockdev {
+    uint16_t block_size;
+    uint32_t block_count;
+    uint8_t (*read)(const blockdev_t *dev, uint32_t block, uint8_t *data, uint32_t count);
+    uint8_t (*write)(const blockdev_t *dev, uint32_t block, const uint8_t *data, uint32_t count);
+    uint8_t (*sync)(const blockdev_t *dev);
+    void *context;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,445 @@
+#include "ch32v10x_dma.h"
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_misc.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_tim.h"
+
+#include "irq_dispatch.h"
+#include "timebase.h"
+#include "timer_capture.h"
+
+typedef struct {
+    TIM_TypeDef *timer;
+    DMA_Channel_TypeDef *dma[4];    // Per capture channel, NULL without one
+    GPIO_TypeDef *gpio[4];
+    uint16_t pin[4];
+    IRQn_Type irq;
+} timer_capture_hw_t;
+
+static const timer_capture_hw_t timer_capture_hws[] = {
+    {TIM1, {DMA1_Channel2, DMA1_Channel3, DMA1_Channel6, DMA1_Channel4},
+     {GPIOA, GPIOA, GPIOA, GPIOA}, {GPIO_Pin_8, GPIO_Pin_9, GPIO_Pin_10, GPIO_Pin_11}, TIM1_UP_IRQn},
+    {TIM2, {DMA1_Channel5, DMA1_Channel7, DMA1_Channel1, DMA1_Channel7},
+     {GPIOA, GPIOA, GPIOA, GPIOA}, {GPIO_Pin_0, GPIO_Pin_1, GPIO_Pin_2, GPIO_Pin_3}, TIM2_IRQn},
+    {TIM3, {DMA1_Channel6, NULL, DMA1_Channel2, DMA1_Channel3},
+     {GPIOA, GPIOA, GPIOB, GPIOB}, {GPIO_Pin_6, GPIO_Pin_7, GPIO_Pin_0, GPIO_Pin_1}, TIM3_IRQn},
+    {TIM4, {DMA1_Channel1, DMA1_Channel4, DMA1_Channel5, NULL},
+     {GPIOB, GPIOB, GPIOB, GPIOB}, {GPIO_Pin_6, GPIO_Pin_7, GPIO_Pin_8, GPIO_Pin_9}, TIM4_IRQn},
+};
+
+// One ring per capture channel: rising edges of an input in the ring of
+// its own channel, falling edges in that of its neighbour
+static uint16_t timer_capture_rings[4][TIMER_CAPTURE_RING];
+
+static const timer_capture_hw_t *timer_capture_hw = NULL;
+static uint8_t timer_capture_mask;
+static uint8_t timer_capture_cc_mask;
+static uint32_t timer_capture_ticks;
+
+// Kept by the overflow interrupt: wraps so far, the counter when it last
+// looked, and per capture channel the ring position then, how many
+// entries hold edges and how many wraps passed without one
+static volatile uint32_t timer_capture_overflows;
+static volatile uint16_t timer_capture_isr_count;
+static volatile uint16_t timer_capture_isr_position[4];
+static volatile uint16_t timer_capture_filled[4];
+static volatile uint8_t timer_capture_quiet[4];
+
+static uint16_t timer_capture_position(uint8_t index){
+    return (TIMER_CAPTURE_RING - timer_capture_hw->dma[index]->CNTR) % TIMER_CAPTURE_RING;
+}
+
+static void timer_capture_irq_handler(void){
+    TIM_TypeDef *timer = timer_capture_hw->timer;
+
+    if((timer->INTFR & TIM_UIF) == 0) {
+        return;
+    }
+
+    // Flags clear by writing 0
+    timer->INTFR = (uint16_t)~TIM_UIF;
+
+    for(uint8_t i = 0; i < 4; i++) {
+        uint16_t position, filled;
+
+        if((timer_capture_cc_mask & (1 << i)) == 0) {
+            continue;
+        }
+
+        position = timer_capture_position(i);
+        if(position != timer_capture_isr_position[i]) {
+            filled = timer_capture_filled[i] + (position - timer_capture_isr_position[i] + TIMER_CAPTURE_RING) % TIMER_CAPTURE_RING;
+            timer_capture_filled[i] = filled < TIMER_CAPTURE_RING ? filled : TIMER_CAPTURE_RING;
+            timer_capture_isr_position[i] = position;
+            timer_capture_quiet[i] = 0;
+        } else if(timer_capture_quiet[i] < 255) {
+            timer_capture_quiet[i]++;
+        }
+    }
+
+    // Read after the positions: edges with a smaller timestamp that were
+    // already counted came after this wrap
+    timer_capture_isr_count = timer->CNT;
+    timer_capture_overflows++;
+}
+
+static uint32_t timer_capture_isqrt(uint64_t value){
+    uint64_t root = 0;
+    uint64_t bit = 1ull << 62;
+
+    while(bit > value) {
+        bit >>= 2;
+    }
+
+    while(bit) {
+        if(value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)root;
+}
+
+uint8_t timer_capture_init(const timer_capture_config_t *config){
+    const timer_capture_hw_t *hw = NULL;
+    GPIO_InitTypeDef GPIO_InitStructure;
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+    TIM_ICInitTypeDef TIM_ICInitStructure;
+    DMA_InitTypeDef DMA_InitStructure;
+    NVIC_InitTypeDef NVIC_InitStructure;
+    uint8_t cc_mask;
+
+    for(uint8_t i = 0; i < sizeof(timer_capture_hws) / sizeof(timer_capture_hws[0]); i++) {
+        if(timer_capture_hws[i].timer == config->timer) {
+            hw = &timer_capture_hws[i];
+        }
+    }
+
+    if(hw == NULL || config->channel_mask == 0 || config->channel_mask > 0x0F || config->filter > 15) {
+        return 1;
+    }
+
+    // One input per pair of channels, and the pair takes both
+    if((config->channel_mask & 0x03) == 0x03 || (config->channel_mask & 0x0C) == 0x0C) {
+        return 1;
+    }
+
+    cc_mask = 0;
+    for(uint8_t i = 0; i < 4; i++) {
+        if(config->channel_mask & (1 << i)) {
+            cc_mask |= (1 << i) | (1 << (i ^ 1));
+        }
+    }
+
+    for(uint8_t i = 0; i < 4; i++) {
+        if((cc_mask & (1 << i)) && hw->dma[i] == NULL) {
+            return 1;
+        }
+    }
+
+    // TIM2 CH2 and CH4 both request on DMA channel 7
+    if(hw->timer == TIM2 && (cc_mask & 0x0A) == 0x0A) {
+        return 1;
+    }
+
+    timer_capture_hw = hw;
+    timer_capture_mask = config->channel_mask;
+    timer_capture_cc_mask = cc_mask;
+
+    // Enable clocks
+    if(hw->timer == TIM1) {
+        RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM1, ENABLE);
+    } else if(hw->timer == TIM2) {
+        RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, ENABLE);
+    } else if(hw->timer == TIM3) {
+        RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3, ENABLE);
+    } else {
+        RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM4, ENABLE);
+    }
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA | RCC_APB2Periph_GPIOB, ENABLE);
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+
+    timer_capture_ticks = timebase_timer_clock(hw->timer) / (config->prescaler + 1);
+
+    // Free-running over the full 16 bits
+    TIM_TimeBaseStructure.TIM_Period = 0xFFFF;
+    TIM_TimeBaseStructure.TIM_Prescaler = config->prescaler;
+    TIM_TimeBaseStructure.TIM_ClockDivision = TIM_CKD_DIV1;
+    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
+    TIM_TimeBaseInit(hw->timer, &TIM_TimeBaseStructure);
+
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IN_FLOATING;
+
+    TIM_ICInitStructure.TIM_ICPrescaler = TIM_ICPSC_DIV1;
+    TIM_ICInitStructure.TIM_ICFilter = config->filter;
+
+    // Configure DMA: each capture moves CCRx into the channel's ring
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+    DMA_InitStructure.DMA_BufferSize = TIMER_CAPTURE_RING;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+
+    for(uint8_t i = 0; i < 4; i++) {
+        if((config->channel_mask & (1 << i)) == 0) {
+            continue;
+        }
+
+        GPIO_InitStructure.GPIO_Pin = hw->pin[i];
+        GPIO_Init(hw->gpio[i], &GPIO_InitStructure);
+
+        // PWM input: the pin's channel captures rising edges, its
+        // neighbour the falling edges of the same pin. TIM_PWMIConfig()
+        // only knows the CH1/CH2 pair.
+        TIM_ICInitStructure.TIM_Channel = TIM_Channel_1 + 4 * i;
+        TIM_ICInitStructure.TIM_ICPolarity = TIM_ICPolarity_Rising;
+        TIM_ICInitStructure.TIM_ICSelection = TIM_ICSelection_DirectTI;
+
+        if(i < 2) {
+            TIM_PWMIConfig(hw->timer, &TIM_ICInitStructure);
+        } else {
+            TIM_ICInit(hw->timer, &TIM_ICInitStructure);
+            TIM_ICInitStructure.TIM_Channel = TIM_Channel_1 + 4 * (i ^ 1);
+            TIM_ICInitStructure.TIM_ICPolarity = TIM_ICPolarity_Falling;
+            TIM_ICInitStructure.TIM_ICSelection = TIM_ICSelection_IndirectTI;
+            TIM_ICInit(hw->timer, &TIM_ICInitStructure);
+        }
+    }
+
+    for(uint8_t i = 0; i < 4; i++) {
+        if((cc_mask & (1 << i)) == 0) {
+            continue;
+        }
+
+        // CH1CVR-CH4CVR are 32 bits apart
+        DMA_DeInit(hw->dma[i]);
+        DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&hw->timer->CH1CVR + 4 * i;
+        DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)timer_capture_rings[i];
+        DMA_Init(hw->dma[i], &DMA_InitStructure);
+
+        TIM_DMACmd(hw->timer, TIM_DMA_CC1 << i, ENABLE);
+    }
+
+    // Highest priority keeps the latency, and so the ambiguous window
+    // around a wrap, as short as possible
+    TIM_ITConfig(hw->timer, TIM_IT_Update, ENABLE);
+    irq_attach(hw->irq, timer_capture_irq_handler);
+    NVIC_InitStructure.NVIC_IRQChannel = hw->irq;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+
+    return 0;
+}
+
+void timer_capture_start(void){
+    TIM_TypeDef *timer = timer_capture_hw->timer;
+
+    timer_capture_stop();
+
+    for(uint8_t i = 0; i < 4; i++) {
+        if((timer_capture_cc_mask & (1 << i)) == 0) {
+            continue;
+        }
+
+        timer_capture_hw->dma[i]->CNTR = TIMER_CAPTURE_RING;
+        timer_capture_hw->dma[i]->CFGR |= DMA_CFGR1_EN;
+        timer_capture_isr_position[i] = 0;
+        timer_capture_filled[i] = 0;
+        timer_capture_quiet[i] = 0;
+    }
+
+    timer_capture_overflows = 0;
+    timer_capture_isr_count = 0;
+
+    timer->CNT = 0;
+    timer->INTFR = (uint16_t)~TIM_UIF;
+    timer->CTLR1 |= TIM_CEN;
+}
+
+void timer_capture_stop(void){
+    timer_capture_hw->timer->CTLR1 &= ~TIM_CEN;
+
+    for(uint8_t i = 0; i < 4; i++) {
+        if(timer_capture_cc_mask & (1 << i)) {
+            timer_capture_hw->dma[i]->CFGR &= ~DMA_CFGR1_EN;
+        }
+    }
+}
+
+// Where a ring stands, as of the overflow interrupt's last look
+typedef struct {
+    uint16_t position;
+    uint16_t edges;
+    uint8_t fresh;
+    uint8_t quiet;
+} timer_capture_view_t;
+
+static void timer_capture_view(uint8_t cc, timer_capture_view_t *view){
+    uint16_t isr_position = timer_capture_isr_position[cc];
+
+    view->position = timer_capture_position(cc);
+    view->edges = timer_capture_filled[cc] + (view->position - isr_position + TIMER_CAPTURE_RING) % TIMER_CAPTURE_RING;
+    view->fresh = view->position != isr_position;
+    view->quiet = timer_capture_quiet[cc];
+}
+
+// Newest edge of a ring: since the last wrap if the interrupt has not seen
+// it, otherwise in the wrap before, unless it came between the wrap and
+// the interrupt. Returns 1 if it is over a wrap old and cannot be placed.
+static uint8_t timer_capture_newest(const timer_capture_view_t *view, uint16_t value, uint32_t overflows,
+                                    uint16_t isr_count, uint32_t *t){
+    if(view->fresh) {
+        *t = (overflows << 16) | value;
+    } else if(view->quiet) {
+        return 1;
+    } else {
+        *t = ((value < isr_count ? overflows : overflows - 1) << 16) | value;
+    }
+
+    return 0;
+}
+
+uint8_t timer_capture_measure(uint8_t index, uint16_t periods, timer_capture_result_t *result){
+    const uint16_t *rises, *falls;
+    timer_capture_view_t rise, fall;
+    uint32_t mstatus, overflows, t_rise, t_fall, sum = 0, high = 0, covered = 0;
+    uint32_t period_min = 0xFFFFFFFF, period_max = 0;
+    uint64_t sum_squares = 0;
+    uint16_t isr_count, rise_value, fall_value, fall_edges, used = 1;
+    uint8_t pending;
+    uint16_t done = 0;
+
+    if(index > 3 || (timer_capture_mask & (1 << index)) == 0 || periods == 0) {
+        return 1;
+    }
+
+    if(periods > TIMER_CAPTURE_RING / 2 - 1) {
+        periods = TIMER_CAPTURE_RING / 2 - 1;
+    }
+
+    rises = timer_capture_rings[index];
+    falls = timer_capture_rings[index ^ 1];
+
+    // A consistent view: no wrap waiting to be counted
+    do {
+        mstatus = irq_lock();
+        timer_capture_view(index, &rise);
+        timer_capture_view(index ^ 1, &fall);
+        pending = (timer_capture_hw->timer->INTFR & TIM_UIF) != 0;
+        overflows = timer_capture_overflows;
+        isr_count = timer_capture_isr_count;
+        irq_unlock(mstatus);
+    } while(pending);
+
+    // The newest half of each ring only, so the DMA cannot lap the walk
+    if(rise.edges > periods + 1) {
+        rise.edges = periods + 1;
+    }
+    fall_edges = fall.edges < periods + 2 ? fall.edges : periods + 2;
+
+    if(rise.edges < 2 || fall_edges == 0) {
+        return 1;
+    }
+
+    rise.position = (rise.position + TIMER_CAPTURE_RING - 1) % TIMER_CAPTURE_RING;
+    fall.position = (fall.position + TIMER_CAPTURE_RING - 1) % TIMER_CAPTURE_RING;
+    rise_value = rises[rise.position];
+    fall_value = falls[fall.position];
+
+    if(timer_capture_newest(&rise, rise_value, overflows, isr_count, &t_rise) != 0 ||
+       timer_capture_newest(&fall, fall_value, overflows, isr_count, &t_fall) != 0) {
+        return 1;
+    }
+
+    result->last_edge = (int32_t)(t_fall - t_rise) > 0 ? t_fall : t_rise;
+
+    // Walk both rings back in time; consecutive edges of one kind are
+    // under a wrap apart
+    for(uint16_t e = 1; e < rise.edges; e++) {
+        uint32_t t_older, period;
+        uint16_t older;
+
+        rise.position = rise.position ? rise.position - 1 : TIMER_CAPTURE_RING - 1;
+        older = rises[rise.position];
+        t_older = t_rise - (uint16_t)(rise_value - older);
+        rise_value = older;
+        period = t_rise - t_older;
+
+        // The high time of this period ends at the newest fall before the
+        // rise that closes it
+        while((int32_t)(t_fall - t_rise) > 0 && used < fall_edges) {
+            fall.position = fall.position ? fall.position - 1 : TIMER_CAPTURE_RING - 1;
+            older = falls[fall.position];
+            t_fall -= (uint16_t)(fall_value - older);
+            fall_value = older;
+            used++;
+        }
+
+        if((int32_t)(t_fall - t_rise) < 0 && (int32_t)(t_fall - t_older) > 0) {
+            high += t_fall - t_older;
+            covered += period;
+        }
+
+        sum += period;
+        sum_squares += (uint64_t)period * period;
+        if(period < period_min) {
+            period_min = period;
+        }
+        if(period > period_max) {
+            period_max = period;
+        }
+        done++;
+
+        t_rise = t_older;
+    }
+
+    if(sum == 0) {
+        return 1;
+    }
+
+    result->periods = done;
+    result->period = sum / done;
+    result->period_min = period_min;
+    result->period_max = period_max;
+    result->frequency = (uint32_t)((uint64_t)timer_capture_ticks * 1000 * done / sum);
+    result->duty = covered ? (uint16_t)((uint64_t)high * 10000 / covered) : 0;
+
+    // Variance in ticks squared, then the deviation scaled to ns
+    sum_squares = (sum_squares - (uint64_t)sum * sum / done) / done;
+    result->jitter = (uint32_t)((uint64_t)timer_capture_isqrt(sum_squares * 1000000) * 1000000 / timer_capture_ticks);
+
+    return 0;
+}
+
+uint32_t timer_capture_now(void){
+    TIM_TypeDef *timer = timer_capture_hw->timer;
+    uint32_t mstatus, overflows;
+    uint16_t count;
+    uint8_t pending;
+
+    do {
+        mstatus = irq_lock();
+        count = timer->CNT;
+        pending = (timer->INTFR & TIM_UIF) != 0;
+        overflows = timer_capture_overflows;
+        irq_unlock(mstatus);
+    } while(pending);
+
+    return (overflows << 16) | count;
+}
+
+uint32_t timer_capture_tick_hz(void){
+    return timer_capture_ticks;
+}
@@ -0,0 +1,71 @@
+#ifndef TIMER_CAPTURE_H
+#define TIMER_CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+
+// Edge timestamps kept per capture channel; measurements look at the
+// newest half
+#define TIMER_CAPTURE_RING 256
+
+typedef struct {
+    TIM_TypeDef *timer;     // TIM1, TIM2, TIM3 or TIM4
+    uint8_t channel_mask;   // Bit n for an input on channel n + 1's pin
+    uint16_t prescaler;     // Timer clocks per tick, minus one
+    uint8_t filter;         // Input filter, 0-15 as TIM_ICFilter
+} timer_capture_config_t;
+
+typedef struct {
+    uint32_t frequency;     // Millihertz
+    uint32_t period;        // Mean, in ticks
+    uint32_t period_min;
+    uint32_t period_max;
+    uint32_t jitter;        // Standard deviation of the period, ns
+    uint16_t duty;          // High time in 0.01 %
+    uint16_t periods;       // Periods the figures cover
+    uint32_t last_edge;     // Timestamp of the newest edge
+} timer_capture_result_t;
+
+// Frequency and duty measurement of up to two inputs on one timer. Each
+// input takes a pair of capture channels in the PWM input arrangement:
+// the channel on the input's pin captures its rising edges, the other one
+// of the pair (CH1 with CH2, CH3 with CH4) its falling edges. Each capture
+// channel has its own DMA channel moving the 16-bit timestamps into a
+// ring, so edges never interrupt the CPU; 100 kHz inputs cost nothing
+// until measured. The only interrupt is the timer's overflow, once per
+// 65536 ticks, which counts wraps to extend timestamps to 32 bits and
+// notes which rings have gone quiet.
+//
+// Pairs with DMA on both channels: TIM1 CH1/CH2 and CH3/CH4; TIM2 either
+// pair but not both (CH2 and CH4 share DMA channel 7); TIM3 CH3/CH4; TIM4
+// CH1/CH2. Pins: TIM1 PA8-PA11, TIM2 PA0-PA3, TIM3 PA6 PA7 PB0 PB1, TIM4
+// PB6-PB9. The other pin of a pair stays free.
+//
+// Periods must be less than one wrap (910 us with no prescaler, 65.5 ms
+// at 1 us ticks); pick the prescaler for the slowest input. An edge within
+// the overflow interrupt's latency of a wrap can rarely be placed a wrap
+// off.
+uint8_t timer_capture_init(const timer_capture_config_t *config);
+
+void timer_capture_start(void);
+void timer_capture_stop(void);
+
+// Statistics over the newest `periods` full periods of the input on
+// channel `index` (0-3), up to TIMER_CAPTURE_RING / 2 - 1, or fewer if
+// fewer were captured.
+// All the work happens here, in the caller's context. Returns 1 if the
+// input has no complete period or has been quiet for over a wrap.
+uint8_t timer_capture_measure(uint8_t index, uint16_t periods, timer_capture_result_t *result);
+
+// Current 32-bit timestamp, and ticks per second
+uint32_t timer_capture_now(void);
+uint32_t timer_capture_tick_hz(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
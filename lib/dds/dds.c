@@ -0,0 +1,253 @@
+#include <string.h>
+
+#include "ch32v10x_dma.h"
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_misc.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_tim.h"
+
+#include "irq_dispatch.h"
+#include "dds.h"
+#include "timebase.h"
+
+static uint16_t dds_buffer[2 * DDS_HALF_SAMPLES];
+
+static dds_config_t dds_config;
+static dds_stats_t dds_stats;
+static DMA_Channel_TypeDef *dds_dma;
+static uint32_t dds_half_flag;
+static uint32_t dds_complete_flag;
+static uint64_t dds_rate_mhz;       // Sample rate in millihertz
+
+static const q15_t *volatile dds_table = dds_sine;
+static volatile uint32_t dds_step = 0;
+static volatile q15_t dds_amplitude = 16384;
+static volatile q15_t dds_offset = 16384;
+static uint32_t dds_phase = 0;
+
+static void dds_fill(uint16_t *out){
+    const q15_t *table = dds_table;
+    uint32_t step = dds_step;
+    uint32_t phase = dds_phase;
+    int32_t period = dds_config.period;
+    int32_t gain = (dds_amplitude * period) >> 15;
+    int32_t centre = (dds_offset * period) >> 15;
+
+    for(uint8_t i = 0; i < DDS_HALF_SAMPLES; i++) {
+        uint32_t index = phase >> (32 - DDS_TABLE_BITS);
+        int32_t fraction = (phase >> (17 - DDS_TABLE_BITS)) & 0x7FFF;
+        int32_t a = table[index];
+        int32_t b = table[(index + 1) & (DDS_TABLE_SIZE - 1)];
+        int32_t value = centre + ((a + (((b - a) * fraction) >> 15)) * gain >> 15);
+
+        out[i] = value < 0 ? 0 : value > period ? period : value;
+        phase += step;
+    }
+
+    dds_phase = phase;
+}
+
+static void dds_dma_irq_handler(void){
+    uint32_t flags = DMA1->INTFR & (dds_half_flag | dds_complete_flag);
+
+    if(flags == 0) {
+        return;
+    }
+
+    // Both halves pending means one went out twice
+    if(flags == (dds_half_flag | dds_complete_flag)) {
+        dds_stats.overruns++;
+    }
+
+    DMA1->INTFCR = flags;
+    dds_stats.half_buffers++;
+
+    dds_fill((flags & dds_complete_flag) ? dds_buffer + DDS_HALF_SAMPLES : dds_buffer);
+}
+
+uint8_t dds_init(const dds_config_t *config){
+    GPIO_InitTypeDef GPIO_InitStructure;
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+    TIM_OCInitTypeDef TIM_OCInitStructure;
+    DMA_InitTypeDef DMA_InitStructure;
+    NVIC_InitTypeDef NVIC_InitStructure;
+    TIM_TypeDef *timer = config->timer;
+    IRQn_Type irq;
+
+    if(config->period < 4 || config->channel > TIM_Channel_4) {
+        return 1;
+    }
+
+    // Enable clocks
+    if(timer == TIM3) {
+        RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3, ENABLE);
+        RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA | RCC_APB2Periph_GPIOB, ENABLE);
+        dds_dma = DMA1_Channel3;
+        dds_half_flag = DMA1_IT_HT3;
+        dds_complete_flag = DMA1_IT_TC3;
+        irq = DMA1_Channel3_IRQn;
+    } else if(timer == TIM1) {
+        RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM1 | RCC_APB2Periph_GPIOA, ENABLE);
+        dds_dma = DMA1_Channel5;
+        dds_half_flag = DMA1_IT_HT5;
+        dds_complete_flag = DMA1_IT_TC5;
+        irq = DMA1_Channel5_IRQn;
+    } else {
+        return 1;
+    }
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+
+    dds_config = *config;
+    dds_rate_mhz = (uint64_t)timebase_timer_clock(timer) * 1000 / config->period;
+    memset(&dds_stats, 0, sizeof(dds_stats));
+
+    // Configure the output pin as alternate function push-pull
+    if(timer == TIM3) {
+        static const uint16_t pins[4] = {GPIO_Pin_6, GPIO_Pin_7, GPIO_Pin_0, GPIO_Pin_1};
+
+        GPIO_InitStructure.GPIO_Pin = pins[config->channel >> 2];
+    } else {
+        GPIO_InitStructure.GPIO_Pin = GPIO_Pin_8 << (config->channel >> 2);
+    }
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF_PP;
+    GPIO_Init(timer == TIM3 && config->channel >= TIM_Channel_3 ? GPIOB : GPIOA, &GPIO_InitStructure);
+
+    // Configure the timer for PWM at the sample rate, as timer_pwm does
+    TIM_TimeBaseStructure.TIM_Period = config->period - 1;
+    TIM_TimeBaseStructure.TIM_Prescaler = 0;
+    TIM_TimeBaseStructure.TIM_ClockDivision = TIM_CKD_DIV1;
+    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
+    TIM_TimeBaseInit(timer, &TIM_TimeBaseStructure);
+
+    TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_PWM1;
+    TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Enable;
+    TIM_OCInitStructure.TIM_OutputNState = TIM_OutputNState_Disable;
+    TIM_OCInitStructure.TIM_Pulse = config->period / 2;
+    TIM_OCInitStructure.TIM_OCPolarity = TIM_OCPolarity_High;
+    TIM_OCInitStructure.TIM_OCNPolarity = TIM_OCNPolarity_High;
+    TIM_OCInitStructure.TIM_OCIdleState = TIM_OCIdleState_Reset;
+    TIM_OCInitStructure.TIM_OCNIdleState = TIM_OCNIdleState_Reset;
+
+    // Preload, so each compare value lands on a period boundary
+    switch(config->channel) {
+        case TIM_Channel_1:
+            TIM_OC1Init(timer, &TIM_OCInitStructure);
+            TIM_OC1PreloadConfig(timer, TIM_OCPreload_Enable);
+            break;
+        case TIM_Channel_2:
+            TIM_OC2Init(timer, &TIM_OCInitStructure);
+            TIM_OC2PreloadConfig(timer, TIM_OCPreload_Enable);
+            break;
+        case TIM_Channel_3:
+            TIM_OC3Init(timer, &TIM_OCInitStructure);
+            TIM_OC3PreloadConfig(timer, TIM_OCPreload_Enable);
+            break;
+        default:
+            TIM_OC4Init(timer, &TIM_OCInitStructure);
+            TIM_OC4PreloadConfig(timer, TIM_OCPreload_Enable);
+            break;
+    }
+
+    if(timer == TIM1) {
+        TIM_CtrlPWMOutputs(TIM1, ENABLE);
+    }
+
+    TIM_ARRPreloadConfig(timer, ENABLE);
+
+    // One compare register per update, reached through the burst register
+    TIM_DMAConfig(timer, TIM_DMABase_CCR1 + (config->channel >> 2), TIM_DMABurstLength_1Transfer);
+
+    // Configure DMA: circular over both halves, interrupt at each half
+    DMA_DeInit(dds_dma);
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&timer->DMAADR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)dds_buffer;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+    DMA_InitStructure.DMA_BufferSize = 2 * DDS_HALF_SAMPLES;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(dds_dma, &DMA_InitStructure);
+
+    DMA_ITConfig(dds_dma, DMA_IT_HT | DMA_IT_TC, ENABLE);
+
+    irq_attach(irq, dds_dma_irq_handler);
+    NVIC_InitStructure.NVIC_IRQChannel = irq;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+
+    return 0;
+}
+
+uint8_t dds_start(void){
+    TIM_TypeDef *timer = dds_config.timer;
+
+    if(timer == NULL) {
+        return 1;
+    }
+
+    dds_stop();
+
+    dds_phase = 0;
+    dds_fill(dds_buffer);
+    dds_fill(dds_buffer + DDS_HALF_SAMPLES);
+
+    dds_dma->CNTR = 2 * DDS_HALF_SAMPLES;
+    DMA1->INTFCR = dds_half_flag | dds_complete_flag;
+    dds_dma->CFGR |= DMA_CFGR1_EN;
+
+    // The update event clears the counter before the DMA request is on,
+    // so it takes nothing from the buffer
+    timer->SWEVGR = TIM_UG;
+    timer->DMAINTENR |= TIM_UDE;
+    timer->CTLR1 |= TIM_CEN;
+
+    return 0;
+}
+
+void dds_stop(void){
+    TIM_TypeDef *timer = dds_config.timer;
+
+    if(timer == NULL) {
+        return;
+    }
+
+    timer->DMAINTENR &= ~TIM_UDE;
+    timer->CTLR1 &= ~TIM_CEN;
+    dds_dma->CFGR &= ~DMA_CFGR1_EN;
+}
+
+void dds_set_waveform(const q15_t *table){
+    dds_table = table;
+}
+
+uint8_t dds_set_frequency(uint32_t millihertz){
+    if(dds_rate_mhz == 0 || (uint64_t)millihertz * 2 > dds_rate_mhz) {
+        return 1;
+    }
+
+    // Taken up from the next half buffer on, with the phase carried over
+    dds_step = (uint32_t)(((uint64_t)millihertz << 32) / dds_rate_mhz);
+
+    return 0;
+}
+
+void dds_set_level(q15_t amplitude, q15_t offset){
+    dds_amplitude = amplitude;
+    dds_offset = offset;
+}
+
+uint32_t dds_sample_rate(void){
+    return (uint32_t)(dds_rate_mhz / 1000);
+}
+
+const dds_stats_t *dds_get_stats(void){
+    return &dds_stats;
+}
@@ -0,0 +1,68 @@
+#ifndef DDS_H
+#define DDS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+#include "dsp_types.h"
+
+#define DDS_TABLE_BITS 8
+#define DDS_TABLE_SIZE (1 << DDS_TABLE_BITS)
+
+// Samples computed per half buffer: one interrupt per this many PWM periods
+#define DDS_HALF_SAMPLES 64
+
+typedef struct {
+    TIM_TypeDef *timer;     // TIM1 or TIM3
+    uint16_t channel;       // TIM_Channel_x
+    uint16_t period;        // Timer clocks per sample, 4 or more: the PWM resolution
+} dds_config_t;
+
+typedef struct {
+    uint32_t half_buffers;
+    uint32_t overruns;      // A half went out again before it was refilled
+} dds_stats_t;
+
+// Built-in waveforms, in flash
+extern const q15_t dds_sine[DDS_TABLE_SIZE];
+extern const q15_t dds_triangle[DDS_TABLE_SIZE];
+
+// Direct digital synthesis into a PWM output, to be low-pass filtered into
+// an analog signal. The timer's update DMA (DMA1 channel 3 for TIM3,
+// channel 5 for TIM1) writes a new compare value every PWM period from a
+// circular buffer. The half-transfer and transfer-complete interrupts
+// compute the next DDS_HALF_SAMPLES values: a 32-bit phase accumulator
+// indexes the waveform table, interpolating linearly between points. The
+// cost is fixed per half buffer, whatever the output frequency.
+//
+// Outputs: TIM3 CH1-CH4 on PA6, PA7, PB0, PB1; TIM1 CH1-CH4 on PA8, PA9,
+// PA10, PA11 (CH2 and CH3 take the USART1 pins). The sample rate is the
+// timer clock over `period`: 70.3 kHz at 1024, for 10-bit resolution, and
+// the frequency step is that over 2^32, about 16 uHz.
+uint8_t dds_init(const dds_config_t *config);
+
+uint8_t dds_start(void);
+void dds_stop(void);
+
+// DDS_TABLE_SIZE points of one period, Q15; the table is read in place, so
+// a user-defined one should be const (flash) or stay put while in use
+void dds_set_waveform(const q15_t *table);
+
+// In millihertz, up to half the sample rate. Fails above that.
+uint8_t dds_set_frequency(uint32_t millihertz);
+
+// Peak amplitude and centre as fractions of full scale in Q15; the output
+// clips at 0 and 100 % duty. Defaults are full swing around 50 %.
+void dds_set_level(q15_t amplitude, q15_t offset);
+
+uint32_t dds_sample_rate(void);
+
+const dds_stats_t *dds_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -9,9 +9,9 @@
  * SPDX-License-Identifier: Apache-2.0
  *******************************************************************************/
 #include "debug.h"
+#include "timebase.h"
 
-static uint8_t  p_us = 0;
-static uint16_t p_ms = 0;
+static uint32_t p_us = 0;
 
 /*********************************************************************
  * @fn      Delay_Init
@@ -23,7 +23,10 @@ static uint16_t p_ms = 0;
 void Delay_Init(void)
 {
     p_us = SystemCoreClock / 8000000;
-    p_ms = (uint16_t)p_us * 1000;
+
+    // SysTick runs free at HCLK/8 for the timebase; delays measure elapsed
+    // ticks instead of restarting it
+    timebase_init();
 }
 
 /*********************************************************************
@@ -37,18 +40,10 @@ void Delay_Init(void)
  */
 void Delay_Us(uint32_t n)
 {
-    uint32_t i;
-
-    SysTick->CTLR = 0;
-    i = (uint32_t)n * p_us;
+    uint32_t start = timebase_ticks();
+    uint32_t i = (uint32_t)n * p_us;
 
-    SysTick->CNTL0 = 0;
-    SysTick->CNTL1 = 0;
-    SysTick->CNTL2 = 0;
-    SysTick->CNTL3 = 0;
-    SysTick->CTLR = 1;
-
-    while((*(__IO uint32_t *)0xE000F004) <= i)
+    while((uint32_t)(timebase_ticks() - start) < i)
         ;
 }
 
@@ -63,18 +58,10 @@ void Delay_Us(uint32_t n)
  */
 void Delay_Ms(uint32_t n)
 {
-    uint32_t i;
-
-    SysTick->CTLR = 0;
-    i = (uint32_t)n * p_ms;
-
-    SysTick->CNTL0 = 0;
-    SysTick->CNTL1 = 0;
-    SysTick->CNTL2 = 0;
-    SysTick->CNTL3 = 0;
-    SysTick->CTLR = 1;
-
-    while((*(__IO uint32_t *)0xE000F004) <= i) ;
+    while(n--)
+    {
+        Delay_Us(1000);
+    }
 }
 
 /*********************************************************************
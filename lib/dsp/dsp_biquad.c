@@ -0,0 +1,83 @@
+#include "dsp_biquad.h"
+
+void dsp_biquad_q15_init(dsp_biquad_q15_t *biquad, const dsp_biquad_q15_coeffs_t *coeffs, q15_t *state, uint8_t stages){
+    biquad->coeffs = coeffs;
+    biquad->state = state;
+    biquad->stages = stages;
+
+    for(uint16_t i = 0; i < 4 * stages; i++) {
+        state[i] = 0;
+    }
+}
+
+void dsp_biquad_q15(dsp_biquad_q15_t *biquad, const q15_t *in, q15_t *out, uint16_t n){
+    const q15_t *source = in;
+
+    for(uint8_t stage = 0; stage < biquad->stages; stage++) {
+        const dsp_biquad_q15_coeffs_t *c = &biquad->coeffs[stage];
+        q15_t *s = &biquad->state[4 * stage];
+        int32_t b0 = c->b0, b1 = c->b1, b2 = c->b2, a1 = c->a1, a2 = c->a2;
+        int32_t x1 = s[0], x2 = s[1], y1 = s[2], y2 = s[3];
+
+        for(uint16_t i = 0; i < n; i++) {
+            int32_t x = source[i];
+            int32_t acc = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+            int32_t y = dsp_sat_q15((acc + (1 << 13)) >> 14);
+
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = y;
+            out[i] = (q15_t)y;
+        }
+
+        s[0] = x1;
+        s[1] = x2;
+        s[2] = y1;
+        s[3] = y2;
+
+        // Later stages filter the previous stage's output in place
+        source = out;
+    }
+}
+
+void dsp_biquad_q31_init(dsp_biquad_q31_t *biquad, const dsp_biquad_q31_coeffs_t *coeffs, q31_t *state, uint8_t stages){
+    biquad->coeffs = coeffs;
+    biquad->state = state;
+    biquad->stages = stages;
+
+    for(uint16_t i = 0; i < 4 * stages; i++) {
+        state[i] = 0;
+    }
+}
+
+void dsp_biquad_q31(dsp_biquad_q31_t *biquad, const q31_t *in, q31_t *out, uint16_t n){
+    const q31_t *source = in;
+
+    for(uint8_t stage = 0; stage < biquad->stages; stage++) {
+        const dsp_biquad_q31_coeffs_t *c = &biquad->coeffs[stage];
+        q31_t *s = &biquad->state[4 * stage];
+        int32_t b0 = c->b0, b1 = c->b1, b2 = c->b2, a1 = c->a1, a2 = c->a2;
+        int32_t x1 = s[0], x2 = s[1], y1 = s[2], y2 = s[3];
+
+        for(uint16_t i = 0; i < n; i++) {
+            int32_t x = source[i];
+            int64_t acc = (int64_t)b0 * x + (int64_t)b1 * x1 + (int64_t)b2 * x2
+                        - (int64_t)a1 * y1 - (int64_t)a2 * y2;
+            int32_t y = dsp_sat_q31((acc + (1 << 29)) >> 30);
+
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = y;
+            out[i] = y;
+        }
+
+        s[0] = x1;
+        s[1] = x2;
+        s[2] = y1;
+        s[3] = y2;
+
+        source = out;
+    }
+}
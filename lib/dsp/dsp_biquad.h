@@ -0,0 +1,49 @@
+#ifndef DSP_BIQUAD_H
+#define DSP_BIQUAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "dsp_types.h"
+
+// Cascades of direct form I biquads:
+//   y = b0 x + b1 x[-1] + b2 x[-2] - a1 y[-1] - a2 y[-2]
+// Coefficients carry one integer bit (Q14 / Q30) because a1 reaches 2 for
+// low cut-offs. Stages run one after another over the whole block, so each
+// keeps its state in registers; `out` may be the same buffer as `in`.
+//
+// The Q15 version is cheap but its coefficients are coarse; poles close to
+// DC (cut-off below ~fs/50) want the Q31 version, which accumulates in 64
+// bits.
+typedef struct {
+    q15_t b0, b1, b2, a1, a2;   // Q14
+} dsp_biquad_q15_coeffs_t;
+
+typedef struct {
+    q31_t b0, b1, b2, a1, a2;   // Q30
+} dsp_biquad_q31_coeffs_t;
+
+typedef struct {
+    const dsp_biquad_q15_coeffs_t *coeffs;
+    q15_t *state;               // 4 per stage: x[-1], x[-2], y[-1], y[-2]
+    uint8_t stages;
+} dsp_biquad_q15_t;
+
+typedef struct {
+    const dsp_biquad_q31_coeffs_t *coeffs;
+    q31_t *state;               // 4 per stage
+    uint8_t stages;
+} dsp_biquad_q31_t;
+
+void dsp_biquad_q15_init(dsp_biquad_q15_t *biquad, const dsp_biquad_q15_coeffs_t *coeffs, q15_t *state, uint8_t stages);
+void dsp_biquad_q15(dsp_biquad_q15_t *biquad, const q15_t *in, q15_t *out, uint16_t n);
+
+void dsp_biquad_q31_init(dsp_biquad_q31_t *biquad, const dsp_biquad_q31_coeffs_t *coeffs, q31_t *state, uint8_t stages);
+void dsp_biquad_q31(dsp_biquad_q31_t *biquad, const q31_t *in, q31_t *out, uint16_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
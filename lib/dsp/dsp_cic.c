@@ -0,0 +1,64 @@
+#include "dsp_cic.h"
+
+uint8_t dsp_cic_init(dsp_cic_t *cic, uint8_t order, uint8_t factor){
+    uint8_t bits = 0;
+
+    if(order == 0 || order > DSP_CIC_MAX_ORDER || factor < 2) {
+        return 1;
+    }
+
+    // Bits of growth per stage, rounded up
+    while((1u << bits) < factor) {
+        bits++;
+    }
+
+    if(16 + order * bits > 32) {
+        return 1;
+    }
+
+    for(uint8_t i = 0; i < DSP_CIC_MAX_ORDER; i++) {
+        cic->integrator[i] = 0;
+        cic->comb[i] = 0;
+    }
+
+    cic->order = order;
+    cic->factor = factor;
+    cic->phase = 0;
+    cic->shift = order * bits;
+
+    return 0;
+}
+
+uint16_t dsp_cic_decimate(dsp_cic_t *cic, const q15_t *in, q15_t *out, uint16_t n){
+    uint32_t *integrator = cic->integrator;
+    uint8_t order = cic->order;
+    uint16_t written = 0;
+
+    while(n--) {
+        uint32_t value = (uint32_t)(int32_t)*in++;
+
+        // Unsigned so the wraparound is defined
+        integrator[0] += value;
+        for(uint8_t i = 1; i < order; i++) {
+            integrator[i] += integrator[i - 1];
+        }
+
+        if(++cic->phase < cic->factor) {
+            continue;
+        }
+
+        cic->phase = 0;
+        value = integrator[order - 1];
+
+        for(uint8_t i = 0; i < order; i++) {
+            uint32_t previous = cic->comb[i];
+
+            cic->comb[i] = value;
+            value -= previous;
+        }
+
+        out[written++] = dsp_sat_q15((int32_t)value >> cic->shift);
+    }
+
+    return written;
+}
@@ -0,0 +1,36 @@
+#ifndef DSP_CIC_H
+#define DSP_CIC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "dsp_types.h"
+
+#define DSP_CIC_MAX_ORDER 4
+
+// Cascaded integrator-comb decimator: `order` integrators at the input
+// rate, `order` combs at the output rate, no multiplies. The registers
+// wrap modulo 2^32, which is harmless as long as the gain factor^order
+// fits next to the 16-bit input; init rejects configurations that do not.
+// Output is scaled down by a power of two so the gain is at most 1 (exactly
+// 1 when factor is a power of two).
+typedef struct {
+    uint32_t integrator[DSP_CIC_MAX_ORDER];
+    uint32_t comb[DSP_CIC_MAX_ORDER];   // Previous input of each comb
+    uint8_t order;
+    uint8_t factor;
+    uint8_t phase;
+    uint8_t shift;
+} dsp_cic_t;
+
+uint8_t dsp_cic_init(dsp_cic_t *cic, uint8_t order, uint8_t factor);
+
+// Returns the number of samples written to out; `out` may be `in`
+uint16_t dsp_cic_decimate(dsp_cic_t *cic, const q15_t *in, q15_t *out, uint16_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
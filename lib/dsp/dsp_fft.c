@@ -0,0 +1,216 @@
+#include "dsp_fft.h"
+
+// Twiddle W_1024^k as (cos, sin); W = cos - j sin
+#define DSP_FFT_COS(k) dsp_fft_twiddle[2 * (k)]
+#define DSP_FFT_SIN(k) dsp_fft_twiddle[2 * (k) + 1]
+
+static uint8_t dsp_fft_log2(uint16_t n){
+    uint8_t bits = 0;
+
+    while((1u << bits) < n) {
+        bits++;
+    }
+
+    return (1u << bits) == n ? bits : 0xFF;
+}
+
+// Bit-reversal permutation; shift scales every value on the way
+static void dsp_fft_bitrev(q15_t *data, uint16_t n, uint8_t shift){
+    uint16_t j = 0;
+
+    for(uint16_t i = 0; i < n; i++) {
+        if(i < j) {
+            q15_t re = data[2 * i];
+            q15_t im = data[2 * i + 1];
+
+            data[2 * i] = data[2 * j] >> shift;
+            data[2 * i + 1] = data[2 * j + 1] >> shift;
+            data[2 * j] = re >> shift;
+            data[2 * j + 1] = im >> shift;
+        } else if(i == j && shift) {
+            data[2 * i] >>= shift;
+            data[2 * i + 1] >>= shift;
+        }
+
+        uint16_t bit = n >> 1;
+
+        while(j & bit) {
+            j ^= bit;
+            bit >>= 1;
+        }
+        j |= bit;
+    }
+}
+
+static void dsp_fft_radix2(q15_t *data, uint16_t n){
+    // First level: all twiddles are 1
+    for(uint16_t k = 0; k < n; k += 2) {
+        int32_t ar = data[2 * k], ai = data[2 * k + 1];
+        int32_t br = data[2 * k + 2], bi = data[2 * k + 3];
+
+        data[2 * k] = (ar + br) >> 1;
+        data[2 * k + 1] = (ai + bi) >> 1;
+        data[2 * k + 2] = (ar - br) >> 1;
+        data[2 * k + 3] = (ai - bi) >> 1;
+    }
+}
+
+// Two radix-2 levels of span h and 2h over the quads k, k+h, k+2h, k+3h.
+// The second level's twiddle for the odd pair is -j times the even one.
+static void dsp_fft_radix4(q15_t *data, uint16_t n, uint16_t h){
+    uint16_t step1 = (DSP_FFT_MAX_POINTS / 2) / h;     // W_2h
+    uint16_t step2 = step1 / 2;                         // W_4h
+
+    for(uint16_t j = 0; j < h; j++) {
+        int32_t c1 = DSP_FFT_COS(j * step1), s1 = DSP_FFT_SIN(j * step1);
+        int32_t c2 = DSP_FFT_COS(j * step2), s2 = DSP_FFT_SIN(j * step2);
+
+        for(uint16_t k = j; k < n; k += 4 * h) {
+            q15_t *a = &data[2 * k];
+            q15_t *b = &data[2 * (k + h)];
+            q15_t *c = &data[2 * (k + 2 * h)];
+            q15_t *d = &data[2 * (k + 3 * h)];
+            int32_t tr, ti;
+            int32_t a1r, a1i, b1r, b1i, c1r, c1i, d1r, d1i;
+
+            // Level 1: (a, b) and (c, d) with W_2h^j
+            tr = (b[0] * c1 + b[1] * s1) >> 15;
+            ti = (b[1] * c1 - b[0] * s1) >> 15;
+            a1r = (a[0] + tr) >> 1;
+            a1i = (a[1] + ti) >> 1;
+            b1r = (a[0] - tr) >> 1;
+            b1i = (a[1] - ti) >> 1;
+
+            tr = (d[0] * c1 + d[1] * s1) >> 15;
+            ti = (d[1] * c1 - d[0] * s1) >> 15;
+            c1r = (c[0] + tr) >> 1;
+            c1i = (c[1] + ti) >> 1;
+            d1r = (c[0] - tr) >> 1;
+            d1i = (c[1] - ti) >> 1;
+
+            // Level 2: (a1, c1) with W_4h^j, (b1, d1) with -j W_4h^j
+            tr = (c1r * c2 + c1i * s2) >> 15;
+            ti = (c1i * c2 - c1r * s2) >> 15;
+            a[0] = (a1r + tr) >> 1;
+            a[1] = (a1i + ti) >> 1;
+            c[0] = (a1r - tr) >> 1;
+            c[1] = (a1i - ti) >> 1;
+
+            tr = (d1i * c2 - d1r * s2) >> 15;
+            ti = -((d1r * c2 + d1i * s2) >> 15);
+            b[0] = (b1r + tr) >> 1;
+            b[1] = (b1i + ti) >> 1;
+            d[0] = (b1r - tr) >> 1;
+            d[1] = (b1i - ti) >> 1;
+        }
+    }
+}
+
+static void dsp_fft_levels(q15_t *data, uint16_t n, uint8_t bits){
+    uint16_t h = 1;
+
+    // An odd number of levels leaves one plain radix-2 level
+    if(bits & 1) {
+        dsp_fft_radix2(data, n);
+        h = 2;
+    }
+
+    for(; h < n; h *= 4) {
+        dsp_fft_radix4(data, n, h);
+    }
+}
+
+uint8_t dsp_cfft_q15(q15_t *data, uint16_t n){
+    uint8_t bits = dsp_fft_log2(n);
+
+    if(bits == 0xFF || n > DSP_FFT_MAX_POINTS) {
+        return 1;
+    }
+
+    dsp_fft_bitrev(data, n, 0);
+    dsp_fft_levels(data, n, bits);
+
+    return 0;
+}
+
+uint8_t dsp_rfft_q15(q15_t *data, uint16_t n){
+    uint16_t m = n / 2;
+    uint16_t step = DSP_FFT_MAX_POINTS / n;
+    uint8_t bits = dsp_fft_log2(m);
+    int32_t zr, zi;
+
+    if(bits == 0xFF || n < 4 || n > DSP_FFT_MAX_POINTS) {
+        return 1;
+    }
+
+    // Treat even/odd samples as re/im of an n/2-point transform. Pairs
+    // can reach a magnitude of sqrt(2), so the input is halved first.
+    dsp_fft_bitrev(data, m, 1);
+    dsp_fft_levels(data, m, bits);
+
+    // Untangle X[k] and X[m - k] from Z[k] and conj(Z[m - k])
+    zr = data[0];
+    zi = data[1];
+    data[0] = dsp_sat_q15(zr + zi);
+    data[1] = dsp_sat_q15(zr - zi);
+
+    for(uint16_t k = 1; k <= m / 2; k++) {
+        q15_t *x = &data[2 * k];
+        q15_t *y = &data[2 * (m - k)];
+        int32_t c = DSP_FFT_COS(k * step), s = DSP_FFT_SIN(k * step);
+        int32_t evr = (x[0] + y[0]) >> 1;
+        int32_t evi = (x[1] - y[1]) >> 1;
+        int32_t odr = (x[0] - y[0]) >> 1;
+        int32_t odi = (x[1] + y[1]) >> 1;
+        int32_t p = (odi * c - odr * s) >> 15;
+        int32_t q = -((odr * c + odi * s) >> 15);
+
+        x[0] = dsp_sat_q15(evr + p);
+        x[1] = dsp_sat_q15(evi + q);
+        y[0] = dsp_sat_q15(evr - p);
+        y[1] = dsp_sat_q15(q - evi);
+    }
+
+    return 0;
+}
+
+void dsp_fft_power_q15(const q15_t *bins, uint32_t *power, uint16_t count){
+    for(uint16_t i = 0; i < count; i++) {
+        int32_t re = bins[2 * i];
+        int32_t im = bins[2 * i + 1];
+
+        power[i] = (uint32_t)(re * re) + (uint32_t)(im * im);
+    }
+}
+
+// Bitwise square root, one result bit per step
+static uint16_t dsp_isqrt(uint32_t x){
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+
+    while(bit > x) {
+        bit >>= 2;
+    }
+
+    while(bit) {
+        if(x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint16_t)root;
+}
+
+void dsp_fft_magnitude_q15(const q15_t *bins, q15_t *magnitude, uint16_t count){
+    for(uint16_t i = 0; i < count; i++) {
+        int32_t re = bins[2 * i];
+        int32_t im = bins[2 * i + 1];
+        uint16_t root = dsp_isqrt((uint32_t)(re * re) + (uint32_t)(im * im));
+
+        magnitude[i] = root > INT16_MAX ? INT16_MAX : (q15_t)root;
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef DSP_FFT_H
+#define DSP_FFT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "dsp_types.h"
+
+#define DSP_FFT_MAX_POINTS 1024
+
+// In-place Q15 FFTs. Data is interleaved (re, im). Every radix-2 level
+// halves its outputs, so the result is X[k] / n and cannot overflow as
+// long as the input magnitudes stay below 1. Pairs of levels are fused
+// into radix-4 passes (radix-2^2): half the loads and stores of plain
+// radix-2, and one complex multiply in four is a swap. Twiddles come from
+// a shared 2 KB table in flash; no RAM beyond the data itself.
+
+// n complex points (2 * n q15 values), a power of two up to 1024.
+// Returns 1 for other sizes.
+uint8_t dsp_cfft_q15(q15_t *data, uint16_t n);
+
+// n real samples, a power of two from 4 to 1024, packed as n/2 complex
+// values. Output is the n/2 bins X[0] .. X[n/2 - 1], scaled by 1/n, in
+// the same buffer; X[0] and X[n/2] are both real, so X[n/2] is stored in
+// the imaginary part of bin 0. An ADC DMA half buffer converted with
+// dsp_q15_from_adc() can be transformed where it lies.
+uint8_t dsp_rfft_q15(q15_t *data, uint16_t n);
+
+// |X|^2 of each bin in Q30, and |X| in Q15. Both can write over the bins.
+void dsp_fft_power_q15(const q15_t *bins, uint32_t *power, uint16_t count);
+void dsp_fft_magnitude_q15(const q15_t *bins, q15_t *magnitude, uint16_t count);
+
+extern const q15_t dsp_fft_twiddle[DSP_FFT_MAX_POINTS];
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
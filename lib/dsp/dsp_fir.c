@@ -0,0 +1,183 @@
+#include "dsp_fir.h"
+
+// Stores x in both copies of the delay line and returns the window,
+// newest sample first
+static inline const q15_t *dsp_fir_q15_push(dsp_fir_q15_t *fir, q15_t x){
+    uint16_t taps = fir->num_taps;
+    uint16_t index = (fir->index == 0 ? taps : fir->index) - 1;
+
+    fir->state[index] = x;
+    fir->state[index + taps] = x;
+    fir->index = index;
+
+    return &fir->state[index];
+}
+
+// Two accumulators let consecutive multiplies issue without waiting on
+// each other's add
+static inline int32_t dsp_dot_q15(const q15_t *a, const q15_t *b, uint16_t n){
+    int32_t acc0 = 0;
+    int32_t acc1 = 0;
+
+    while(n >= 4) {
+        acc0 += (int32_t)a[0] * b[0];
+        acc1 += (int32_t)a[1] * b[1];
+        acc0 += (int32_t)a[2] * b[2];
+        acc1 += (int32_t)a[3] * b[3];
+        a += 4;
+        b += 4;
+        n -= 4;
+    }
+
+    while(n--) {
+        acc0 += (int32_t)*a++ * *b++;
+    }
+
+    return acc0 + acc1;
+}
+
+static inline q15_t dsp_fir_q15_round(int32_t acc){
+    return dsp_sat_q15((acc + (1 << 14)) >> 15);
+}
+
+void dsp_fir_q15_init(dsp_fir_q15_t *fir, const q15_t *coeffs, q15_t *state, uint16_t num_taps){
+    fir->coeffs = coeffs;
+    fir->state = state;
+    fir->num_taps = num_taps;
+    fir->index = 0;
+
+    for(uint16_t i = 0; i < 2 * num_taps; i++) {
+        state[i] = 0;
+    }
+}
+
+void dsp_fir_q15(dsp_fir_q15_t *fir, const q15_t *in, q15_t *out, uint16_t n){
+    const q15_t *coeffs = fir->coeffs;
+    uint16_t taps = fir->num_taps;
+
+    while(n--) {
+        const q15_t *window = dsp_fir_q15_push(fir, *in++);
+
+        *out++ = dsp_fir_q15_round(dsp_dot_q15(coeffs, window, taps));
+    }
+}
+
+void dsp_fir_sym_q15(dsp_fir_q15_t *fir, const q15_t *in, q15_t *out, uint16_t n){
+    const q15_t *coeffs = fir->coeffs;
+    uint16_t taps = fir->num_taps;
+    uint16_t pairs = taps / 2;
+
+    while(n--) {
+        const q15_t *head = dsp_fir_q15_push(fir, *in++);
+        const q15_t *tail = head + taps - 1;
+        const q15_t *h = coeffs;
+        int32_t acc0 = 0;
+        int32_t acc1 = 0;
+        uint16_t k = pairs;
+
+        while(k >= 2) {
+            acc0 += (int32_t)h[0] * (head[0] + tail[0]);
+            acc1 += (int32_t)h[1] * (head[1] + tail[-1]);
+            h += 2;
+            head += 2;
+            tail -= 2;
+            k -= 2;
+        }
+
+        if(k) {
+            acc0 += (int32_t)h[0] * (head[0] + tail[0]);
+            h++;
+            head++;
+        }
+
+        // Centre tap of an odd-length filter
+        if(taps & 1) {
+            acc0 += (int32_t)h[0] * head[0];
+        }
+
+        *out++ = dsp_fir_q15_round(acc0 + acc1);
+    }
+}
+
+void dsp_fir_q31_init(dsp_fir_q31_t *fir, const q31_t *coeffs, q31_t *state, uint16_t num_taps){
+    fir->coeffs = coeffs;
+    fir->state = state;
+    fir->num_taps = num_taps;
+    fir->index = 0;
+
+    for(uint16_t i = 0; i < 2 * num_taps; i++) {
+        state[i] = 0;
+    }
+}
+
+// High word of a 32x32 product: a single mulh on RV32IM
+static inline int32_t dsp_mulh(int32_t a, int32_t b){
+    return (int32_t)(((int64_t)a * b) >> 32);
+}
+
+void dsp_fir_q31(dsp_fir_q31_t *fir, const q31_t *in, q31_t *out, uint16_t n){
+    const q31_t *coeffs = fir->coeffs;
+    uint16_t taps = fir->num_taps;
+
+    while(n--) {
+        uint16_t index = (fir->index == 0 ? taps : fir->index) - 1;
+        const q31_t *h = coeffs;
+        const q31_t *x;
+        int32_t acc0 = 0;
+        int32_t acc1 = 0;
+        uint16_t k = taps;
+
+        fir->state[index] = *in;
+        fir->state[index + taps] = *in++;
+        fir->index = index;
+        x = &fir->state[index];
+
+        while(k >= 4) {
+            acc0 += dsp_mulh(h[0], x[0]);
+            acc1 += dsp_mulh(h[1], x[1]);
+            acc0 += dsp_mulh(h[2], x[2]);
+            acc1 += dsp_mulh(h[3], x[3]);
+            h += 4;
+            x += 4;
+            k -= 4;
+        }
+
+        while(k--) {
+            acc0 += dsp_mulh(*h++, *x++);
+        }
+
+        // Q31 * Q31 >> 32 is Q30
+        *out++ = dsp_sat_q31(((int64_t)acc0 + acc1) * 2);
+    }
+}
+
+uint8_t dsp_fir_decimate_q15_init(dsp_fir_decimate_q15_t *decimator, const q15_t *coeffs, q15_t *state,
+                                  uint16_t num_taps, uint8_t factor){
+    if(factor == 0) {
+        return 1;
+    }
+
+    dsp_fir_q15_init(&decimator->fir, coeffs, state, num_taps);
+    decimator->factor = factor;
+    decimator->phase = 0;
+
+    return 0;
+}
+
+uint16_t dsp_fir_decimate_q15(dsp_fir_decimate_q15_t *decimator, const q15_t *in, q15_t *out, uint16_t n){
+    dsp_fir_q15_t *fir = &decimator->fir;
+    uint16_t written = 0;
+
+    while(n--) {
+        const q15_t *window = dsp_fir_q15_push(fir, *in++);
+
+        if(++decimator->phase < decimator->factor) {
+            continue;
+        }
+
+        decimator->phase = 0;
+        out[written++] = dsp_fir_q15_round(dsp_dot_q15(fir->coeffs, window, fir->num_taps));
+    }
+
+    return written;
+}
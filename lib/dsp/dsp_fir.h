@@ -0,0 +1,63 @@
+#ifndef DSP_FIR_H
+#define DSP_FIR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "dsp_types.h"
+
+// Streaming FIR filters. The delay line is stored twice over (2 * taps
+// entries) so the newest `taps` samples are always contiguous: no copying
+// per block and no wrap check in the inner loop. Blocks can be any length
+// and `out` may be the same buffer as `in`.
+//
+// Q15 kernels accumulate in 32 bits, which holds as long as the absolute
+// coefficient sum stays below 2 (any normalised low-pass does). Output is
+// rounded and saturated.
+typedef struct {
+    const q15_t *coeffs;    // h[0] applies to the newest sample
+    q15_t *state;           // 2 * num_taps entries
+    uint16_t num_taps;
+    uint16_t index;
+} dsp_fir_q15_t;
+
+typedef struct {
+    const q31_t *coeffs;
+    q31_t *state;           // 2 * num_taps entries
+    uint16_t num_taps;
+    uint16_t index;
+} dsp_fir_q31_t;
+
+// FIR followed by keeping every factor-th output; only the kept outputs
+// are computed, which is what a polyphase decimator saves
+typedef struct {
+    dsp_fir_q15_t fir;
+    uint8_t factor;
+    uint8_t phase;
+} dsp_fir_decimate_q15_t;
+
+void dsp_fir_q15_init(dsp_fir_q15_t *fir, const q15_t *coeffs, q15_t *state, uint16_t num_taps);
+void dsp_fir_q15(dsp_fir_q15_t *fir, const q15_t *in, q15_t *out, uint16_t n);
+
+// Linear-phase FIR with h[k] == h[num_taps - 1 - k]. `coeffs` holds only
+// the first (num_taps + 1) / 2; mirrored samples are added before the
+// multiply, halving the multiplies.
+void dsp_fir_sym_q15(dsp_fir_q15_t *fir, const q15_t *in, q15_t *out, uint16_t n);
+
+// Keeps the top 32 bits of each product (one mulh), so the result carries
+// about 30 bits; the full 64-bit accumulation is rarely worth its cost
+void dsp_fir_q31_init(dsp_fir_q31_t *fir, const q31_t *coeffs, q31_t *state, uint16_t num_taps);
+void dsp_fir_q31(dsp_fir_q31_t *fir, const q31_t *in, q31_t *out, uint16_t n);
+
+uint8_t dsp_fir_decimate_q15_init(dsp_fir_decimate_q15_t *decimator, const q15_t *coeffs, q15_t *state,
+                                  uint16_t num_taps, uint8_t factor);
+
+// Returns the number of samples written to out
+uint16_t dsp_fir_decimate_q15(dsp_fir_decimate_q15_t *decimator, const q15_t *in, q15_t *out, uint16_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+#include "dsp_smooth.h"
+
+uint8_t dsp_moving_average_init(dsp_moving_average_t *average, q15_t *history, uint16_t window){
+    uint8_t shift = 0;
+
+    if(window == 0 || (window & (window - 1)) != 0 || window > 0x8000) {
+        return 1;
+    }
+
+    while((1u << shift) < window) {
+        shift++;
+    }
+
+    for(uint16_t i = 0; i < window; i++) {
+        history[i] = 0;
+    }
+
+    average->history = history;
+    average->sum = 0;
+    average->mask = window - 1;
+    average->index = 0;
+    average->shift = shift;
+
+    return 0;
+}
+
+void dsp_moving_average(dsp_moving_average_t *average, const q15_t *in, q15_t *out, uint16_t n){
+    q15_t *history = average->history;
+    int32_t sum = average->sum;
+    uint16_t mask = average->mask;
+    uint16_t index = average->index;
+    uint8_t shift = average->shift;
+
+    while(n--) {
+        q15_t x = *in++;
+
+        sum += x - history[index];
+        history[index] = x;
+        index = (index + 1) & mask;
+        *out++ = (q15_t)(sum >> shift);
+    }
+
+    average->sum = sum;
+    average->index = index;
+}
+
+uint8_t dsp_median_init(dsp_median_t *median, uint8_t window){
+    if((window & 1) == 0 || window > DSP_MEDIAN_MAX_WINDOW) {
+        return 1;
+    }
+
+    for(uint8_t i = 0; i < window; i++) {
+        median->history[i] = 0;
+        median->sorted[i] = 0;
+    }
+
+    median->window = window;
+    median->index = 0;
+
+    return 0;
+}
+
+void dsp_median(dsp_median_t *median, const q15_t *in, q15_t *out, uint16_t n){
+    q15_t *sorted = median->sorted;
+    uint8_t window = median->window;
+
+    while(n--) {
+        q15_t x = *in++;
+        q15_t oldest = median->history[median->index];
+        uint8_t position = 0;
+
+        median->history[median->index] = x;
+        if(++median->index == window) {
+            median->index = 0;
+        }
+
+        // Replace the oldest sample with the new one and slide it into place
+        while(sorted[position] != oldest) {
+            position++;
+        }
+
+        if(x > oldest) {
+            while(position + 1 < window && sorted[position + 1] < x) {
+                sorted[position] = sorted[position + 1];
+                position++;
+            }
+        } else {
+            while(position > 0 && sorted[position - 1] > x) {
+                sorted[position] = sorted[position - 1];
+                position--;
+            }
+        }
+
+        sorted[position] = x;
+        *out++ = sorted[window / 2];
+    }
+}
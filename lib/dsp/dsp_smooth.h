@@ -0,0 +1,42 @@
+#ifndef DSP_SMOOTH_H
+#define DSP_SMOOTH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "dsp_types.h"
+
+#define DSP_MEDIAN_MAX_WINDOW 15
+
+// Running mean over a power-of-two window: one add, one subtract and a
+// shift per sample whatever the window length
+typedef struct {
+    q15_t *history;         // window entries
+    int32_t sum;
+    uint16_t mask;
+    uint16_t index;
+    uint8_t shift;
+} dsp_moving_average_t;
+
+// Running median over an odd window. A sorted copy of the window is kept
+// up to date by moving one entry, so a sample costs O(window) rather than
+// a sort.
+typedef struct {
+    q15_t history[DSP_MEDIAN_MAX_WINDOW];
+    q15_t sorted[DSP_MEDIAN_MAX_WINDOW];
+    uint8_t window;
+    uint8_t index;
+} dsp_median_t;
+
+uint8_t dsp_moving_average_init(dsp_moving_average_t *average, q15_t *history, uint16_t window);
+void dsp_moving_average(dsp_moving_average_t *average, const q15_t *in, q15_t *out, uint16_t n);
+
+uint8_t dsp_median_init(dsp_median_t *median, uint8_t window);
+void dsp_median(dsp_median_t *median, const q15_t *in, q15_t *out, uint16_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
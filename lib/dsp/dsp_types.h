@@ -0,0 +1,46 @@
+#ifndef DSP_TYPES_H
+#define DSP_TYPES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Fixed-point samples: Q15 covers [-1, 1) in 16 bits, Q31 in 32 bits
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+static inline q15_t dsp_sat_q15(int32_t x){
+    if(x > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if(x < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (q15_t)x;
+}
+
+static inline q31_t dsp_sat_q31(int64_t x){
+    if(x > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if(x < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (q31_t)x;
+}
+
+// 12-bit right-aligned ADC codes to Q15 around mid-scale. Works in place
+// on a DMA half buffer, since q15_t and uint16_t have the same size.
+static inline void dsp_q15_from_adc(const uint16_t *in, q15_t *out, uint16_t n){
+    while(n--) {
+        *out++ = (q15_t)((*in++ - 2048) * 16);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
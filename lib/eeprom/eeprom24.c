@@ -0,0 +1,131 @@
+#include <string.h>
+
+#include "eeprom24.h"
+#include "i2c_master.h"
+#include "timebase.h"
+
+static eeprom24_config_t eeprom24_config;
+static i2c_transaction_t eeprom24_transaction;
+
+// Memory address followed by one page of data, so a burst is a single DMA
+// transfer
+static uint8_t eeprom24_buffer[2 + EEPROM24_MAX_PAGE];
+
+// Puts the memory address into the buffer and the bus address into the
+// transaction; returns the number of address bytes
+static uint8_t eeprom24_set_address(uint32_t address){
+    if(eeprom24_config.address_bytes == 1) {
+        eeprom24_transaction.address = eeprom24_config.address | ((address >> 7) & 0x0E);
+        eeprom24_buffer[0] = address;
+        return 1;
+    }
+
+    eeprom24_transaction.address = eeprom24_config.address | ((address >> 15) & 0x0E);
+    eeprom24_buffer[0] = address >> 8;
+    eeprom24_buffer[1] = address;
+    return 2;
+}
+
+// While a write cycle runs the part NACKs its address, so a refused
+// transaction is retried until the part answers or the write cycle
+// timeout passes. This is the ACK polling; no fixed delay is needed.
+static uint8_t eeprom24_transfer(void){
+    uint32_t deadline = timebase_deadline_us(EEPROM24_WRITE_TIMEOUT_US);
+
+    for(;;) {
+        i2c_master_submit(&eeprom24_transaction);
+
+        if(i2c_master_wait(&eeprom24_transaction) == 0) {
+            return 0;
+        }
+
+        if(eeprom24_transaction.error != I2C_ERROR_NACK || timebase_expired(deadline)) {
+            return 1;
+        }
+    }
+}
+
+uint8_t eeprom24_init(const eeprom24_config_t *config){
+    if(config->page_size == 0 || config->page_size > EEPROM24_MAX_PAGE ||
+       config->address_bytes < 1 || config->address_bytes > 2) {
+        return 1;
+    }
+
+    eeprom24_config = *config;
+    memset(&eeprom24_transaction, 0, sizeof(eeprom24_transaction));
+
+    // The part has to answer its address
+    eeprom24_transaction.address = config->address;
+    return eeprom24_transfer();
+}
+
+uint8_t eeprom24_read(uint32_t address, uint8_t *data, uint32_t length){
+    uint32_t block_size = eeprom24_config.address_bytes == 1 ? 256 : 65536;
+    uint32_t chunk;
+
+    if(address + length > eeprom24_config.size) {
+        return 1;
+    }
+
+    while(length) {
+        // The bus address changes at each block boundary, and rx_length is 16 bits
+        chunk = block_size - (address % block_size);
+        if(chunk > length) {
+            chunk = length;
+        }
+        if(chunk > 0xFFFF) {
+            chunk = 0xFFFF;
+        }
+
+        eeprom24_transaction.tx_buffer = eeprom24_buffer;
+        eeprom24_transaction.tx_length = eeprom24_set_address(address);
+        eeprom24_transaction.rx_buffer = data;
+        eeprom24_transaction.rx_length = chunk;
+
+        if(eeprom24_transfer() != 0) {
+            return 1;
+        }
+
+        address += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+
+    return 0;
+}
+
+uint8_t eeprom24_write(uint32_t address, const uint8_t *data, uint32_t length){
+    uint16_t chunk;
+    uint8_t header;
+
+    if(address + length > eeprom24_config.size) {
+        return 1;
+    }
+
+    while(length) {
+        // A burst that crosses a page boundary wraps around inside the page
+        chunk = eeprom24_config.page_size - (address % eeprom24_config.page_size);
+        if(chunk > length) {
+            chunk = length;
+        }
+
+        header = eeprom24_set_address(address);
+        memcpy(&eeprom24_buffer[header], data, chunk);
+
+        eeprom24_transaction.tx_buffer = eeprom24_buffer;
+        eeprom24_transaction.tx_length = header + chunk;
+        eeprom24_transaction.rx_length = 0;
+
+        if(eeprom24_transfer() != 0) {
+            return 1;
+        }
+
+        address += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+
+    // Wait out the last write cycle so the data is durable on return
+    eeprom24_transaction.tx_length = 0;
+    return eeprom24_transfer();
+}
@@ -0,0 +1,44 @@
+#ifndef EEPROM24_H
+#define EEPROM24_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+
+// Largest page supported; 24C32/64 use 32 bytes, 24C128/256 64 bytes
+#ifndef EEPROM24_MAX_PAGE
+#define EEPROM24_MAX_PAGE 64
+#endif
+
+// Write cycle is 5 ms on most parts; ACK polling stops after this long
+#ifndef EEPROM24_WRITE_TIMEOUT_US
+#define EEPROM24_WRITE_TIMEOUT_US 20000
+#endif
+
+typedef struct {
+    uint8_t address;        // 8-bit bus address, 0xA0 with A2..A0 low
+    uint8_t address_bytes;  // 1 for 24C01-24C16, 2 for 24C32 and up
+    uint16_t page_size;
+    uint32_t size;          // Bytes
+} eeprom24_config_t;
+
+// 24Cxx serial EEPROM on the I2C master queue. i2c_master_init() must have
+// been called. Parts with one address byte carry the upper address bits in
+// the bus address (24C04-24C16). Thread context only.
+uint8_t eeprom24_init(const eeprom24_config_t *config);
+
+// One sequential read per address block
+uint8_t eeprom24_read(uint32_t address, uint8_t *data, uint32_t length);
+
+// Splits the data into page-aligned bursts. Each burst starts as soon as
+// the part acknowledges again after the previous write cycle; the call
+// returns once the last write cycle has finished.
+uint8_t eeprom24_write(uint32_t address, const uint8_t *data, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1113 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "fat.h"
+
+#define FAT_NO_SECTOR 0xFFFFFFFF
+
+// Directory entry attributes
+#define FAT_ATTR_READ_ONLY 0x01
+#define FAT_ATTR_VOLUME    0x08
+#define FAT_ATTR_DIRECTORY 0x10
+#define FAT_ATTR_ARCHIVE   0x20
+
+#define FAT_ENTRY_SIZE    32
+#define FAT_ENTRY_FREE    0xE5
+#define FAT_ENTRY_END     0x00
+
+// fat_file_t.state
+#define FAT_STATE_BUFFER_VALID 0x01
+#define FAT_STATE_BUFFER_DIRTY 0x02
+#define FAT_STATE_ENTRY_DIRTY  0x04
+
+// fat_dir_find() results
+#define FAT_FOUND     0
+#define FAT_NOT_FOUND 1
+#define FAT_ERROR     2
+
+// 2024-01-01 00:00 when no time source is set
+#define FAT_DEFAULT_TIME ((uint32_t)(2024 - 1980) << 25 | 1UL << 21 | 1UL << 16)
+
+typedef struct {
+    uint32_t cluster;   // 0 for the fixed FAT12/16 root directory
+    uint32_t sector;
+    uint32_t index;     // Sector within the cluster or the fixed root
+} fat_dir_t;
+
+static const blockdev_t *fat_dev = NULL;
+static uint8_t fat_type;
+static uint8_t fat_sectors_per_cluster;
+static uint8_t fat_count;
+static uint32_t fat_table_start;
+static uint32_t fat_table_sectors;
+static uint32_t fat_root_start;
+static uint32_t fat_root_sectors;
+static uint32_t fat_root_cluster;
+static uint32_t fat_data_start;
+static uint32_t fat_cluster_count;
+static uint32_t fat_free_hint;
+static uint32_t fat_fsinfo_sector;
+static uint8_t fat_fsinfo_dirty;
+static uint32_t (*fat_time_source)(void) = NULL;
+
+// One FAT sector and one directory sector are cached; every FAT copy is
+// written when the FAT sector is evicted or flushed
+static uint8_t fat_table_cache[FAT_SECTOR_SIZE];
+static uint32_t fat_table_cached = FAT_NO_SECTOR;
+static uint8_t fat_table_dirty = 0;
+static uint8_t fat_dir_cache[FAT_SECTOR_SIZE];
+static uint32_t fat_dir_cached = FAT_NO_SECTOR;
+static uint8_t fat_dir_dirty = 0;
+
+static uint16_t fat_get16(const uint8_t *p){
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t fat_get32(const uint8_t *p){
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void fat_put16(uint8_t *p, uint16_t value){
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+static void fat_put32(uint8_t *p, uint32_t value){
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static uint32_t fat_cluster_bytes(void){
+    return (uint32_t)fat_sectors_per_cluster * FAT_SECTOR_SIZE;
+}
+
+static uint32_t fat_cluster_sector(uint32_t cluster){
+    return fat_data_start + (cluster - 2) * fat_sectors_per_cluster;
+}
+
+static uint8_t fat_is_cluster(uint32_t cluster){
+    return cluster >= 2 && cluster < fat_cluster_count + 2;
+}
+
+static uint32_t fat_eoc(void){
+    return fat_type == FAT_TYPE_FAT12 ? 0xFFF : fat_type == FAT_TYPE_FAT16 ? 0xFFFF : 0x0FFFFFFF;
+}
+
+static uint8_t fat_is_eoc(uint32_t value){
+    return value >= (fat_eoc() & ~7UL);
+}
+
+static uint32_t fat_now(void){
+    return fat_time_source ? fat_time_source() : FAT_DEFAULT_TIME;
+}
+
+static uint8_t fat_table_flush(void){
+    if(!fat_table_dirty) {
+        return 0;
+    }
+
+    for(uint8_t i = 0; i < fat_count; i++) {
+        if(fat_dev->write(fat_dev, fat_table_cached + i * fat_table_sectors, fat_table_cache, 1) != 0) {
+            return 1;
+        }
+    }
+
+    fat_table_dirty = 0;
+
+    return 0;
+}
+
+static uint8_t fat_table_load(uint32_t sector){
+    if(sector == fat_table_cached) {
+        return 0;
+    }
+
+    if(fat_table_flush() != 0) {
+        return 1;
+    }
+
+    fat_table_cached = FAT_NO_SECTOR;
+    if(fat_dev->read(fat_dev, sector, fat_table_cache, 1) != 0) {
+        return 1;
+    }
+    fat_table_cached = sector;
+
+    return 0;
+}
+
+static uint8_t fat_dir_flush(void){
+    if(fat_dir_dirty) {
+        if(fat_dev->write(fat_dev, fat_dir_cached, fat_dir_cache, 1) != 0) {
+            return 1;
+        }
+        fat_dir_dirty = 0;
+    }
+
+    return 0;
+}
+
+static uint8_t fat_dir_load(uint32_t sector){
+    if(sector == fat_dir_cached) {
+        return 0;
+    }
+
+    if(fat_dir_flush() != 0) {
+        return 1;
+    }
+
+    fat_dir_cached = FAT_NO_SECTOR;
+    if(fat_dev->read(fat_dev, sector, fat_dir_cache, 1) != 0) {
+        return 1;
+    }
+    fat_dir_cached = sector;
+
+    return 0;
+}
+
+// Returns 1 (never a valid link) on I/O errors or out-of-range clusters
+static uint32_t fat_table_get(uint32_t cluster){
+    uint32_t offset;
+    uint16_t value;
+
+    if(!fat_is_cluster(cluster)) {
+        return 1;
+    }
+
+    switch(fat_type) {
+    case FAT_TYPE_FAT12:
+        // 12-bit entries may straddle two sectors
+        offset = cluster + cluster / 2;
+        if(fat_table_load(fat_table_start + offset / FAT_SECTOR_SIZE) != 0) {
+            return 1;
+        }
+        value = fat_table_cache[offset % FAT_SECTOR_SIZE];
+        offset++;
+        if(fat_table_load(fat_table_start + offset / FAT_SECTOR_SIZE) != 0) {
+            return 1;
+        }
+        value |= fat_table_cache[offset % FAT_SECTOR_SIZE] << 8;
+        return cluster & 1 ? value >> 4 : value & 0xFFF;
+
+    case FAT_TYPE_FAT16:
+        offset = cluster * 2;
+        if(fat_table_load(fat_table_start + offset / FAT_SECTOR_SIZE) != 0) {
+            return 1;
+        }
+        return fat_get16(&fat_table_cache[offset % FAT_SECTOR_SIZE]);
+
+    default:
+        offset = cluster * 4;
+        if(fat_table_load(fat_table_start + offset / FAT_SECTOR_SIZE) != 0) {
+            return 1;
+        }
+        return fat_get32(&fat_table_cache[offset % FAT_SECTOR_SIZE]) & 0x0FFFFFFF;
+    }
+}
+
+static uint8_t fat_table_set(uint32_t cluster, uint32_t value){
+    uint32_t offset;
+    uint8_t *entry;
+
+    if(!fat_is_cluster(cluster)) {
+        return 1;
+    }
+
+    switch(fat_type) {
+    case FAT_TYPE_FAT12:
+        offset = cluster + cluster / 2;
+        if(fat_table_load(fat_table_start + offset / FAT_SECTOR_SIZE) != 0) {
+            return 1;
+        }
+        entry = &fat_table_cache[offset % FAT_SECTOR_SIZE];
+        *entry = cluster & 1 ? (*entry & 0x0F) | (value << 4) : value;
+        fat_table_dirty = 1;
+        offset++;
+        if(fat_table_load(fat_table_start + offset / FAT_SECTOR_SIZE) != 0) {
+            return 1;
+        }
+        entry = &fat_table_cache[offset % FAT_SECTOR_SIZE];
+        *entry = cluster & 1 ? value >> 4 : (*entry & 0xF0) | ((value >> 8) & 0x0F);
+        break;
+
+    case FAT_TYPE_FAT16:
+        offset = cluster * 2;
+        if(fat_table_load(fat_table_start + offset / FAT_SECTOR_SIZE) != 0) {
+            return 1;
+        }
+        fat_put16(&fat_table_cache[offset % FAT_SECTOR_SIZE], value);
+        break;
+
+    default:
+        // The top four bits are reserved and must be preserved
+        offset = cluster * 4;
+        if(fat_table_load(fat_table_start + offset / FAT_SECTOR_SIZE) != 0) {
+            return 1;
+        }
+        entry = &fat_table_cache[offset % FAT_SECTOR_SIZE];
+        fat_put32(entry, (fat_get32(entry) & 0xF0000000) | (value & 0x0FFFFFFF));
+        fat_fsinfo_dirty = 1;
+        break;
+    }
+
+    fat_table_dirty = 1;
+
+    return 0;
+}
+
+// Looks for `count` free clusters in a row from the allocation hint on;
+// settles for the longest run found when there is none that long
+static uint32_t fat_find_free(uint32_t count, uint32_t *found){
+    uint32_t cluster = fat_free_hint;
+    uint32_t start = 0, length = 0;
+    uint32_t best_start = 0, best_length = 0;
+
+    for(uint32_t scanned = 0; scanned < fat_cluster_count; scanned++, cluster++) {
+        if(!fat_is_cluster(cluster)) {
+            cluster = 2;
+            length = 0;
+        }
+
+        if(fat_table_get(cluster) != 0) {
+            length = 0;
+            continue;
+        }
+
+        if(length++ == 0) {
+            start = cluster;
+        }
+
+        if(length > best_length) {
+            best_start = start;
+            best_length = length;
+            if(length == count) {
+                break;
+            }
+        }
+    }
+
+    *found = best_length;
+
+    return best_start;
+}
+
+// Allocates a chained run and links it after `previous` (0 starts a new
+// chain). Returns the first cluster, 0 when the volume is full.
+static uint32_t fat_allocate(uint32_t previous, uint32_t count, uint32_t *allocated){
+    uint32_t start, length;
+
+    start = fat_find_free(count, &length);
+    if(start == 0) {
+        return 0;
+    }
+
+    for(uint32_t i = 0; i < length; i++) {
+        if(fat_table_set(start + i, i + 1 < length ? start + i + 1 : fat_eoc()) != 0) {
+            return 0;
+        }
+    }
+
+    if(previous && fat_table_set(previous, start) != 0) {
+        return 0;
+    }
+
+    fat_free_hint = start + length;
+    *allocated = length;
+
+    return start;
+}
+
+static uint8_t fat_free_chain(uint32_t cluster){
+    uint32_t next;
+
+    // No valid chain is longer than the volume; a corrupted table might be
+    for(uint32_t freed = 0; fat_is_cluster(cluster); freed++) {
+        if(freed == fat_cluster_count) {
+            return 1;
+        }
+
+        next = fat_table_get(cluster);
+        if(fat_table_set(cluster, 0) != 0) {
+            return 1;
+        }
+        if(cluster < fat_free_hint) {
+            fat_free_hint = cluster;
+        }
+        cluster = next;
+    }
+
+    return 0;
+}
+
+static uint32_t fat_entry_cluster(const uint8_t *entry){
+    uint32_t cluster = fat_get16(entry + 26);
+
+    if(fat_type == FAT_TYPE_FAT32) {
+        cluster |= (uint32_t)fat_get16(entry + 20) << 16;
+    }
+
+    return cluster;
+}
+
+static void fat_dir_start(fat_dir_t *dir, uint32_t cluster){
+    if(cluster == 0 && fat_type == FAT_TYPE_FAT32) {
+        cluster = fat_root_cluster;
+    }
+
+    dir->cluster = cluster;
+    dir->index = 0;
+    dir->sector = cluster ? fat_cluster_sector(cluster) : fat_root_start;
+}
+
+// Moves to the next directory sector, optionally growing the directory by
+// a zeroed cluster. Returns 1 at the end of the directory or on error.
+static uint8_t fat_dir_next_sector(fat_dir_t *dir, uint8_t extend){
+    uint32_t next, count;
+
+    dir->index++;
+    dir->sector++;
+
+    if(!dir->cluster) {
+        return dir->index >= fat_root_sectors;
+    }
+
+    if(dir->index < fat_sectors_per_cluster) {
+        return 0;
+    }
+
+    next = fat_table_get(dir->cluster);
+    if(fat_is_eoc(next)) {
+        if(!extend || fat_dir_flush() != 0) {
+            return 1;
+        }
+
+        next = fat_allocate(dir->cluster, 1, &count);
+        if(next == 0) {
+            return 1;
+        }
+
+        memset(fat_dir_cache, 0, FAT_SECTOR_SIZE);
+        fat_dir_cached = FAT_NO_SECTOR;
+        for(uint8_t i = 0; i < fat_sectors_per_cluster; i++) {
+            if(fat_dev->write(fat_dev, fat_cluster_sector(next) + i, fat_dir_cache, 1) != 0) {
+                return 1;
+            }
+        }
+        fat_dir_cached = fat_cluster_sector(next);
+    } else if(!fat_is_cluster(next)) {
+        return 1;
+    }
+
+    dir->cluster = next;
+    dir->index = 0;
+    dir->sector = fat_cluster_sector(next);
+
+    return 0;
+}
+
+// Leaves the entry in fat_dir_cache at *offset on FAT_FOUND
+static uint8_t fat_dir_find(uint32_t dir_cluster, const uint8_t *name, uint32_t *sector, uint16_t *offset){
+    fat_dir_t dir;
+    const uint8_t *entry;
+
+    fat_dir_start(&dir, dir_cluster);
+
+    for(;;) {
+        if(fat_dir_load(dir.sector) != 0) {
+            return FAT_ERROR;
+        }
+
+        for(uint16_t i = 0; i < FAT_SECTOR_SIZE; i += FAT_ENTRY_SIZE) {
+            entry = &fat_dir_cache[i];
+
+            if(entry[0] == FAT_ENTRY_END) {
+                return FAT_NOT_FOUND;
+            }
+
+            // Long-name entries carry the volume bit and are skipped with it
+            if(entry[0] == FAT_ENTRY_FREE || (entry[11] & FAT_ATTR_VOLUME)) {
+                continue;
+            }
+
+            if(memcmp(entry, name, 11) == 0) {
+                *sector = dir.sector;
+                *offset = i;
+                return FAT_FOUND;
+            }
+        }
+
+        if(fat_dir_next_sector(&dir, 0) != 0) {
+            return FAT_NOT_FOUND;
+        }
+    }
+}
+
+static uint8_t fat_dir_allocate(uint32_t dir_cluster, uint32_t *sector, uint16_t *offset){
+    fat_dir_t dir;
+
+    fat_dir_start(&dir, dir_cluster);
+
+    for(;;) {
+        if(fat_dir_load(dir.sector) != 0) {
+            return 1;
+        }
+
+        for(uint16_t i = 0; i < FAT_SECTOR_SIZE; i += FAT_ENTRY_SIZE) {
+            if(fat_dir_cache[i] == FAT_ENTRY_END || fat_dir_cache[i] == FAT_ENTRY_FREE) {
+                *sector = dir.sector;
+                *offset = i;
+                return 0;
+            }
+        }
+
+        if(fat_dir_next_sector(&dir, 1) != 0) {
+            return 1;
+        }
+    }
+}
+
+// Converts one path component to the space-padded 8.3 form. Returns the
+// number of characters consumed, 0 if the component is not a valid name.
+static uint8_t fat_make_name(const char *path, uint8_t *name){
+    uint8_t length = 0, i = 0, limit = 8;
+    char c;
+
+    memset(name, ' ', 11);
+
+    while(path[length] && path[length] != '/') {
+        c = path[length++];
+
+        if(c == '.') {
+            if(limit == 11 || i == 0) {
+                return 0;
+            }
+            i = 8;
+            limit = 11;
+            continue;
+        }
+
+        if(i >= limit || c <= ' ' || strchr("\"*+,:;<=>?[\\]|", c)) {
+            return 0;
+        }
+
+        name[i++] = c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+    }
+
+    return name[0] == ' ' ? 0 : length;
+}
+
+// Walks the directories in `path` and returns the one holding its last
+// component, whose name is left in `name`
+static uint8_t fat_resolve(const char *path, uint32_t *dir_cluster, uint8_t *name){
+    uint32_t cluster = 0, sector;
+    uint16_t offset;
+    uint8_t length;
+
+    while(*path == '/') {
+        path++;
+    }
+
+    for(;;) {
+        length = fat_make_name(path, name);
+        if(length == 0) {
+            return 1;
+        }
+
+        path += length;
+        if(*path == '\0') {
+            *dir_cluster = cluster;
+            return 0;
+        }
+        path++;
+
+        if(fat_dir_find(cluster, name, &sector, &offset) != FAT_FOUND ||
+           !(fat_dir_cache[offset + 11] & FAT_ATTR_DIRECTORY)) {
+            return 1;
+        }
+
+        cluster = fat_entry_cluster(&fat_dir_cache[offset]);
+    }
+}
+
+static uint8_t fat_is_boot_sector(const uint8_t *sector){
+    uint8_t spc = sector[13];
+
+    return (sector[0] == 0xEB || sector[0] == 0xE9) &&
+           fat_get16(sector + 11) == FAT_SECTOR_SIZE &&
+           spc != 0 && (spc & (spc - 1)) == 0 &&
+           fat_get16(sector + 14) != 0 &&
+           (sector[16] == 1 || sector[16] == 2);
+}
+
+uint8_t fat_mount(const blockdev_t *dev){
+    uint8_t *boot = fat_dir_cache;
+    uint32_t volume = 0, total, fat_size, next_free;
+    uint16_t root_entries;
+
+    fat_dev = NULL;
+    fat_table_cached = FAT_NO_SECTOR;
+    fat_table_dirty = 0;
+    fat_dir_cached = FAT_NO_SECTOR;
+    fat_dir_dirty = 0;
+    fat_fsinfo_dirty = 0;
+
+    if(dev->block_size != FAT_SECTOR_SIZE || dev->read(dev, 0, boot, 1) != 0 ||
+       boot[510] != 0x55 || boot[511] != 0xAA) {
+        return 1;
+    }
+
+    // Not a boot sector, so an MBR: use the first partition
+    if(!fat_is_boot_sector(boot)) {
+        volume = fat_get32(boot + 446 + 8);
+        if(volume == 0 || dev->read(dev, volume, boot, 1) != 0 || !fat_is_boot_sector(boot)) {
+            return 1;
+        }
+    }
+
+    fat_sectors_per_cluster = boot[13];
+    fat_count = boot[16];
+    root_entries = fat_get16(boot + 17);
+    total = fat_get16(boot + 19);
+    if(total == 0) {
+        total = fat_get32(boot + 32);
+    }
+    fat_size = fat_get16(boot + 22);
+    if(fat_size == 0) {
+        fat_size = fat_get32(boot + 36);
+    }
+
+    fat_table_start = volume + fat_get16(boot + 14);
+    fat_table_sectors = fat_size;
+    fat_root_start = fat_table_start + fat_count * fat_size;
+    fat_root_sectors = ((uint32_t)root_entries * FAT_ENTRY_SIZE + FAT_SECTOR_SIZE - 1) / FAT_SECTOR_SIZE;
+    fat_data_start = fat_root_start + fat_root_sectors;
+
+    if(total <= fat_data_start - volume) {
+        return 1;
+    }
+    fat_cluster_count = (total - (fat_data_start - volume)) / fat_sectors_per_cluster;
+
+    // The type follows from the cluster count alone
+    if(fat_cluster_count < 4085) {
+        fat_type = FAT_TYPE_FAT12;
+    } else if(fat_cluster_count < 65525) {
+        fat_type = FAT_TYPE_FAT16;
+    } else {
+        fat_type = FAT_TYPE_FAT32;
+    }
+
+    fat_free_hint = 2;
+    fat_fsinfo_sector = FAT_NO_SECTOR;
+
+    if(fat_type == FAT_TYPE_FAT32) {
+        fat_root_cluster = fat_get32(boot + 44);
+        fat_fsinfo_sector = volume + fat_get16(boot + 48);
+
+        // Resume allocation where the last writer left off
+        if(dev->read(dev, fat_fsinfo_sector, boot, 1) == 0 &&
+           fat_get32(boot) == 0x41615252 && fat_get32(boot + 484) == 0x61417272) {
+            next_free = fat_get32(boot + 492);
+            if(next_free >= 2 && next_free < fat_cluster_count + 2) {
+                fat_free_hint = next_free;
+            }
+        } else {
+            fat_fsinfo_sector = FAT_NO_SECTOR;
+        }
+    } else if(root_entries == 0) {
+        return 1;
+    }
+
+    fat_dev = dev;
+
+    return 0;
+}
+
+uint8_t fat_get_type(void){
+    return fat_dev ? fat_type : 0;
+}
+
+uint32_t fat_get_cluster_size(void){
+    return fat_dev ? fat_cluster_bytes() : 0;
+}
+
+void fat_set_time_source(uint32_t (*get_time)(void)){
+    fat_time_source = get_time;
+}
+
+// Moves the cluster-chain cache to cluster `index` of the file, allocating
+// (a preallocated run at a time) when `allocate` is set
+static uint8_t fat_file_seek_cluster(fat_file_t *file, uint32_t index, uint8_t allocate){
+    uint32_t next, count;
+
+    if(file->first_cluster == 0) {
+        if(!allocate) {
+            return 1;
+        }
+
+        next = fat_allocate(0, FAT_PREALLOC_CLUSTERS, &count);
+        if(next == 0) {
+            return 1;
+        }
+
+        file->first_cluster = next;
+        file->cluster = next;
+        file->cluster_index = 0;
+        file->run_start = next;
+        file->run_end = next + count - 1;
+        file->state |= FAT_STATE_ENTRY_DIRTY;
+    }
+
+    if(file->cluster == 0 || index < file->cluster_index) {
+        file->cluster = file->first_cluster;
+        file->cluster_index = 0;
+    }
+
+    while(file->cluster_index < index) {
+        if(file->cluster >= file->run_start && file->cluster < file->run_end) {
+            // Inside a known-contiguous run: no FAT lookup
+            next = file->cluster + 1;
+        } else {
+            next = fat_table_get(file->cluster);
+
+            if(fat_is_eoc(next)) {
+                if(!allocate) {
+                    return 1;
+                }
+
+                next = fat_allocate(file->cluster, FAT_PREALLOC_CLUSTERS, &count);
+                if(next == 0) {
+                    return 1;
+                }
+
+                if(file->cluster == file->run_end && next == file->run_end + 1) {
+                    file->run_end = next + count - 1;
+                } else {
+                    file->run_start = next;
+                    file->run_end = next + count - 1;
+                }
+            } else if(!fat_is_cluster(next)) {
+                return 1;
+            }
+        }
+
+        file->cluster = next;
+        file->cluster_index++;
+    }
+
+    return 0;
+}
+
+// Number of sectors from the current position, up to `wanted`, that are
+// contiguous on disk and already allocated
+static uint32_t fat_file_span(fat_file_t *file, uint32_t wanted){
+    uint32_t first = fat_sectors_per_cluster - (file->position / FAT_SECTOR_SIZE) % fat_sectors_per_cluster;
+    uint32_t available = first;
+    uint32_t cluster = file->cluster;
+
+    if(cluster < file->run_start || cluster > file->run_end) {
+        file->run_start = cluster;
+        file->run_end = cluster;
+    }
+
+    while(available < wanted) {
+        if(cluster >= file->run_end) {
+            if(fat_table_get(cluster) != cluster + 1) {
+                break;
+            }
+            file->run_end = cluster + 1;
+        }
+
+        cluster++;
+        available += fat_sectors_per_cluster;
+    }
+
+    return available < wanted ? available : wanted;
+}
+
+// After a direct transfer of `sectors`, points the cache at the cluster
+// holding the last one; the run guarantees they are consecutive
+static void fat_file_advance(fat_file_t *file, uint32_t sectors){
+    uint32_t last = (file->position / FAT_SECTOR_SIZE) % fat_sectors_per_cluster + sectors - 1;
+
+    file->cluster += last / fat_sectors_per_cluster;
+    file->cluster_index += last / fat_sectors_per_cluster;
+}
+
+static uint32_t fat_file_sector(const fat_file_t *file){
+    return fat_cluster_sector(file->cluster) + (file->position / FAT_SECTOR_SIZE) % fat_sectors_per_cluster;
+}
+
+static uint8_t fat_file_flush_buffer(fat_file_t *file){
+    if(file->state & FAT_STATE_BUFFER_DIRTY) {
+        if(fat_dev->write(fat_dev, file->buffer_sector, file->buffer, 1) != 0) {
+            return 1;
+        }
+        file->state &= ~FAT_STATE_BUFFER_DIRTY;
+    }
+
+    return 0;
+}
+
+static uint8_t fat_file_load_buffer(fat_file_t *file, uint32_t sector, uint8_t read){
+    if((file->state & FAT_STATE_BUFFER_VALID) && file->buffer_sector == sector) {
+        return 0;
+    }
+
+    if(fat_file_flush_buffer(file) != 0) {
+        return 1;
+    }
+
+    file->state &= ~FAT_STATE_BUFFER_VALID;
+
+    if(read) {
+        if(fat_dev->read(fat_dev, sector, file->buffer, 1) != 0) {
+            return 1;
+        }
+    } else {
+        memset(file->buffer, 0, FAT_SECTOR_SIZE);
+    }
+
+    file->buffer_sector = sector;
+    file->state |= FAT_STATE_BUFFER_VALID;
+
+    return 0;
+}
+
+uint8_t fat_open(fat_file_t *file, const char *path, uint8_t mode){
+    uint8_t name[11];
+    uint32_t dir_cluster, sector, time;
+    uint16_t offset;
+    uint8_t *entry;
+    uint8_t result;
+
+    file->mode = 0;
+    file->state = 0;
+
+    if(!fat_dev || fat_resolve(path, &dir_cluster, name) != 0) {
+        return 1;
+    }
+
+    result = fat_dir_find(dir_cluster, name, &sector, &offset);
+    if(result == FAT_ERROR) {
+        return 1;
+    }
+
+    if(result == FAT_NOT_FOUND) {
+        if(!(mode & FAT_CREATE) || !(mode & FAT_WRITE) || fat_dir_allocate(dir_cluster, &sector, &offset) != 0) {
+            return 1;
+        }
+
+        time = fat_now();
+        entry = &fat_dir_cache[offset];
+        memset(entry, 0, FAT_ENTRY_SIZE);
+        memcpy(entry, name, 11);
+        entry[11] = FAT_ATTR_ARCHIVE;
+        fat_put16(entry + 14, time);
+        fat_put16(entry + 16, time >> 16);
+        fat_put16(entry + 18, time >> 16);
+        fat_put16(entry + 22, time);
+        fat_put16(entry + 24, time >> 16);
+        fat_dir_dirty = 1;
+    }
+
+    entry = &fat_dir_cache[offset];
+    if((entry[11] & (FAT_ATTR_DIRECTORY | FAT_ATTR_VOLUME)) ||
+       ((mode & FAT_WRITE) && (entry[11] & FAT_ATTR_READ_ONLY))) {
+        return 1;
+    }
+
+    file->size = fat_get32(entry + 28);
+    file->position = 0;
+    file->first_cluster = fat_entry_cluster(entry);
+    file->cluster = 0;
+    file->cluster_index = 0;
+    file->run_start = 0;
+    file->run_end = 0;
+    file->entry_sector = sector;
+    file->entry_offset = offset;
+    file->buffer_sector = FAT_NO_SECTOR;
+    file->mode = mode;
+
+    if((mode & FAT_TRUNCATE) && (mode & FAT_WRITE) && file->first_cluster) {
+        if(fat_free_chain(file->first_cluster) != 0) {
+            file->mode = 0;
+            return 1;
+        }
+        file->first_cluster = 0;
+        file->size = 0;
+        file->state |= FAT_STATE_ENTRY_DIRTY;
+    }
+
+    if(mode & FAT_APPEND) {
+        file->position = file->size;
+    }
+
+    return 0;
+}
+
+uint8_t fat_read(fat_file_t *file, void *data, uint32_t length, uint32_t *read){
+    uint8_t *out = data;
+    uint32_t chunk, sectors, offset;
+
+    *read = 0;
+
+    if(!(file->mode & FAT_READ)) {
+        return 1;
+    }
+
+    if(length > file->size - file->position) {
+        length = file->size - file->position;
+    }
+
+    while(length) {
+        if(fat_file_seek_cluster(file, file->position / fat_cluster_bytes(), 0) != 0) {
+            return 1;
+        }
+
+        offset = file->position % FAT_SECTOR_SIZE;
+
+        if(offset == 0 && length >= FAT_SECTOR_SIZE) {
+            // Whole sectors go straight into the caller's buffer, as many
+            // per device call as the cluster run allows
+            sectors = fat_file_span(file, length / FAT_SECTOR_SIZE);
+            if(fat_file_flush_buffer(file) != 0 ||
+               fat_dev->read(fat_dev, fat_file_sector(file), out, sectors) != 0) {
+                return 1;
+            }
+            fat_file_advance(file, sectors);
+            chunk = sectors * FAT_SECTOR_SIZE;
+        } else {
+            if(fat_file_load_buffer(file, fat_file_sector(file), 1) != 0) {
+                return 1;
+            }
+            chunk = FAT_SECTOR_SIZE - offset;
+            if(chunk > length) {
+                chunk = length;
+            }
+            memcpy(out, &file->buffer[offset], chunk);
+        }
+
+        file->position += chunk;
+        out += chunk;
+        *read += chunk;
+        length -= chunk;
+    }
+
+    return 0;
+}
+
+uint8_t fat_write(fat_file_t *file, const void *data, uint32_t length){
+    const uint8_t *in = data;
+    uint32_t chunk, sectors, offset, sector;
+
+    if(!(file->mode & FAT_WRITE)) {
+        return 1;
+    }
+
+    while(length) {
+        if(fat_file_seek_cluster(file, file->position / fat_cluster_bytes(), 1) != 0) {
+            return 1;
+        }
+
+        offset = file->position % FAT_SECTOR_SIZE;
+        sector = fat_file_sector(file);
+
+        if(offset == 0 && length >= FAT_SECTOR_SIZE) {
+            sectors = fat_file_span(file, length / FAT_SECTOR_SIZE);
+
+            // The buffered copy is about to be overwritten
+            if((file->state & FAT_STATE_BUFFER_VALID) && file->buffer_sector - sector < sectors) {
+                file->state &= ~(FAT_STATE_BUFFER_VALID | FAT_STATE_BUFFER_DIRTY);
+            }
+
+            if(fat_dev->write(fat_dev, sector, in, sectors) != 0) {
+                return 1;
+            }
+            fat_file_advance(file, sectors);
+            chunk = sectors * FAT_SECTOR_SIZE;
+        } else {
+            // Sectors wholly past the end of the file have nothing worth reading
+            if(fat_file_load_buffer(file, sector, file->position - offset < file->size) != 0) {
+                return 1;
+            }
+            chunk = FAT_SECTOR_SIZE - offset;
+            if(chunk > length) {
+                chunk = length;
+            }
+            memcpy(&file->buffer[offset], in, chunk);
+            file->state |= FAT_STATE_BUFFER_DIRTY;
+        }
+
+        file->position += chunk;
+        in += chunk;
+        length -= chunk;
+
+        if(file->position > file->size) {
+            file->size = file->position;
+        }
+        file->state |= FAT_STATE_ENTRY_DIRTY;
+    }
+
+    return 0;
+}
+
+uint8_t fat_seek(fat_file_t *file, uint32_t position){
+    if(!file->mode || position > file->size) {
+        return 1;
+    }
+
+    // The chain is followed lazily on the next read or write
+    file->position = position;
+
+    return 0;
+}
+
+static uint8_t fat_file_update_entry(fat_file_t *file){
+    uint32_t time;
+    uint8_t *entry;
+
+    if(!(file->state & FAT_STATE_ENTRY_DIRTY)) {
+        return 0;
+    }
+
+    if(fat_dir_load(file->entry_sector) != 0) {
+        return 1;
+    }
+
+    time = fat_now();
+    entry = &fat_dir_cache[file->entry_offset];
+    entry[11] |= FAT_ATTR_ARCHIVE;
+    fat_put16(entry + 20, file->first_cluster >> 16);
+    fat_put16(entry + 22, time);
+    fat_put16(entry + 24, time >> 16);
+    fat_put16(entry + 26, file->first_cluster);
+    fat_put32(entry + 28, file->size);
+    fat_dir_dirty = 1;
+
+    file->state &= ~FAT_STATE_ENTRY_DIRTY;
+
+    return 0;
+}
+
+// FSInfo is only a hint; mark the free count unknown rather than keep it
+static uint8_t fat_fsinfo_flush(void){
+    if(!fat_fsinfo_dirty || fat_fsinfo_sector == FAT_NO_SECTOR) {
+        return 0;
+    }
+
+    if(fat_dir_load(fat_fsinfo_sector) != 0) {
+        return 1;
+    }
+
+    fat_put32(&fat_dir_cache[488], 0xFFFFFFFF);
+    fat_put32(&fat_dir_cache[492], fat_free_hint);
+    fat_dir_dirty = 1;
+    fat_fsinfo_dirty = 0;
+
+    return 0;
+}
+
+static uint8_t fat_flush_volume(void){
+    if(fat_fsinfo_flush() != 0 || fat_dir_flush() != 0 || fat_table_flush() != 0) {
+        return 1;
+    }
+
+    return fat_dev->sync(fat_dev);
+}
+
+uint8_t fat_sync(fat_file_t *file){
+    if(!file->mode) {
+        return 1;
+    }
+
+    if(fat_file_flush_buffer(file) != 0 || fat_file_update_entry(file) != 0) {
+        return 1;
+    }
+
+    return fat_flush_volume();
+}
+
+// Releases preallocated clusters past the end of the file
+static uint8_t fat_file_trim(fat_file_t *file){
+    uint32_t needed, next;
+
+    if(file->first_cluster == 0) {
+        return 0;
+    }
+
+    needed = (file->size + fat_cluster_bytes() - 1) / fat_cluster_bytes();
+
+    if(needed == 0) {
+        if(fat_free_chain(file->first_cluster) != 0) {
+            return 1;
+        }
+        file->first_cluster = 0;
+        file->cluster = 0;
+        file->state |= FAT_STATE_ENTRY_DIRTY;
+        return 0;
+    }
+
+    if(fat_file_seek_cluster(file, needed - 1, 0) != 0) {
+        return 1;
+    }
+
+    next = fat_table_get(file->cluster);
+    if(fat_is_eoc(next)) {
+        return 0;
+    }
+
+    if(fat_table_set(file->cluster, fat_eoc()) != 0) {
+        return 1;
+    }
+
+    file->run_start = file->cluster;
+    file->run_end = file->cluster;
+
+    return fat_free_chain(next);
+}
+
+uint8_t fat_close(fat_file_t *file){
+    uint8_t error = 0;
+
+    if(!file->mode) {
+        return 1;
+    }
+
+    // The directory entry is written even if the trim failed
+    if(file->mode & FAT_WRITE) {
+        error = fat_file_trim(file);
+        error |= fat_sync(file);
+    }
+
+    file->mode = 0;
+    file->state = 0;
+
+    return error;
+}
+
+uint8_t fat_remove(const char *path){
+    uint8_t name[11];
+    uint32_t dir_cluster, sector;
+    uint16_t offset;
+    uint8_t *entry;
+
+    if(!fat_dev || fat_resolve(path, &dir_cluster, name) != 0 ||
+       fat_dir_find(dir_cluster, name, &sector, &offset) != FAT_FOUND) {
+        return 1;
+    }
+
+    entry = &fat_dir_cache[offset];
+    if(entry[11] & (FAT_ATTR_DIRECTORY | FAT_ATTR_VOLUME | FAT_ATTR_READ_ONLY)) {
+        return 1;
+    }
+
+    entry[0] = FAT_ENTRY_FREE;
+    fat_dir_dirty = 1;
+
+    if(fat_free_chain(fat_entry_cluster(entry)) != 0) {
+        return 1;
+    }
+
+    return fat_flush_volume();
+}
@@ -0,0 +1,78 @@
+#ifndef FAT_H
+#define FAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+#include "blockdev.h"
+
+#define FAT_SECTOR_SIZE 512
+
+// Clusters reserved per allocation when a file grows. Appends then run
+// through contiguous clusters without touching the FAT; the unused tail is
+// released on close.
+#ifndef FAT_PREALLOC_CLUSTERS
+#define FAT_PREALLOC_CLUSTERS 16
+#endif
+
+#define FAT_TYPE_FAT12 12
+#define FAT_TYPE_FAT16 16
+#define FAT_TYPE_FAT32 32
+
+// Open modes
+#define FAT_READ     0x01
+#define FAT_WRITE    0x02
+#define FAT_CREATE   0x04 // Create the file if it does not exist
+#define FAT_TRUNCATE 0x08
+#define FAT_APPEND   0x10 // Start at the end of the file
+
+// Caller-owned open file, including its sector buffer, so any number of
+// files can be open without a heap. Fields are private to the driver.
+typedef struct {
+    uint32_t size;
+    uint32_t position;
+    uint32_t first_cluster;
+
+    // Cluster-chain cache: the cluster holding the current position and a
+    // known-contiguous run around it, so sequential access and appends
+    // never walk the chain
+    uint32_t cluster;
+    uint32_t cluster_index;
+    uint32_t run_start;
+    uint32_t run_end;
+
+    uint32_t entry_sector;      // Directory entry location
+    uint16_t entry_offset;
+    uint8_t mode;
+    uint8_t state;
+
+    uint32_t buffer_sector;
+    uint8_t buffer[FAT_SECTOR_SIZE];
+} fat_file_t;
+
+// Single volume on a block device with 512-byte blocks, either a bare
+// filesystem or the first partition of an MBR. Names are 8.3 only;
+// directories in paths must already exist. Thread context only.
+uint8_t fat_mount(const blockdev_t *dev);
+uint8_t fat_get_type(void);
+uint32_t fat_get_cluster_size(void);
+
+// Date and time for new and modified entries, packed as in FatFs:
+// year-1980 << 25 | month << 21 | day << 16 | hour << 11 | minute << 5 | second / 2
+void fat_set_time_source(uint32_t (*get_time)(void));
+
+uint8_t fat_open(fat_file_t *file, const char *path, uint8_t mode);
+uint8_t fat_read(fat_file_t *file, void *data, uint32_t length, uint32_t *read);
+uint8_t fat_write(fat_file_t *file, const void *data, uint32_t length);
+uint8_t fat_seek(fat_file_t *file, uint32_t position);
+uint8_t fat_sync(fat_file_t *file);
+uint8_t fat_close(fat_file_t *file);
+uint8_t fat_remove(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
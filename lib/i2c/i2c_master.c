@@ -0,0 +1,453 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "ch32v10x_dma.h"
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_i2c.h"
+#include "ch32v10x_misc.h"
+#include "ch32v10x_rcc.h"
+#include "debug.h"
+
+#include "irq_dispatch.h"
+#include "i2c_master.h"
+#include "timebase.h"
+
+#define I2C_MASTER_TX_DMA DMA1_Channel6
+#define I2C_MASTER_RX_DMA DMA1_Channel7
+
+#define I2C_MASTER_ERRORS (I2C_STAR1_BERR | I2C_STAR1_ARLO | I2C_STAR1_AF | I2C_STAR1_OVR)
+#define I2C_MASTER_IRQS   (I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITERREN | I2C_CTLR2_DMAEN | I2C_CTLR2_LAST)
+
+#define I2C_MASTER_SCL GPIO_Pin_6
+#define I2C_MASTER_SDA GPIO_Pin_7
+
+// Half a clock period for bus recovery, 100 kHz
+#define I2C_MASTER_RECOVERY_HALF_US 5
+
+static i2c_transaction_t *volatile i2c_master_head = NULL;
+static i2c_transaction_t *i2c_master_tail = NULL;
+
+static uint32_t i2c_master_clock_speed;
+static uint32_t i2c_master_byte_us;
+static uint32_t i2c_master_deadline;
+static i2c_master_stats_t i2c_master_stats;
+
+// Set while the active transaction is in its read phase
+static volatile uint8_t i2c_master_reading = 0;
+
+// Set while the active transaction waits for the previous STOP to go out
+static volatile uint8_t i2c_master_start_pending = 0;
+
+// Arms the RX DMA and generates a START, or a repeated START straight
+// after a write phase
+static void i2c_master_start_read(i2c_transaction_t *transaction){
+    i2c_master_reading = 1;
+
+    I2C_MASTER_RX_DMA->MADDR = (uint32_t)transaction->rx_buffer;
+    I2C_MASTER_RX_DMA->CNTR = transaction->rx_length;
+    I2C_MASTER_RX_DMA->CFGR |= DMA_CFGR1_EN;
+
+    // A single byte is NACKed by clearing ACK before ADDR is cleared;
+    // longer reads let the DMA end-of-transfer NACK the last byte
+    if(transaction->rx_length == 1) {
+        I2C1->CTLR1 &= ~I2C_CTLR1_ACK;
+        I2C1->CTLR2 &= ~I2C_CTLR2_LAST;
+    } else {
+        I2C1->CTLR1 |= I2C_CTLR1_ACK;
+        I2C1->CTLR2 |= I2C_CTLR2_LAST;
+    }
+
+    I2C1->CTLR1 |= I2C_CTLR1_START;
+}
+
+// Called from interrupts and under the lock, so it never waits: a START
+// requested while the previous STOP is still going out would be lost, and
+// the master raises no event once the STOP is on the bus. The transaction
+// is left pending for i2c_master_poll() to start instead.
+static void i2c_master_start(i2c_transaction_t *transaction){
+    uint32_t bytes = transaction->tx_length + transaction->rx_length + 2;
+
+    transaction->status = I2C_TRANSACTION_ACTIVE;
+    transaction->error = I2C_ERROR_NONE;
+
+    // Twice the time on the wire plus room for clock stretching. A STOP
+    // the bus never releases runs into it too, and recovery frees the bus.
+    i2c_master_deadline = timebase_deadline_us(bytes * i2c_master_byte_us * 2 + I2C_MASTER_TIMEOUT_US);
+
+    // The previous STOP takes about half a bit time to appear on the bus
+    if(I2C1->CTLR1 & I2C_CTLR1_STOP) {
+        i2c_master_start_pending = 1;
+        return;
+    }
+
+    i2c_master_start_pending = 0;
+
+    I2C1->CTLR2 |= I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITERREN | I2C_CTLR2_DMAEN;
+
+    if(transaction->tx_length == 0 && transaction->rx_length != 0) {
+        i2c_master_start_read(transaction);
+        return;
+    }
+
+    i2c_master_reading = 0;
+
+    if(transaction->tx_length) {
+        I2C_MASTER_TX_DMA->MADDR = (uint32_t)transaction->tx_buffer;
+        I2C_MASTER_TX_DMA->CNTR = transaction->tx_length;
+        I2C_MASTER_TX_DMA->CFGR |= DMA_CFGR1_EN;
+    }
+
+    I2C1->CTLR1 |= I2C_CTLR1_START;
+}
+
+// Ends the active transaction and starts the next one before running the
+// callback, so the bus idles as little as possible; behind a STOP that has
+// not gone out yet, the next one waits for i2c_master_poll()
+static void i2c_master_finish(uint8_t error){
+    i2c_transaction_t *done = i2c_master_head;
+
+    i2c_master_start_pending = 0;
+    I2C1->CTLR2 &= ~I2C_MASTER_IRQS;
+    I2C_MASTER_TX_DMA->CFGR &= ~DMA_CFGR1_EN;
+    I2C_MASTER_RX_DMA->CFGR &= ~DMA_CFGR1_EN;
+
+    i2c_master_head = done->next;
+
+    if(i2c_master_head) {
+        i2c_master_start(i2c_master_head);
+    } else {
+        i2c_master_tail = NULL;
+    }
+
+    done->next = NULL;
+    done->error = error;
+    done->status = error == I2C_ERROR_NONE ? I2C_TRANSACTION_DONE : I2C_TRANSACTION_FAILED;
+
+    if(done->callback) {
+        done->callback(done);
+    }
+}
+
+static void i2c_master_ev_irq_handler(void){
+    i2c_transaction_t *transaction = i2c_master_head;
+    uint16_t star1 = I2C1->STAR1;
+
+    if(transaction == NULL) {
+        I2C1->CTLR2 &= ~I2C_MASTER_IRQS;
+        return;
+    }
+
+    if(star1 & I2C_STAR1_SB) {
+        // Reading STAR1 then writing DATAR clears SB
+        I2C1->DATAR = transaction->address | (i2c_master_reading ? 0x01 : 0x00);
+    } else if(star1 & I2C_STAR1_ADDR) {
+        // Reading STAR2 clears ADDR and lets the data phase start
+        (void)I2C1->STAR2;
+
+        if(i2c_master_reading) {
+            if(transaction->rx_length == 1) {
+                I2C1->CTLR1 |= I2C_CTLR1_STOP;
+            }
+        } else if(transaction->tx_length == 0) {
+            I2C1->CTLR1 |= I2C_CTLR1_STOP;
+            i2c_master_finish(I2C_ERROR_NONE);
+        }
+    } else if(star1 & I2C_STAR1_BTF) {
+        // The DMA has handed over the last byte and it has been shifted out
+        if(i2c_master_reading || I2C_MASTER_TX_DMA->CNTR != 0) {
+            return;
+        }
+
+        I2C_MASTER_TX_DMA->CFGR &= ~DMA_CFGR1_EN;
+
+        if(transaction->rx_length) {
+            // Repeated START; reading DATAR clears BTF so the interrupt
+            // does not fire again before SB
+            i2c_master_start_read(transaction);
+            (void)I2C1->DATAR;
+        } else {
+            I2C1->CTLR1 |= I2C_CTLR1_STOP;
+            i2c_master_finish(I2C_ERROR_NONE);
+        }
+    }
+}
+
+static void i2c_master_er_irq_handler(void){
+    uint16_t star1 = I2C1->STAR1;
+    uint8_t error;
+
+    // Error flags clear by writing 0
+    I2C1->STAR1 = (uint16_t)~(star1 & I2C_MASTER_ERRORS);
+
+    if(i2c_master_head == NULL) {
+        return;
+    }
+
+    if(star1 & I2C_STAR1_ARLO) {
+        // The interface has already dropped back to slave mode
+        error = I2C_ERROR_ARBITRATION;
+        i2c_master_stats.arbitration_lost++;
+    } else if(star1 & I2C_STAR1_AF) {
+        error = I2C_ERROR_NACK;
+        i2c_master_stats.nacks++;
+        I2C1->CTLR1 |= I2C_CTLR1_STOP;
+    } else {
+        error = I2C_ERROR_BUS;
+        i2c_master_stats.bus_errors++;
+        I2C1->CTLR1 |= I2C_CTLR1_STOP;
+    }
+
+    i2c_master_finish(error);
+}
+
+// With LAST set the hardware has NACKed the final byte; the STOP goes out
+// once it has been stored
+static void i2c_master_rx_irq_handler(void){
+    if(DMA_GetITStatus(DMA1_IT_TC7) == RESET) {
+        return;
+    }
+
+    DMA_ClearITPendingBit(DMA1_IT_GL7);
+
+    if(i2c_master_head == NULL) {
+        return;
+    }
+
+    if(i2c_master_head->rx_length != 1) {
+        I2C1->CTLR1 |= I2C_CTLR1_STOP;
+    }
+
+    i2c_master_finish(I2C_ERROR_NONE);
+}
+
+static void i2c_master_configure(void){
+    I2C_InitTypeDef I2C_InitStructure;
+
+    I2C_InitStructure.I2C_ClockSpeed = i2c_master_clock_speed;
+    I2C_InitStructure.I2C_Mode = I2C_Mode_I2C;
+    I2C_InitStructure.I2C_DutyCycle = I2C_DutyCycle_2;
+    I2C_InitStructure.I2C_OwnAddress1 = 0x30;
+    I2C_InitStructure.I2C_Ack = I2C_Ack_Enable;
+    I2C_InitStructure.I2C_AcknowledgedAddress = I2C_AcknowledgedAddress_7bit;
+    I2C_Init(I2C1, &I2C_InitStructure);
+
+    I2C_Cmd(I2C1, ENABLE);
+}
+
+static void i2c_master_set_pins(GPIOMode_TypeDef mode){
+    GPIO_InitTypeDef GPIO_InitStructure;
+
+    GPIO_InitStructure.GPIO_Pin = I2C_MASTER_SCL | I2C_MASTER_SDA;
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+    GPIO_InitStructure.GPIO_Mode = mode;
+    GPIO_Init(GPIOB, &GPIO_InitStructure);
+}
+
+// Takes the pins over as open-drain GPIO and clocks SCL until a slave
+// stuck mid-byte lets go of SDA (at most 9 clocks), then sends a STOP.
+// Returns 1 if either line is still held low afterwards.
+static uint8_t i2c_master_bus_clear(void){
+    uint8_t released;
+
+    GPIOB->BSHR = I2C_MASTER_SCL | I2C_MASTER_SDA;
+    i2c_master_set_pins(GPIO_Mode_Out_OD);
+    Delay_Us(I2C_MASTER_RECOVERY_HALF_US);
+
+    for(uint8_t pulse = 0; pulse < 9 && !(GPIOB->INDR & I2C_MASTER_SDA); pulse++) {
+        GPIOB->BCR = I2C_MASTER_SCL;
+        Delay_Us(I2C_MASTER_RECOVERY_HALF_US);
+        GPIOB->BSHR = I2C_MASTER_SCL;
+        Delay_Us(I2C_MASTER_RECOVERY_HALF_US);
+    }
+
+    // STOP: SDA rises while SCL is high
+    GPIOB->BCR = I2C_MASTER_SCL;
+    Delay_Us(I2C_MASTER_RECOVERY_HALF_US);
+    GPIOB->BCR = I2C_MASTER_SDA;
+    Delay_Us(I2C_MASTER_RECOVERY_HALF_US);
+    GPIOB->BSHR = I2C_MASTER_SCL;
+    Delay_Us(I2C_MASTER_RECOVERY_HALF_US);
+    GPIOB->BSHR = I2C_MASTER_SDA;
+    Delay_Us(I2C_MASTER_RECOVERY_HALF_US);
+
+    released = (GPIOB->INDR & (I2C_MASTER_SCL | I2C_MASTER_SDA)) == (I2C_MASTER_SCL | I2C_MASTER_SDA);
+
+    i2c_master_set_pins(GPIO_Mode_AF_OD);
+
+    return released ? 0 : 1;
+}
+
+uint8_t i2c_master_recover(void){
+    uint32_t start = timebase_us();
+    uint8_t result;
+
+    I2C_Cmd(I2C1, DISABLE);
+    result = i2c_master_bus_clear();
+
+    // The peripheral may still believe the bus is busy; a software reset
+    // clears every register, so it is set up again from scratch
+    I2C_SoftwareResetCmd(I2C1, ENABLE);
+    I2C_SoftwareResetCmd(I2C1, DISABLE);
+    i2c_master_configure();
+
+    i2c_master_stats.recoveries++;
+    if(result != 0) {
+        i2c_master_stats.recovery_failures++;
+    }
+    i2c_master_stats.last_recovery_us = timebase_us() - start;
+
+    return result;
+}
+
+void i2c_master_init(uint32_t clock_speed){
+    DMA_InitTypeDef DMA_InitStructure;
+    NVIC_InitTypeDef NVIC_InitStructure;
+
+    i2c_master_head = NULL;
+    i2c_master_tail = NULL;
+    i2c_master_start_pending = 0;
+    i2c_master_clock_speed = clock_speed;
+    i2c_master_byte_us = 9 * 1000000 / clock_speed + 1;
+    memset(&i2c_master_stats, 0, sizeof(i2c_master_stats));
+
+    // Enable clocks
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOB | RCC_APB2Periph_AFIO, ENABLE);
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_I2C1, ENABLE);
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+
+    // Configure I2C pins (PB6 - SCL, PB7 - SDA)
+    i2c_master_set_pins(GPIO_Mode_AF_OD);
+
+    // Configure DMA for I2C TX (Channel 6); addresses and lengths are set per transaction
+    DMA_DeInit(I2C_MASTER_TX_DMA);
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&I2C1->DATAR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = 0;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+    DMA_InitStructure.DMA_BufferSize = 0;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(I2C_MASTER_TX_DMA, &DMA_InitStructure);
+
+    // Configure DMA for I2C RX (Channel 7)
+    DMA_DeInit(I2C_MASTER_RX_DMA);
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+    DMA_Init(I2C_MASTER_RX_DMA, &DMA_InitStructure);
+
+    DMA_ITConfig(I2C_MASTER_RX_DMA, DMA_IT_TC, ENABLE);
+
+    // A slave left mid-byte by a reset may still be holding SDA
+    i2c_master_bus_clear();
+
+    I2C_DeInit(I2C1);
+    i2c_master_configure();
+
+    // Configure NVIC; all three share a priority so they never nest
+    irq_attach(I2C1_EV_IRQn, i2c_master_ev_irq_handler);
+    irq_attach(I2C1_ER_IRQn, i2c_master_er_irq_handler);
+    irq_attach(DMA1_Channel7_IRQn, i2c_master_rx_irq_handler);
+
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 1;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_InitStructure.NVIC_IRQChannel = I2C1_EV_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
+    NVIC_InitStructure.NVIC_IRQChannel = I2C1_ER_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
+    NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel7_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
+
+}
+
+uint8_t i2c_master_submit(i2c_transaction_t *transaction){
+    uint32_t irq_state;
+
+    irq_state = irq_lock();
+
+    if(transaction->status == I2C_TRANSACTION_QUEUED || transaction->status == I2C_TRANSACTION_ACTIVE) {
+        irq_unlock(irq_state);
+        return 1;
+    }
+
+    transaction->status = I2C_TRANSACTION_QUEUED;
+    transaction->next = NULL;
+
+    if(i2c_master_tail) {
+        i2c_master_tail->next = transaction;
+        i2c_master_tail = transaction;
+    } else {
+        i2c_master_head = transaction;
+        i2c_master_tail = transaction;
+        i2c_master_start(transaction);
+    }
+
+    irq_unlock(irq_state);
+
+    return 0;
+}
+
+void i2c_master_poll(void){
+    i2c_transaction_t *transaction;
+    uint32_t irq_state = irq_lock();
+
+    transaction = i2c_master_head;
+    if(transaction == NULL || transaction->status != I2C_TRANSACTION_ACTIVE) {
+        irq_unlock(irq_state);
+        return;
+    }
+
+    // Start a transaction held back behind a STOP that has now gone out
+    if(i2c_master_start_pending && !(I2C1->CTLR1 & I2C_CTLR1_STOP)) {
+        i2c_master_start(transaction);
+        irq_unlock(irq_state);
+        return;
+    }
+
+    if(!timebase_expired(i2c_master_deadline)) {
+        irq_unlock(irq_state);
+        return;
+    }
+
+    // Silence the engine; submissions meanwhile only join the queue. A read
+    // that completed just now must not finish the transaction behind our
+    // back, so its DMA interrupt is dropped and masked for the recovery.
+    I2C1->CTLR2 &= ~I2C_MASTER_IRQS;
+    I2C_MASTER_TX_DMA->CFGR &= ~DMA_CFGR1_EN;
+    I2C_MASTER_RX_DMA->CFGR &= ~(DMA_CFGR1_EN | DMA_IT_TC);
+    DMA_ClearITPendingBit(DMA1_IT_GL7);
+    irq_unlock(irq_state);
+
+    i2c_master_stats.timeouts++;
+    i2c_master_recover();
+
+    irq_state = irq_lock();
+    I2C_MASTER_RX_DMA->CFGR |= DMA_IT_TC;
+
+    // An event already latched when the engine was silenced may have
+    // ended it meanwhile
+    if(i2c_master_head == transaction) {
+        i2c_master_finish(I2C_ERROR_TIMEOUT);
+    }
+
+    irq_unlock(irq_state);
+}
+
+uint8_t i2c_master_wait(i2c_transaction_t *transaction){
+    while(transaction->status == I2C_TRANSACTION_QUEUED || transaction->status == I2C_TRANSACTION_ACTIVE) {
+        i2c_master_poll();
+    }
+
+    return transaction->status == I2C_TRANSACTION_DONE ? 0 : 1;
+}
+
+uint8_t i2c_master_is_idle(void){
+    return i2c_master_head == NULL;
+}
+
+const i2c_master_stats_t *i2c_master_get_stats(void){
+    return &i2c_master_stats;
+}
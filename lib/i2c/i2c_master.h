@@ -0,0 +1,93 @@
+#ifndef I2C_MASTER_H
+#define I2C_MASTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+
+#define I2C_TRANSACTION_IDLE   0
+#define I2C_TRANSACTION_QUEUED 1
+#define I2C_TRANSACTION_ACTIVE 2
+#define I2C_TRANSACTION_DONE   3
+#define I2C_TRANSACTION_FAILED 4
+
+#define I2C_ERROR_NONE        0
+#define I2C_ERROR_NACK        1 // Address or data not acknowledged
+#define I2C_ERROR_ARBITRATION 2
+#define I2C_ERROR_BUS         3 // Misplaced START or STOP
+#define I2C_ERROR_TIMEOUT     4 // Deadline passed; the bus has been recovered
+
+// Slack on top of twice the transfer's time on the wire before a
+// transaction is declared stuck
+#ifndef I2C_MASTER_TIMEOUT_US
+#define I2C_MASTER_TIMEOUT_US 2000
+#endif
+
+typedef struct i2c_transaction i2c_transaction_t;
+typedef void (*i2c_transaction_callback_t)(i2c_transaction_t *transaction);
+
+// Owned by the caller and linked into the queue in place, like an SPI
+// queue transaction. Writes tx_length bytes, then reads rx_length bytes
+// after a repeated START if both are set (a register read); with both zero
+// it only checks that the address is acknowledged. Leave it untouched until
+// the callback runs or status reads DONE or FAILED.
+struct i2c_transaction {
+    uint8_t address;            // 8-bit bus address as for I2C_Send7bitAddress(), e.g. 0xA0
+    const uint8_t *tx_buffer;
+    uint16_t tx_length;
+    uint8_t *rx_buffer;
+    uint16_t rx_length;
+    i2c_transaction_callback_t callback; // Runs in interrupt context, may submit more work
+    void *context;
+
+    volatile uint8_t status;
+    volatile uint8_t error;
+    i2c_transaction_t *next;
+};
+
+// I2C1 master on PB6 (SCL), PB7 (SDA) with DMA1 channels 6/7, which
+// USART2 cannot use at the same time. Every phase runs from the I2C1 event
+// and error interrupts and the RX DMA interrupt.
+void i2c_master_init(uint32_t clock_speed);
+
+// Safe from thread and interrupt context. Returns 1 if the transaction is
+// already queued.
+uint8_t i2c_master_submit(i2c_transaction_t *transaction);
+
+// Starts a transaction that was queued behind a STOP still going out, and
+// expires the active transaction once its deadline has passed: the bus is
+// recovered and the transaction fails with I2C_ERROR_TIMEOUT. Nothing else
+// watches the clock or the STOP, so call this from the main loop or while
+// waiting.
+void i2c_master_poll(void);
+
+// Polls until the transaction finishes; returns 1 unless it succeeded.
+// Thread context only.
+uint8_t i2c_master_wait(i2c_transaction_t *transaction);
+
+uint8_t i2c_master_is_idle(void);
+
+typedef struct {
+    uint32_t nacks;
+    uint32_t arbitration_lost;
+    uint32_t bus_errors;
+    uint32_t timeouts;
+    uint32_t recoveries;
+    uint32_t recovery_failures; // SDA or SCL still low after recovery
+    uint32_t last_recovery_us;
+} i2c_master_stats_t;
+
+// Frees a bus held by a slave stuck mid-byte: up to 9 clocks on SCL as
+// GPIO, a STOP, then a peripheral software reset and re-init. Runs
+// automatically on timeouts; returns 1 if a line is still held low.
+uint8_t i2c_master_recover(void);
+
+const i2c_master_stats_t *i2c_master_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
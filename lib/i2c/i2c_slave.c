@@ -0,0 +1,244 @@
+#include <string.h>
+
+#include "ch32v10x_dma.h"
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_i2c.h"
+#include "ch32v10x_misc.h"
+#include "ch32v10x_rcc.h"
+
+#include "irq_dispatch.h"
+#include "i2c_slave.h"
+
+#define I2C_SLAVE_TX_DMA DMA1_Channel4
+#define I2C_SLAVE_RX_DMA DMA1_Channel5
+
+#define I2C_SLAVE_ERRORS (I2C_STAR1_BERR | I2C_STAR1_ARLO | I2C_STAR1_AF | I2C_STAR1_OVR)
+
+static i2c_slave_config_t i2c_slave_config;
+static i2c_slave_stats_t i2c_slave_stats;
+
+// Pointer byte followed by the data of one master write
+static uint8_t i2c_slave_staging[1 + I2C_SLAVE_MAX_REGISTERS];
+
+static uint8_t i2c_slave_pointer = 0;
+static uint8_t i2c_slave_reading = 0;
+
+// TX DMA progress: the register the channel was armed at, bytes it moved in
+// passes that already wrapped, and the length of the current pass
+static uint8_t i2c_slave_tx_start = 0;
+static uint16_t i2c_slave_tx_wrapped = 0;
+static uint8_t i2c_slave_tx_armed = 0;
+
+static void i2c_slave_arm_rx(void){
+    I2C_SLAVE_RX_DMA->CFGR &= ~DMA_CFGR1_EN;
+    I2C_SLAVE_RX_DMA->MADDR = (uint32_t)i2c_slave_staging;
+    I2C_SLAVE_RX_DMA->CNTR = i2c_slave_config.size + 1;
+    I2C_SLAVE_RX_DMA->CFGR |= DMA_CFGR1_EN;
+}
+
+static void i2c_slave_arm_tx(void){
+    I2C_SLAVE_TX_DMA->CFGR &= ~DMA_CFGR1_EN;
+
+    i2c_slave_tx_start = i2c_slave_pointer;
+    i2c_slave_tx_wrapped = 0;
+    i2c_slave_tx_armed = i2c_slave_config.size - i2c_slave_pointer;
+
+    I2C_SLAVE_TX_DMA->MADDR = (uint32_t)&i2c_slave_config.registers[i2c_slave_pointer];
+    I2C_SLAVE_TX_DMA->CNTR = i2c_slave_tx_armed;
+    I2C_SLAVE_TX_DMA->CFGR |= DMA_CFGR1_EN;
+}
+
+// Copies a finished master write into the map and points the TX DMA at
+// the new register pointer. Returns 0 if nothing had been received.
+static uint8_t i2c_slave_apply_write(void){
+    uint8_t size = i2c_slave_config.size;
+    uint8_t received = size + 1 - I2C_SLAVE_RX_DMA->CNTR;
+    uint8_t offset, length;
+
+    if(received == 0) {
+        return 0;
+    }
+
+    offset = i2c_slave_staging[0] % size;
+    length = received - 1;
+
+    for(uint8_t i = 0; i < length; i++) {
+        i2c_slave_config.registers[(offset + i) % size] = i2c_slave_staging[1 + i];
+    }
+
+    i2c_slave_pointer = (offset + length) % size;
+    i2c_slave_arm_rx();
+    i2c_slave_arm_tx();
+
+    if(length) {
+        i2c_slave_stats.writes++;
+        if(i2c_slave_config.on_write) {
+            i2c_slave_config.on_write(offset, length);
+        }
+    }
+
+    return 1;
+}
+
+// The read ran off the end of the map: carry on from register 0. The DMA
+// is a byte ahead, so this has a whole byte time to happen.
+static void i2c_slave_tx_irq_handler(void){
+    if((DMA1->INTFR & DMA1_IT_TC4) == 0) {
+        return;
+    }
+
+    DMA1->INTFCR = DMA1_IT_TC4;
+    I2C_SLAVE_TX_DMA->CFGR &= ~DMA_CFGR1_EN;
+
+    i2c_slave_tx_wrapped += i2c_slave_tx_armed;
+    i2c_slave_tx_armed = i2c_slave_config.size;
+
+    I2C_SLAVE_TX_DMA->MADDR = (uint32_t)i2c_slave_config.registers;
+    I2C_SLAVE_TX_DMA->CNTR = i2c_slave_tx_armed;
+    I2C_SLAVE_TX_DMA->CFGR |= DMA_CFGR1_EN;
+}
+
+static void i2c_slave_ev_irq_handler(void){
+    uint16_t star1 = I2C2->STAR1;
+    uint16_t star2;
+
+    if(star1 & I2C_STAR1_ADDR) {
+        // Pointer write then repeated START: the write is applied and the
+        // TX channel re-armed at the new pointer while ADDR still holds
+        // the bus, or the first TXE would take the old pointer's byte. A
+        // new transaction after a STOP finds nothing to apply.
+        i2c_slave_apply_write();
+
+        // Reading STAR2 after STAR1 clears ADDR
+        star2 = I2C2->STAR2;
+        i2c_slave_reading = (star2 & I2C_STAR2_TRA) != 0;
+    }
+
+    if(star1 & I2C_STAR1_STOPF) {
+        // Reading STAR1 then writing CTLR1 clears STOPF
+        I2C2->CTLR1 |= I2C_CTLR1_PE;
+        i2c_slave_apply_write();
+    }
+}
+
+static void i2c_slave_er_irq_handler(void){
+    uint16_t star1 = I2C2->STAR1;
+    uint16_t loaded;
+
+    // Error flags clear by writing 0
+    I2C2->STAR1 = (uint16_t)~(star1 & I2C_SLAVE_ERRORS);
+
+    if(star1 & I2C_STAR1_AF) {
+        // The master NACKs the byte it wants last. The DMA is a byte ahead
+        // and that byte is never sent, so the next read starts there; the
+        // channel is re-armed at it, wrapped into the map.
+        if(i2c_slave_reading) {
+            loaded = i2c_slave_tx_wrapped + i2c_slave_tx_armed - I2C_SLAVE_TX_DMA->CNTR;
+            if(loaded) {
+                i2c_slave_pointer = (i2c_slave_tx_start + loaded - 1) % i2c_slave_config.size;
+            }
+            i2c_slave_arm_tx();
+            i2c_slave_reading = 0;
+            i2c_slave_stats.reads++;
+        }
+    }
+
+    if(star1 & I2C_STAR1_OVR) {
+        i2c_slave_stats.overruns++;
+    }
+
+    if(star1 & (I2C_STAR1_BERR | I2C_STAR1_ARLO)) {
+        i2c_slave_stats.bus_errors++;
+    }
+}
+
+uint8_t i2c_slave_init(const i2c_slave_config_t *config){
+    GPIO_InitTypeDef GPIO_InitStructure;
+    I2C_InitTypeDef I2C_InitStructure;
+    DMA_InitTypeDef DMA_InitStructure;
+    NVIC_InitTypeDef NVIC_InitStructure;
+
+    if(config->size == 0 || config->size > I2C_SLAVE_MAX_REGISTERS) {
+        return 1;
+    }
+
+    i2c_slave_config = *config;
+    i2c_slave_pointer = 0;
+    i2c_slave_reading = 0;
+    memset(&i2c_slave_stats, 0, sizeof(i2c_slave_stats));
+
+    // Enable clocks
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOB | RCC_APB2Periph_AFIO, ENABLE);
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_I2C2, ENABLE);
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+
+    // Configure I2C pins (PB10 - SCL, PB11 - SDA)
+    GPIO_InitStructure.GPIO_Pin = GPIO_Pin_10 | GPIO_Pin_11;
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF_OD;
+    GPIO_Init(GPIOB, &GPIO_InitStructure);
+
+    // Configure DMA for I2C2 TX (Channel 4) and RX (Channel 5); both stay armed
+    DMA_DeInit(I2C_SLAVE_TX_DMA);
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&I2C2->DATAR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)config->registers;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+    DMA_InitStructure.DMA_BufferSize = 0;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(I2C_SLAVE_TX_DMA, &DMA_InitStructure);
+
+    DMA_DeInit(I2C_SLAVE_RX_DMA);
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)i2c_slave_staging;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+    DMA_Init(I2C_SLAVE_RX_DMA, &DMA_InitStructure);
+
+    i2c_slave_arm_rx();
+    i2c_slave_arm_tx();
+
+    DMA_ITConfig(I2C_SLAVE_TX_DMA, DMA_IT_TC, ENABLE);
+
+    // Configure I2C2 as a slave; the clock speed only sets the input filter timing
+    I2C_DeInit(I2C2);
+    I2C_InitStructure.I2C_ClockSpeed = 400000;
+    I2C_InitStructure.I2C_Mode = I2C_Mode_I2C;
+    I2C_InitStructure.I2C_DutyCycle = I2C_DutyCycle_2;
+    I2C_InitStructure.I2C_OwnAddress1 = config->address;
+    I2C_InitStructure.I2C_Ack = I2C_Ack_Enable;
+    I2C_InitStructure.I2C_AcknowledgedAddress = I2C_AcknowledgedAddress_7bit;
+    I2C_Init(I2C2, &I2C_InitStructure);
+
+    I2C_StretchClockCmd(I2C2, DISABLE);
+    I2C_DMACmd(I2C2, ENABLE);
+    I2C_ITConfig(I2C2, I2C_IT_EVT | I2C_IT_ERR, ENABLE);
+
+    irq_attach(I2C2_EV_IRQn, i2c_slave_ev_irq_handler);
+    irq_attach(I2C2_ER_IRQn, i2c_slave_er_irq_handler);
+    irq_attach(DMA1_Channel4_IRQn, i2c_slave_tx_irq_handler);
+
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_InitStructure.NVIC_IRQChannel = I2C2_EV_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
+    NVIC_InitStructure.NVIC_IRQChannel = I2C2_ER_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
+    NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel4_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
+
+    I2C_Cmd(I2C2, ENABLE);
+
+    // I2C_Init() writes CTLR1 before PE is set, so ACK is enabled again here
+    I2C_AcknowledgeConfig(I2C2, ENABLE);
+
+    return 0;
+}
+
+const i2c_slave_stats_t *i2c_slave_get_stats(void){
+    return &i2c_slave_stats;
+}
@@ -0,0 +1,55 @@
+#ifndef I2C_SLAVE_H
+#define I2C_SLAVE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+
+// Largest register map; a write is staged in a buffer one byte longer
+#ifndef I2C_SLAVE_MAX_REGISTERS
+#define I2C_SLAVE_MAX_REGISTERS 64
+#endif
+
+// Runs in interrupt context after a master write has been applied.
+// offset + length may run past the end of the map and wrap to 0.
+typedef void (*i2c_slave_write_callback_t)(uint8_t offset, uint8_t length);
+
+typedef struct {
+    uint8_t address;            // 8-bit bus address, e.g. 0x50 << 1
+    uint8_t *registers;         // Owned by the application, read by DMA
+    uint8_t size;               // Up to I2C_SLAVE_MAX_REGISTERS
+    i2c_slave_write_callback_t on_write;
+} i2c_slave_config_t;
+
+typedef struct {
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t overruns;          // Master was faster than the DMA, or wrote past the buffer
+    uint32_t bus_errors;
+} i2c_slave_stats_t;
+
+// Register-map slave on I2C2, PB10 (SCL) and PB11 (SDA), with DMA1
+// channels 4/5. The usual protocol applies: the first byte of a write sets
+// the register pointer and the rest are stored from there; a read returns
+// registers from the pointer on. The pointer auto-increments and wraps to
+// register 0 at the end of the map, for reads and writes alike, and the
+// next read carries on where the last one stopped.
+//
+// The clock is never stretched. Both DMA channels stay armed, so data
+// moves without CPU help. A write is applied to the map in one go when it
+// ends (STOP or repeated START), so readers never see half of one. A
+// pointer write followed by a repeated-START read re-arms the TX DMA from
+// the address interrupt, and a read reaching the end of the map re-arms it
+// at register 0 from the DMA interrupt, so the I2C2 and DMA1 channel 4
+// interrupts run at the highest priority.
+uint8_t i2c_slave_init(const i2c_slave_config_t *config);
+
+const i2c_slave_stats_t *i2c_slave_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,347 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "ch32v10x_gpio.h"
+#include "debug.h"
+
+#include "spi_lcd.h"
+#include "spi_queue.h"
+
+// MIPI DCS commands shared by both controllers
+#define SPI_LCD_CMD_CASET  0x2A
+#define SPI_LCD_CMD_RASET  0x2B
+#define SPI_LCD_CMD_RAMWR  0x2C
+#define SPI_LCD_CMD_MADCTL 0x36
+
+// Init tables: command count, then per command the opcode, the argument
+// count (SPI_LCD_DELAY set when a delay in ms follows the arguments), the
+// arguments and the optional delay
+#define SPI_LCD_DELAY 0x80
+
+static const uint8_t spi_lcd_init_st7735[] = {
+    16,
+    0x01, SPI_LCD_DELAY, 150,                       // SWRESET
+    0x11, SPI_LCD_DELAY, 255,                       // SLPOUT
+    0xB1, 3, 0x01, 0x2C, 0x2D,                      // FRMCTR1
+    0xB2, 3, 0x01, 0x2C, 0x2D,                      // FRMCTR2
+    0xB3, 6, 0x01, 0x2C, 0x2D, 0x01, 0x2C, 0x2D,    // FRMCTR3
+    0xB4, 1, 0x07,                                  // INVCTR
+    0xC0, 3, 0xA2, 0x02, 0x84,                      // PWCTR1
+    0xC1, 1, 0xC5,                                  // PWCTR2
+    0xC2, 2, 0x0A, 0x00,                            // PWCTR3
+    0xC3, 2, 0x8A, 0x2A,                            // PWCTR4
+    0xC4, 2, 0x8A, 0xEE,                            // PWCTR5
+    0xC5, 1, 0x0E,                                  // VMCTR1
+    0x20, 0,                                        // INVOFF
+    0x3A, 1, 0x05,                                  // COLMOD 16 bpp
+    0x13, SPI_LCD_DELAY, 10,                        // NORON
+    0x29, SPI_LCD_DELAY, 100,                       // DISPON
+};
+
+static const uint8_t spi_lcd_init_ili9341[] = {
+    11,
+    0x01, SPI_LCD_DELAY, 150,                       // SWRESET
+    0xC0, 1, 0x23,                                  // PWCTR1
+    0xC1, 1, 0x10,                                  // PWCTR2
+    0xC5, 2, 0x3E, 0x28,                            // VMCTR1
+    0xC7, 1, 0x86,                                  // VMCTR2
+    0x3A, 1, 0x55,                                  // COLMOD 16 bpp
+    0xB1, 2, 0x00, 0x18,                            // FRMCTR1
+    0xB6, 3, 0x08, 0x82, 0x27,                      // DFUNCTR
+    0x26, 1, 0x01,                                  // GAMMASET
+    0x11, SPI_LCD_DELAY, 120,                       // SLPOUT
+    0x29, SPI_LCD_DELAY, 20,                        // DISPON
+};
+
+// Half-open rectangle
+typedef struct {
+    uint16_t x0, y0, x1, y1;
+} spi_lcd_rect_t;
+
+static spi_lcd_config_t spi_lcd_config;
+
+static spi_lcd_rect_t spi_lcd_dirty[SPI_LCD_DIRTY_MAX];
+static uint8_t spi_lcd_dirty_count = 0;
+
+// Commands go out 8 bits wide and synchronously since DC changes between
+// phases; pixels go out as 16-bit frames so RGB565 needs no byte swapping
+static spi_device_t spi_lcd_device;
+static spi_transaction_t spi_lcd_command;
+static spi_transaction_t spi_lcd_pixels[2];
+static uint16_t spi_lcd_chunk[2][SPI_LCD_CHUNK_PIXELS];
+
+static void spi_lcd_init_transaction(spi_transaction_t *transaction, uint8_t flags){
+    memset(transaction, 0, sizeof(*transaction));
+    transaction->device = &spi_lcd_device;
+    transaction->flags = flags;
+}
+
+static uint8_t spi_lcd_is_pending(const spi_transaction_t *transaction){
+    return transaction->status == SPI_TRANSACTION_QUEUED || transaction->status == SPI_TRANSACTION_ACTIVE;
+}
+
+static void spi_lcd_send(const uint8_t *data, uint16_t length){
+    spi_lcd_command.tx_buffer = data;
+    spi_lcd_command.length = length;
+    spi_queue_submit(&spi_lcd_command);
+
+    while(spi_lcd_command.status != SPI_TRANSACTION_DONE);
+}
+
+static void spi_lcd_write_command(uint8_t command, const uint8_t *args, uint8_t length){
+    // DC must not change under pixel data still being clocked out
+    spi_lcd_wait_idle();
+
+    spi_lcd_config.dc_port->BCR = spi_lcd_config.dc_pin;
+    spi_lcd_send(&command, 1);
+    spi_lcd_config.dc_port->BSHR = spi_lcd_config.dc_pin;
+
+    if(length) {
+        spi_lcd_send(args, length);
+    }
+}
+
+static void spi_lcd_run_init(const uint8_t *table){
+    uint8_t commands = *table++;
+    uint8_t command, length;
+
+    while(commands--) {
+        command = *table++;
+        length = *table++;
+        spi_lcd_write_command(command, table, length & ~SPI_LCD_DELAY);
+        table += length & ~SPI_LCD_DELAY;
+
+        if(length & SPI_LCD_DELAY) {
+            Delay_Ms(*table == 255 ? 500 : *table);
+            table++;
+        }
+    }
+}
+
+// Leaves the controller expecting pixel data for the window
+static void spi_lcd_set_window(const spi_lcd_rect_t *rect){
+    uint8_t args[4];
+    uint16_t x0 = rect->x0 + spi_lcd_config.x_offset;
+    uint16_t x1 = rect->x1 - 1 + spi_lcd_config.x_offset;
+    uint16_t y0 = rect->y0 + spi_lcd_config.y_offset;
+    uint16_t y1 = rect->y1 - 1 + spi_lcd_config.y_offset;
+
+    args[0] = x0 >> 8;
+    args[1] = x0;
+    args[2] = x1 >> 8;
+    args[3] = x1;
+    spi_lcd_write_command(SPI_LCD_CMD_CASET, args, 4);
+
+    args[0] = y0 >> 8;
+    args[1] = y0;
+    args[2] = y1 >> 8;
+    args[3] = y1;
+    spi_lcd_write_command(SPI_LCD_CMD_RASET, args, 4);
+
+    spi_lcd_write_command(SPI_LCD_CMD_RAMWR, NULL, 0);
+}
+
+static void spi_lcd_send_chunk(uint8_t index, const uint16_t *pixels, uint16_t count){
+    spi_lcd_pixels[index].tx_buffer = (const uint8_t *)pixels;
+    spi_lcd_pixels[index].length = count;
+    spi_queue_submit(&spi_lcd_pixels[index]);
+}
+
+static void spi_lcd_draw_rect(const spi_lcd_rect_t *rect, spi_lcd_render_t render){
+    uint16_t width = rect->x1 - rect->x0;
+    uint16_t lines_per_chunk = SPI_LCD_CHUNK_PIXELS / width;
+    uint16_t y, lines;
+    uint8_t index = 0;
+
+    spi_lcd_set_window(rect);
+
+    for(y = rect->y0; y < rect->y1; y += lines) {
+        lines = rect->y1 - y;
+        if(lines > lines_per_chunk) {
+            lines = lines_per_chunk;
+        }
+
+        // The other chunk keeps the bus busy while this one renders
+        while(spi_lcd_is_pending(&spi_lcd_pixels[index]));
+
+        render(rect->x0, y, width, lines, spi_lcd_chunk[index]);
+        spi_lcd_send_chunk(index, spi_lcd_chunk[index], width * lines);
+
+        index ^= 1;
+    }
+}
+
+// Clips to the screen; returns 0 for an empty result
+static uint8_t spi_lcd_make_rect(spi_lcd_rect_t *rect, uint16_t x, uint16_t y, uint16_t width, uint16_t height){
+    if(x >= spi_lcd_config.width || y >= spi_lcd_config.height || width == 0 || height == 0) {
+        return 0;
+    }
+
+    rect->x0 = x;
+    rect->y0 = y;
+    rect->x1 = width > spi_lcd_config.width - x ? spi_lcd_config.width : x + width;
+    rect->y1 = height > spi_lcd_config.height - y ? spi_lcd_config.height : y + height;
+
+    return 1;
+}
+
+static uint32_t spi_lcd_area(const spi_lcd_rect_t *rect){
+    return (uint32_t)(rect->x1 - rect->x0) * (rect->y1 - rect->y0);
+}
+
+static void spi_lcd_union(spi_lcd_rect_t *rect, const spi_lcd_rect_t *other){
+    if(other->x0 < rect->x0) rect->x0 = other->x0;
+    if(other->y0 < rect->y0) rect->y0 = other->y0;
+    if(other->x1 > rect->x1) rect->x1 = other->x1;
+    if(other->y1 > rect->y1) rect->y1 = other->y1;
+}
+
+// Touching rectangles count too: sending them as one window saves a
+// window setup
+static uint8_t spi_lcd_touches(const spi_lcd_rect_t *a, const spi_lcd_rect_t *b){
+    return a->x0 <= b->x1 && b->x0 <= a->x1 && a->y0 <= b->y1 && b->y0 <= a->y1;
+}
+
+static void spi_lcd_dirty_remove(uint8_t index){
+    spi_lcd_dirty[index] = spi_lcd_dirty[--spi_lcd_dirty_count];
+}
+
+void spi_lcd_invalidate(uint16_t x, uint16_t y, uint16_t width, uint16_t height){
+    spi_lcd_rect_t rect, merged;
+    uint32_t growth, best_growth;
+    uint8_t i, best;
+
+    if(!spi_lcd_make_rect(&rect, x, y, width, height)) {
+        return;
+    }
+
+    for(;;) {
+        for(i = 0; i < spi_lcd_dirty_count; i++) {
+            if(spi_lcd_touches(&rect, &spi_lcd_dirty[i])) {
+                break;
+            }
+        }
+
+        if(i == spi_lcd_dirty_count) {
+            if(spi_lcd_dirty_count < SPI_LCD_DIRTY_MAX) {
+                break;
+            }
+
+            // List full: absorb the entry that adds the least redrawn area
+            best = 0;
+            best_growth = 0xFFFFFFFF;
+            for(i = 0; i < spi_lcd_dirty_count; i++) {
+                merged = rect;
+                spi_lcd_union(&merged, &spi_lcd_dirty[i]);
+                growth = spi_lcd_area(&merged) - spi_lcd_area(&spi_lcd_dirty[i]);
+                if(growth < best_growth) {
+                    best_growth = growth;
+                    best = i;
+                }
+            }
+            i = best;
+        }
+
+        // The union may now touch other entries, so scan again
+        spi_lcd_union(&rect, &spi_lcd_dirty[i]);
+        spi_lcd_dirty_remove(i);
+    }
+
+    spi_lcd_dirty[spi_lcd_dirty_count++] = rect;
+}
+
+void spi_lcd_invalidate_all(void){
+    spi_lcd_dirty_count = 0;
+    spi_lcd_invalidate(0, 0, spi_lcd_config.width, spi_lcd_config.height);
+}
+
+void spi_lcd_flush(spi_lcd_render_t render){
+    while(spi_lcd_dirty_count) {
+        spi_lcd_draw_rect(&spi_lcd_dirty[spi_lcd_dirty_count - 1], render);
+        spi_lcd_dirty_count--;
+    }
+}
+
+void spi_lcd_draw(uint16_t x, uint16_t y, uint16_t width, uint16_t height, spi_lcd_render_t render){
+    spi_lcd_rect_t rect;
+
+    if(spi_lcd_make_rect(&rect, x, y, width, height)) {
+        spi_lcd_draw_rect(&rect, render);
+    }
+}
+
+void spi_lcd_fill(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t color){
+    spi_lcd_rect_t rect;
+    uint32_t remaining;
+    uint16_t count;
+    uint8_t index = 0;
+
+    if(!spi_lcd_make_rect(&rect, x, y, width, height)) {
+        return;
+    }
+
+    spi_lcd_set_window(&rect);
+
+    // Both transactions stream the same solid chunk, so nothing is rendered
+    for(count = 0; count < SPI_LCD_CHUNK_PIXELS; count++) {
+        spi_lcd_chunk[0][count] = color;
+    }
+
+    remaining = spi_lcd_area(&rect);
+    while(remaining) {
+        count = remaining > SPI_LCD_CHUNK_PIXELS ? SPI_LCD_CHUNK_PIXELS : remaining;
+
+        while(spi_lcd_is_pending(&spi_lcd_pixels[index]));
+        spi_lcd_send_chunk(index, spi_lcd_chunk[0], count);
+
+        remaining -= count;
+        index ^= 1;
+    }
+}
+
+void spi_lcd_wait_idle(void){
+    while(spi_lcd_is_pending(&spi_lcd_pixels[0]) || spi_lcd_is_pending(&spi_lcd_pixels[1]));
+}
+
+uint8_t spi_lcd_init(const spi_lcd_config_t *config){
+    GPIO_InitTypeDef GPIO_InitStructure;
+
+    if(config->width == 0 || config->width > SPI_LCD_CHUNK_PIXELS || config->height == 0) {
+        return 1;
+    }
+
+    spi_lcd_config = *config;
+    spi_lcd_dirty_count = 0;
+
+    spi_device_init(&spi_lcd_device, config->cs_port, config->cs_pin, 0, config->prescaler);
+
+    spi_lcd_init_transaction(&spi_lcd_command, 0);
+    spi_lcd_init_transaction(&spi_lcd_pixels[0], SPI_TRANSACTION_16BIT);
+    spi_lcd_init_transaction(&spi_lcd_pixels[1], SPI_TRANSACTION_16BIT);
+
+    // Configure DC (and reset) pins
+    GPIO_SetBits(config->dc_port, config->dc_pin);
+    GPIO_InitStructure.GPIO_Pin = config->dc_pin;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_Out_PP;
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+    GPIO_Init(config->dc_port, &GPIO_InitStructure);
+
+    if(config->reset_port) {
+        GPIO_ResetBits(config->reset_port, config->reset_pin);
+        GPIO_InitStructure.GPIO_Pin = config->reset_pin;
+        GPIO_Init(config->reset_port, &GPIO_InitStructure);
+        Delay_Ms(10);
+        GPIO_SetBits(config->reset_port, config->reset_pin);
+        Delay_Ms(120);
+    }
+
+    if(config->controller == SPI_LCD_ILI9341) {
+        spi_lcd_run_init(spi_lcd_init_ili9341);
+    } else {
+        spi_lcd_run_init(spi_lcd_init_st7735);
+    }
+
+    spi_lcd_write_command(SPI_LCD_CMD_MADCTL, &config->madctl, 1);
+
+    return 0;
+}
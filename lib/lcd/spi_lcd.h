@@ -0,0 +1,75 @@
+#ifndef SPI_LCD_H
+#define SPI_LCD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+
+#define SPI_LCD_ST7735  0
+#define SPI_LCD_ILI9341 1
+
+// Pixels per line chunk; two chunks are kept so one renders while the other
+// is sent. Must hold at least one full line.
+#ifndef SPI_LCD_CHUNK_PIXELS
+#define SPI_LCD_CHUNK_PIXELS 512
+#endif
+
+#ifndef SPI_LCD_DIRTY_MAX
+#define SPI_LCD_DIRTY_MAX 8
+#endif
+
+// MADCTL bits for rotation and colour order
+#define SPI_LCD_MADCTL_MY  0x80
+#define SPI_LCD_MADCTL_MX  0x40
+#define SPI_LCD_MADCTL_MV  0x20
+#define SPI_LCD_MADCTL_BGR 0x08
+
+#define SPI_LCD_RGB565(r, g, b) ((uint16_t)((((r) & 0xF8) << 8) | (((g) & 0xFC) << 3) | ((b) >> 3)))
+
+typedef struct {
+    uint8_t controller;         // SPI_LCD_ST7735 or SPI_LCD_ILI9341
+    uint16_t width;             // After rotation
+    uint16_t height;
+    uint8_t x_offset;           // Panel offset into controller RAM (ST7735 variants)
+    uint8_t y_offset;
+    uint8_t madctl;
+    GPIO_TypeDef *cs_port;
+    uint16_t cs_pin;
+    GPIO_TypeDef *dc_port;      // Data/command select
+    uint16_t dc_pin;
+    GPIO_TypeDef *reset_port;   // NULL when reset is tied to the board reset
+    uint16_t reset_pin;
+    uint16_t prescaler;         // SPI_BaudRatePrescaler_x
+} spi_lcd_config_t;
+
+// Fills `lines` rows of `width` RGB565 pixels starting at (x, y), row-major
+typedef void (*spi_lcd_render_t)(uint16_t x, uint16_t y, uint16_t width, uint16_t lines, uint16_t *pixels);
+
+// Display on the shared SPI1 queue. spi_queue_init() must have been called
+// and the CS, DC and reset port clocks enabled. Thread context only.
+uint8_t spi_lcd_init(const spi_lcd_config_t *config);
+
+// Marks a region for the next flush. Regions that overlap or touch it are
+// merged into it. When the list is full and nothing touches, the new region
+// is merged with the entry whose bounding box grows least.
+void spi_lcd_invalidate(uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+void spi_lcd_invalidate_all(void);
+
+// Renders and sends every dirty region chunk by chunk: chunk N+1 is rendered
+// while chunk N is on the wire. Returns once the last chunk is queued.
+void spi_lcd_flush(spi_lcd_render_t render);
+
+// Draws one region immediately, bypassing the dirty list
+void spi_lcd_draw(uint16_t x, uint16_t y, uint16_t width, uint16_t height, spi_lcd_render_t render);
+void spi_lcd_fill(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t color);
+
+// Waits for queued pixel data to finish
+void spi_lcd_wait_idle(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
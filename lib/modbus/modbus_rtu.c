@@ -0,0 +1,432 @@
+#include <stddef.h>
+
+#include "ch32v10x_misc.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_tim.h"
+
+#include "irq_dispatch.h"
+#include "modbus_rtu.h"
+#include "timebase.h"
+
+#define MODBUS_MAX_READ_BITS       2000
+#define MODBUS_MAX_READ_REGISTERS  125
+#define MODBUS_MAX_WRITE_BITS      1968
+#define MODBUS_MAX_WRITE_REGISTERS 123
+
+// CRC-16/MODBUS (reflected 0x8005), one lookup per byte
+static const uint16_t modbus_crc_table[256] = {
+    0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+    0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+    0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+    0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+    0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+    0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+    0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+    0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+    0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+    0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+    0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+    0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+    0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+    0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+    0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+    0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+    0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+    0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+    0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+    0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+    0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+    0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+    0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+    0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+    0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+    0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+    0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+    0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+    0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+    0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+    0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+    0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040,
+};
+
+static const modbus_map_t *modbus_map;
+static TIM_TypeDef *modbus_timer;
+static volatile uint16_t modbus_idle_snapshot;
+static uint8_t modbus_rx_frame[MODBUS_FRAME_SIZE];
+static uint8_t modbus_tx_frame[MODBUS_FRAME_SIZE];
+static modbus_stats_t modbus_stats;
+
+uint16_t modbus_crc16(const uint8_t *data, uint16_t length){
+    uint16_t crc = 0xFFFF;
+
+    while(length--) {
+        crc = (crc >> 8) ^ modbus_crc_table[(crc ^ *data++) & 0xFF];
+    }
+
+    return crc;
+}
+
+static uint16_t modbus_get_u16(const uint8_t *data){
+    return ((uint16_t)data[0] << 8) | data[1];
+}
+
+static void modbus_put_u16(uint8_t *data, uint16_t value){
+    data[0] = value >> 8;
+    data[1] = value & 0xFF;
+}
+
+static uint8_t modbus_get_bit(const uint8_t *bits, uint16_t index){
+    return (bits[index >> 3] >> (index & 7)) & 1;
+}
+
+static void modbus_set_bit(uint8_t *bits, uint16_t index, uint8_t value){
+    if(value) {
+        bits[index >> 3] |= 1 << (index & 7);
+    } else {
+        bits[index >> 3] &= ~(1 << (index & 7));
+    }
+}
+
+static uint16_t modbus_exception(uint8_t *rsp, uint8_t function, uint8_t code){
+    rsp[0] = function | 0x80;
+    rsp[1] = code;
+    modbus_stats.exceptions++;
+    return 2;
+}
+
+static uint16_t modbus_read_bits(const uint8_t *req, uint8_t *rsp, const uint8_t *bits, uint16_t bit_count){
+    uint16_t start = modbus_get_u16(&req[1]);
+    uint16_t count = modbus_get_u16(&req[3]);
+    uint8_t byte_count = (count + 7) / 8;
+
+    if(count == 0 || count > MODBUS_MAX_READ_BITS) {
+        return modbus_exception(rsp, req[0], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+
+    if(bits == NULL || (uint32_t)start + count > bit_count) {
+        return modbus_exception(rsp, req[0], MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+    }
+
+    rsp[0] = req[0];
+    rsp[1] = byte_count;
+
+    for(uint8_t i = 0; i < byte_count; i++) {
+        rsp[2 + i] = 0;
+    }
+
+    for(uint16_t i = 0; i < count; i++) {
+        if(modbus_get_bit(bits, start + i)) {
+            rsp[2 + (i >> 3)] |= 1 << (i & 7);
+        }
+    }
+
+    return 2 + byte_count;
+}
+
+static uint16_t modbus_read_registers(const uint8_t *req, uint8_t *rsp, const uint16_t *registers, uint16_t register_count){
+    uint16_t start = modbus_get_u16(&req[1]);
+    uint16_t count = modbus_get_u16(&req[3]);
+
+    if(count == 0 || count > MODBUS_MAX_READ_REGISTERS) {
+        return modbus_exception(rsp, req[0], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+
+    if(registers == NULL || (uint32_t)start + count > register_count) {
+        return modbus_exception(rsp, req[0], MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+    }
+
+    rsp[0] = req[0];
+    rsp[1] = count * 2;
+
+    for(uint16_t i = 0; i < count; i++) {
+        modbus_put_u16(&rsp[2 + i * 2], registers[start + i]);
+    }
+
+    return 2 + count * 2;
+}
+
+static uint16_t modbus_write_single_coil(const uint8_t *req, uint8_t *rsp){
+    uint16_t address = modbus_get_u16(&req[1]);
+    uint16_t value = modbus_get_u16(&req[3]);
+
+    if(value != 0xFF00 && value != 0x0000) {
+        return modbus_exception(rsp, req[0], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+
+    if(modbus_map->coils == NULL || address >= modbus_map->coil_count) {
+        return modbus_exception(rsp, req[0], MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+    }
+
+    modbus_set_bit(modbus_map->coils, address, value == 0xFF00);
+
+    for(uint8_t i = 0; i < 5; i++) {
+        rsp[i] = req[i];
+    }
+
+    return 5;
+}
+
+static uint16_t modbus_write_single_register(const uint8_t *req, uint8_t *rsp){
+    uint16_t address = modbus_get_u16(&req[1]);
+
+    if(modbus_map->holding_registers == NULL || address >= modbus_map->holding_register_count) {
+        return modbus_exception(rsp, req[0], MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+    }
+
+    modbus_map->holding_registers[address] = modbus_get_u16(&req[3]);
+
+    for(uint8_t i = 0; i < 5; i++) {
+        rsp[i] = req[i];
+    }
+
+    return 5;
+}
+
+static uint16_t modbus_write_multiple_coils(const uint8_t *req, uint16_t req_length, uint8_t *rsp){
+    uint16_t start = modbus_get_u16(&req[1]);
+    uint16_t count = modbus_get_u16(&req[3]);
+    uint8_t byte_count = req[5];
+
+    if(count == 0 || count > MODBUS_MAX_WRITE_BITS || byte_count != (count + 7) / 8 || req_length != 6 + byte_count) {
+        return modbus_exception(rsp, req[0], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+
+    if(modbus_map->coils == NULL || (uint32_t)start + count > modbus_map->coil_count) {
+        return modbus_exception(rsp, req[0], MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+    }
+
+    for(uint16_t i = 0; i < count; i++) {
+        modbus_set_bit(modbus_map->coils, start + i, modbus_get_bit(&req[6], i));
+    }
+
+    for(uint8_t i = 0; i < 5; i++) {
+        rsp[i] = req[i];
+    }
+
+    return 5;
+}
+
+static uint16_t modbus_write_multiple_registers(const uint8_t *req, uint16_t req_length, uint8_t *rsp){
+    uint16_t start = modbus_get_u16(&req[1]);
+    uint16_t count = modbus_get_u16(&req[3]);
+    uint8_t byte_count = req[5];
+
+    if(count == 0 || count > MODBUS_MAX_WRITE_REGISTERS || byte_count != count * 2 || req_length != 6 + byte_count) {
+        return modbus_exception(rsp, req[0], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+
+    if(modbus_map->holding_registers == NULL || (uint32_t)start + count > modbus_map->holding_register_count) {
+        return modbus_exception(rsp, req[0], MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+    }
+
+    for(uint16_t i = 0; i < count; i++) {
+        modbus_map->holding_registers[start + i] = modbus_get_u16(&req[6 + i * 2]);
+    }
+
+    for(uint8_t i = 0; i < 5; i++) {
+        rsp[i] = req[i];
+    }
+
+    return 5;
+}
+
+// req/rsp point at the function code; returns the response PDU length
+static uint16_t modbus_execute(const uint8_t *req, uint16_t req_length, uint8_t *rsp){
+    uint8_t function = req[0];
+    uint16_t rsp_length;
+
+    switch(function) {
+    case MODBUS_FC_READ_COILS:
+    case MODBUS_FC_READ_DISCRETE_INPUTS:
+    case MODBUS_FC_READ_HOLDING_REGISTERS:
+    case MODBUS_FC_READ_INPUT_REGISTERS:
+    case MODBUS_FC_WRITE_SINGLE_COIL:
+    case MODBUS_FC_WRITE_SINGLE_REGISTER:
+
+        if(req_length != 5) {
+            return modbus_exception(rsp, function, MODBUS_EX_ILLEGAL_DATA_VALUE);
+        }
+
+        break;
+
+    case MODBUS_FC_WRITE_MULTIPLE_COILS:
+    case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+
+        if(req_length < 7) {
+            return modbus_exception(rsp, function, MODBUS_EX_ILLEGAL_DATA_VALUE);
+        }
+
+        break;
+
+    default:
+        return modbus_exception(rsp, function, MODBUS_EX_ILLEGAL_FUNCTION);
+    }
+
+    switch(function) {
+    case MODBUS_FC_READ_COILS:
+        return modbus_read_bits(req, rsp, modbus_map->coils, modbus_map->coil_count);
+
+    case MODBUS_FC_READ_DISCRETE_INPUTS:
+        return modbus_read_bits(req, rsp, modbus_map->discrete_inputs, modbus_map->discrete_input_count);
+
+    case MODBUS_FC_READ_HOLDING_REGISTERS:
+        return modbus_read_registers(req, rsp, modbus_map->holding_registers, modbus_map->holding_register_count);
+
+    case MODBUS_FC_READ_INPUT_REGISTERS:
+        return modbus_read_registers(req, rsp, modbus_map->input_registers, modbus_map->input_register_count);
+
+    case MODBUS_FC_WRITE_SINGLE_COIL:
+        rsp_length = modbus_write_single_coil(req, rsp);
+        break;
+
+    case MODBUS_FC_WRITE_SINGLE_REGISTER:
+        rsp_length = modbus_write_single_register(req, rsp);
+        break;
+
+    case MODBUS_FC_WRITE_MULTIPLE_COILS:
+        rsp_length = modbus_write_multiple_coils(req, req_length, rsp);
+        break;
+
+    default:
+        rsp_length = modbus_write_multiple_registers(req, req_length, rsp);
+        break;
+    }
+
+    if(!(rsp[0] & 0x80) && modbus_map->write_callback) {
+        if(function == MODBUS_FC_WRITE_SINGLE_COIL || function == MODBUS_FC_WRITE_SINGLE_REGISTER) {
+            modbus_map->write_callback(function, modbus_get_u16(&req[1]), 1);
+        } else {
+            modbus_map->write_callback(function, modbus_get_u16(&req[1]), modbus_get_u16(&req[3]));
+        }
+    }
+
+    return rsp_length;
+}
+
+static void modbus_process_frame(const uint8_t *frame, uint16_t length){
+    uint16_t crc;
+    uint16_t rsp_length;
+
+    // Address, function code and CRC at the very least
+    if(length < 4) {
+        return;
+    }
+
+    crc = modbus_crc16(frame, length - 2);
+
+    if(frame[length - 2] != (crc & 0xFF) || frame[length - 1] != (crc >> 8)) {
+        modbus_stats.crc_errors++;
+        return;
+    }
+
+    if(frame[0] != modbus_map->slave_address && frame[0] != 0) {
+        return;
+    }
+
+    modbus_stats.frames_received++;
+    rsp_length = modbus_execute(&frame[1], length - 3, &modbus_tx_frame[1]);
+
+    // Broadcasts are executed but never answered
+    if(frame[0] == 0) {
+        return;
+    }
+
+    modbus_tx_frame[0] = frame[0];
+    crc = modbus_crc16(modbus_tx_frame, rsp_length + 1);
+    modbus_tx_frame[rsp_length + 1] = crc & 0xFF;
+    modbus_tx_frame[rsp_length + 2] = crc >> 8;
+
+    if(rs485_send(modbus_tx_frame, rsp_length + 3) == 0) {
+        modbus_stats.frames_answered++;
+    }
+}
+
+// One character of silence seen: time the remainder of t3.5
+static void modbus_rx_idle(void){
+    modbus_idle_snapshot = rs485_available();
+    TIM_SetCounter(modbus_timer, 0);
+    TIM_Cmd(modbus_timer, ENABLE);
+}
+
+static void modbus_timer_irq_handler(void){
+    uint16_t length;
+
+    if(TIM_GetITStatus(modbus_timer, TIM_IT_Update) == RESET) {
+        return;
+    }
+
+    TIM_ClearITPendingBit(modbus_timer, TIM_IT_Update);
+
+    // Bytes arrived after the idle event; the next idle event re-arms the timer
+    if(rs485_available() != modbus_idle_snapshot) {
+        return;
+    }
+
+    if(modbus_idle_snapshot > MODBUS_FRAME_SIZE) {
+        rs485_flush_rx();
+        modbus_stats.overruns++;
+        return;
+    }
+
+    length = rs485_read(modbus_rx_frame, MODBUS_FRAME_SIZE);
+    modbus_process_frame(modbus_rx_frame, length);
+}
+
+uint8_t modbus_rtu_init(const rs485_config_t *port, TIM_TypeDef *timer, const modbus_map_t *map){
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+    NVIC_InitTypeDef NVIC_InitStructure;
+    uint32_t t35_us;
+    uint32_t idle_us;
+
+    if(timer != TIM2 && timer != TIM3) {
+        return 1;
+    }
+
+    modbus_map = map;
+    modbus_timer = timer;
+
+    if(rs485_init(port) != 0) {
+        return 1;
+    }
+
+    // t3.5 counts 11-bit characters; above 19200 baud the spec fixes it at 1750 us.
+    // IDLE fires after one 10-bit character of silence, the timer covers the rest.
+    if(port->baudrate > 19200) {
+        t35_us = 1750;
+    } else {
+        t35_us = (38500000UL + port->baudrate - 1) / port->baudrate;
+    }
+
+    idle_us = 10000000UL / port->baudrate;
+
+    RCC_APB1PeriphClockCmd(timer == TIM2 ? RCC_APB1Periph_TIM2 : RCC_APB1Periph_TIM3, ENABLE);
+
+    // One-shot timer with 1 us ticks
+    TIM_TimeBaseStructure.TIM_Period = t35_us > idle_us ? t35_us - idle_us : 1;
+    TIM_TimeBaseStructure.TIM_Prescaler = timebase_timer_clock(timer) / 1000000 - 1;
+    TIM_TimeBaseStructure.TIM_ClockDivision = TIM_CKD_DIV1;
+    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseInit(timer, &TIM_TimeBaseStructure);
+    TIM_SelectOnePulseMode(timer, TIM_OPMode_Single);
+    TIM_UpdateRequestConfig(timer, TIM_UpdateSource_Regular);
+
+    // TIM_TimeBaseInit forces an update event; drop it before enabling the interrupt
+    TIM_ClearITPendingBit(timer, TIM_IT_Update);
+    TIM_ITConfig(timer, TIM_IT_Update, ENABLE);
+
+    // Below the USART so frame parsing never delays the DE release
+    irq_attach(timer == TIM2 ? TIM2_IRQn : TIM3_IRQn, modbus_timer_irq_handler);
+    NVIC_InitStructure.NVIC_IRQChannel = timer == TIM2 ? TIM2_IRQn : TIM3_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+
+    rs485_set_rx_idle_callback(modbus_rx_idle);
+
+    return 0;
+}
+
+const modbus_stats_t *modbus_rtu_get_stats(void){
+    return &modbus_stats;
+}
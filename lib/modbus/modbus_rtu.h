@@ -0,0 +1,65 @@
+#ifndef MODBUS_RTU_H
+#define MODBUS_RTU_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+#include "rs485.h"
+
+#define MODBUS_FRAME_SIZE 256
+
+// Function codes served by the slave
+#define MODBUS_FC_READ_COILS               0x01
+#define MODBUS_FC_READ_DISCRETE_INPUTS     0x02
+#define MODBUS_FC_READ_HOLDING_REGISTERS   0x03
+#define MODBUS_FC_READ_INPUT_REGISTERS     0x04
+#define MODBUS_FC_WRITE_SINGLE_COIL        0x05
+#define MODBUS_FC_WRITE_SINGLE_REGISTER    0x06
+#define MODBUS_FC_WRITE_MULTIPLE_COILS     0x0F
+#define MODBUS_FC_WRITE_MULTIPLE_REGISTERS 0x10
+
+#define MODBUS_EX_ILLEGAL_FUNCTION         0x01
+#define MODBUS_EX_ILLEGAL_DATA_ADDRESS     0x02
+#define MODBUS_EX_ILLEGAL_DATA_VALUE       0x03
+
+// Register map served straight from application memory. Coils and discrete
+// inputs are bit-packed LSB first, the same order Modbus puts them on the wire.
+// Unused tables are left NULL with a count of 0.
+typedef struct {
+    uint8_t slave_address;
+    uint16_t *holding_registers;
+    uint16_t holding_register_count;
+    const uint16_t *input_registers;
+    uint16_t input_register_count;
+    uint8_t *coils;
+    uint16_t coil_count;
+    const uint8_t *discrete_inputs;
+    uint16_t discrete_input_count;
+
+    // Called from interrupt context after a write request has been applied
+    void (*write_callback)(uint8_t function, uint16_t address, uint16_t count);
+} modbus_map_t;
+
+typedef struct {
+    uint32_t frames_received;
+    uint32_t frames_answered;
+    uint32_t crc_errors;
+    uint32_t exceptions;
+    uint32_t overruns;
+} modbus_stats_t;
+
+// Frames are delimited by the USART idle-line interrupt plus a one-shot
+// timer (TIM2 or TIM3) covering the rest of t3.5, then parsed and answered
+// from the timer interrupt without ever waiting on the bus.
+uint8_t modbus_rtu_init(const rs485_config_t *port, TIM_TypeDef *timer, const modbus_map_t *map);
+const modbus_stats_t *modbus_rtu_get_stats(void);
+
+uint16_t modbus_crc16(const uint8_t *data, uint16_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
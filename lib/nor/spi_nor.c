@@ -0,0 +1,440 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "ch32v10x_spi.h"
+#include "debug.h"
+
+#include "spi_nor.h"
+#include "spi_queue.h"
+
+// Commands
+#define SPI_NOR_CMD_WRITE_ENABLE   0x06
+#define SPI_NOR_CMD_READ_STATUS    0x05
+#define SPI_NOR_CMD_PAGE_PROGRAM   0x02
+#define SPI_NOR_CMD_FAST_READ      0x0B
+#define SPI_NOR_CMD_SECTOR_ERASE   0x20
+#define SPI_NOR_CMD_BLOCK_ERASE_32 0x52
+#define SPI_NOR_CMD_BLOCK_ERASE_64 0xD8
+#define SPI_NOR_CMD_JEDEC_ID       0x9F
+#define SPI_NOR_CMD_RELEASE_PD     0xAB
+
+#define SPI_NOR_STATUS_BUSY 0x01
+
+// Longest operation issued is a 64 KB block erase (2 s max on W25Q parts)
+#define SPI_NOR_POLL_INTERVAL_US 5
+#define SPI_NOR_READY_TIMEOUT_US 3000000
+
+#define SPI_NOR_MAX_CAPACITY  (16UL * 1024 * 1024)
+#define SPI_NOR_CACHE_INVALID 0xFFFFFFFF
+#define SPI_NOR_READ_CHUNK    0x8000
+
+// Read-modify-write stages one block at a time in the cache
+#if SPI_NOR_CACHE_SIZE < SPI_NOR_BLOCK_SIZE
+#error "SPI_NOR_CACHE_SIZE must hold at least one SPI_NOR_BLOCK_SIZE block"
+#endif
+
+static uint32_t spi_nor_jedec_id = 0;
+static uint32_t spi_nor_capacity = 0;
+static uint8_t spi_nor_write_pending = 0;
+
+static spi_device_t spi_nor_device;
+
+// Write enable, command header and data phase go out as one queue chain
+static spi_transaction_t spi_nor_wren;
+static spi_transaction_t spi_nor_command;
+static spi_transaction_t spi_nor_data;
+static const uint8_t spi_nor_wren_command = SPI_NOR_CMD_WRITE_ENABLE;
+static uint8_t spi_nor_header[5];
+static uint8_t spi_nor_response[5];
+
+static uint8_t spi_nor_cache[SPI_NOR_CACHE_SIZE];
+static uint32_t spi_nor_cache_address = SPI_NOR_CACHE_INVALID;
+
+static blockdev_t spi_nor_blockdev;
+
+static void spi_nor_init_transaction(spi_transaction_t *transaction){
+    memset(transaction, 0, sizeof(*transaction));
+    transaction->device = &spi_nor_device;
+}
+
+static void spi_nor_set_address(uint8_t command, uint32_t address){
+    spi_nor_header[0] = command;
+    spi_nor_header[1] = address >> 16;
+    spi_nor_header[2] = address >> 8;
+    spi_nor_header[3] = address;
+    spi_nor_header[4] = 0xFF;
+}
+
+// Sends the header, then optionally a data phase with CS held, optionally
+// preceded by a write enable. Returns once the last byte is clocked.
+static void spi_nor_transfer(uint8_t write_enable, uint8_t header_length,
+                             const uint8_t *tx, uint8_t *rx, uint16_t length){
+    spi_transaction_t *chain[3];
+    uint8_t count = 0;
+
+    if(write_enable) {
+        chain[count++] = &spi_nor_wren;
+    }
+
+    spi_nor_command.length = header_length;
+    spi_nor_command.flags = length ? SPI_TRANSACTION_KEEP_CS : 0;
+    chain[count++] = &spi_nor_command;
+
+    if(length) {
+        spi_nor_data.tx_buffer = tx;
+        spi_nor_data.rx_buffer = rx;
+        spi_nor_data.length = length;
+        chain[count++] = &spi_nor_data;
+    }
+
+    spi_queue_submit_chain(chain, count);
+
+    while(chain[count - 1]->status != SPI_TRANSACTION_DONE);
+}
+
+static uint8_t spi_nor_read_status(void){
+    spi_nor_header[0] = SPI_NOR_CMD_READ_STATUS;
+    spi_nor_header[1] = 0xFF;
+    spi_nor_transfer(0, 2, NULL, NULL, 0);
+
+    return spi_nor_response[1];
+}
+
+uint8_t spi_nor_is_busy(void){
+    if(spi_nor_write_pending && !(spi_nor_read_status() & SPI_NOR_STATUS_BUSY)) {
+        spi_nor_write_pending = 0;
+    }
+
+    return spi_nor_write_pending;
+}
+
+uint8_t spi_nor_wait_ready(void){
+    uint32_t polls = SPI_NOR_READY_TIMEOUT_US / SPI_NOR_POLL_INTERVAL_US;
+
+    while(spi_nor_is_busy()) {
+        if(--polls == 0) {
+            return 1;
+        }
+        Delay_Us(SPI_NOR_POLL_INTERVAL_US);
+    }
+
+    return 0;
+}
+
+static uint8_t spi_nor_in_range(uint32_t address, uint32_t length){
+    return spi_nor_capacity && address < spi_nor_capacity && length <= spi_nor_capacity - address;
+}
+
+static void spi_nor_cache_invalidate(uint32_t address, uint32_t length){
+    if(spi_nor_cache_address != SPI_NOR_CACHE_INVALID &&
+       address < spi_nor_cache_address + SPI_NOR_CACHE_SIZE &&
+       spi_nor_cache_address < address + length) {
+        spi_nor_cache_address = SPI_NOR_CACHE_INVALID;
+    }
+}
+
+// Streams straight into the caller's buffer, bypassing the cache
+static uint8_t spi_nor_fast_read(uint32_t address, uint8_t *data, uint32_t length){
+    uint16_t chunk;
+
+    if(spi_nor_wait_ready() != 0) {
+        return 1;
+    }
+
+    while(length) {
+        chunk = length > SPI_NOR_READ_CHUNK ? SPI_NOR_READ_CHUNK : length;
+        spi_nor_set_address(SPI_NOR_CMD_FAST_READ, address);
+        spi_nor_transfer(0, 5, NULL, data, chunk);
+
+        address += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+
+    return 0;
+}
+
+uint8_t spi_nor_read(uint32_t address, uint8_t *data, uint32_t length){
+    if(!spi_nor_in_range(address, length)) {
+        return 1;
+    }
+
+    if(length >= SPI_NOR_CACHE_SIZE) {
+        return spi_nor_fast_read(address, data, length);
+    }
+
+    // Refill the window from the requested address so the sequential reads
+    // that follow are served from RAM
+    if(spi_nor_cache_address == SPI_NOR_CACHE_INVALID ||
+       address < spi_nor_cache_address ||
+       address + length > spi_nor_cache_address + SPI_NOR_CACHE_SIZE) {
+        uint32_t window = address;
+
+        if(window > spi_nor_capacity - SPI_NOR_CACHE_SIZE) {
+            window = spi_nor_capacity - SPI_NOR_CACHE_SIZE;
+        }
+
+        spi_nor_cache_address = SPI_NOR_CACHE_INVALID;
+        if(spi_nor_fast_read(window, spi_nor_cache, SPI_NOR_CACHE_SIZE) != 0) {
+            return 1;
+        }
+        spi_nor_cache_address = window;
+    }
+
+    memcpy(data, &spi_nor_cache[address - spi_nor_cache_address], length);
+
+    return 0;
+}
+
+uint8_t spi_nor_program(uint32_t address, const uint8_t *data, uint32_t length){
+    uint16_t chunk;
+
+    if(!spi_nor_in_range(address, length)) {
+        return 1;
+    }
+
+    spi_nor_cache_invalidate(address, length);
+
+    // Each page is sent the moment the previous one finishes programming;
+    // the last one completes after we return
+    while(length) {
+        chunk = SPI_NOR_PAGE_SIZE - (address & (SPI_NOR_PAGE_SIZE - 1));
+        if(chunk > length) {
+            chunk = length;
+        }
+
+        if(spi_nor_wait_ready() != 0) {
+            return 1;
+        }
+
+        spi_nor_set_address(SPI_NOR_CMD_PAGE_PROGRAM, address);
+        spi_nor_transfer(1, 4, data, NULL, chunk);
+        spi_nor_write_pending = 1;
+
+        address += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+
+    return 0;
+}
+
+uint8_t spi_nor_erase(uint32_t address, uint32_t length){
+    uint8_t command;
+    uint32_t size;
+
+    if(!spi_nor_in_range(address, length) || (address | length) & (SPI_NOR_SECTOR_SIZE - 1)) {
+        return 1;
+    }
+
+    spi_nor_cache_invalidate(address, length);
+
+    // Largest aligned erase that fits: one 64 KB block erase is several
+    // times faster than sixteen sector erases
+    while(length) {
+        if(!(address & 0xFFFF) && length >= 0x10000) {
+            command = SPI_NOR_CMD_BLOCK_ERASE_64;
+            size = 0x10000;
+        } else if(!(address & 0x7FFF) && length >= 0x8000) {
+            command = SPI_NOR_CMD_BLOCK_ERASE_32;
+            size = 0x8000;
+        } else {
+            command = SPI_NOR_CMD_SECTOR_ERASE;
+            size = SPI_NOR_SECTOR_SIZE;
+        }
+
+        if(spi_nor_wait_ready() != 0) {
+            return 1;
+        }
+
+        spi_nor_set_address(command, address);
+        spi_nor_transfer(1, 4, NULL, NULL, 0);
+        spi_nor_write_pending = 1;
+
+        address += size;
+        length -= size;
+    }
+
+    return 0;
+}
+
+// Programming can only clear bits, so a block whose new contents keep every
+// 0 bit of the old contents is programmed in place without an erase
+static uint8_t spi_nor_is_programmable(uint32_t address, const uint8_t *data, uint8_t *identical){
+    uint8_t *old = spi_nor_cache;
+
+    spi_nor_cache_address = SPI_NOR_CACHE_INVALID;
+    if(spi_nor_fast_read(address, old, SPI_NOR_BLOCK_SIZE) != 0) {
+        return 0;
+    }
+
+    *identical = memcmp(old, data, SPI_NOR_BLOCK_SIZE) == 0;
+
+    for(uint16_t i = 0; i < SPI_NOR_BLOCK_SIZE; i++) {
+        if((old[i] & data[i]) != data[i]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Copies the sector through the scratch sector with the new blocks merged in,
+// using one block of RAM instead of a whole sector
+static uint8_t spi_nor_rewrite_sector(uint32_t sector, uint32_t address, const uint8_t *data, uint32_t length){
+    uint32_t scratch = spi_nor_capacity - SPI_NOR_SECTOR_SIZE;
+    const uint8_t *source;
+    uint32_t offset;
+
+    spi_nor_cache_address = SPI_NOR_CACHE_INVALID;
+
+    if(spi_nor_erase(scratch, SPI_NOR_SECTOR_SIZE) != 0) {
+        return 1;
+    }
+
+    for(offset = 0; offset < SPI_NOR_SECTOR_SIZE; offset += SPI_NOR_BLOCK_SIZE) {
+        if(sector + offset >= address && sector + offset < address + length) {
+            source = data + (sector + offset - address);
+        } else {
+            if(spi_nor_fast_read(sector + offset, spi_nor_cache, SPI_NOR_BLOCK_SIZE) != 0) {
+                return 1;
+            }
+            source = spi_nor_cache;
+        }
+
+        if(spi_nor_program(scratch + offset, source, SPI_NOR_BLOCK_SIZE) != 0) {
+            return 1;
+        }
+    }
+
+    if(spi_nor_erase(sector, SPI_NOR_SECTOR_SIZE) != 0) {
+        return 1;
+    }
+
+    for(offset = 0; offset < SPI_NOR_SECTOR_SIZE; offset += SPI_NOR_BLOCK_SIZE) {
+        if(spi_nor_fast_read(scratch + offset, spi_nor_cache, SPI_NOR_BLOCK_SIZE) != 0 ||
+           spi_nor_program(sector + offset, spi_nor_cache, SPI_NOR_BLOCK_SIZE) != 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static uint8_t spi_nor_blockdev_read(const blockdev_t *dev, uint32_t block, uint8_t *data, uint32_t count){
+    if(block >= dev->block_count || count > dev->block_count - block) {
+        return 1;
+    }
+
+    return spi_nor_read(block * SPI_NOR_BLOCK_SIZE, data, count * SPI_NOR_BLOCK_SIZE);
+}
+
+static uint8_t spi_nor_blockdev_write(const blockdev_t *dev, uint32_t block, const uint8_t *data, uint32_t count){
+    uint32_t address, sector, length, chunk, offset;
+    uint8_t identical, direct;
+
+    if(block >= dev->block_count || count > dev->block_count - block) {
+        return 1;
+    }
+
+    address = block * SPI_NOR_BLOCK_SIZE;
+    length = count * SPI_NOR_BLOCK_SIZE;
+
+    // One pass per sector touched
+    while(length) {
+        sector = address & ~(SPI_NOR_SECTOR_SIZE - 1);
+        chunk = sector + SPI_NOR_SECTOR_SIZE - address;
+        if(chunk > length) {
+            chunk = length;
+        }
+
+        direct = 1;
+        for(offset = 0; offset < chunk && direct; offset += SPI_NOR_BLOCK_SIZE) {
+            direct = spi_nor_is_programmable(address + offset, data + offset, &identical);
+            if(direct && !identical &&
+               spi_nor_program(address + offset, data + offset, SPI_NOR_BLOCK_SIZE) != 0) {
+                return 1;
+            }
+        }
+
+        // Blocks already programmed above are rewritten with the same data
+        if(!direct && spi_nor_rewrite_sector(sector, address, data, chunk) != 0) {
+            return 1;
+        }
+
+        address += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+
+    return 0;
+}
+
+static uint8_t spi_nor_blockdev_sync(const blockdev_t *dev){
+    return spi_nor_wait_ready();
+}
+
+uint8_t spi_nor_init(const spi_nor_config_t *config){
+    uint8_t capacity_code;
+
+    spi_nor_capacity = 0;
+    spi_nor_jedec_id = 0;
+    spi_nor_write_pending = 0;
+    spi_nor_cache_address = SPI_NOR_CACHE_INVALID;
+
+    spi_device_init(&spi_nor_device, config->cs_port, config->cs_pin, 0, config->prescaler);
+
+    spi_nor_init_transaction(&spi_nor_wren);
+    spi_nor_init_transaction(&spi_nor_command);
+    spi_nor_init_transaction(&spi_nor_data);
+    spi_nor_wren.tx_buffer = &spi_nor_wren_command;
+    spi_nor_wren.length = 1;
+    spi_nor_command.tx_buffer = spi_nor_header;
+    spi_nor_command.rx_buffer = spi_nor_response;
+
+    // Wake the chip in case it was left in power-down (tRES1 = 3 us)
+    spi_nor_header[0] = SPI_NOR_CMD_RELEASE_PD;
+    spi_nor_transfer(0, 1, NULL, NULL, 0);
+    Delay_Us(5);
+
+    spi_nor_header[0] = SPI_NOR_CMD_JEDEC_ID;
+    spi_nor_header[1] = 0xFF;
+    spi_nor_header[2] = 0xFF;
+    spi_nor_header[3] = 0xFF;
+    spi_nor_transfer(0, 4, NULL, NULL, 0);
+
+    spi_nor_jedec_id = ((uint32_t)spi_nor_response[1] << 16) | ((uint32_t)spi_nor_response[2] << 8) | spi_nor_response[3];
+    capacity_code = spi_nor_response[3];
+
+    // No chip answers 0x00 or 0xFF as manufacturer; anything below 64 KB
+    // cannot hold a 64 KB block erase
+    if(spi_nor_response[1] == 0x00 || spi_nor_response[1] == 0xFF || capacity_code < 16 || capacity_code > 31) {
+        return 1;
+    }
+
+    spi_nor_capacity = 1UL << capacity_code;
+    if(spi_nor_capacity > SPI_NOR_MAX_CAPACITY) {
+        spi_nor_capacity = SPI_NOR_MAX_CAPACITY;
+    }
+
+    spi_nor_blockdev.block_size = SPI_NOR_BLOCK_SIZE;
+    spi_nor_blockdev.block_count = (spi_nor_capacity - SPI_NOR_SECTOR_SIZE) / SPI_NOR_BLOCK_SIZE;
+    spi_nor_blockdev.read = spi_nor_blockdev_read;
+    spi_nor_blockdev.write = spi_nor_blockdev_write;
+    spi_nor_blockdev.sync = spi_nor_blockdev_sync;
+    spi_nor_blockdev.context = NULL;
+
+    return 0;
+}
+
+uint32_t spi_nor_get_jedec_id(void){
+    return spi_nor_jedec_id;
+}
+
+uint32_t spi_nor_get_capacity(void){
+    return spi_nor_capacity;
+}
+
+const blockdev_t *spi_nor_get_blockdev(void){
+    return spi_nor_capacity ? &spi_nor_blockdev : NULL;
+}
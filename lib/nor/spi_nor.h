@@ -0,0 +1,51 @@
+#ifndef SPI_NOR_H
+#define SPI_NOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+#include "blockdev.h"
+
+#define SPI_NOR_PAGE_SIZE   256
+#define SPI_NOR_SECTOR_SIZE 4096
+#define SPI_NOR_BLOCK_SIZE  512
+
+// Read-ahead window; small reads are served from it until they leave it
+#ifndef SPI_NOR_CACHE_SIZE
+#define SPI_NOR_CACHE_SIZE 1024
+#endif
+
+typedef struct {
+    GPIO_TypeDef *cs_port;
+    uint16_t cs_pin;
+    uint16_t prescaler; // SPI_BaudRatePrescaler_x
+} spi_nor_config_t;
+
+// W25Qxx-style serial NOR flash on the shared SPI1 queue. spi_queue_init()
+// must have been called and the CS port clock enabled. Identifies the chip
+// by JEDEC ID; parts larger than 16 MB are used through 3-byte addressing.
+uint8_t spi_nor_init(const spi_nor_config_t *config);
+uint32_t spi_nor_get_jedec_id(void);
+uint32_t spi_nor_get_capacity(void);
+
+// Raw access, thread context only. Program and erase return as soon as the
+// last command has been sent; the chip finishes in the background and the
+// next access waits for it, so the caller can prepare the next data while
+// the array is busy.
+uint8_t spi_nor_read(uint32_t address, uint8_t *data, uint32_t length);
+uint8_t spi_nor_program(uint32_t address, const uint8_t *data, uint32_t length);
+uint8_t spi_nor_erase(uint32_t address, uint32_t length); // Sector aligned
+uint8_t spi_nor_wait_ready(void);
+uint8_t spi_nor_is_busy(void);
+
+// 512-byte blocks over the whole chip except the last sector, which is kept
+// as scratch space for read-modify-write of blocks that need an erase.
+const blockdev_t *spi_nor_get_blockdev(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
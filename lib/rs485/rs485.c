@@ -0,0 +1,228 @@
+#include <stddef.h>
+
+#include "ch32v10x_dma.h"
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_misc.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_usart.h"
+
+#include "irq_dispatch.h"
+#include "rs485.h"
+
+typedef struct {
+    USART_TypeDef *usart;
+    GPIO_TypeDef *gpio;
+    uint16_t tx_pin;
+    uint16_t rx_pin;
+    DMA_Channel_TypeDef *tx_dma;
+    DMA_Channel_TypeDef *rx_dma;
+    IRQn_Type irq;
+} rs485_port_t;
+
+static const rs485_port_t rs485_ports[] = {
+    {USART1, GPIOA, GPIO_Pin_9, GPIO_Pin_10, DMA1_Channel4, DMA1_Channel5, USART1_IRQn},
+    {USART2, GPIOA, GPIO_Pin_2, GPIO_Pin_3, DMA1_Channel7, DMA1_Channel6, USART2_IRQn},
+    {USART3, GPIOB, GPIO_Pin_10, GPIO_Pin_11, DMA1_Channel2, DMA1_Channel3, USART3_IRQn},
+};
+
+static const rs485_port_t *rs485_port;
+static GPIO_TypeDef *rs485_de_port;
+static uint16_t rs485_de_pin;
+static volatile uint8_t rs485_tx_busy = 0;
+static rs485_tx_complete_t rs485_tx_complete_callback;
+static rs485_rx_idle_t rs485_rx_idle_callback;
+
+static uint8_t rs485_rx_buffer[RS485_RX_BUFFER_SIZE];
+static uint16_t rs485_rx_tail = 0;
+
+// TC is enabled only while a frame is on the wire. Register access is
+// direct so DE drops within a few cycles of the final stop bit.
+static void rs485_usart_irq_handler(void){
+    USART_TypeDef *usart = rs485_port->usart;
+
+    if((usart->CTLR1 & USART_CTLR1_IDLEIE) && (usart->STATR & USART_STATR_IDLE)) {
+        // STATR then DATAR read clears IDLE; the line is quiet, so DMA loses nothing
+        (void)usart->DATAR;
+
+        if(rs485_rx_idle_callback) {
+            rs485_rx_idle_callback();
+        }
+    }
+
+    if((usart->CTLR1 & USART_CTLR1_TCIE) && (usart->STATR & USART_STATR_TC)) {
+        rs485_de_port->BCR = rs485_de_pin;
+        usart->CTLR1 = (usart->CTLR1 & ~USART_CTLR1_TCIE) | USART_CTLR1_RE;
+        rs485_port->tx_dma->CFGR &= ~DMA_CFGR1_EN;
+        rs485_tx_busy = 0;
+
+        if(rs485_tx_complete_callback) {
+            rs485_tx_complete_callback();
+        }
+    }
+}
+
+uint8_t rs485_init(const rs485_config_t *config){
+    GPIO_InitTypeDef GPIO_InitStructure;
+    USART_InitTypeDef USART_InitStructure;
+    DMA_InitTypeDef DMA_InitStructure;
+    NVIC_InitTypeDef NVIC_InitStructure;
+    const rs485_port_t *port = NULL;
+
+    for(uint8_t i = 0; i < sizeof(rs485_ports) / sizeof(rs485_ports[0]); i++) {
+        if(rs485_ports[i].usart == config->usart) {
+            port = &rs485_ports[i];
+        }
+    }
+
+    if(port == NULL) {
+        return 1;
+    }
+
+    rs485_port = port;
+    rs485_de_port = config->de_port;
+    rs485_de_pin = config->de_pin;
+    rs485_tx_busy = 0;
+    rs485_rx_tail = 0;
+
+    // Enable clocks
+    if(port->usart == USART1) {
+        RCC_APB2PeriphClockCmd(RCC_APB2Periph_USART1, ENABLE);
+    } else if(port->usart == USART2) {
+        RCC_APB1PeriphClockCmd(RCC_APB1Periph_USART2, ENABLE);
+    } else {
+        RCC_APB1PeriphClockCmd(RCC_APB1Periph_USART3, ENABLE);
+    }
+
+    RCC_APB2PeriphClockCmd(port->gpio == GPIOA ? RCC_APB2Periph_GPIOA : RCC_APB2Periph_GPIOB, ENABLE);
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+
+    // Driver-enable low: transceiver listening
+    GPIO_ResetBits(config->de_port, config->de_pin);
+    GPIO_InitStructure.GPIO_Pin = config->de_pin;
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_Out_PP;
+    GPIO_Init(config->de_port, &GPIO_InitStructure);
+
+    GPIO_InitStructure.GPIO_Pin = port->tx_pin;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF_PP;
+    GPIO_Init(port->gpio, &GPIO_InitStructure);
+
+    GPIO_InitStructure.GPIO_Pin = port->rx_pin;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IN_FLOATING;
+    GPIO_Init(port->gpio, &GPIO_InitStructure);
+
+    // TX DMA: memory address and length are set per frame
+    DMA_DeInit(port->tx_dma);
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&port->usart->DATAR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = 0;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+    DMA_InitStructure.DMA_BufferSize = 0;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(port->tx_dma, &DMA_InitStructure);
+
+    // RX DMA: free-running ring, read side tracked in software
+    DMA_DeInit(port->rx_dma);
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)rs485_rx_buffer;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+    DMA_InitStructure.DMA_BufferSize = RS485_RX_BUFFER_SIZE;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+    DMA_Init(port->rx_dma, &DMA_InitStructure);
+
+    // Configure USART
+    USART_InitStructure.USART_BaudRate = config->baudrate;
+    USART_InitStructure.USART_WordLength = USART_WordLength_8b;
+    USART_InitStructure.USART_StopBits = USART_StopBits_1;
+    USART_InitStructure.USART_Parity = USART_Parity_No;
+    USART_InitStructure.USART_HardwareFlowControl = USART_HardwareFlowControl_None;
+    USART_InitStructure.USART_Mode = USART_Mode_Rx | USART_Mode_Tx;
+    USART_Init(port->usart, &USART_InitStructure);
+
+    USART_DMACmd(port->usart, USART_DMAReq_Tx | USART_DMAReq_Rx, ENABLE);
+
+    // Highest priority: the bus stays driven until this handler runs
+    irq_attach(port->irq, rs485_usart_irq_handler);
+    NVIC_InitStructure.NVIC_IRQChannel = port->irq;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+
+    DMA_Cmd(port->rx_dma, ENABLE);
+    USART_Cmd(port->usart, ENABLE);
+
+    return 0;
+}
+
+uint8_t rs485_send(const uint8_t *data, uint16_t length){
+    USART_TypeDef *usart = rs485_port->usart;
+    DMA_Channel_TypeDef *tx_dma = rs485_port->tx_dma;
+
+    if(rs485_tx_busy || length == 0) {
+        return 1;
+    }
+
+    rs485_tx_busy = 1;
+
+    // Receiver off so our own echo never reaches the RX ring
+    usart->CTLR1 &= ~USART_CTLR1_RE;
+    rs485_de_port->BSHR = rs485_de_pin;
+
+    tx_dma->CFGR &= ~DMA_CFGR1_EN;
+    tx_dma->MADDR = (uint32_t)data;
+    tx_dma->CNTR = length;
+
+    // TC is cleared by writing 0; it sets again only after the last stop bit
+    usart->STATR = (uint16_t)~USART_STATR_TC;
+    usart->CTLR1 |= USART_CTLR1_TCIE;
+    tx_dma->CFGR |= DMA_CFGR1_EN;
+
+    return 0;
+}
+
+uint8_t rs485_is_busy(void){
+    return rs485_tx_busy;
+}
+
+void rs485_set_tx_complete_callback(rs485_tx_complete_t callback){
+    rs485_tx_complete_callback = callback;
+}
+
+void rs485_set_rx_idle_callback(rs485_rx_idle_t callback){
+    rs485_rx_idle_callback = callback;
+
+    if(callback) {
+        rs485_port->usart->CTLR1 |= USART_CTLR1_IDLEIE;
+    } else {
+        rs485_port->usart->CTLR1 &= ~USART_CTLR1_IDLEIE;
+    }
+}
+
+static uint16_t rs485_rx_head(void){
+    return (RS485_RX_BUFFER_SIZE - rs485_port->rx_dma->CNTR) % RS485_RX_BUFFER_SIZE;
+}
+
+uint16_t rs485_available(void){
+    return (rs485_rx_head() - rs485_rx_tail + RS485_RX_BUFFER_SIZE) % RS485_RX_BUFFER_SIZE;
+}
+
+uint16_t rs485_read(uint8_t *data, uint16_t max_length){
+    uint16_t head = rs485_rx_head();
+    uint16_t count = 0;
+
+    while(rs485_rx_tail != head && count < max_length) {
+        data[count++] = rs485_rx_buffer[rs485_rx_tail];
+        rs485_rx_tail = (rs485_rx_tail + 1) % RS485_RX_BUFFER_SIZE;
+    }
+
+    return count;
+}
+
+void rs485_flush_rx(void){
+    rs485_rx_tail = rs485_rx_head();
+}
@@ -0,0 +1,47 @@
+#ifndef RS485_H
+#define RS485_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+
+// Must hold at least one full frame of the protocol running on top
+#ifndef RS485_RX_BUFFER_SIZE
+#define RS485_RX_BUFFER_SIZE 512
+#endif
+
+typedef struct {
+    USART_TypeDef *usart;   // USART1 (PA9/PA10), USART2 (PA2/PA3) or USART3 (PB10/PB11)
+    uint32_t baudrate;
+    GPIO_TypeDef *de_port;  // DE and /RE of the transceiver tied together; clock enabled by caller
+    uint16_t de_pin;
+} rs485_config_t;
+
+typedef void (*rs485_tx_complete_t)(void);
+typedef void (*rs485_rx_idle_t)(void);
+
+uint8_t rs485_init(const rs485_config_t *config);
+
+// Starts a DMA transmission straight from data, which must stay untouched
+// until rs485_is_busy() returns 0. Returns 1 if a frame is still in flight.
+uint8_t rs485_send(const uint8_t *data, uint16_t length);
+uint8_t rs485_is_busy(void);
+
+// Called from the USART interrupt right after DE has been released.
+void rs485_set_tx_complete_callback(rs485_tx_complete_t callback);
+
+// Called from the USART interrupt once the line has been idle for one
+// character after receiving data. Passing NULL disables the interrupt.
+void rs485_set_rx_idle_callback(rs485_rx_idle_t callback);
+
+uint16_t rs485_available(void);
+uint16_t rs485_read(uint8_t *data, uint16_t max_length);
+void rs485_flush_rx(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
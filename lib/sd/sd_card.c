@@ -0,0 +1,687 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "ch32v10x_spi.h"
+#include "debug.h"
+
+#include "sd_card.h"
+#include "spi_queue.h"
+
+// Commands (ACMDs are flagged so sd_card_command() prefixes CMD55)
+#define SD_CMD0   0
+#define SD_CMD8   8
+#define SD_CMD9   9
+#define SD_CMD12  12
+#define SD_CMD16  16
+#define SD_CMD17  17
+#define SD_CMD18  18
+#define SD_CMD24  24
+#define SD_CMD25  25
+#define SD_CMD55  55
+#define SD_CMD58  58
+#define SD_CMD59  59
+#define SD_ACMD   0x80
+#define SD_ACMD23 (SD_ACMD | 23)
+#define SD_ACMD41 (SD_ACMD | 41)
+
+#define SD_R1_IDLE 0x01
+
+#define SD_TOKEN_START        0xFE
+#define SD_TOKEN_START_MULTI  0xFC
+#define SD_TOKEN_STOP_MULTI   0xFD
+#define SD_DATA_ACCEPTED      0x05
+
+// Answers normally arrive within a few bytes, so polls start back to back
+// and are only spaced out once the card is clearly busy
+#define SD_FAST_POLLS          64
+#define SD_POLL_INTERVAL_US    10
+#define SD_COMMAND_TIMEOUT_US  1000
+#define SD_READ_TIMEOUT_US     100000
+#define SD_WRITE_TIMEOUT_US    500000
+#define SD_INIT_TIMEOUT_MS     1000
+
+#define SD_CACHE_EMPTY 0xFFFFFFFF
+
+typedef struct {
+    uint32_t block;
+    uint32_t stamp;
+    uint8_t dirty;
+} sd_card_cache_entry_t;
+
+// CRC-16/XMODEM as used for SD data blocks
+static const uint16_t sd_card_crc16_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+
+static uint8_t sd_card_sdhc = 0;
+static uint32_t sd_card_block_count = 0;
+static sd_card_stats_t sd_card_stats;
+
+// CS is driven here rather than by the queue since it stays low across a
+// whole command; the bus is locked to the card for as long as it is low
+static spi_device_t sd_card_device;
+static GPIO_TypeDef *sd_card_cs_port;
+static uint16_t sd_card_cs_pin;
+static spi_transaction_t sd_card_transfer;
+static spi_transaction_t sd_card_token;
+static spi_transaction_t sd_card_data;
+static spi_transaction_t sd_card_crc;
+static uint8_t sd_card_frame[6];
+static uint8_t sd_card_byte[2];
+static uint8_t sd_card_crc_buffer[2];
+
+static uint8_t sd_card_cache_data[SD_CARD_CACHE_BLOCKS][SD_CARD_BLOCK_SIZE];
+static sd_card_cache_entry_t sd_card_cache[SD_CARD_CACHE_BLOCKS];
+static uint32_t sd_card_cache_clock = 0;
+
+static blockdev_t sd_card_blockdev;
+
+static uint16_t sd_card_crc16(const uint8_t *data, uint16_t length){
+    uint16_t crc = 0;
+
+    while(length--) {
+        crc = (crc << 8) ^ sd_card_crc16_table[((crc >> 8) ^ *data++) & 0xFF];
+    }
+
+    return crc;
+}
+
+static uint8_t sd_card_crc7(const uint8_t *data, uint8_t length){
+    uint8_t crc = 0;
+
+    while(length--) {
+        crc ^= *data++;
+        for(uint8_t bit = 0; bit < 8; bit++) {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x12 : crc << 1;
+        }
+    }
+
+    return crc | 0x01;
+}
+
+static void sd_card_init_transaction(spi_transaction_t *transaction){
+    memset(transaction, 0, sizeof(*transaction));
+    transaction->device = &sd_card_device;
+}
+
+static void sd_card_set_prescaler(uint16_t prescaler){
+    spi_device_init(&sd_card_device, NULL, 0, 0, prescaler);
+}
+
+static void sd_card_wait(spi_transaction_t *transaction){
+    while(transaction->status != SPI_TRANSACTION_DONE);
+}
+
+static void sd_card_exchange(const uint8_t *tx, uint8_t *rx, uint16_t length){
+    sd_card_transfer.tx_buffer = tx;
+    sd_card_transfer.rx_buffer = rx;
+    sd_card_transfer.length = length;
+    spi_queue_submit(&sd_card_transfer);
+    sd_card_wait(&sd_card_transfer);
+}
+
+static uint8_t sd_card_receive_byte(void){
+    sd_card_exchange(NULL, sd_card_byte, 1);
+    return sd_card_byte[0];
+}
+
+// Clocks 0xFF until the card's answer equals `value` (match = 1) or
+// differs from it (match = 0)
+static uint8_t sd_card_poll(uint8_t value, uint8_t match, uint32_t timeout_us, uint8_t *response){
+    uint32_t polls = timeout_us / SD_POLL_INTERVAL_US;
+    uint8_t received;
+
+    for(uint8_t i = 0; i < SD_FAST_POLLS; i++) {
+        received = sd_card_receive_byte();
+        if((received == value) == match) {
+            *response = received;
+            return 0;
+        }
+    }
+
+    while(polls--) {
+        Delay_Us(SD_POLL_INTERVAL_US);
+        received = sd_card_receive_byte();
+        if((received == value) == match) {
+            *response = received;
+            return 0;
+        }
+    }
+
+    sd_card_stats.timeouts++;
+    return 1;
+}
+
+// Clocks 0xFF until the card answers something other than `idle`
+static uint8_t sd_card_wait_response(uint8_t idle, uint32_t timeout_us, uint8_t *response){
+    return sd_card_poll(idle, 0, timeout_us, response);
+}
+
+// A busy card holds MISO low. Only a released bus (0xFF) means ready; a
+// byte still shifting out of the busy signal is not.
+static uint8_t sd_card_wait_ready(uint32_t timeout_us){
+    uint8_t response;
+
+    return sd_card_poll(0xFF, 1, timeout_us, &response);
+}
+
+static void sd_card_deselect(void){
+    sd_card_cs_port->BSHR = sd_card_cs_pin;
+
+    // One more clock so the card releases MISO
+    sd_card_receive_byte();
+    spi_queue_unlock(&sd_card_device);
+}
+
+static uint8_t sd_card_select(void){
+    // Another driver may hold the bus for a moment with its own CS low
+    while(spi_queue_lock(&sd_card_device) != 0);
+
+    sd_card_cs_port->BCR = sd_card_cs_pin;
+
+    if(sd_card_wait_ready(SD_WRITE_TIMEOUT_US) != 0) {
+        sd_card_deselect();
+        return 1;
+    }
+
+    return 0;
+}
+
+// Sends a command with CS left asserted; returns R1 or 0xFF on failure.
+// The caller deselects once any data phase is over.
+static uint8_t sd_card_command(uint8_t command, uint32_t argument){
+    uint8_t r1;
+
+    if(command & SD_ACMD) {
+        r1 = sd_card_command(SD_CMD55, 0);
+        if(r1 > SD_R1_IDLE) {
+            return r1;
+        }
+        command &= ~SD_ACMD;
+    }
+
+    if(command != SD_CMD12) {
+        sd_card_deselect();
+        if(sd_card_select() != 0) {
+            return 0xFF;
+        }
+    }
+
+    sd_card_frame[0] = 0x40 | command;
+    sd_card_frame[1] = argument >> 24;
+    sd_card_frame[2] = argument >> 16;
+    sd_card_frame[3] = argument >> 8;
+    sd_card_frame[4] = argument;
+    sd_card_frame[5] = sd_card_crc7(sd_card_frame, 5);
+    sd_card_exchange(sd_card_frame, NULL, 6);
+
+    // CMD12 is followed by a stuff byte
+    if(command == SD_CMD12) {
+        sd_card_receive_byte();
+    }
+
+    if(sd_card_wait_response(0xFF, SD_COMMAND_TIMEOUT_US, &r1) != 0 || (r1 & 0x80)) {
+        return 0xFF;
+    }
+
+    return r1;
+}
+
+// Starts one block of `length` bytes streaming into `data` with its CRC
+// into sd_card_crc_buffer. Returns once the start token has arrived.
+static uint8_t sd_card_start_receive(uint8_t *data, uint16_t length){
+    spi_transaction_t *chain[2] = { &sd_card_data, &sd_card_crc };
+    uint8_t token;
+
+    if(sd_card_wait_response(0xFF, SD_READ_TIMEOUT_US, &token) != 0 || token != SD_TOKEN_START) {
+        return 1;
+    }
+
+    sd_card_data.tx_buffer = NULL;
+    sd_card_data.rx_buffer = data;
+    sd_card_data.length = length;
+    sd_card_crc.tx_buffer = NULL;
+    sd_card_crc.rx_buffer = sd_card_crc_buffer;
+    spi_queue_submit_chain(chain, 2);
+
+    return 0;
+}
+
+static uint8_t sd_card_check_crc(const uint8_t *data, uint16_t length, uint16_t crc){
+#if SD_CARD_USE_CRC
+    if(sd_card_crc16(data, length) != crc) {
+        sd_card_stats.crc_errors++;
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+static uint8_t sd_card_read_blocks(uint32_t block, uint8_t *data, uint32_t count){
+    const uint8_t *previous = NULL;
+    uint16_t previous_crc = 0;
+    uint8_t error = 0;
+
+    if(sd_card_command(count == 1 ? SD_CMD17 : SD_CMD18, sd_card_sdhc ? block : block * SD_CARD_BLOCK_SIZE) != 0) {
+        sd_card_deselect();
+        return 1;
+    }
+
+    for(uint32_t i = 0; i < count && !error; i++) {
+        if(sd_card_start_receive(data, SD_CARD_BLOCK_SIZE) != 0) {
+            error = 1;
+            break;
+        }
+
+        // Check the previous block while this one streams in
+        if(previous) {
+            error = sd_card_check_crc(previous, SD_CARD_BLOCK_SIZE, previous_crc);
+        }
+
+        sd_card_wait(&sd_card_crc);
+        previous = data;
+        previous_crc = (sd_card_crc_buffer[0] << 8) | sd_card_crc_buffer[1];
+        data += SD_CARD_BLOCK_SIZE;
+    }
+
+    if(!error && previous) {
+        error = sd_card_check_crc(previous, SD_CARD_BLOCK_SIZE, previous_crc);
+    }
+
+    if(count > 1) {
+        sd_card_command(SD_CMD12, 0);
+        sd_card_wait_ready(SD_WRITE_TIMEOUT_US);
+    }
+
+    sd_card_deselect();
+
+    return error;
+}
+
+static uint8_t sd_card_write_blocks(uint32_t block, const uint8_t *data, uint32_t count){
+    spi_transaction_t *chain[3] = { &sd_card_token, &sd_card_data, &sd_card_crc };
+    uint16_t crc = sd_card_crc16(data, SD_CARD_BLOCK_SIZE);
+    uint8_t response = 0xFF;
+    uint8_t error = 0;
+
+    // Pre-erase hint lets the card prepare the whole run; failure is harmless
+    if(count > 1) {
+        sd_card_command(SD_ACMD23, count);
+    }
+
+    if(sd_card_command(count == 1 ? SD_CMD24 : SD_CMD25, sd_card_sdhc ? block : block * SD_CARD_BLOCK_SIZE) != 0) {
+        sd_card_deselect();
+        return 1;
+    }
+
+    // One gap byte, then the start token
+    sd_card_byte[0] = 0xFF;
+    sd_card_byte[1] = count == 1 ? SD_TOKEN_START : SD_TOKEN_START_MULTI;
+    sd_card_token.tx_buffer = sd_card_byte;
+    sd_card_token.rx_buffer = NULL;
+    sd_card_token.length = 2;
+    sd_card_crc.rx_buffer = NULL;
+    sd_card_crc.tx_buffer = sd_card_crc_buffer;
+
+    for(uint32_t i = 0; i < count; i++) {
+        sd_card_crc_buffer[0] = crc >> 8;
+        sd_card_crc_buffer[1] = crc;
+        sd_card_data.tx_buffer = data;
+        sd_card_data.rx_buffer = NULL;
+        sd_card_data.length = SD_CARD_BLOCK_SIZE;
+        spi_queue_submit_chain(chain, 3);
+
+        // CRC of the next block is computed while this one goes out
+        data += SD_CARD_BLOCK_SIZE;
+        if(i + 1 < count) {
+            crc = sd_card_crc16(data, SD_CARD_BLOCK_SIZE);
+        }
+
+        sd_card_wait(&sd_card_crc);
+
+        if(sd_card_wait_response(0xFF, SD_COMMAND_TIMEOUT_US, &response) != 0 ||
+           (response & 0x1F) != SD_DATA_ACCEPTED) {
+            if((response & 0x1F) == 0x0B) {
+                sd_card_stats.crc_errors++;
+            }
+            error = 1;
+            break;
+        }
+
+        if(sd_card_wait_ready(SD_WRITE_TIMEOUT_US) != 0) {
+            error = 1;
+            break;
+        }
+    }
+
+    if(count > 1) {
+        sd_card_byte[1] = SD_TOKEN_STOP_MULTI;
+        sd_card_exchange(sd_card_byte, NULL, 2);
+        if(sd_card_wait_ready(SD_WRITE_TIMEOUT_US) != 0) {
+            error = 1;
+        }
+    }
+
+    sd_card_deselect();
+
+    return error;
+}
+
+static uint8_t sd_card_cache_find(uint32_t block){
+    for(uint8_t i = 0; i < SD_CARD_CACHE_BLOCKS; i++) {
+        if(sd_card_cache[i].block == block) {
+            return i;
+        }
+    }
+
+    return SD_CARD_CACHE_BLOCKS;
+}
+
+static uint8_t sd_card_cache_writeback(uint8_t index){
+    if(!sd_card_cache[index].dirty) {
+        return 0;
+    }
+
+    if(sd_card_write_blocks(sd_card_cache[index].block, sd_card_cache_data[index], 1) != 0) {
+        return 1;
+    }
+
+    sd_card_cache[index].dirty = 0;
+    sd_card_stats.writebacks++;
+
+    return 0;
+}
+
+// Frees the least recently used entry, writing it back if dirty
+static uint8_t sd_card_cache_evict(uint8_t *index){
+    uint8_t victim = 0;
+
+    for(uint8_t i = 1; i < SD_CARD_CACHE_BLOCKS; i++) {
+        if(sd_card_cache[i].block == SD_CACHE_EMPTY) {
+            victim = i;
+            break;
+        }
+        if(sd_card_cache[victim].block != SD_CACHE_EMPTY && sd_card_cache[i].stamp < sd_card_cache[victim].stamp) {
+            victim = i;
+        }
+    }
+
+    if(sd_card_cache_writeback(victim) != 0) {
+        return 1;
+    }
+
+    sd_card_cache[victim].block = SD_CACHE_EMPTY;
+    *index = victim;
+
+    return 0;
+}
+
+static void sd_card_cache_touch(uint8_t index, uint32_t block){
+    sd_card_cache[index].block = block;
+    sd_card_cache[index].stamp = ++sd_card_cache_clock;
+}
+
+static uint8_t sd_card_blockdev_read(const blockdev_t *dev, uint32_t block, uint8_t *data, uint32_t count){
+    uint8_t index;
+
+    if(block >= sd_card_block_count || count > sd_card_block_count - block) {
+        return 1;
+    }
+
+    if(count > 1) {
+        if(sd_card_read_blocks(block, data, count) != 0) {
+            return 1;
+        }
+
+        // Cached blocks not yet written back are newer than the card
+        for(index = 0; index < SD_CARD_CACHE_BLOCKS; index++) {
+            if(sd_card_cache[index].dirty && sd_card_cache[index].block - block < count) {
+                memcpy(data + (sd_card_cache[index].block - block) * SD_CARD_BLOCK_SIZE,
+                       sd_card_cache_data[index], SD_CARD_BLOCK_SIZE);
+            }
+        }
+
+        return 0;
+    }
+
+    index = sd_card_cache_find(block);
+    if(index < SD_CARD_CACHE_BLOCKS) {
+        sd_card_stats.cache_hits++;
+    } else {
+        sd_card_stats.cache_misses++;
+        if(sd_card_cache_evict(&index) != 0 ||
+           sd_card_read_blocks(block, sd_card_cache_data[index], 1) != 0) {
+            return 1;
+        }
+    }
+
+    sd_card_cache_touch(index, block);
+    memcpy(data, sd_card_cache_data[index], SD_CARD_BLOCK_SIZE);
+
+    return 0;
+}
+
+static uint8_t sd_card_blockdev_write(const blockdev_t *dev, uint32_t block, const uint8_t *data, uint32_t count){
+    uint8_t index;
+
+    if(block >= sd_card_block_count || count > sd_card_block_count - block) {
+        return 1;
+    }
+
+    if(count > 1) {
+        if(sd_card_write_blocks(block, data, count) != 0) {
+            return 1;
+        }
+
+        // Keep cached copies in step; they now match the card
+        for(index = 0; index < SD_CARD_CACHE_BLOCKS; index++) {
+            if(sd_card_cache[index].block != SD_CACHE_EMPTY && sd_card_cache[index].block - block < count) {
+                memcpy(sd_card_cache_data[index], data + (sd_card_cache[index].block - block) * SD_CARD_BLOCK_SIZE,
+                       SD_CARD_BLOCK_SIZE);
+                sd_card_cache[index].dirty = 0;
+            }
+        }
+
+        return 0;
+    }
+
+    index = sd_card_cache_find(block);
+    if(index < SD_CARD_CACHE_BLOCKS) {
+        sd_card_stats.cache_hits++;
+    } else {
+        sd_card_stats.cache_misses++;
+        if(sd_card_cache_evict(&index) != 0) {
+            return 1;
+        }
+    }
+
+    sd_card_cache_touch(index, block);
+    memcpy(sd_card_cache_data[index], data, SD_CARD_BLOCK_SIZE);
+    sd_card_cache[index].dirty = 1;
+
+    return 0;
+}
+
+static uint8_t sd_card_blockdev_sync(const blockdev_t *dev){
+    uint8_t error = 0;
+
+    for(uint8_t i = 0; i < SD_CARD_CACHE_BLOCKS; i++) {
+        error |= sd_card_cache_writeback(i);
+    }
+
+    return error;
+}
+
+static uint8_t sd_card_read_csd(void){
+    uint8_t csd[16];
+    uint32_t c_size;
+    uint8_t error;
+
+    if(sd_card_command(SD_CMD9, 0) != 0 || sd_card_start_receive(csd, 16) != 0) {
+        sd_card_deselect();
+        return 1;
+    }
+
+    sd_card_wait(&sd_card_crc);
+    error = sd_card_check_crc(csd, 16, (sd_card_crc_buffer[0] << 8) | sd_card_crc_buffer[1]);
+    sd_card_deselect();
+
+    if(error) {
+        return 1;
+    }
+
+    if((csd[0] >> 6) == 1) {
+        // CSD 2.0: C_SIZE[69:48] in units of 512 KB
+        c_size = ((uint32_t)(csd[7] & 0x3F) << 16) | ((uint32_t)csd[8] << 8) | csd[9];
+        sd_card_block_count = (c_size + 1) << 10;
+    } else {
+        // CSD 1.0: (C_SIZE + 1) << (C_SIZE_MULT + 2) blocks of READ_BL_LEN
+        uint8_t read_bl_len = csd[5] & 0x0F;
+        uint8_t c_size_mult = ((csd[9] & 0x03) << 1) | (csd[10] >> 7);
+
+        c_size = ((uint32_t)(csd[6] & 0x03) << 10) | ((uint32_t)csd[7] << 2) | (csd[8] >> 6);
+        sd_card_block_count = (c_size + 1) << (c_size_mult + 2 + read_bl_len - 9);
+    }
+
+    return 0;
+}
+
+uint8_t sd_card_init(const sd_card_config_t *config){
+    uint8_t response[4];
+    uint32_t acmd41_argument = 0;
+    uint16_t tries;
+
+    sd_card_sdhc = 0;
+    sd_card_block_count = 0;
+    memset(&sd_card_stats, 0, sizeof(sd_card_stats));
+
+    for(uint8_t i = 0; i < SD_CARD_CACHE_BLOCKS; i++) {
+        sd_card_cache[i].block = SD_CACHE_EMPTY;
+        sd_card_cache[i].dirty = 0;
+    }
+
+    sd_card_cs_port = config->cs_port;
+    sd_card_cs_pin = config->cs_pin;
+    spi_queue_init_cs(config->cs_port, config->cs_pin);
+
+    sd_card_init_transaction(&sd_card_transfer);
+    sd_card_init_transaction(&sd_card_token);
+    sd_card_init_transaction(&sd_card_data);
+    sd_card_init_transaction(&sd_card_crc);
+    sd_card_crc.length = 2;
+
+    // Identification runs below 400 kHz
+    sd_card_set_prescaler(SPI_BaudRatePrescaler_256);
+
+    // At least 74 clocks with CS high to enter native mode, then CMD0 for SPI mode
+    for(uint8_t i = 0; i < 10; i++) {
+        sd_card_receive_byte();
+    }
+
+    for(tries = 0; sd_card_command(SD_CMD0, 0) != SD_R1_IDLE; tries++) {
+        if(tries == 10) {
+            sd_card_deselect();
+            return 1;
+        }
+    }
+
+    // CMD8 is only answered by version 2 cards, which may be SDHC
+    if(sd_card_command(SD_CMD8, 0x1AA) == SD_R1_IDLE) {
+        sd_card_exchange(NULL, response, 4);
+        if(response[2] != 0x01 || response[3] != 0xAA) {
+            sd_card_deselect();
+            return 1;
+        }
+        acmd41_argument = 1UL << 30;
+    }
+
+    for(tries = 0; sd_card_command(SD_ACMD41, acmd41_argument) != 0; tries++) {
+        if(tries == SD_INIT_TIMEOUT_MS) {
+            sd_card_deselect();
+            return 1;
+        }
+        Delay_Ms(1);
+    }
+
+    if(acmd41_argument) {
+        if(sd_card_command(SD_CMD58, 0) != 0) {
+            sd_card_deselect();
+            return 1;
+        }
+        sd_card_exchange(NULL, response, 4);
+        sd_card_sdhc = (response[0] & 0x40) != 0;
+    }
+
+    if(!sd_card_sdhc && sd_card_command(SD_CMD16, SD_CARD_BLOCK_SIZE) != 0) {
+        sd_card_deselect();
+        return 1;
+    }
+
+    if(sd_card_command(SD_CMD59, SD_CARD_USE_CRC) != 0) {
+        sd_card_deselect();
+        return 1;
+    }
+
+    sd_card_deselect();
+    sd_card_set_prescaler(config->prescaler);
+
+    if(sd_card_read_csd() != 0) {
+        return 1;
+    }
+
+    sd_card_blockdev.block_size = SD_CARD_BLOCK_SIZE;
+    sd_card_blockdev.block_count = sd_card_block_count;
+    sd_card_blockdev.read = sd_card_blockdev_read;
+    sd_card_blockdev.write = sd_card_blockdev_write;
+    sd_card_blockdev.sync = sd_card_blockdev_sync;
+    sd_card_blockdev.context = NULL;
+
+    return 0;
+}
+
+uint8_t sd_card_is_sdhc(void){
+    return sd_card_sdhc;
+}
+
+uint32_t sd_card_get_block_count(void){
+    return sd_card_block_count;
+}
+
+const sd_card_stats_t *sd_card_get_stats(void){
+    return &sd_card_stats;
+}
+
+const blockdev_t *sd_card_get_blockdev(void){
+    return sd_card_block_count ? &sd_card_blockdev : NULL;
+}
@@ -0,0 +1,54 @@
+#ifndef SD_CARD_H
+#define SD_CARD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+#include "blockdev.h"
+
+#define SD_CARD_BLOCK_SIZE 512
+
+// Write-back cache for single-block traffic (FAT and directory sectors).
+// Multi-block transfers bypass it and go straight to CMD18/CMD25.
+#ifndef SD_CARD_CACHE_BLOCKS
+#define SD_CARD_CACHE_BLOCKS 4
+#endif
+
+// Set to 0 to run the card with CRC checking off (CMD59)
+#ifndef SD_CARD_USE_CRC
+#define SD_CARD_USE_CRC 1
+#endif
+
+typedef struct {
+    GPIO_TypeDef *cs_port;
+    uint16_t cs_pin;
+    uint16_t prescaler; // SPI_BaudRatePrescaler_x after init, 25 MHz max
+} sd_card_config_t;
+
+typedef struct {
+    uint32_t cache_hits;
+    uint32_t cache_misses;
+    uint32_t writebacks;
+    uint32_t crc_errors;
+    uint32_t timeouts;
+} sd_card_stats_t;
+
+// SD/SDHC card in SPI mode on the shared SPI1 queue. spi_queue_init() must
+// have been called and the CS port clock enabled. A command holds CS over
+// several queue transactions and locks the bus meanwhile; transfers for
+// other SPI1 devices wait in the queue. Thread context only.
+uint8_t sd_card_init(const sd_card_config_t *config);
+uint8_t sd_card_is_sdhc(void);
+uint32_t sd_card_get_block_count(void);
+const sd_card_stats_t *sd_card_get_stats(void);
+
+// Block device over the cache; sync() writes back dirty blocks
+const blockdev_t *sd_card_get_blockdev(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
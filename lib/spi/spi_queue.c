@@ -0,0 +1,345 @@
+#include <stddef.h>
+
+#include "ch32v10x_dma.h"
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_misc.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_spi.h"
+
+#include "irq_dispatch.h"
+#include "spi_queue.h"
+
+#define SPI_QUEUE_RX_DMA DMA1_Channel2
+#define SPI_QUEUE_TX_DMA DMA1_Channel3
+
+#define DMA_CFGR1_SIZE_MASK (DMA_CFGR1_PSIZE | DMA_CFGR1_MSIZE)
+
+// Transactions waiting for the bus, in submission order
+static spi_transaction_t *spi_queue_head = NULL;
+static spi_transaction_t *spi_queue_tail = NULL;
+
+static spi_transaction_t *volatile spi_queue_active = NULL;
+static const spi_device_t *volatile spi_queue_owner = NULL;
+
+// Last value written to CTLR1, so a start never has to read it back
+static uint16_t spi_queue_ctlr1;
+
+// Source and sink for transactions without a TX or RX buffer
+static const uint16_t spi_queue_dummy_tx = 0xFFFF;
+static uint16_t spi_queue_dummy_rx;
+
+static void spi_queue_start(spi_transaction_t *transaction){
+    const spi_device_t *device = transaction->device;
+    uint16_t ctlr1 = device->ctlr1;
+    uint16_t dma_size = 0;
+
+    if(transaction->flags & SPI_TRANSACTION_16BIT) {
+        ctlr1 |= SPI_CTLR1_DFF;
+        dma_size = DMA_CFGR1_PSIZE_0 | DMA_CFGR1_MSIZE_0;
+    }
+
+    spi_queue_active = transaction;
+    transaction->status = SPI_TRANSACTION_ACTIVE;
+
+    // Mode, clock and frame size can only change with the peripheral disabled
+    if(ctlr1 != spi_queue_ctlr1) {
+        SPI1->CTLR1 = ctlr1 & ~SPI_CTLR1_SPE;
+        SPI1->CTLR1 = ctlr1;
+        spi_queue_ctlr1 = ctlr1;
+    }
+
+    SPI_QUEUE_RX_DMA->CFGR = (SPI_QUEUE_RX_DMA->CFGR & ~DMA_CFGR1_SIZE_MASK) | dma_size;
+    SPI_QUEUE_TX_DMA->CFGR = (SPI_QUEUE_TX_DMA->CFGR & ~DMA_CFGR1_SIZE_MASK) | dma_size;
+
+    if(transaction->rx_buffer) {
+        SPI_QUEUE_RX_DMA->MADDR = (uint32_t)transaction->rx_buffer;
+        SPI_QUEUE_RX_DMA->CFGR |= DMA_CFGR1_MINC;
+    } else {
+        SPI_QUEUE_RX_DMA->MADDR = (uint32_t)&spi_queue_dummy_rx;
+        SPI_QUEUE_RX_DMA->CFGR &= ~DMA_CFGR1_MINC;
+    }
+
+    if(transaction->tx_buffer) {
+        SPI_QUEUE_TX_DMA->MADDR = (uint32_t)transaction->tx_buffer;
+        SPI_QUEUE_TX_DMA->CFGR |= DMA_CFGR1_MINC;
+    } else {
+        SPI_QUEUE_TX_DMA->MADDR = (uint32_t)&spi_queue_dummy_tx;
+        SPI_QUEUE_TX_DMA->CFGR &= ~DMA_CFGR1_MINC;
+    }
+
+    SPI_QUEUE_RX_DMA->CNTR = transaction->length;
+    SPI_QUEUE_TX_DMA->CNTR = transaction->length;
+
+    if(device->cs_port) {
+        device->cs_port->BCR = device->cs_pin;
+    }
+
+    // RX first so the first received byte always has a taker
+    SPI_QUEUE_RX_DMA->CFGR |= DMA_CFGR1_EN;
+    SPI_QUEUE_TX_DMA->CFGR |= DMA_CFGR1_EN;
+}
+
+// Unlinks the oldest waiting transaction for a device, or the oldest of
+// all if device is NULL. Caller holds irq_lock() or runs in the DMA IRQ.
+static spi_transaction_t *spi_queue_take(const spi_device_t *device){
+    spi_transaction_t *previous = NULL;
+    spi_transaction_t *transaction = spi_queue_head;
+
+    while(transaction && device && transaction->device != device) {
+        previous = transaction;
+        transaction = transaction->next;
+    }
+
+    if(transaction == NULL) {
+        return NULL;
+    }
+
+    if(previous) {
+        previous->next = transaction->next;
+    } else {
+        spi_queue_head = transaction->next;
+    }
+
+    if(spi_queue_tail == transaction) {
+        spi_queue_tail = previous;
+    }
+
+    transaction->next = NULL;
+    return transaction;
+}
+
+// Starts the next transaction on an idle bus: the owner's work, or while
+// the bus is not owned, the oldest of all
+static void spi_queue_dispatch(void){
+    spi_transaction_t *next = spi_queue_take(spi_queue_owner);
+
+    if(next) {
+        spi_queue_start(next);
+    }
+}
+
+// RX completion means the last bit has been clocked in: release CS and
+// chain straight into the next transaction before running the callback.
+static void spi_queue_rx_irq_handler(void){
+    spi_transaction_t *done = spi_queue_active;
+    spi_transaction_t *next = NULL;
+
+    if(DMA_GetITStatus(DMA1_IT_TC2) == RESET) {
+        return;
+    }
+
+    DMA_ClearITPendingBit(DMA1_IT_GL2);
+    SPI_QUEUE_RX_DMA->CFGR &= ~DMA_CFGR1_EN;
+    SPI_QUEUE_TX_DMA->CFGR &= ~DMA_CFGR1_EN;
+
+    spi_queue_active = NULL;
+
+    // The rest of a KEEP_CS chain goes first. With nothing left in it, CS
+    // is released like at any other end, before another device can start.
+    if(done->flags & SPI_TRANSACTION_KEEP_CS) {
+        next = spi_queue_take(done->device);
+    }
+
+    if(next) {
+        spi_queue_start(next);
+    } else {
+        if(done->device->cs_port) {
+            done->device->cs_port->BSHR = done->device->cs_pin;
+        }
+        spi_queue_dispatch();
+    }
+
+    done->status = SPI_TRANSACTION_DONE;
+
+    if(done->callback) {
+        done->callback(done);
+    }
+}
+
+void spi_queue_init(void){
+    GPIO_InitTypeDef GPIO_InitStructure;
+    SPI_InitTypeDef SPI_InitStructure;
+    DMA_InitTypeDef DMA_InitStructure;
+    NVIC_InitTypeDef NVIC_InitStructure;
+
+    spi_queue_head = NULL;
+    spi_queue_tail = NULL;
+    spi_queue_active = NULL;
+    spi_queue_owner = NULL;
+
+    // Enable clocks
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA | RCC_APB2Periph_SPI1, ENABLE);
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+
+    // Configure SPI1 pins
+    // PA5 - SCK, PA6 - MISO, PA7 - MOSI
+    GPIO_InitStructure.GPIO_Pin = GPIO_Pin_5 | GPIO_Pin_7;
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF_PP;
+    GPIO_Init(GPIOA, &GPIO_InitStructure);
+
+    GPIO_InitStructure.GPIO_Pin = GPIO_Pin_6;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IN_FLOATING;
+    GPIO_Init(GPIOA, &GPIO_InitStructure);
+
+    // Configure DMA for SPI1 RX (Channel 2); addresses and lengths are set per transaction
+    DMA_DeInit(SPI_QUEUE_RX_DMA);
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&SPI1->DATAR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)&spi_queue_dummy_rx;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+    DMA_InitStructure.DMA_BufferSize = 0;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(SPI_QUEUE_RX_DMA, &DMA_InitStructure);
+
+    // Configure DMA for SPI1 TX (Channel 3)
+    DMA_DeInit(SPI_QUEUE_TX_DMA);
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)&spi_queue_dummy_tx;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+    DMA_Init(SPI_QUEUE_TX_DMA, &DMA_InitStructure);
+
+    DMA_ITConfig(SPI_QUEUE_RX_DMA, DMA_IT_TC, ENABLE);
+
+    irq_attach(DMA1_Channel2_IRQn, spi_queue_rx_irq_handler);
+    NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel2_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+
+    // Configure SPI1; CTLR1 is replaced by each device's image, CTLR2 only
+    // ever holds the two DMA requests
+    SPI_InitStructure.SPI_Direction = SPI_Direction_2Lines_FullDuplex;
+    SPI_InitStructure.SPI_Mode = SPI_Mode_Master;
+    SPI_InitStructure.SPI_DataSize = SPI_DataSize_8b;
+    SPI_InitStructure.SPI_CPOL = SPI_CPOL_Low;
+    SPI_InitStructure.SPI_CPHA = SPI_CPHA_1Edge;
+    SPI_InitStructure.SPI_NSS = SPI_NSS_Soft;
+    SPI_InitStructure.SPI_BaudRatePrescaler = SPI_BaudRatePrescaler_64;
+    SPI_InitStructure.SPI_FirstBit = SPI_FirstBit_MSB;
+    SPI_InitStructure.SPI_CRCPolynomial = 7;
+    SPI_Init(SPI1, &SPI_InitStructure);
+
+    SPI_I2S_DMACmd(SPI1, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, ENABLE);
+    SPI_Cmd(SPI1, ENABLE);
+    spi_queue_ctlr1 = SPI1->CTLR1;
+}
+
+void spi_device_init(spi_device_t *device, GPIO_TypeDef *cs_port, uint16_t cs_pin, uint8_t mode, uint16_t prescaler){
+    device->cs_port = cs_port;
+    device->cs_pin = cs_pin;
+
+    // Full duplex, 8-bit, MSB first, software NSS held high
+    device->ctlr1 = SPI_Mode_Master | SPI_NSS_Soft | prescaler | (mode & 0x03) | SPI_CTLR1_SPE;
+
+    if(cs_port) {
+        spi_queue_init_cs(cs_port, cs_pin);
+    }
+}
+
+void spi_queue_init_cs(GPIO_TypeDef *port, uint16_t pin){
+    GPIO_InitTypeDef GPIO_InitStructure;
+
+    GPIO_SetBits(port, pin);
+    GPIO_InitStructure.GPIO_Pin = pin;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_Out_PP;
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+    GPIO_Init(port, &GPIO_InitStructure);
+}
+
+static uint8_t spi_queue_is_pending(const spi_transaction_t *transaction){
+    return transaction->status == SPI_TRANSACTION_QUEUED || transaction->status == SPI_TRANSACTION_ACTIVE;
+}
+
+// Caller holds irq_lock()
+static void spi_queue_append(spi_transaction_t *transaction){
+    transaction->status = SPI_TRANSACTION_QUEUED;
+    transaction->next = NULL;
+
+    if(spi_queue_tail) {
+        spi_queue_tail->next = transaction;
+    } else {
+        spi_queue_head = transaction;
+    }
+    spi_queue_tail = transaction;
+}
+
+uint8_t spi_queue_submit(spi_transaction_t *transaction){
+    return spi_queue_submit_chain(&transaction, 1);
+}
+
+uint8_t spi_queue_submit_chain(spi_transaction_t *const *transactions, uint8_t count){
+    uint32_t irq_state;
+
+    for(uint8_t i = 0; i < count; i++) {
+        if(transactions[i]->length == 0) {
+            return 1;
+        }
+    }
+
+    irq_state = irq_lock();
+
+    for(uint8_t i = 0; i < count; i++) {
+        if(spi_queue_is_pending(transactions[i])) {
+            irq_unlock(irq_state);
+            return 1;
+        }
+    }
+
+    for(uint8_t i = 0; i < count; i++) {
+        spi_queue_append(transactions[i]);
+    }
+
+    if(spi_queue_active == NULL) {
+        spi_queue_dispatch();
+    }
+
+    irq_unlock(irq_state);
+
+    return 0;
+}
+
+uint8_t spi_queue_lock(const spi_device_t *device){
+    spi_transaction_t *active;
+    uint32_t irq_state = irq_lock();
+
+    if(spi_queue_owner != NULL && spi_queue_owner != device) {
+        irq_unlock(irq_state);
+        return 1;
+    }
+
+    spi_queue_owner = device;
+    irq_unlock(irq_state);
+
+    // A chain already running for another device is allowed to finish
+    do {
+        active = spi_queue_active;
+    } while(active != NULL && active->device != device);
+
+    return 0;
+}
+
+void spi_queue_unlock(const spi_device_t *device){
+    uint32_t irq_state = irq_lock();
+
+    if(spi_queue_owner == device) {
+        spi_queue_owner = NULL;
+
+        // Work held back for other devices can start now
+        if(spi_queue_active == NULL) {
+            spi_queue_dispatch();
+        }
+    }
+
+    irq_unlock(irq_state);
+}
+
+uint8_t spi_queue_is_idle(void){
+    return spi_queue_active == NULL && spi_queue_head == NULL;
+}
@@ -0,0 +1,79 @@
+#ifndef SPI_QUEUE_H
+#define SPI_QUEUE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+
+#define SPI_TRANSACTION_IDLE   0
+#define SPI_TRANSACTION_QUEUED 1
+#define SPI_TRANSACTION_ACTIVE 2
+#define SPI_TRANSACTION_DONE   3
+
+// Transaction flags
+#define SPI_TRANSACTION_KEEP_CS 0x01 // Leave CS asserted for the next transaction in the chain, if one is queued
+#define SPI_TRANSACTION_16BIT   0x02 // 16-bit frames; buffers hold uint16_t and length counts frames
+
+// One device on the bus. Its CTLR1 image is computed once, so switching
+// devices costs two register writes instead of a full SPI_Init().
+typedef struct {
+    GPIO_TypeDef *cs_port;      // Active-low chip select, NULL if the driver handles CS itself
+    uint16_t cs_pin;
+    uint16_t ctlr1;
+} spi_device_t;
+
+typedef struct spi_transaction spi_transaction_t;
+typedef void (*spi_transaction_callback_t)(spi_transaction_t *transaction);
+
+// Owned by the caller and linked into the queue in place, so the queue has
+// no fixed depth and needs no allocation. Leave it untouched until the
+// callback runs or status reads SPI_TRANSACTION_DONE.
+struct spi_transaction {
+    const spi_device_t *device;
+    const uint8_t *tx_buffer;   // NULL clocks out 0xFF
+    uint8_t *rx_buffer;         // NULL discards received data
+    uint16_t length;            // Frames
+    uint8_t flags;
+    spi_transaction_callback_t callback; // Runs in the DMA interrupt, may submit more work
+    void *context;
+
+    volatile uint8_t status;
+    spi_transaction_t *next;
+};
+
+// SPI1 master on PA5 (SCK), PA6 (MISO), PA7 (MOSI) with DMA1 channels 2/3.
+void spi_queue_init(void);
+
+// Fills in a device for SPI mode 0-3 (CPOL << 1 | CPHA) at the given
+// SPI_BaudRatePrescaler_x and configures its chip-select pin as a
+// deasserted push-pull output. The GPIO port clock must already be enabled.
+void spi_device_init(spi_device_t *device, GPIO_TypeDef *cs_port, uint16_t cs_pin, uint8_t mode, uint16_t prescaler);
+
+// Configures a chip-select pin as a push-pull output, deasserted.
+void spi_queue_init_cs(GPIO_TypeDef *port, uint16_t pin);
+
+// Safe from thread and interrupt context. Returns 1 if the transaction is
+// already queued or empty.
+uint8_t spi_queue_submit(spi_transaction_t *transaction);
+
+// Queues transactions back to back with nothing interleaved, e.g. a command
+// header with SPI_TRANSACTION_KEEP_CS followed by its data phase.
+uint8_t spi_queue_submit_chain(spi_transaction_t *const *transactions, uint8_t count);
+
+// Reserves the bus for one device across several transactions, e.g. while
+// a driver holds CS itself. Transactions for other devices, including ones
+// submitted from interrupts, stay queued until spi_queue_unlock(). Waits
+// for another device's transfer in progress to finish. Thread context only;
+// returns 1 if another device holds the bus.
+uint8_t spi_queue_lock(const spi_device_t *device);
+void spi_queue_unlock(const spi_device_t *device);
+
+uint8_t spi_queue_is_idle(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,66 @@
+#include "ch32v10x_rcc.h"
+
+#include "timebase.h"
+
+#define TIMEBASE_CTLR_STE 0x01
+
+#define TIMEBASE_CNTL (*(__IO uint32_t *)&SysTick->CNTL0)
+#define TIMEBASE_CNTH (*(__IO uint32_t *)&SysTick->CNTH0)
+
+static uint32_t timebase_ticks_per_us = 9;
+
+void timebase_init(void){
+    timebase_ticks_per_us = SystemCoreClock / 8000000;
+
+    // Already counting: keep the time running
+    if((SysTick->CTLR & TIMEBASE_CTLR_STE) == 0) {
+        TIMEBASE_CNTL = 0;
+        TIMEBASE_CNTH = 0;
+        SysTick->CTLR = TIMEBASE_CTLR_STE;
+    }
+}
+
+uint32_t timebase_ticks(void){
+    return TIMEBASE_CNTL;
+}
+
+uint64_t timebase_ticks64(void){
+    uint32_t high, low;
+
+    // Re-read if the low word wrapped between the two reads
+    do {
+        high = TIMEBASE_CNTH;
+        low = TIMEBASE_CNTL;
+    } while(high != TIMEBASE_CNTH);
+
+    return ((uint64_t)high << 32) | low;
+}
+
+uint32_t timebase_tick_hz(void){
+    return SystemCoreClock / 8;
+}
+
+uint32_t timebase_us(void){
+    return timebase_ticks64() / timebase_ticks_per_us;
+}
+
+uint32_t timebase_ms(void){
+    return timebase_ticks64() / (timebase_ticks_per_us * 1000);
+}
+
+uint32_t timebase_timer_clock(TIM_TypeDef *timer){
+    RCC_ClocksTypeDef clocks;
+    uint32_t pclk;
+
+    RCC_GetClocksFreq(&clocks);
+
+    // TIM1 sits on APB2, the others on APB1
+    pclk = timer == TIM1 ? clocks.PCLK2_Frequency : clocks.PCLK1_Frequency;
+
+    // Timers run at twice PCLK whenever the APB prescaler is not 1
+    if(pclk == clocks.HCLK_Frequency) {
+        return pclk;
+    }
+
+    return pclk * 2;
+}
@@ -0,0 +1,38 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+
+// SysTick runs free at HCLK/8, as the vendor delay code sets it up, and is
+// never reset, so it serves as the clock for deadlines and benchmarks. One
+// tick is eight core cycles, 9 MHz at 72 MHz. Delay_Init() starts it;
+// calling timebase_init() again is harmless.
+void timebase_init(void);
+
+uint32_t timebase_ticks(void);      // Wraps after 2^32 ticks (~8 min at 9 MHz)
+uint64_t timebase_ticks64(void);
+uint32_t timebase_tick_hz(void);
+uint32_t timebase_us(void);
+uint32_t timebase_ms(void);
+
+// Counter clock of a general-purpose or advanced timer before its prescaler
+uint32_t timebase_timer_clock(TIM_TypeDef *timer);
+
+// Deadlines compare against timebase_us() with wraparound
+static inline uint32_t timebase_deadline_us(uint32_t timeout_us){
+    return timebase_us() + timeout_us;
+}
+
+static inline uint8_t timebase_expired(uint32_t deadline_us){
+    return (int32_t)(timebase_us() - deadline_us) >= 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,253 @@
+#include <string.h>
+
+#include "ch32v10x_dma.h"
+#include "ch32v10x_gpio.h"
+#include "ch32v10x_misc.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_tim.h"
+
+#include "irq_dispatch.h"
+#include "timebase.h"
+#include "ws2812.h"
+
+#define WS2812_DMA DMA1_Channel3
+
+#define WS2812_BIT_HZ 800000
+
+// Compare values per half buffer, one per bit, and the same in words
+#define WS2812_HALF_BYTES (WS2812_LEDS_PER_HALF * 24)
+#define WS2812_HALF_WORDS (WS2812_HALF_BYTES / 4)
+
+// 30 us per LED on the wire
+#define WS2812_HALF_US (WS2812_LEDS_PER_HALF * 30)
+
+static uint32_t ws2812_buffer[2 * WS2812_HALF_WORDS];
+
+// Four compare values per pixel nibble, most significant bit in the low
+// byte since the DMA walks the buffer upwards
+static uint32_t ws2812_nibbles[16];
+
+static ws2812_stats_t ws2812_stats;
+static volatile uint16_t *ws2812_compare;
+static const uint8_t *ws2812_pixels;
+static uint16_t ws2812_count;
+static uint16_t ws2812_halves;      // Data and reset halves in this frame
+static uint16_t ws2812_halves_done;
+static volatile uint8_t ws2812_busy = 0;
+
+// Encodes the LEDs of the frame's `half`th half buffer; past the last LED
+// the line stays low
+static void ws2812_fill(uint32_t *out, uint16_t half){
+    uint16_t led = half * WS2812_LEDS_PER_HALF;
+    uint8_t words = WS2812_HALF_WORDS;
+
+    if(led < ws2812_count) {
+        uint16_t leds = ws2812_count - led;
+        const uint8_t *pixels = ws2812_pixels + led * 3;
+        uint8_t bytes;
+
+        bytes = (leds < WS2812_LEDS_PER_HALF ? leds : WS2812_LEDS_PER_HALF) * 3;
+        words -= bytes * 2;
+
+        while(bytes--) {
+            uint8_t value = *pixels++;
+
+            out[0] = ws2812_nibbles[value >> 4];
+            out[1] = ws2812_nibbles[value & 0x0F];
+            out += 2;
+        }
+    }
+
+    while(words--) {
+        *out++ = 0;
+    }
+}
+
+static void ws2812_finish(void){
+    TIM3->DMAINTENR &= ~TIM_UDE;
+    TIM3->CTLR1 &= ~TIM_CEN;
+    *ws2812_compare = 0;
+    WS2812_DMA->CFGR &= ~DMA_CFGR1_EN;
+
+    ws2812_stats.frames++;
+    ws2812_busy = 0;
+}
+
+static void ws2812_dma_irq_handler(void){
+    uint32_t flags = DMA1->INTFR & (DMA1_IT_HT3 | DMA1_IT_TC3);
+    uint32_t *half;
+
+    if(flags == 0) {
+        return;
+    }
+
+    // Both halves pending: the DMA already went round into stale data
+    if(flags == (DMA1_IT_HT3 | DMA1_IT_TC3)) {
+        ws2812_stats.underruns++;
+    }
+
+    DMA1->INTFCR = flags;
+    half = (flags & DMA1_IT_TC3) ? ws2812_buffer + WS2812_HALF_WORDS : ws2812_buffer;
+
+    if(++ws2812_halves_done >= ws2812_halves) {
+        ws2812_finish();
+        return;
+    }
+
+    // The other half is on the wire; this one goes out after it
+    ws2812_fill(half, ws2812_halves_done + 1);
+}
+
+uint8_t ws2812_init(uint16_t channel){
+    GPIO_InitTypeDef GPIO_InitStructure;
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+    TIM_OCInitTypeDef TIM_OCInitStructure;
+    DMA_InitTypeDef DMA_InitStructure;
+    NVIC_InitTypeDef NVIC_InitStructure;
+    uint32_t period, zero, one;
+
+    // Enable clocks
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3, ENABLE);
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA | RCC_APB2Periph_GPIOB, ENABLE);
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+
+    // 1.25 us bits: a 0 is high for 0.4 us, a 1 for 0.8 us. Compare values
+    // have to fit the byte-wide buffer.
+    period = timebase_timer_clock(TIM3) / WS2812_BIT_HZ;
+    if(period > 255) {
+        return 1;
+    }
+    zero = (period * 8 + 12) / 25;
+    one = (period * 16 + 12) / 25;
+
+    for(uint8_t n = 0; n < 16; n++) {
+        ws2812_nibbles[n] = 0;
+        for(uint8_t bit = 0; bit < 4; bit++) {
+            ws2812_nibbles[n] |= ((n & (8 >> bit)) ? one : zero) << (8 * bit);
+        }
+    }
+
+    TIM_TimeBaseStructure.TIM_Period = period - 1;
+    TIM_TimeBaseStructure.TIM_Prescaler = 0;
+    TIM_TimeBaseStructure.TIM_ClockDivision = TIM_CKD_DIV1;
+    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
+    TIM_TimeBaseInit(TIM3, &TIM_TimeBaseStructure);
+
+    TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_PWM1;
+    TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Enable;
+    TIM_OCInitStructure.TIM_Pulse = 0;
+    TIM_OCInitStructure.TIM_OCPolarity = TIM_OCPolarity_High;
+
+    // Preload: a value the DMA writes at one update shapes the next bit
+    switch(channel) {
+        case TIM_Channel_1:
+            GPIO_InitStructure.GPIO_Pin = GPIO_Pin_6;
+            TIM_OC1Init(TIM3, &TIM_OCInitStructure);
+            TIM_OC1PreloadConfig(TIM3, TIM_OCPreload_Enable);
+            ws2812_compare = &TIM3->CH1CVR;
+            break;
+        case TIM_Channel_2:
+            GPIO_InitStructure.GPIO_Pin = GPIO_Pin_7;
+            TIM_OC2Init(TIM3, &TIM_OCInitStructure);
+            TIM_OC2PreloadConfig(TIM3, TIM_OCPreload_Enable);
+            ws2812_compare = &TIM3->CH2CVR;
+            break;
+        case TIM_Channel_3:
+            GPIO_InitStructure.GPIO_Pin = GPIO_Pin_0;
+            TIM_OC3Init(TIM3, &TIM_OCInitStructure);
+            TIM_OC3PreloadConfig(TIM3, TIM_OCPreload_Enable);
+            ws2812_compare = &TIM3->CH3CVR;
+            break;
+        case TIM_Channel_4:
+            GPIO_InitStructure.GPIO_Pin = GPIO_Pin_1;
+            TIM_OC4Init(TIM3, &TIM_OCInitStructure);
+            TIM_OC4PreloadConfig(TIM3, TIM_OCPreload_Enable);
+            ws2812_compare = &TIM3->CH4CVR;
+            break;
+        default:
+            return 1;
+    }
+
+    GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF_PP;
+    GPIO_Init(channel <= TIM_Channel_2 ? GPIOA : GPIOB, &GPIO_InitStructure);
+
+    TIM_ARRPreloadConfig(TIM3, ENABLE);
+
+    // One compare register per update, reached through the burst register
+    TIM_DMAConfig(TIM3, TIM_DMABase_CCR1 + (channel >> 2), TIM_DMABurstLength_1Transfer);
+
+    // Configure DMA: bytes widened to the 16-bit register, circular over
+    // both halves, interrupt at each half
+    DMA_DeInit(WS2812_DMA);
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&TIM3->DMAADR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)ws2812_buffer;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+    DMA_InitStructure.DMA_BufferSize = 2 * WS2812_HALF_BYTES;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(WS2812_DMA, &DMA_InitStructure);
+
+    DMA_ITConfig(WS2812_DMA, DMA_IT_HT | DMA_IT_TC, ENABLE);
+
+    irq_attach(DMA1_Channel3_IRQn, ws2812_dma_irq_handler);
+    NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel3_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+
+    memset(&ws2812_stats, 0, sizeof(ws2812_stats));
+    ws2812_busy = 0;
+
+    return 0;
+}
+
+uint8_t ws2812_show(const uint8_t *pixels, uint16_t count){
+    if(ws2812_busy || count == 0) {
+        return 1;
+    }
+
+    ws2812_pixels = pixels;
+    ws2812_count = count;
+    ws2812_halves_done = 0;
+
+    // Data, then enough low halves for the latch; one more covers the
+    // update the compare values lag behind
+    ws2812_halves = (count + WS2812_LEDS_PER_HALF - 1) / WS2812_LEDS_PER_HALF +
+                    (WS2812_RESET_US + WS2812_HALF_US - 1) / WS2812_HALF_US + 1;
+
+    ws2812_fill(ws2812_buffer, 0);
+    ws2812_fill(ws2812_buffer + WS2812_HALF_WORDS, 1);
+
+    ws2812_busy = 1;
+
+    WS2812_DMA->CFGR &= ~DMA_CFGR1_EN;
+    WS2812_DMA->CNTR = 2 * WS2812_HALF_BYTES;
+    DMA1->INTFCR = DMA1_IT_GL3;
+    WS2812_DMA->CFGR |= DMA_CFGR1_EN;
+
+    // The first period is low; the DMA's first value shapes the second.
+    // The update event loads the zero and clears the counter before the
+    // DMA request is enabled, so it takes nothing from the buffer.
+    *ws2812_compare = 0;
+    TIM3->SWEVGR = TIM_UG;
+    TIM3->DMAINTENR |= TIM_UDE;
+    TIM3->CTLR1 |= TIM_CEN;
+
+    return 0;
+}
+
+uint8_t ws2812_is_busy(void){
+    return ws2812_busy;
+}
+
+const ws2812_stats_t *ws2812_get_stats(void){
+    return &ws2812_stats;
+}
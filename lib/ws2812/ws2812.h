@@ -0,0 +1,52 @@
+#ifndef WS2812_H
+#define WS2812_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ch32v10x.h"
+
+// LEDs encoded per half of the DMA buffer: 24 bytes of RAM each, and one
+// interrupt per this many LEDs on the wire (30 us each)
+#define WS2812_LEDS_PER_HALF 4
+
+// Line held low after the last LED; newer WS2812B parts need 280 us
+#define WS2812_RESET_US 300
+
+typedef struct {
+    uint32_t frames;
+    uint32_t underruns;     // Encoding fell behind the wire; that frame glitched
+} ws2812_stats_t;
+
+// WS2812 / NeoPixel chain on a TIM3 channel: CH1 PA6, CH2 PA7, CH3 PB0 or
+// CH4 PB1 (TIM_Channel_x). The timer runs at 800 kHz and the update event
+// DMA (DMA1 channel 3, shared with SPI1 TX) writes one compare value per
+// bit through the DMA burst register, so the waveform never depends on the
+// CPU. The compare values are one byte per bit in a small circular buffer;
+// the half-transfer and transfer-complete interrupts encode the next
+// WS2812_LEDS_PER_HALF LEDs into the half just sent. 300 LEDs at 60 fps
+// cost about 1 % of the CPU.
+uint8_t ws2812_init(uint16_t channel);
+
+// Starts sending `count` LEDs, three bytes each in wire order (G, R, B).
+// The pixels are read while the frame goes out, so they must stay put
+// until ws2812_is_busy() returns 0. Returns 1 if a frame is still going.
+uint8_t ws2812_show(const uint8_t *pixels, uint16_t count);
+
+uint8_t ws2812_is_busy(void);
+
+static inline void ws2812_set_pixel(uint8_t *pixels, uint16_t index, uint8_t r, uint8_t g, uint8_t b){
+    pixels += index * 3;
+    pixels[0] = g;
+    pixels[1] = r;
+    pixels[2] = b;
+}
+
+const ws2812_stats_t *ws2812_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
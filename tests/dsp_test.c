@@ -0,0 +1,368 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "dsp_biquad.h"
+#include "dsp_cic.h"
+#include "dsp_fir.h"
+#include "dsp_smooth.h"
+#include "test.h"
+
+// Each kernel against a plain textbook reference that computes every
+// output from the whole input history in 64 bits. The kernels run the
+// signal in uneven blocks, so their delay lines and phases carry across
+// calls, and must match the reference bit for bit.
+#define DSP_TEST_LENGTH 1000
+#define DSP_TEST_TAPS   31
+
+// The dsp_bench filters: 31-tap low-pass, and a 4th-order Butterworth as
+// two biquads
+static const q15_t dsp_test_fir[DSP_TEST_TAPS] = {
+    0, 39, 91, 139, 129, 0, -271, -609, -832, -696, 0, 1297, 3011, 4755, 6059, 6542,
+    6059, 4755, 3011, 1297, 0, -696, -832, -609, -271, 0, 129, 139, 91, 39, 0,
+};
+
+// Odd and even length halves of asymmetric-looking symmetric filters
+static const q15_t dsp_test_sym_odd[4] = {-1200, 3000, 9000, 16000};
+static const q15_t dsp_test_sym_even[4] = {-1200, 3000, 9000, 12000};
+
+static const dsp_biquad_q15_coeffs_t dsp_test_biquad_q15[2] = {
+    {312, 624, 312, -24243, 9107},
+    {359, 717, 359, -27869, 12919},
+};
+
+static const dsp_biquad_q31_coeffs_t dsp_test_biquad_q31[2] = {
+    {20440642, 40881285, 20440642, -1588788093, 596808838},
+    {23497607, 46995214, 23497607, -1826396550, 846645154},
+};
+
+static const uint16_t dsp_test_blocks[] = {1, 3, 17, 64, 255, 2};
+
+static q15_t input[DSP_TEST_LENGTH];
+static q15_t output[DSP_TEST_LENGTH];
+static q15_t expected[DSP_TEST_LENGTH];
+static q31_t input_q31[DSP_TEST_LENGTH];
+static q31_t output_q31[DSP_TEST_LENGTH];
+static q31_t expected_q31[DSP_TEST_LENGTH];
+
+// Ramp plus noise, or noise over the full range to reach saturation
+static void fill(uint32_t seed, int full_scale){
+    for(int i = 0; i < DSP_TEST_LENGTH; i++) {
+        seed = seed * 1664525 + 1013904223;
+        if(full_scale) {
+            input[i] = (q15_t)(seed >> 16);
+        } else {
+            input[i] = (q15_t)(i * 16 - 8000 + (int16_t)(seed >> 16) / 8);
+        }
+        input_q31[i] = (q31_t)input[i] * 65536 + (q31_t)(seed & 0xFFFF) - 32768;
+    }
+}
+
+static q15_t sat_q15(int64_t x){
+    return x > INT16_MAX ? INT16_MAX : x < INT16_MIN ? INT16_MIN : (q15_t)x;
+}
+
+static q31_t sat_q31(int64_t x){
+    return x > INT32_MAX ? INT32_MAX : x < INT32_MIN ? INT32_MIN : (q31_t)x;
+}
+
+// Sample n - k, zero before the start
+static int64_t past(const q15_t *x, int n, int k){
+    return n - k >= 0 ? x[n - k] : 0;
+}
+
+static void reference_fir_q15(const q15_t *h, int taps, q15_t *y){
+    for(int n = 0; n < DSP_TEST_LENGTH; n++) {
+        int64_t acc = 0;
+
+        for(int k = 0; k < taps; k++) {
+            acc += h[k] * past(input, n, k);
+        }
+
+        y[n] = sat_q15((acc + (1 << 14)) >> 15);
+    }
+}
+
+static void reference_fir_q31(const q31_t *h, int taps, q31_t *y){
+    for(int n = 0; n < DSP_TEST_LENGTH; n++) {
+        int64_t acc = 0;
+
+        // The kernel keeps the high word of each product
+        for(int k = 0; k < taps && k <= n; k++) {
+            acc += ((int64_t)h[k] * input_q31[n - k]) >> 32;
+        }
+
+        y[n] = sat_q31(acc * 2);
+    }
+}
+
+static void reference_biquad_q15(const dsp_biquad_q15_coeffs_t *c, int stages, q15_t *y){
+    q15_t x[DSP_TEST_LENGTH];
+
+    memcpy(x, input, sizeof(x));
+
+    for(int stage = 0; stage < stages; stage++, c++) {
+        for(int n = 0; n < DSP_TEST_LENGTH; n++) {
+            int64_t acc = c->b0 * past(x, n, 0) + c->b1 * past(x, n, 1) + c->b2 * past(x, n, 2)
+                        - c->a1 * past(y, n, 1) - c->a2 * past(y, n, 2);
+
+            y[n] = sat_q15((acc + (1 << 13)) >> 14);
+        }
+        memcpy(x, y, sizeof(x));
+    }
+}
+
+static void reference_biquad_q31(const dsp_biquad_q31_coeffs_t *c, int stages, q31_t *y){
+    q31_t x[DSP_TEST_LENGTH];
+
+    memcpy(x, input_q31, sizeof(x));
+
+    for(int stage = 0; stage < stages; stage++, c++) {
+        for(int n = 0; n < DSP_TEST_LENGTH; n++) {
+            int64_t x1 = n >= 1 ? x[n - 1] : 0, x2 = n >= 2 ? x[n - 2] : 0;
+            int64_t y1 = n >= 1 ? y[n - 1] : 0, y2 = n >= 2 ? y[n - 2] : 0;
+            int64_t acc = c->b0 * (int64_t)x[n] + c->b1 * x1 + c->b2 * x2 - c->a1 * y1 - c->a2 * y2;
+
+            y[n] = sat_q31((acc + (1 << 29)) >> 30);
+        }
+        memcpy(x, y, sizeof(x));
+    }
+}
+
+// Every factor-th sample of the input convolved with a boxcar of `factor`
+// ones, `order` times over
+static int reference_cic(int order, int factor, int shift, q15_t *y){
+    int64_t h[DSP_CIC_MAX_ORDER * 256];
+    int length = 1;
+    int written = 0;
+
+    h[0] = 1;
+    for(int stage = 0; stage < order; stage++) {
+        int64_t next[DSP_CIC_MAX_ORDER * 256] = {0};
+
+        for(int i = 0; i < length; i++) {
+            for(int j = 0; j < factor; j++) {
+                next[i + j] += h[i];
+            }
+        }
+        length += factor - 1;
+        memcpy(h, next, sizeof(h));
+    }
+
+    for(int n = factor - 1; n < DSP_TEST_LENGTH; n += factor) {
+        int64_t acc = 0;
+
+        for(int k = 0; k < length; k++) {
+            acc += h[k] * past(input, n, k);
+        }
+
+        y[written++] = sat_q15(acc >> shift);
+    }
+
+    return written;
+}
+
+static void reference_moving_average(int window, int shift, q15_t *y){
+    for(int n = 0; n < DSP_TEST_LENGTH; n++) {
+        int64_t sum = 0;
+
+        for(int k = 0; k < window; k++) {
+            sum += past(input, n, k);
+        }
+
+        y[n] = (q15_t)(sum >> shift);
+    }
+}
+
+static void reference_median(int window, q15_t *y){
+    for(int n = 0; n < DSP_TEST_LENGTH; n++) {
+        q15_t sorted[DSP_MEDIAN_MAX_WINDOW];
+
+        for(int k = 0; k < window; k++) {
+            q15_t x = (q15_t)past(input, n, k);
+            int i = k;
+
+            while(i > 0 && sorted[i - 1] > x) {
+                sorted[i] = sorted[i - 1];
+                i--;
+            }
+            sorted[i] = x;
+        }
+
+        y[n] = sorted[window / 2];
+    }
+}
+
+// Runs a Q15 kernel over the input in uneven blocks, into `output`
+#define RUN_BLOCKS(call) do { \
+    int done = 0; \
+    for(int b = 0; done < DSP_TEST_LENGTH; b++) { \
+        uint16_t n = dsp_test_blocks[b % (sizeof(dsp_test_blocks) / sizeof(dsp_test_blocks[0]))]; \
+        if(n > DSP_TEST_LENGTH - done) { \
+            n = DSP_TEST_LENGTH - done; \
+        } \
+        call; \
+        done += n; \
+    } \
+} while(0)
+
+static void test_fir(void){
+    q15_t state[2 * DSP_TEST_TAPS];
+    q15_t full[7];
+    dsp_fir_q15_t fir;
+
+    reference_fir_q15(dsp_test_fir, DSP_TEST_TAPS, expected);
+    dsp_fir_q15_init(&fir, dsp_test_fir, state, DSP_TEST_TAPS);
+    RUN_BLOCKS(dsp_fir_q15(&fir, input + done, output + done, n));
+    CHECK_MEMORY(output, expected, sizeof(expected));
+
+    // In place
+    memcpy(output, input, sizeof(output));
+    dsp_fir_q15_init(&fir, dsp_test_fir, state, DSP_TEST_TAPS);
+    RUN_BLOCKS(dsp_fir_q15(&fir, output + done, output + done, n));
+    CHECK_MEMORY(output, expected, sizeof(expected));
+
+    // Symmetric, odd and even lengths, against the mirrored coefficients
+    for(int taps = 7; taps <= 8; taps++) {
+        const q15_t *half = taps & 1 ? dsp_test_sym_odd : dsp_test_sym_even;
+        q15_t mirrored[8];
+
+        for(int k = 0; k < taps; k++) {
+            mirrored[k] = half[k < (taps + 1) / 2 ? k : taps - 1 - k];
+        }
+
+        reference_fir_q15(mirrored, taps, expected);
+        dsp_fir_q15_init(&fir, half, state, taps);
+        RUN_BLOCKS(dsp_fir_sym_q15(&fir, input + done, output + done, n));
+        CHECK_MEMORY(output, expected, sizeof(expected));
+    }
+
+    // The symmetric kernel agrees with the plain one on the same filter
+    memcpy(full, dsp_test_sym_odd, 4 * sizeof(q15_t));
+    full[4] = full[2];
+    full[5] = full[1];
+    full[6] = full[0];
+    reference_fir_q15(full, 7, expected);
+    dsp_fir_q15_init(&fir, full, state, 7);
+    RUN_BLOCKS(dsp_fir_q15(&fir, input + done, output + done, n));
+    CHECK_MEMORY(output, expected, sizeof(expected));
+}
+
+static void test_fir_q31(void){
+    q31_t coeffs[DSP_TEST_TAPS];
+    q31_t state[2 * DSP_TEST_TAPS];
+    dsp_fir_q31_t fir;
+
+    for(int k = 0; k < DSP_TEST_TAPS; k++) {
+        coeffs[k] = (q31_t)dsp_test_fir[k] * 65536 + k;
+    }
+
+    reference_fir_q31(coeffs, DSP_TEST_TAPS, expected_q31);
+    dsp_fir_q31_init(&fir, coeffs, state, DSP_TEST_TAPS);
+    RUN_BLOCKS(dsp_fir_q31(&fir, input_q31 + done, output_q31 + done, n));
+    CHECK_MEMORY(output_q31, expected_q31, sizeof(expected_q31));
+}
+
+static void test_fir_decimate(void){
+    q15_t state[2 * DSP_TEST_TAPS];
+    dsp_fir_decimate_q15_t decimator;
+    int written = 0;
+
+    CHECK_EQUAL(dsp_fir_decimate_q15_init(&decimator, dsp_test_fir, state, DSP_TEST_TAPS, 0), 1);
+    CHECK_EQUAL(dsp_fir_decimate_q15_init(&decimator, dsp_test_fir, state, DSP_TEST_TAPS, 4), 0);
+
+    reference_fir_q15(dsp_test_fir, DSP_TEST_TAPS, expected);
+    RUN_BLOCKS(written += dsp_fir_decimate_q15(&decimator, input + done, output + written, n));
+    CHECK_EQUAL(written, DSP_TEST_LENGTH / 4);
+
+    for(int i = 0; i < written; i++) {
+        CHECK_EQUAL(output[i], expected[4 * i + 3]);
+    }
+}
+
+static void test_biquad(void){
+    q15_t state[8];
+    q31_t state_q31[8];
+    dsp_biquad_q15_t biquad;
+    dsp_biquad_q31_t biquad_q31;
+
+    reference_biquad_q15(dsp_test_biquad_q15, 2, expected);
+    dsp_biquad_q15_init(&biquad, dsp_test_biquad_q15, state, 2);
+    RUN_BLOCKS(dsp_biquad_q15(&biquad, input + done, output + done, n));
+    CHECK_MEMORY(output, expected, sizeof(expected));
+
+    reference_biquad_q31(dsp_test_biquad_q31, 2, expected_q31);
+    dsp_biquad_q31_init(&biquad_q31, dsp_test_biquad_q31, state_q31, 2);
+    RUN_BLOCKS(dsp_biquad_q31(&biquad_q31, input_q31 + done, output_q31 + done, n));
+    CHECK_MEMORY(output_q31, expected_q31, sizeof(expected_q31));
+}
+
+static void test_cic(void){
+    static const uint8_t configs[][2] = {{3, 8}, {1, 2}, {2, 5}, {4, 16}};
+    dsp_cic_t cic;
+
+    // 16 bits of input plus order * ceil(log2(factor)) of growth must fit
+    CHECK_EQUAL(dsp_cic_init(&cic, 0, 8), 1);
+    CHECK_EQUAL(dsp_cic_init(&cic, 3, 1), 1);
+    CHECK_EQUAL(dsp_cic_init(&cic, 4, 17), 1);
+
+    for(unsigned c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+        int written = 0;
+        int expected_written;
+
+        CHECK_EQUAL(dsp_cic_init(&cic, configs[c][0], configs[c][1]), 0);
+        expected_written = reference_cic(configs[c][0], configs[c][1], cic.shift, expected);
+        RUN_BLOCKS(written += dsp_cic_decimate(&cic, input + done, output + written, n));
+        CHECK_EQUAL(written, expected_written);
+        CHECK_MEMORY(output, expected, written * sizeof(q15_t));
+    }
+}
+
+static void test_moving_average(void){
+    q15_t history[64];
+    dsp_moving_average_t average;
+
+    CHECK_EQUAL(dsp_moving_average_init(&average, history, 12), 1);
+
+    for(int window = 1; window <= 64; window *= 4) {
+        int shift = 0;
+
+        while((1 << shift) < window) {
+            shift++;
+        }
+
+        reference_moving_average(window, shift, expected);
+        CHECK_EQUAL(dsp_moving_average_init(&average, history, window), 0);
+        RUN_BLOCKS(dsp_moving_average(&average, input + done, output + done, n));
+        CHECK_MEMORY(output, expected, sizeof(expected));
+    }
+}
+
+static void test_median(void){
+    dsp_median_t median;
+
+    CHECK_EQUAL(dsp_median_init(&median, 4), 1);
+    CHECK_EQUAL(dsp_median_init(&median, DSP_MEDIAN_MAX_WINDOW + 2), 1);
+
+    for(int window = 1; window <= DSP_MEDIAN_MAX_WINDOW; window += 2) {
+        reference_median(window, expected);
+        CHECK_EQUAL(dsp_median_init(&median, window), 0);
+        RUN_BLOCKS(dsp_median(&median, input + done, output + done, n));
+        CHECK_MEMORY(output, expected, sizeof(expected));
+    }
+}
+
+int main(void){
+    for(int full_scale = 0; full_scale <= 1; full_scale++) {
+        fill(12345 + full_scale, full_scale);
+
+        test_fir();
+        test_fir_q31();
+        test_fir_decimate();
+        test_biquad();
+        test_cic();
+        test_moving_average();
+        test_median();
+    }
+
+    return test_summary("dsp");
+}
@@ -0,0 +1,331 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "ch32v10x_misc.h"
+#include "ch32v10x_rcc.h"
+#include "ch32v10x_tim.h"
+
+#include "irq_dispatch.h"
+#include "modbus_rtu.h"
+#include "test.h"
+#include "timebase.h"
+
+// Simulated master side: the frames the master puts on the bus land in the
+// fake RS-485 receive buffer, and whatever the slave sends is kept for the
+// checks. The timer and USART interrupts are called by hand in the order
+// the hardware raises them.
+static uint8_t bus_rx[512];
+static uint16_t bus_rx_length;
+static uint8_t bus_tx[MODBUS_FRAME_SIZE];
+static uint16_t bus_tx_length;
+static uint16_t bus_tx_count;
+
+static irq_handler_t timer_handler;
+static rs485_rx_idle_t idle_callback;
+
+uint8_t rs485_init(const rs485_config_t *config){
+    return 0;
+}
+
+uint8_t rs485_send(const uint8_t *data, uint16_t length){
+    memcpy(bus_tx, data, length);
+    bus_tx_length = length;
+    bus_tx_count++;
+    return 0;
+}
+
+void rs485_set_rx_idle_callback(rs485_rx_idle_t callback){
+    idle_callback = callback;
+}
+
+uint16_t rs485_available(void){
+    return bus_rx_length;
+}
+
+uint16_t rs485_read(uint8_t *data, uint16_t max_length){
+    uint16_t length = bus_rx_length < max_length ? bus_rx_length : max_length;
+
+    memcpy(data, bus_rx, length);
+    memmove(bus_rx, bus_rx + length, bus_rx_length - length);
+    bus_rx_length -= length;
+
+    return length;
+}
+
+void rs485_flush_rx(void){
+    bus_rx_length = 0;
+}
+
+void irq_attach(IRQn_Type irq, irq_handler_t handler){
+    timer_handler = handler;
+}
+
+uint32_t timebase_timer_clock(TIM_TypeDef *timer){
+    return 72000000;
+}
+
+void RCC_APB1PeriphClockCmd(uint32_t RCC_APB1Periph, FunctionalState NewState){}
+void NVIC_Init(NVIC_InitTypeDef *NVIC_InitStruct){}
+void TIM_TimeBaseInit(TIM_TypeDef *TIMx, TIM_TimeBaseInitTypeDef *TIM_TimeBaseInitStruct){}
+void TIM_Cmd(TIM_TypeDef *TIMx, FunctionalState NewState){}
+void TIM_ITConfig(TIM_TypeDef *TIMx, uint16_t TIM_IT, FunctionalState NewState){}
+void TIM_UpdateRequestConfig(TIM_TypeDef *TIMx, uint16_t TIM_UpdateSource){}
+void TIM_SelectOnePulseMode(TIM_TypeDef *TIMx, uint16_t TIM_OPMode){}
+void TIM_SetCounter(TIM_TypeDef *TIMx, uint16_t Counter){}
+void TIM_ClearITPendingBit(TIM_TypeDef *TIMx, uint16_t TIM_IT){}
+
+ITStatus TIM_GetITStatus(TIM_TypeDef *TIMx, uint16_t TIM_IT){
+    return SET;
+}
+
+static uint16_t holding_registers[16];
+static uint16_t input_registers[4] = {0x1234, 0x5678, 0x9ABC, 0xDEF0};
+static uint8_t coils[2];
+static uint8_t discrete_inputs[1] = {0xA5};
+
+static uint8_t write_function;
+static uint16_t write_address;
+static uint16_t write_count;
+
+static void write_callback(uint8_t function, uint16_t address, uint16_t count){
+    write_function = function;
+    write_address = address;
+    write_count = count;
+}
+
+static const modbus_map_t map = {
+    .slave_address = 0x11,
+    .holding_registers = holding_registers,
+    .holding_register_count = 16,
+    .input_registers = input_registers,
+    .input_register_count = 4,
+    .coils = coils,
+    .coil_count = 16,
+    .discrete_inputs = discrete_inputs,
+    .discrete_input_count = 8,
+    .write_callback = write_callback,
+};
+
+// Puts address + PDU + CRC on the bus, then lets the line go idle for t3.5
+static void master_send(uint8_t address, const uint8_t *pdu, uint16_t length){
+    uint16_t crc;
+
+    bus_rx[bus_rx_length] = address;
+    memcpy(&bus_rx[bus_rx_length + 1], pdu, length);
+    crc = modbus_crc16(&bus_rx[bus_rx_length], length + 1);
+    bus_rx[bus_rx_length + length + 1] = crc & 0xFF;
+    bus_rx[bus_rx_length + length + 2] = crc >> 8;
+    bus_rx_length += length + 3;
+
+    bus_tx_length = 0;
+    idle_callback();
+    timer_handler();
+}
+
+// The response must carry a valid CRC; returns its PDU length
+static uint16_t response_pdu_length(void){
+    uint16_t crc;
+
+    if(bus_tx_length < 4) {
+        return 0;
+    }
+
+    crc = modbus_crc16(bus_tx, bus_tx_length - 2);
+    CHECK_EQUAL(bus_tx[bus_tx_length - 2], crc & 0xFF);
+    CHECK_EQUAL(bus_tx[bus_tx_length - 1], crc >> 8);
+
+    return bus_tx_length - 3;
+}
+
+static void test_crc(void){
+    static const uint8_t check[] = "123456789";
+    static const uint8_t frame[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x01};
+
+    // CRC-16/MODBUS check value, and a frame from the spec's examples
+    CHECK_EQUAL(modbus_crc16(check, 9), 0x4B37);
+    CHECK_EQUAL(modbus_crc16(frame, sizeof(frame)), 0x0A84);
+}
+
+static void test_read_holding_registers(void){
+    static const uint8_t request[] = {0x03, 0x00, 0x02, 0x00, 0x03};
+    static const uint8_t expected[] = {0x11, 0x03, 0x06, 0x00, 0x0A, 0x00, 0x0B, 0xBE, 0xEF};
+
+    holding_registers[2] = 0x000A;
+    holding_registers[3] = 0x000B;
+    holding_registers[4] = 0xBEEF;
+
+    master_send(0x11, request, sizeof(request));
+    CHECK_EQUAL(response_pdu_length(), sizeof(expected) - 1);
+    CHECK_MEMORY(bus_tx, expected, sizeof(expected));
+}
+
+static void test_read_input_registers(void){
+    static const uint8_t request[] = {0x04, 0x00, 0x01, 0x00, 0x02};
+    static const uint8_t expected[] = {0x11, 0x04, 0x04, 0x56, 0x78, 0x9A, 0xBC};
+
+    master_send(0x11, request, sizeof(request));
+    CHECK_EQUAL(response_pdu_length(), sizeof(expected) - 1);
+    CHECK_MEMORY(bus_tx, expected, sizeof(expected));
+}
+
+static void test_read_bits(void){
+    static const uint8_t read_coils[] = {0x01, 0x00, 0x03, 0x00, 0x0A};
+    static const uint8_t coils_expected[] = {0x11, 0x01, 0x02, 0x81, 0x02};
+    static const uint8_t read_inputs[] = {0x02, 0x00, 0x00, 0x00, 0x08};
+    static const uint8_t inputs_expected[] = {0x11, 0x02, 0x01, 0xA5};
+
+    // Coils 3 and 10 and 12 set; bits 3-12 come back LSB first
+    coils[0] = 0x08;
+    coils[1] = 0x14;
+
+    master_send(0x11, read_coils, sizeof(read_coils));
+    CHECK_EQUAL(response_pdu_length(), sizeof(coils_expected) - 1);
+    CHECK_MEMORY(bus_tx, coils_expected, sizeof(coils_expected));
+
+    master_send(0x11, read_inputs, sizeof(read_inputs));
+    CHECK_EQUAL(response_pdu_length(), sizeof(inputs_expected) - 1);
+    CHECK_MEMORY(bus_tx, inputs_expected, sizeof(inputs_expected));
+}
+
+static void test_write_single(void){
+    static const uint8_t write_register[] = {0x06, 0x00, 0x07, 0x12, 0x34};
+    static const uint8_t write_coil[] = {0x05, 0x00, 0x09, 0xFF, 0x00};
+    static const uint8_t bad_coil[] = {0x05, 0x00, 0x09, 0x12, 0x34};
+
+    // Both echo the request
+    master_send(0x11, write_register, sizeof(write_register));
+    CHECK_EQUAL(response_pdu_length(), sizeof(write_register));
+    CHECK_MEMORY(&bus_tx[1], write_register, sizeof(write_register));
+    CHECK_EQUAL(holding_registers[7], 0x1234);
+    CHECK_EQUAL(write_function, MODBUS_FC_WRITE_SINGLE_REGISTER);
+    CHECK_EQUAL(write_address, 7);
+    CHECK_EQUAL(write_count, 1);
+
+    coils[1] = 0;
+    master_send(0x11, write_coil, sizeof(write_coil));
+    CHECK_EQUAL(response_pdu_length(), sizeof(write_coil));
+    CHECK_MEMORY(&bus_tx[1], write_coil, sizeof(write_coil));
+    CHECK_EQUAL(coils[1], 0x02);
+
+    master_send(0x11, bad_coil, sizeof(bad_coil));
+    CHECK_EQUAL(response_pdu_length(), 2);
+    CHECK_EQUAL(bus_tx[1], 0x85);
+    CHECK_EQUAL(bus_tx[2], MODBUS_EX_ILLEGAL_DATA_VALUE);
+}
+
+static void test_write_multiple(void){
+    static const uint8_t write_registers[] = {0x10, 0x00, 0x0E, 0x00, 0x02, 0x04, 0xCA, 0xFE, 0xF0, 0x0D};
+    static const uint8_t write_coils[] = {0x0F, 0x00, 0x04, 0x00, 0x0A, 0x02, 0xCD, 0x01};
+    static const uint8_t short_coils[] = {0x0F, 0x00, 0x04, 0x00, 0x0A, 0x01, 0xCD};
+
+    master_send(0x11, write_registers, sizeof(write_registers));
+    CHECK_EQUAL(response_pdu_length(), 5);
+    CHECK_MEMORY(&bus_tx[1], write_registers, 5);
+    CHECK_EQUAL(holding_registers[14], 0xCAFE);
+    CHECK_EQUAL(holding_registers[15], 0xF00D);
+    CHECK_EQUAL(write_function, MODBUS_FC_WRITE_MULTIPLE_REGISTERS);
+    CHECK_EQUAL(write_address, 14);
+    CHECK_EQUAL(write_count, 2);
+
+    // Ten coils from 4: 0xCD then two bits of 0x01
+    coils[0] = 0;
+    coils[1] = 0;
+    master_send(0x11, write_coils, sizeof(write_coils));
+    CHECK_EQUAL(response_pdu_length(), 5);
+    CHECK_MEMORY(&bus_tx[1], write_coils, 5);
+    CHECK_EQUAL(coils[0], 0xD0);
+    CHECK_EQUAL(coils[1], 0x1C);
+
+    // Byte count disagreeing with the quantity
+    master_send(0x11, short_coils, sizeof(short_coils));
+    CHECK_EQUAL(response_pdu_length(), 2);
+    CHECK_EQUAL(bus_tx[1], 0x8F);
+    CHECK_EQUAL(bus_tx[2], MODBUS_EX_ILLEGAL_DATA_VALUE);
+}
+
+static void test_exceptions(void){
+    static const uint8_t unknown[] = {0x2B, 0x0E, 0x01, 0x00};
+    static const uint8_t past_end[] = {0x03, 0x00, 0x0F, 0x00, 0x02};
+    static const uint8_t too_many[] = {0x03, 0x00, 0x00, 0x00, 0x7E};
+    uint32_t exceptions = modbus_rtu_get_stats()->exceptions;
+
+    master_send(0x11, unknown, sizeof(unknown));
+    CHECK_EQUAL(response_pdu_length(), 2);
+    CHECK_EQUAL(bus_tx[1], 0xAB);
+    CHECK_EQUAL(bus_tx[2], MODBUS_EX_ILLEGAL_FUNCTION);
+
+    master_send(0x11, past_end, sizeof(past_end));
+    CHECK_EQUAL(response_pdu_length(), 2);
+    CHECK_EQUAL(bus_tx[1], 0x83);
+    CHECK_EQUAL(bus_tx[2], MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+
+    master_send(0x11, too_many, sizeof(too_many));
+    CHECK_EQUAL(response_pdu_length(), 2);
+    CHECK_EQUAL(bus_tx[1], 0x83);
+    CHECK_EQUAL(bus_tx[2], MODBUS_EX_ILLEGAL_DATA_VALUE);
+
+    CHECK_EQUAL(modbus_rtu_get_stats()->exceptions - exceptions, 3);
+}
+
+static void test_framing(void){
+    static const uint8_t request[] = {0x06, 0x00, 0x01, 0x55, 0xAA};
+    const modbus_stats_t *stats = modbus_rtu_get_stats();
+    uint32_t crc_errors = stats->crc_errors;
+    uint16_t sent = bus_tx_count;
+
+    // Another slave's request is ignored
+    holding_registers[1] = 0;
+    master_send(0x12, request, sizeof(request));
+    CHECK_EQUAL(bus_tx_count, sent);
+    CHECK_EQUAL(holding_registers[1], 0);
+
+    // A broadcast is executed but not answered
+    master_send(0x00, request, sizeof(request));
+    CHECK_EQUAL(bus_tx_count, sent);
+    CHECK_EQUAL(holding_registers[1], 0x55AA);
+
+    // A corrupted byte fails the CRC
+    holding_registers[1] = 0;
+    bus_rx[0] = 0x11;
+    memcpy(&bus_rx[1], request, sizeof(request));
+    bus_rx[2] ^= 0x40;
+    bus_rx[6] = 0x00;
+    bus_rx[7] = 0x00;
+    bus_rx_length = 8;
+    idle_callback();
+    timer_handler();
+    CHECK_EQUAL(bus_tx_count, sent);
+    CHECK_EQUAL(stats->crc_errors - crc_errors, 1);
+    CHECK_EQUAL(holding_registers[1], 0);
+
+    // A byte after the idle event means the gap was shorter than t3.5: the
+    // frame is left for the next idle event
+    bus_rx[0] = 0x11;
+    memcpy(&bus_rx[1], request, sizeof(request));
+    bus_rx_length = 4;
+    idle_callback();
+    bus_rx_length = 6;
+    timer_handler();
+    CHECK_EQUAL(bus_tx_count, sent);
+    CHECK_EQUAL(bus_rx_length, 6);
+    rs485_flush_rx();
+}
+
+int main(void){
+    rs485_config_t port = {.baudrate = 115200};
+
+    CHECK_EQUAL(modbus_rtu_init(&port, TIM2, &map), 0);
+    CHECK(timer_handler != NULL);
+    CHECK(idle_callback != NULL);
+
+    test_crc();
+    test_read_holding_registers();
+    test_read_input_registers();
+    test_read_bits();
+    test_write_single();
+    test_write_multiple();
+    test_exceptions();
+    test_framing();
+
+    return test_summary("modbus_rtu");
+}
@@ -0,0 +1,343 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "spi_nor.h"
+#include "spi_queue.h"
+#include "test.h"
+
+// Simulated W25Q80: 1 MB of NOR behind the SPI queue. The fake queue runs
+// each chain synchronously, byte by byte, through a model of the chip's
+// command decoder: CS low starts a command, CS high executes it. Programs
+// only clear bits and wrap within their page, erases need the write enable
+// latch, and the chip stays busy for a few status polls after each. Any
+// command the real part would reject or mangle counts as a violation.
+#define NOR_CAPACITY (1UL << 20)
+#define NOR_BUSY_POLLS 3
+
+static uint8_t nor_array[NOR_CAPACITY];
+static uint8_t nor_page[SPI_NOR_PAGE_SIZE];
+static uint8_t nor_opcode;
+static uint32_t nor_position;           // Bytes since CS went low
+static uint32_t nor_address;
+static uint8_t nor_write_enabled;
+static uint8_t nor_busy;
+
+static uint32_t nor_programs;
+static uint32_t nor_erases_4k;
+static uint32_t nor_erases_32k;
+static uint32_t nor_erases_64k;
+static uint32_t nor_violations;
+
+static uint8_t nor_exchange(uint8_t mosi){
+    uint32_t n = nor_position++;
+
+    if(n == 0) {
+        nor_opcode = mosi;
+        nor_address = 0;
+
+        if(nor_busy && mosi != 0x05) {
+            nor_violations++;
+        }
+
+        return 0xFF;
+    }
+
+    if(nor_busy && nor_opcode != 0x05) {
+        return 0xFF;
+    }
+
+    switch(nor_opcode) {
+    case 0x05:
+        if(nor_busy) {
+            nor_busy--;
+            return 0x01 | (nor_write_enabled << 1);
+        }
+        return nor_write_enabled << 1;
+
+    case 0x9F:
+        return n == 1 ? 0xEF : n == 2 ? 0x40 : n == 3 ? 0x14 : 0xFF;
+
+    case 0x0B:
+    case 0x02:
+    case 0x20:
+    case 0x52:
+    case 0xD8:
+        if(n <= 3) {
+            nor_address = (nor_address << 8) | mosi;
+            return 0xFF;
+        }
+
+        if(nor_opcode == 0x0B) {
+            // One dummy byte, then data
+            return n == 4 ? 0xFF : nor_array[(nor_address + n - 5) % NOR_CAPACITY];
+        }
+
+        if(nor_opcode == 0x02) {
+            // Past 256 bytes the page buffer wraps over itself
+            if(n - 4 >= SPI_NOR_PAGE_SIZE) {
+                nor_violations++;
+            }
+            nor_page[(nor_address + n - 4) % SPI_NOR_PAGE_SIZE] &= mosi;
+            return 0xFF;
+        }
+
+        nor_violations++;
+        return 0xFF;
+
+    default:
+        return 0xFF;
+    }
+}
+
+static void nor_release(void){
+    uint32_t length = nor_position;
+    uint32_t size = 0;
+
+    nor_position = 0;
+
+    if(length == 0 || (nor_busy && nor_opcode != 0x05)) {
+        return;
+    }
+
+    switch(nor_opcode) {
+    case 0x06:
+        nor_write_enabled = 1;
+        return;
+
+    case 0x02:
+        if(!nor_write_enabled || length < 5) {
+            nor_violations++;
+            return;
+        }
+
+        // Bytes outside the clocked ones were left at 0xFF in the buffer
+        for(uint16_t i = 0; i < SPI_NOR_PAGE_SIZE; i++) {
+            nor_array[(nor_address & ~(SPI_NOR_PAGE_SIZE - 1)) + i] &= nor_page[i];
+        }
+        memset(nor_page, 0xFF, sizeof(nor_page));
+        nor_programs++;
+        break;
+
+    case 0x20:
+        size = 0x1000;
+        nor_erases_4k++;
+        break;
+
+    case 0x52:
+        size = 0x8000;
+        nor_erases_32k++;
+        break;
+
+    case 0xD8:
+        size = 0x10000;
+        nor_erases_64k++;
+        break;
+
+    default:
+        return;
+    }
+
+    if(size) {
+        if(!nor_write_enabled || length != 4) {
+            nor_violations++;
+            return;
+        }
+
+        memset(&nor_array[nor_address & ~(size - 1)], 0xFF, size);
+    }
+
+    nor_write_enabled = 0;
+    nor_busy = NOR_BUSY_POLLS;
+}
+
+void spi_device_init(spi_device_t *device, GPIO_TypeDef *cs_port, uint16_t cs_pin, uint8_t mode, uint16_t prescaler){
+    device->cs_port = cs_port;
+    device->cs_pin = cs_pin;
+}
+
+uint8_t spi_queue_submit_chain(spi_transaction_t *const *transactions, uint8_t count){
+    for(uint8_t i = 0; i < count; i++) {
+        spi_transaction_t *transaction = transactions[i];
+
+        for(uint16_t n = 0; n < transaction->length; n++) {
+            uint8_t miso = nor_exchange(transaction->tx_buffer ? transaction->tx_buffer[n] : 0xFF);
+
+            if(transaction->rx_buffer) {
+                transaction->rx_buffer[n] = miso;
+            }
+        }
+
+        // The queue releases CS unless the chain continues
+        if(!(transaction->flags & SPI_TRANSACTION_KEEP_CS) || i == count - 1) {
+            nor_release();
+        }
+
+        transaction->status = SPI_TRANSACTION_DONE;
+    }
+
+    return 0;
+}
+
+uint8_t spi_queue_submit(spi_transaction_t *transaction){
+    return spi_queue_submit_chain(&transaction, 1);
+}
+
+void Delay_Us(uint32_t n){}
+
+static uint8_t pattern[3 * SPI_NOR_SECTOR_SIZE];
+static uint8_t buffer[3 * SPI_NOR_SECTOR_SIZE];
+
+static void fill(uint8_t *data, uint32_t length, uint32_t seed){
+    for(uint32_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 16;
+    }
+}
+
+static void test_identify(void){
+    spi_nor_config_t config = {NULL, 0, 0};
+    const blockdev_t *dev;
+
+    memset(nor_array, 0x00, sizeof(nor_array));
+    memset(nor_page, 0xFF, sizeof(nor_page));
+
+    CHECK(spi_nor_get_blockdev() == NULL);
+    CHECK_EQUAL(spi_nor_init(&config), 0);
+    CHECK_EQUAL(spi_nor_get_jedec_id(), 0xEF4014);
+    CHECK_EQUAL(spi_nor_get_capacity(), NOR_CAPACITY);
+
+    // Everything but the scratch sector
+    dev = spi_nor_get_blockdev();
+    CHECK(dev != NULL);
+    CHECK_EQUAL(dev->block_size, SPI_NOR_BLOCK_SIZE);
+    CHECK_EQUAL(dev->block_count, (NOR_CAPACITY - SPI_NOR_SECTOR_SIZE) / SPI_NOR_BLOCK_SIZE);
+}
+
+static void test_erase(void){
+    // 64 KB, then 32 KB, then 4 KB steps; the sector after stays
+    CHECK_EQUAL(spi_nor_erase(0x10000, 0x19000), 0);
+    CHECK_EQUAL(nor_erases_64k, 1);
+    CHECK_EQUAL(nor_erases_32k, 1);
+    CHECK_EQUAL(nor_erases_4k, 1);
+    CHECK_EQUAL(spi_nor_wait_ready(), 0);
+
+    for(uint32_t i = 0x10000; i < 0x29000; i++) {
+        if(nor_array[i] != 0xFF) {
+            CHECK_EQUAL(nor_array[i], 0xFF);
+            break;
+        }
+    }
+    CHECK_EQUAL(nor_array[0x0FFFF], 0x00);
+    CHECK_EQUAL(nor_array[0x29000], 0x00);
+
+    CHECK_EQUAL(spi_nor_erase(0, 3 * SPI_NOR_SECTOR_SIZE), 0);
+    CHECK_EQUAL(nor_erases_4k, 4);
+
+    CHECK_EQUAL(spi_nor_erase(0x100, SPI_NOR_SECTOR_SIZE), 1);
+    CHECK_EQUAL(spi_nor_erase(0, 0x800), 1);
+    CHECK_EQUAL(spi_nor_erase(NOR_CAPACITY - SPI_NOR_SECTOR_SIZE, 2 * SPI_NOR_SECTOR_SIZE), 1);
+}
+
+static void test_program_read(void){
+    uint32_t programs = nor_programs;
+
+    // Starts mid-page and spans three page boundaries
+    fill(pattern, 600, 1);
+    CHECK_EQUAL(spi_nor_program(0x1F0, pattern, 600), 0);
+    CHECK_EQUAL(nor_programs - programs, 4);
+    CHECK_MEMORY(&nor_array[0x1F0], pattern, 600);
+    CHECK_EQUAL(nor_array[0x1EF], 0xFF);
+    CHECK_EQUAL(nor_array[0x1F0 + 600], 0xFF);
+
+    // Small reads through the cache, a large one straight through
+    memset(buffer, 0, sizeof(buffer));
+    CHECK_EQUAL(spi_nor_read(0x1F0, buffer, 16), 0);
+    CHECK_MEMORY(buffer, pattern, 16);
+    CHECK_EQUAL(spi_nor_read(0x200, buffer, 100), 0);
+    CHECK_MEMORY(buffer, pattern + 0x10, 100);
+    CHECK_EQUAL(spi_nor_read(0x1F0, buffer, SPI_NOR_CACHE_SIZE + 1), 0);
+    CHECK_MEMORY(buffer, pattern, 600);
+    CHECK_EQUAL(buffer[600], 0xFF);
+
+    // A program inside the cached window must show in the next read
+    CHECK_EQUAL(spi_nor_read(0x500, buffer, 8), 0);
+    CHECK_EQUAL(buffer[0], 0xFF);
+    CHECK_EQUAL(spi_nor_program(0x502, (const uint8_t *)"\x12\x34", 2), 0);
+    CHECK_EQUAL(spi_nor_read(0x500, buffer, 8), 0);
+    CHECK_EQUAL(buffer[1], 0xFF);
+    CHECK_EQUAL(buffer[2], 0x12);
+    CHECK_EQUAL(buffer[3], 0x34);
+
+    // The window is pulled back to stay inside the chip
+    CHECK_EQUAL(spi_nor_read(NOR_CAPACITY - 4, buffer, 4), 0);
+    CHECK_EQUAL(spi_nor_read(NOR_CAPACITY - 4, buffer, 5), 1);
+    CHECK_EQUAL(spi_nor_program(NOR_CAPACITY, buffer, 1), 1);
+}
+
+static void test_blockdev(void){
+    const blockdev_t *dev = spi_nor_get_blockdev();
+    uint32_t sector = 0x3000;
+    uint32_t block = sector / SPI_NOR_BLOCK_SIZE;
+    uint32_t erases, programs;
+
+    CHECK_EQUAL(spi_nor_erase(sector, 2 * SPI_NOR_SECTOR_SIZE), 0);
+
+    // Erased blocks are programmed in place
+    fill(pattern, 3 * SPI_NOR_SECTOR_SIZE, 2);
+    erases = nor_erases_4k;
+    CHECK_EQUAL(dev->write(dev, block, pattern, SPI_NOR_SECTOR_SIZE / SPI_NOR_BLOCK_SIZE), 0);
+    CHECK_EQUAL(nor_erases_4k, erases);
+    CHECK_MEMORY(&nor_array[sector], pattern, SPI_NOR_SECTOR_SIZE);
+
+    // Writing the same data again programs nothing
+    programs = nor_programs;
+    CHECK_EQUAL(dev->write(dev, block + 2, pattern + 2 * SPI_NOR_BLOCK_SIZE, 1), 0);
+    CHECK_EQUAL(nor_programs, programs);
+
+    // Only clearing bits: still no erase
+    memcpy(buffer, pattern + 3 * SPI_NOR_BLOCK_SIZE, SPI_NOR_BLOCK_SIZE);
+    for(uint16_t i = 0; i < SPI_NOR_BLOCK_SIZE; i++) {
+        buffer[i] &= 0x0F;
+    }
+    CHECK_EQUAL(dev->write(dev, block + 3, buffer, 1), 0);
+    CHECK_EQUAL(nor_erases_4k, erases);
+    CHECK_MEMORY(&nor_array[sector + 3 * SPI_NOR_BLOCK_SIZE], buffer, SPI_NOR_BLOCK_SIZE);
+    memcpy(pattern + 3 * SPI_NOR_BLOCK_SIZE, buffer, SPI_NOR_BLOCK_SIZE);
+
+    // Setting bits goes through the scratch sector: it and the sector are
+    // erased, and the other seven blocks survive
+    memset(buffer, 0xA5, SPI_NOR_BLOCK_SIZE);
+    CHECK_EQUAL(dev->write(dev, block + 5, buffer, 1), 0);
+    CHECK_EQUAL(nor_erases_4k - erases, 2);
+    memcpy(pattern + 5 * SPI_NOR_BLOCK_SIZE, buffer, SPI_NOR_BLOCK_SIZE);
+    CHECK_MEMORY(&nor_array[sector], pattern, SPI_NOR_SECTOR_SIZE);
+
+    // Across a sector boundary, the second sector still erased
+    fill(buffer, 4 * SPI_NOR_BLOCK_SIZE, 3);
+    erases = nor_erases_4k;
+    CHECK_EQUAL(dev->write(dev, block + 6, buffer, 4), 0);
+    CHECK_EQUAL(nor_erases_4k - erases, 2);
+    memcpy(pattern + 6 * SPI_NOR_BLOCK_SIZE, buffer, 4 * SPI_NOR_BLOCK_SIZE);
+    memset(pattern + 10 * SPI_NOR_BLOCK_SIZE, 0xFF, 6 * SPI_NOR_BLOCK_SIZE);
+    CHECK_MEMORY(&nor_array[sector], pattern, 2 * SPI_NOR_SECTOR_SIZE);
+
+    CHECK_EQUAL(dev->sync(dev), 0);
+    memset(buffer, 0, sizeof(buffer));
+    CHECK_EQUAL(dev->read(dev, block, buffer, 16), 0);
+    CHECK_MEMORY(buffer, pattern, 2 * SPI_NOR_SECTOR_SIZE);
+
+    CHECK_EQUAL(dev->write(dev, dev->block_count - 1, buffer, 2), 1);
+    CHECK_EQUAL(dev->read(dev, dev->block_count, buffer, 1), 1);
+}
+
+int main(void){
+    test_identify();
+    test_erase();
+    test_program_read();
+    test_blockdev();
+
+    CHECK_EQUAL(nor_violations, 0);
+
+    return test_summary("spi_nor");
+}
@@ -0,0 +1,34 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+#include <string.h>
+
+// Minimal checks for the host tests: a failed check prints where it is and
+// the test's main() returns the failure count
+static int test_failures = 0;
+
+#define CHECK(condition) do { \
+    if(!(condition)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        test_failures++; \
+    } \
+} while(0)
+
+#define CHECK_EQUAL(actual, expected) do { \
+    long long test_actual = (long long)(actual); \
+    long long test_expected = (long long)(expected); \
+    if(test_actual != test_expected) { \
+        printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, test_actual, test_expected); \
+        test_failures++; \
+    } \
+} while(0)
+
+#define CHECK_MEMORY(actual, expected, length) CHECK(memcmp((actual), (expected), (length)) == 0)
+
+static inline int test_summary(const char *name){
+    printf("%s: %s (%d failed)\n", name, test_failures ? "FAIL" : "ok", test_failures);
+    return test_failures != 0;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Modbus RTU master for exercising the Modbus Slave app over a USB-RS485 adapter.
+
+Usage: modbus_master.py /dev/ttyUSB0 [--baud 115200] [--address 0x11]
+Requires pyserial.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+import serial
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+class Master:
+    def __init__(self, port, baud, address):
+        self.serial = serial.Serial(port, baud, timeout=0.1)
+        self.address = address
+        # t3.5 as the slave measures it, plus margin
+        self.gap = 0.00175 if baud > 19200 else 38.5 / baud
+
+    def request(self, pdu, expected_length):
+        frame = bytes([self.address]) + pdu
+        frame += struct.pack('<H', crc16(frame))
+        time.sleep(self.gap)
+        self.serial.reset_input_buffer()
+        start = time.perf_counter()
+        self.serial.write(frame)
+        response = self.serial.read(expected_length)
+        elapsed = time.perf_counter() - start
+        if len(response) >= 5 and response[1] & 0x80:
+            response += self.serial.read(5 - len(response))
+        if len(response) < 5:
+            raise IOError('timeout, got %r' % response)
+        if crc16(response[:-2]) != struct.unpack('<H', response[-2:])[0]:
+            raise IOError('bad CRC in %r' % response)
+        if response[1] & 0x80:
+            raise ValueError('exception 0x%02X' % response[2])
+        return response[1:-2], elapsed
+
+    def read_holding(self, start, count):
+        pdu, elapsed = self.request(struct.pack('>BHH', 0x03, start, count), 5 + count * 2)
+        return list(struct.unpack('>%dH' % count, pdu[2:])), elapsed
+
+    def read_input(self, start, count):
+        pdu, _ = self.request(struct.pack('>BHH', 0x04, start, count), 5 + count * 2)
+        return list(struct.unpack('>%dH' % count, pdu[2:]))
+
+    def write_register(self, address, value):
+        self.request(struct.pack('>BHH', 0x06, address, value), 8)
+
+    def write_registers(self, start, values):
+        pdu = struct.pack('>BHHB', 0x10, start, len(values), len(values) * 2)
+        pdu += struct.pack('>%dH' % len(values), *values)
+        self.request(pdu, 8)
+
+    def write_coil(self, address, on):
+        self.request(struct.pack('>BHH', 0x05, address, 0xFF00 if on else 0), 8)
+
+    def read_coils(self, start, count):
+        pdu, _ = self.request(struct.pack('>BHH', 0x01, start, count), 5 + (count + 7) // 8)
+        return pdu[2:]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('port')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--address', type=lambda v: int(v, 0), default=0x11)
+    parser.add_argument('--iterations', type=int, default=100)
+    args = parser.parse_args()
+
+    master = Master(args.port, args.baud, args.address)
+    failures = 0
+
+    values = [0x1234, 0xBEEF, 7, 0]
+    master.write_registers(0, values)
+    read, _ = master.read_holding(0, 4)
+    if read != values:
+        print('FAIL write/read multiple: %r' % read)
+        failures += 1
+
+    master.write_register(5, 0x5A5A)
+    read, _ = master.read_holding(5, 1)
+    if read != [0x5A5A]:
+        print('FAIL write/read single: %r' % read)
+        failures += 1
+
+    master.write_coil(0, True)
+    if master.read_coils(0, 8)[0] & 1 != 1:
+        print('FAIL coil 0 not set')
+        failures += 1
+    master.write_coil(0, False)
+
+    try:
+        master.read_holding(100, 1)
+        print('FAIL no exception for illegal address')
+        failures += 1
+    except ValueError:
+        pass
+
+    print('Input registers: %r' % master.read_input(0, 4))
+
+    # Request-to-response time, including both frames on the wire
+    times = [master.read_holding(0, 8)[1] for _ in range(args.iterations)]
+    print('Read 8 registers: min %.3f ms, avg %.3f ms, max %.3f ms' % (
+        min(times) * 1e3, sum(times) / len(times) * 1e3, max(times) * 1e3))
+
+    print('%d failure(s)' % failures)
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
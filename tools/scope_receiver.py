@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Receiver for the ADC Scope app: rebuilds the sample stream and reports drops.
+
+Usage: scope_receiver.py /dev/ttyUSB0 [--baud 2000000] [--seconds 10] [--csv out.csv]
+Requires pyserial.
+
+Each half buffer arrives as a 16-byte header (see adc_stream.h) followed by
+the samples. A frame only counts once the next header shows up right behind
+it, so one cut short by the device is discarded rather than misread.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+import serial
+
+SYNC = b'\xa5\x5a'
+HEADER = struct.Struct('<HHIIHBB')
+
+
+def check_byte(header):
+    check = 0
+    for byte in header[:-1]:
+        check ^= byte
+    return check
+
+
+class Receiver:
+    def __init__(self, csv=None):
+        self.buffer = bytearray()
+        self.csv = csv
+        self.channels = None
+        self.sequence = None
+        self.timestamp = None
+        self.frames = 0
+        self.dropped = 0
+        self.discarded = 0
+        self.samples = 0
+        self.rate = 0.0
+        self.means = []
+
+    def feed(self, data):
+        self.buffer += data
+
+        while True:
+            start = self.buffer.find(SYNC)
+            if start < 0:
+                del self.buffer[:-1]
+                return
+            if start:
+                self.discarded += start
+                del self.buffer[:start]
+            if len(self.buffer) < HEADER.size:
+                return
+
+            header = bytes(self.buffer[:HEADER.size])
+            _, sequence, timestamp, mask, frames, count, check = HEADER.unpack(header)
+            if check != check_byte(header) or count == 0:
+                self.discarded += 1
+                del self.buffer[:1]
+                continue
+
+            end = HEADER.size + frames * count * 2
+            if len(self.buffer) < end + len(SYNC):
+                return
+            if self.buffer[end:end + len(SYNC)] != SYNC:
+                # Cut short: the next header started inside the samples
+                self.discarded += 1
+                del self.buffer[:1]
+                continue
+
+            samples = struct.unpack_from('<%dH' % (frames * count), self.buffer, HEADER.size)
+            del self.buffer[:end]
+            self.frame(sequence, timestamp, mask, frames, count, samples)
+
+    def frame(self, sequence, timestamp, mask, frames, count, samples):
+        if self.sequence is not None:
+            gap = (sequence - self.sequence - 1) & 0xFFFF
+            self.dropped += gap
+            interval = (timestamp - self.timestamp) & 0xFFFFFFFF
+            if interval:
+                self.rate = frames * (gap + 1) * 1e6 / interval
+            if gap and self.csv:
+                self.csv.write('# %d half buffer(s) dropped\n' % gap)
+        elif self.csv:
+            channels = [n for n in range(32) if mask >> n & 1]
+            self.csv.write(','.join('ch%d' % n for n in channels) + '\n')
+
+        self.sequence = sequence
+        self.timestamp = timestamp
+        self.channels = [n for n in range(32) if mask >> n & 1]
+        self.frames += 1
+        self.samples += len(samples)
+        self.means = [sum(samples[i::count]) / frames for i in range(count)]
+
+        if self.csv:
+            for i in range(0, len(samples), count):
+                self.csv.write(','.join(str(v) for v in samples[i:i + count]) + '\n')
+
+    def report(self, elapsed):
+        means = ' '.join('ch%d=%.1f' % (n, m) for n, m in zip(self.channels or [], self.means))
+        print('%d frames, %d dropped, %d bytes discarded, %.0f samples/s, %.1f kframes/s %s' % (
+            self.frames, self.dropped, self.discarded, self.samples / elapsed, self.rate / 1e3, means))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('port')
+    parser.add_argument('--baud', type=int, default=2000000)
+    parser.add_argument('--seconds', type=float, default=10)
+    parser.add_argument('--csv', type=argparse.FileType('w'))
+    args = parser.parse_args()
+
+    port = serial.Serial(args.port, args.baud, timeout=0.1)
+    receiver = Receiver(args.csv)
+    start = time.perf_counter()
+    next_report = start + 1
+
+    while True:
+        receiver.feed(port.read(max(port.in_waiting, 1)))
+        now = time.perf_counter()
+        if now >= next_report:
+            receiver.report(now - start)
+            next_report += 1
+        if now - start >= args.seconds:
+            break
+
+    receiver.report(time.perf_counter() - start)
+    if receiver.frames == 0:
+        print('No frames received')
+        return 1
+    return 1 if receiver.dropped else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())